@@ -107,6 +107,10 @@ build_test_tools() {
         mkdir -p $WORKING_DIR/test
         mv -f vcmipidemo $WORKING_DIR/test
         mv -f vcimgnetsrv $WORKING_DIR/test
+        cd $WORKING_DIR/src/vctools
+        make clean
+        make CROSS_COMPILE=$CROSS_COMPILE
+        mv -f vccapture vcbench vcrecord vcctl $WORKING_DIR/test
 }
 
 while [ $# != 0 ] ; do
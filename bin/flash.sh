@@ -47,7 +47,7 @@ flash_test_tools() {
         TARGET_DIR=/home/$TARGET_USER/test
         $TARGET_SHELL rm -Rf $TARGET_DIR
         $TARGET_SHELL mkdir -p $TARGET_DIR
-        scp $WORKING_DIR/test/* $TARGET_USER@$TARGET_IP:$TARGET_DIR
+        scp $WORKING_DIR/test/*.sh $TARGET_USER@$TARGET_IP:$TARGET_DIR
 }
 
 reboot_target() {
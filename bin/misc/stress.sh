@@ -0,0 +1,12 @@
+#!/bin/bash
+#
+# Runs stressor.sh on the target. Usage: stress.sh [seconds]
+clear
+
+. config/configure.sh
+
+TARGET_DIR=/home/root
+STRESSOR=stressor.sh
+
+scp $STRESSOR root@$TARGET_IP:$TARGET_DIR
+$TARGET_SHELL sh $TARGET_DIR/$STRESSOR $1
@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Sets and reads controls from several processes while the stream is started and stopped over
+# and over again. Afterwards the kernel log is checked for I2C errors and the driver must still
+# answer. Usage: stressor.sh [seconds]
+
+DURATION=${1:-60}
+VIDEO=/dev/video0
+SUBDEV=/dev/v4l-subdev1
+LOG=/tmp/stressor
+
+rm -rf $LOG
+mkdir -p $LOG
+dmesg -c > /dev/null
+
+END=$(($(date +%s) + DURATION))
+
+stream() {
+        while [ $(date +%s) -lt $END ]; do
+                v4l2-ctl -d $VIDEO --stream-mmap --stream-count=5 > /dev/null 2>> $LOG/stream
+        done
+}
+
+set_ctrl() {
+        # $1: control, $2 $3: range
+        while [ $(date +%s) -lt $END ]; do
+                VALUE=$(($2 + RANDOM % ($3 - $2 + 1)))
+                v4l2-ctl -d $SUBDEV -c $1=$VALUE 2>> $LOG/$1
+        done
+}
+
+get_ctrls() {
+        while [ $(date +%s) -lt $END ]; do
+                v4l2-ctl -d $SUBDEV -C exposure,gain,streamon_latency > /dev/null 2>> $LOG/get
+                v4l2-ctl -d $SUBDEV --get-subdev-fmt 0 > /dev/null 2>> $LOG/get
+        done
+}
+
+echo "Stressing $SUBDEV for $DURATION s ..."
+stream &
+set_ctrl exposure 100 20000 &
+set_ctrl gain 0 100 &
+set_ctrl black_level 0 100 &
+get_ctrls &
+get_ctrls &
+wait
+
+echo "Errors of the control and stream processes:"
+sort $LOG/* | uniq -c
+echo "I2C errors in the kernel log:"
+dmesg | grep -c -i "unable\|couldn't\|error"
+echo "Last StreamOn latency:"
+v4l2-ctl -d $SUBDEV -C streamon_latency
@@ -39,7 +39,7 @@ copy_device_tree() {
 copy_test_tools() {
         echo "Copy test tools ..."
         sudo mkdir -p $NFS_DIR/home/root/test
-        sudo cp $WORKING_DIR/test/* $NFS_DIR/home/root/test
+        sudo cp $WORKING_DIR/test/*.sh $NFS_DIR/home/root/test
 }
 
 while [ $# != 0 ] ; do
@@ -7,12 +7,16 @@
 #include <linux/device.h>
 #include <linux/gpio/consumer.h>
 #include <linux/init.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/of_device.h>
 #include <linux/regulator/consumer.h>
 #include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/delay.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/vc_mipi_camera.h>
 #include <media/v4l2-async.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
@@ -25,6 +29,35 @@ struct vc_device {
 	struct v4l2_ctrl_handler ctrl_handler;
 	struct media_pad pad;
 	struct v4l2_fwnode_endpoint ep; 	// the parsed DT endpoint info
+	struct v4l2_ctrl *link_freq;
+	struct v4l2_ctrl *pixel_rate;
+	struct v4l2_ctrl *hblank;
+	struct v4l2_ctrl *vblank;
+	struct v4l2_ctrl *gain;
+	struct v4l2_ctrl *analogue_gain;
+	struct v4l2_ctrl *streamon_latency;
+	struct v4l2_ctrl *bracket_interval;
+	struct v4l2_ctrl *recovery_count;
+	struct v4l2_ctrl *recovery_failures;
+	// Timed exposure bracket
+	struct work_struct bracket_work;
+	__u32 bracket[VC_BRACKET_MAX];	// µs
+	int bracket_count;
+	int bracket_busy;
+	// Software trigger ioctl
+	__u32 trigger_sequence;
+	const char *test_pattern_menu[VC_TEST_PATTERN_MAX];
+	// Stream watchdog
+	struct delayed_work watchdog_work;
+	int watchdog_ms;		// Period of the status check, 0 = disabled
+	int stopping;			// STREAMOFF cancels the watchdog, a running recovery gives up
+	__u32 recoveries;
+	__u32 failed_recoveries;
+	wait_queue_head_t reset_done;	// Woken up when state.resetting is cleared
+	__s64 link_freqs[ARRAY_SIZE(((struct vc_desc *)0)->modes)];
+	int exposure_lines;		// V4L2_CID_EXPOSURE in lines instead of µs
+	int gain_sync;
+	int link_update;		// VBLANK is clamped to the range of a new mode
 
 	struct vc_cam cam;
 };
@@ -40,6 +73,91 @@ static inline struct vc_cam *to_vc_cam(struct v4l2_subdev *sd)
 	return &device->cam;
 }
 
+// Publishes the link frequency, the pixel rate and the blanking of the given mode. The caller has
+// to hold the lock of the control handler.
+static void vc_sd_update_link_ctrls(struct vc_device *device, int mode)
+{
+	struct vc_cam *cam = &device->cam;
+	__s64 freq = vc_core_get_link_freq(cam, mode);
+	__s64 pixel_rate = vc_core_get_pixel_rate(cam, mode);
+	struct vc_control vblank;
+	__u32 hblank;
+	int index;
+
+	if (freq == 0 || !device->link_freq || !device->pixel_rate)
+		return;
+
+	for (index = 0; index <= device->link_freq->maximum; index++) {
+		if (device->link_freqs[index] == freq) {
+			__v4l2_ctrl_s_ctrl(device->link_freq, index);
+			break;
+		}
+	}
+	__v4l2_ctrl_s_ctrl_int64(device->pixel_rate, pixel_rate);
+
+	if (device->hblank) {
+		hblank = vc_core_get_hblank(cam, pixel_rate);
+		__v4l2_ctrl_modify_range(device->hblank, hblank, hblank, 1, hblank);
+	}
+	if (device->vblank) {
+		// A clamped value is only cached. The module may not be in the mode yet.
+		vc_core_get_vblank_range(cam, &vblank);
+		device->link_update = 1;
+		__v4l2_ctrl_modify_range(device->vblank, vblank.min, vblank.max, 1, vblank.def);
+		device->link_update = 0;
+	}
+}
+
+static void vc_sd_update_link(struct vc_device *device, int mode)
+{
+	if (!device->link_freq)
+		return;
+
+	v4l2_ctrl_lock(device->link_freq);
+	vc_sd_update_link_ctrls(device, mode);
+	v4l2_ctrl_unlock(device->link_freq);
+}
+
+// --- Module reset ------------------------------------------------------------
+
+// Waits until the module has booted after the reset started by vc_mod_set_mode(). This is the only
+// place where the mutex is released within a hardware sequence, so that controls and get paths
+// are not blocked meanwhile. They see state.resetting and only cache their settings.
+static int vc_sd_wait_for_module(struct vc_device *device)
+{
+	struct vc_cam *cam = &device->cam;
+	int ret = -EAGAIN;
+	int try;
+
+	for (try = 0; try < 10 && ret == -EAGAIN && !device->stopping; try++) {
+		vc_core_unlock(cam);
+		usleep_range(200000, 200000);
+		vc_core_lock(cam);
+		vc_core_stats_sleep(cam, 200000);
+		ret = vc_mod_poll_ready(cam);
+	}
+	if (ret == -EAGAIN)
+		ret = device->stopping ? -ECANCELED : -ETIMEDOUT;
+
+	vc_mod_end_reset(cam, ret);
+	wake_up_all(&device->reset_done);
+
+	return ret;
+}
+
+// Takes the mutex when no module reset is running. Operations which would interfere with the reset
+// (stream control, format and crop) wait for its end instead of failing.
+static void vc_sd_lock(struct vc_device *device)
+{
+	struct vc_cam *cam = &device->cam;
+
+	vc_core_lock(cam);
+	while (cam->state.resetting) {
+		vc_core_unlock(cam);
+		wait_event(device->reset_done, !cam->state.resetting);
+		vc_core_lock(cam);
+	}
+}
 
 // --- v4l2_subdev_core_ops ---------------------------------------------------
 
@@ -48,78 +166,257 @@ static int vc_sd_s_power(struct v4l2_subdev *sd, int on)
 	return 0;
 }
 
-static int vc_sd_s_ctrl(struct v4l2_subdev *sd, struct v4l2_control *control)
+// The caller has to hold the camera mutex.
+static int __vc_sd_s_ctrl(struct v4l2_subdev *sd, struct v4l2_control *control)
 {
+	struct vc_device *device = to_vc_device(sd);
 	struct vc_cam *cam = to_vc_cam(sd);
 	struct device *dev = vc_core_get_sen_device(cam);
+	struct vc_i2c_stats stats;
+	char *op;
+	int ret;
+
+	vc_core_stats_snapshot(cam, &stats);
 
 	switch (control->id) {
 	case V4L2_CID_EXPOSURE:
-		return vc_sen_set_exposure(cam, control->value);
+		op = "exposure";
+		if (device->exposure_lines)
+			ret = vc_sen_set_exposure_lines(cam, control->value);
+		else
+			ret = vc_sen_set_exposure(cam, control->value);
+		break;
 
 	case V4L2_CID_GAIN:
-		return vc_sen_set_gain(cam, control->value);
+	case V4L2_CID_ANALOGUE_GAIN:
+		op = "gain";
+		ret = vc_sen_set_gain(cam, control->value);
+		break;
+
+	case V4L2_CID_VBLANK:
+		op = "vblank";
+		ret = vc_core_set_vblank(cam, control->value);
+		break;
 
 	case V4L2_CID_BLACK_LEVEL:
-		return vc_sen_set_blacklevel(cam, control->value);
+		op = "black_level";
+		ret = vc_sen_set_blacklevel(cam, control->value);
+		break;
+
+	case V4L2_CID_TEST_PATTERN:
+		op = "test_pattern";
+		ret = vc_sen_set_test_pattern(cam, control->value);
+		break;
 
 	case V4L2_CID_TRIGGER_MODE:
-		return vc_mod_set_trigger_mode(cam, control->value);
+		op = "trigger_mode";
+		ret = vc_mod_set_trigger_mode(cam, control->value);
+		break;
 
 	case V4L2_CID_FLASH_MODE:
-		return vc_mod_set_io_mode(cam, control->value);
+		op = "flash_mode";
+		ret = vc_mod_set_io_mode(cam, control->value);
+		break;
 
 	case V4L2_CID_FRAME_RATE:
-		return vc_core_set_framerate(cam, control->value);
+		op = "frame_rate";
+		ret = vc_core_set_framerate(cam, control->value);
+		break;
 
         case V4L2_CID_SINGLE_TRIGGER:
-                return vc_mod_set_single_trigger(cam);
+		op = "single_trigger";
+                ret = vc_mod_set_single_trigger(cam);
+		break;
 
 	default:
 		vc_warn(dev, "%s(): Unkown control 0x%08x\n", __FUNCTION__, control->id);
 		return -EINVAL;
 	}
 
-	return 0;
+	vc_core_stats_report(cam, &stats, op);
+
+	return ret;
+}
+
+static int vc_sd_s_ctrl(struct v4l2_subdev *sd, struct v4l2_control *control)
+{
+	struct vc_cam *cam = to_vc_cam(sd);
+	int ret;
+
+	vc_core_lock(cam);
+	ret = __vc_sd_s_ctrl(sd, control);
+	vc_core_unlock(cam);
+
+	return ret;
 }
 
 // --- v4l2_subdev_video_ops ---------------------------------------------------
 
+static int vc_sd_start_stream(struct v4l2_subdev *sd, int *restore)
+{
+	struct vc_device *device = to_vc_device(sd);
+	struct vc_cam *cam = to_vc_cam(sd);
+	struct vc_state *state = &cam->state;
+	int try, restored;
+	int ret = 0;
+
+	for (try = 0; try < 3; try++) {
+		ret = vc_mod_set_mode(cam, restore);
+		if (ret == -EINVAL) {
+			// No module mode for the requested format and trigger mode.
+			return ret;
+		}
+		if (ret || !state->resetting)
+			break;
+		ret = vc_sd_wait_for_module(device);
+		// A control (e.g. the trigger mode) may have changed the planned mode meanwhile.
+		if (ret || vc_mod_plan_mode(cam) == state->mode)
+			break;
+		vc_notice(sd->dev, "%s(): Mode changed during the reset. Resetting again.\n", __FUNCTION__);
+	}
+	// The module isn't in the mode (e.g. not ready after the reset or STREAMOFF has canceled the
+	// reset), so the sensor isn't started.
+	if (ret)
+		return ret;
+	vc_sd_update_link_ctrls(to_vc_device(sd), state->mode);
+	// Writes the exposure and VMAX including a VBLANK clamped by the new mode.
+	restored = vc_sen_restore(cam);
+	ret = vc_sen_start_stream(cam);
+
+	return ret ? ret : restored;
+}
+
+// --- Stream watchdog ---------------------------------------------------------
+
+// Resets the module and replays the cached settings. The stream is only streaming again when the
+// restart succeeded, otherwise the application has to restart it. The caller has to hold the camera
+// mutex.
+static void vc_watchdog_recover(struct vc_device *device)
+{
+	struct v4l2_subdev *sd = &device->sd;
+	struct vc_cam *cam = &device->cam;
+	struct vc_state *state = &cam->state;
+	struct device *dev = sd->dev;
+	ktime_t start = ktime_get();
+	int restore = 0;
+	int ret;
+
+	vc_warn(dev, "%s(): Module stalled. Resetting the module.\n", __FUNCTION__);
+
+	// The module has lost its settings, nothing has to be stopped.
+	state->streaming = 0;
+	vc_mod_invalidate_mode(cam);
+	ret = vc_sd_start_stream(sd, &restore);
+	if (ret) {
+		// vc_sen_start_stream() marks the sensor as streaming even if the start failed.
+		state->streaming = 0;
+		if (ret == -ECANCELED) {
+			vc_notice(dev, "%s(): Recovery canceled by stream off\n", __FUNCTION__);
+			return;
+		}
+		// The control event tells the application that the stream has stopped.
+		device->failed_recoveries++;
+		if (device->recovery_failures)
+			__v4l2_ctrl_s_ctrl(device->recovery_failures, 
+				min_t(__u32, device->failed_recoveries, S32_MAX));
+		vc_err(dev, "%s(): Recovery failed, the stream has to be restarted (error: %d)\n", 
+			__FUNCTION__, ret);
+		return;
+	}
+
+	device->recoveries++;
+	if (device->recovery_count)
+		__v4l2_ctrl_s_ctrl(device->recovery_count, min_t(__u32, device->recoveries, S32_MAX));
+	vc_notice(dev, "%s(): Stream recovered in %lld us (recoveries: %u)\n", __FUNCTION__,
+		ktime_us_delta(ktime_get(), start), device->recoveries);
+}
+
+static void vc_watchdog_work(struct work_struct *work)
+{
+	struct vc_device *device = container_of(to_delayed_work(work), struct vc_device, watchdog_work);
+	struct vc_cam *cam = &device->cam;
+
+	vc_core_lock(cam);
+	if (!cam->state.streaming || device->stopping) {
+		vc_core_unlock(cam);
+		return;
+	}
+	if (vc_mod_check_status(cam))
+		vc_watchdog_recover(device);
+	// A failed or canceled recovery leaves the stream stopped.
+	if (cam->state.streaming && !device->stopping)
+		schedule_delayed_work(&device->watchdog_work, msecs_to_jiffies(device->watchdog_ms));
+	vc_core_unlock(cam);
+}
+
 static int vc_sd_s_stream(struct v4l2_subdev *sd, int enable)
 {
 	struct vc_cam *cam = to_vc_cam(sd);
-	// struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_ctrl *ctrl = &cam->ctrl;
 	struct vc_state *state = &cam->state;
 	struct device *dev = sd->dev;
-	struct vc_frame *frame = vc_core_get_frame(cam);
-	int reset = 0;
+	struct vc_device *device = to_vc_device(sd);
+	struct vc_i2c_stats stats;
+	ktime_t start = ktime_get();
+	s64 latency_us;
+	int restore = 0;
 	int ret = 0;
 
 	vc_notice(dev, "%s(): Set streaming: %s\n", __FUNCTION__, enable ? "on" : "off");
 
+	// The watchdog is canceled before waiting for a running reset, so that a recovery which is
+	// waiting for the module gives up instead of restarting the stream. The work takes the mutex.
+	if (!enable && device->watchdog_ms) {
+		vc_core_lock(cam);
+		device->stopping = 1;
+		vc_core_unlock(cam);
+		cancel_delayed_work_sync(&device->watchdog_work);
+	}
+
+	vc_sd_lock(device);
+
+	vc_core_stats_snapshot(cam, &stats);
+
 	if (enable) {
 		if (state->streaming == 1) {
 			vc_warn(dev, "%s(): Sensor is already streaming!\n", __FUNCTION__);
 			ret = vc_sen_stop_stream(cam);
 		}
 
-		ret  = vc_mod_set_mode(cam, &reset);
-		if (!ret && reset) {
-			ret |= vc_sen_set_roi(cam, frame->x, frame->y, frame->width, frame->height);
-			ret |= vc_sen_set_exposure(cam, cam->state.exposure);
-			ret |= vc_sen_set_gain(cam, cam->state.gain);
-			ret |= vc_sen_set_blacklevel(cam, cam->state.blacklevel);
+		ret = vc_sd_start_stream(sd, &restore);
+		if (ret == -EINVAL) {
+			vc_core_unlock(cam);
+			return ret;
 		}
-		ret |= vc_sen_start_stream(cam);
-		if (ret == 0)
+		if (ret && (ctrl->flags & FLAG_RESET_ALWAYS) && restore != RESTORE_ALL) {
+			vc_warn(dev, "%s(): Restart without reset failed! Resetting the module.\n", __FUNCTION__);
+			vc_mod_invalidate_mode(cam);
+			ret = vc_sd_start_stream(sd, &restore);
+		}
+		if (ret == 0) {
+			// The sensor is operating when vc_sd_start_stream() returns.
+			latency_us = ktime_us_delta(ktime_get(), start);
 			state->streaming = 1;
+			device->trigger_sequence = 0;
+			vc_core_stats_streamon(cam, latency_us);
+			if (device->streamon_latency)
+				__v4l2_ctrl_s_ctrl(device->streamon_latency, min_t(s64, latency_us, S32_MAX));
+			if (device->watchdog_ms)
+				schedule_delayed_work(&device->watchdog_work, msecs_to_jiffies(device->watchdog_ms));
+		}
 
 	} else {
+		device->stopping = 0;
 		ret = vc_sen_stop_stream(cam);
 		if (ret == 0)
 			state->streaming = 0;
 	}
 
+	vc_core_stats_report(cam, &stats, enable ? ((restore == RESTORE_ALL) ? "streamon_cold" : "streamon_warm") : 
+		"streamoff");
+
+	vc_core_unlock(cam);
+
 	return ret;
 }
 
@@ -129,11 +426,14 @@ static int vc_sd_get_fmt(struct v4l2_subdev *sd, struct v4l2_subdev_pad_config *
 {
 	struct vc_cam *cam = to_vc_cam(sd);
 	struct v4l2_mbus_framefmt *mf = &format->format;
-	struct vc_frame* frame = vc_core_get_frame(cam);
+	struct vc_state state;
 
-	mf->code = vc_core_get_format(cam);
-	mf->width = frame->width;
-	mf->height = frame->height;
+	// Doesn't wait for a running module reset.
+	vc_core_get_state(cam, &state);
+
+	mf->code = state.format_code;
+	mf->width = state.frame.width;
+	mf->height = state.frame.height;
 	// mf->reserved[1] = 30;
 
 	return 0;
@@ -143,25 +443,253 @@ static int vc_sd_set_fmt(struct v4l2_subdev *sd, struct v4l2_subdev_pad_config *
 {
 	struct vc_cam *cam = to_vc_cam(sd);
 	struct v4l2_mbus_framefmt *mf = &format->format;
+	struct vc_i2c_stats stats;
+
+	vc_sd_lock(to_vc_device(sd));
+	vc_core_stats_snapshot(cam, &stats);
 
 	vc_core_set_format(cam, mf->code);
 	vc_core_set_frame(cam, 0, 0, mf->width, mf->height);
+	vc_sd_update_link_ctrls(to_vc_device(sd), vc_mod_plan_mode(cam));
+
+	vc_core_stats_report(cam, &stats, "set_fmt");
+
+	vc_core_unlock(cam);
 	
 	return 0;
 }
 
+static int vc_sd_get_selection(struct v4l2_subdev *sd, struct v4l2_subdev_pad_config *cfg, struct v4l2_subdev_selection *sel)
+{
+	struct vc_cam *cam = to_vc_cam(sd);
+	struct vc_state state;
+	struct vc_frame *frame = &state.frame;
+
+	vc_core_get_state(cam, &state);
+
+	switch (sel->target) {
+	case V4L2_SEL_TGT_CROP:
+		sel->r.left = frame->x;
+		sel->r.top = frame->y;
+		sel->r.width = frame->width;
+		sel->r.height = frame->height;
+		return 0;
+
+	case V4L2_SEL_TGT_CROP_DEFAULT:
+	case V4L2_SEL_TGT_CROP_BOUNDS:
+	case V4L2_SEL_TGT_NATIVE_SIZE:
+		sel->r.left = 0;
+		sel->r.top = 0;
+		sel->r.width = cam->ctrl.frame.width;
+		sel->r.height = cam->ctrl.frame.height;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static int vc_sd_set_selection(struct v4l2_subdev *sd, struct v4l2_subdev_pad_config *cfg, struct v4l2_subdev_selection *sel)
+{
+	struct vc_cam *cam = to_vc_cam(sd);
+	struct vc_frame *frame = &cam->state.frame;
+	struct device *dev = sd->dev;
+	int ret = 0;
+
+	if (sel->target != V4L2_SEL_TGT_CROP)
+		return -EINVAL;
+
+	vc_sd_lock(to_vc_device(sd));
+	if (cam->state.streaming) {
+		// While streaming the ROI can only be moved (pan). The size would change the buffers.
+		if (sel->r.width != frame->width || sel->r.height != frame->height) {
+			vc_err(dev, "%s(): Crop size can't be changed while streaming!\n", __FUNCTION__);
+			vc_core_unlock(cam);
+			return -EBUSY;
+		}
+		ret = vc_sen_move_roi(cam, sel->r.left, sel->r.top);
+	} else {
+		vc_core_set_frame(cam, sel->r.left, sel->r.top, sel->r.width, sel->r.height);
+		vc_sd_update_link_ctrls(to_vc_device(sd), vc_mod_plan_mode(cam));
+	}
+
+	sel->r.left = frame->x;
+	sel->r.top = frame->y;
+	sel->r.width = frame->width;
+	sel->r.height = frame->height;
+
+	vc_core_unlock(cam);
+
+	return ret;
+}
+
+// --- Timed exposure bracket ------------------------------------------------
+
+// Fires the single triggers of the bracket back to back, timed by the estimated frame time. The
+// bracket is best effort: the triggers are not synchronized to the frames. A trigger which reaches
+// the module while it still exposes or reads out the previous frame is lost, and the application
+// has to assign the frames to the exposures itself. The mutex is only held while the
+// registers are written, so that controls can be set between the frames.
+static void vc_bracket_work(struct work_struct *work)
+{
+	struct vc_device *device = container_of(work, struct vc_device, bracket_work);
+	struct vc_cam *cam = &device->cam;
+	struct device *dev = vc_core_get_sen_device(cam);
+	ktime_t first = 0;
+	ktime_t last = 0;
+	__u32 frame_us = 0;
+	__u32 interval = 0;
+	int index;
+	int ret = 0;
+
+	for (index = 0; index < device->bracket_count; index++) {
+		if (index > 0)
+			usleep_range(frame_us, frame_us + 100);
+
+		vc_core_lock(cam);
+		last = ktime_get();
+		if (index == 0)
+			first = last;
+		ret = vc_mod_bracket_trigger(cam, device->bracket[index], &frame_us);
+		vc_core_unlock(cam);
+		if (ret)
+			break;
+	}
+
+	if (index > 1)
+		interval = ktime_us_delta(last, first) / (index - 1);
+
+	vc_core_lock(cam);
+	vc_mod_bracket_end(cam);
+	if (device->bracket_interval)
+		__v4l2_ctrl_s_ctrl(device->bracket_interval, interval);
+	device->bracket_busy = 0;
+	vc_core_unlock(cam);
+
+	vc_notice(dev, "%s(): Bracket of %d exposures triggered (interval: %u us)\n", __FUNCTION__,
+		index, interval);
+}
+
+// Loads the exposures (µs, 0 ends the list) and starts the bracket. The caller has to hold the
+// camera mutex.
+static int vc_bracket_start(struct vc_device *device, __u32 *exposures)
+{
+	struct vc_cam *cam = &device->cam;
+	struct vc_state *state = &cam->state;
+	struct device *dev = vc_core_get_sen_device(cam);
+	int count = 0;
+
+	if (!state->streaming || vc_mod_get_trigger_mode(cam) != 4) {
+		vc_err(dev, "%s(): Bracketing needs a stream in single trigger mode!\n", __FUNCTION__);
+		return -EBUSY;
+	}
+	if (device->bracket_busy) {
+		vc_err(dev, "%s(): Bracket is still running!\n", __FUNCTION__);
+		return -EBUSY;
+	}
+
+	while (count < VC_BRACKET_MAX && exposures[count] > 0) {
+		device->bracket[count] = exposures[count];
+		count++;
+	}
+	if (count == 0)
+		return 0;
+
+	device->bracket_count = count;
+	device->bracket_busy = 1;
+	schedule_work(&device->bracket_work);
+
+	return 0;
+}
+
+// --- Multi ROI ---------------------------------------------------------------
+
+// The control holds x, y, width and height of each window. A window with width 0 ends the list.
+// The caller has to hold the camera mutex.
+static int vc_sd_set_multi_roi(struct vc_device *device, __u32 *values)
+{
+	struct vc_frame rois[VC_ROI_MAX];
+	int count = 0;
+
+	while (count < VC_ROI_MAX && values[4*count + 2] > 0) {
+		rois[count].x = values[4*count];
+		rois[count].y = values[4*count + 1];
+		rois[count].width = values[4*count + 2];
+		rois[count].height = values[4*count + 3];
+		count++;
+	}
+
+	return vc_sen_set_multi_roi(&device->cam, rois, count);
+}
+
 // --- v4l2_ctrl_ops ---------------------------------------------------
 
 int vc_ctrl_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct vc_device *device = container_of(ctrl->handler, struct vc_device, ctrl_handler);
+	struct vc_state *state = &device->cam.state;
+	struct v4l2_ctrl *other;
 	struct v4l2_control control;
+	int ret;
+
+	// GAIN and ANALOGUE_GAIN write the same register. The other control only follows.
+	if (device->gain_sync)
+		return 0;
+
+	// VBLANK is written together with the exposure after the module mode has been set.
+	if (device->link_update) {
+		if (ctrl->id == V4L2_CID_VBLANK) {
+			state->vblank = ctrl->val;
+			state->dirty |= RESTORE_EXPOSURE;
+		}
+		return 0;
+	}
+
+	if (ctrl->id == V4L2_CID_TIMED_EXPOSURE_BRACKET)
+		return vc_bracket_start(device, ctrl->p_new.p_u32);
+	if (ctrl->id == V4L2_CID_MULTI_ROI)
+		return vc_sd_set_multi_roi(device, ctrl->p_new.p_u32);
 
+	// Called with the lock of the control handler, which is the camera mutex.
 	control.id = ctrl->id;
 	control.value = ctrl->val;
-	vc_sd_s_ctrl(&device->sd, &control);
+	ret = __vc_sd_s_ctrl(&device->sd, &control);
 
-	return 0;
+	// Report the values the sensor really uses. Subscribers get them with the control event, which
+	// doesn't tell the frame the value applies to (see ctrl_frame_delay).
+	switch (ctrl->id) {
+	case V4L2_CID_EXPOSURE:
+		if (!device->exposure_lines)
+			ctrl->val = state->exposure;
+		break;
+	case V4L2_CID_GAIN:
+	case V4L2_CID_ANALOGUE_GAIN:
+		ctrl->val = state->gain;
+		break;
+	case V4L2_CID_BLACK_LEVEL:
+		ctrl->val = state->blacklevel;
+		break;
+	case V4L2_CID_FRAME_RATE:
+		ctrl->val = state->framerate;
+		break;
+	}
+
+	if (ctrl == device->gain || ctrl == device->analogue_gain) {
+		other = (ctrl == device->gain) ? device->analogue_gain : device->gain;
+		if (other) {
+			device->gain_sync = 1;
+			__v4l2_ctrl_s_ctrl(other, ctrl->val);
+			device->gain_sync = 0;
+		}
+	}
+
+	// The planned mode depends on the trigger mode and the frame rate.
+	if (ctrl->id == V4L2_CID_TRIGGER_MODE || ctrl->id == V4L2_CID_FRAME_RATE)
+		vc_sd_update_link_ctrls(device, vc_mod_plan_mode(&device->cam));
+
+	vc_core_publish_state(&device->cam);
+
+	// On error the control framework keeps the current value.
+	return ret;
 }
 
 
@@ -199,14 +727,66 @@ static int vc_sd_parse_dt(struct vc_device *device)
 		} else {
 			vc_core_set_num_lanes(cam, value);
 		}
+
+		// Optional: V4L2_CID_EXPOSURE in lines (e.g. for libcamera)
+		if (read_property_u32(node, "exposure_lines", 10, &value) == 0) {
+			device->exposure_lines = value;
+		}
+
+		// Optional: Period of the stream watchdog in ms
+		if (read_property_u32(node, "watchdog_ms", 10, &value) == 0) {
+			device->watchdog_ms = value;
+		}
 	}
 
 	return 0;
 }
 
+// Fires a single trigger with as little overhead as possible. The timestamp is taken when the
+// I2C write has completed, so that user space can measure the latency until the frame arrives.
+static int vc_sd_trigger(struct v4l2_subdev *sd, struct vc_trigger *trigger)
+{
+	struct vc_device *device = to_vc_device(sd);
+	struct vc_cam *cam = to_vc_cam(sd);
+	ktime_t start, end;
+	int ret;
+
+	memset(trigger, 0, sizeof(*trigger));
+
+	vc_core_lock(cam);
+	if (device->bracket_busy) {
+		vc_core_unlock(cam);
+		return -EBUSY;
+	}
+	start = ktime_get();
+	ret = vc_mod_fire_single_trigger(cam);
+	end = ktime_get();
+	if (ret == 0) {
+		trigger->timestamp = ktime_to_ns(end);
+		trigger->duration = ktime_to_ns(ktime_sub(end, start));
+		trigger->sequence = ++device->trigger_sequence;
+	}
+	vc_core_unlock(cam);
+
+	return ret;
+}
+
+static long vc_sd_ioctl(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
+{
+	switch (cmd) {
+	case VIDIOC_VC_TRIGGER:
+		return vc_sd_trigger(sd, arg);
+	}
+
+	return -ENOIOCTLCMD;
+}
+
 static const struct v4l2_subdev_core_ops vc_core_ops = {
 	.s_power = vc_sd_s_power,
+	.ioctl = vc_sd_ioctl,
 	.s_ctrl = vc_sd_s_ctrl,
+	.subscribe_event = v4l2_ctrl_subdev_subscribe_event,
+	.unsubscribe_event = v4l2_event_subdev_unsubscribe,
 };
 
 static const struct v4l2_subdev_video_ops vc_video_ops = {
@@ -216,6 +796,8 @@ static const struct v4l2_subdev_video_ops vc_video_ops = {
 static const struct v4l2_subdev_pad_ops vc_pad_ops = {
 	.get_fmt = vc_sd_get_fmt,
 	.set_fmt = vc_sd_set_fmt,
+	.get_selection = vc_sd_get_selection,
+	.set_selection = vc_sd_set_selection,
 };
 
 static const struct v4l2_subdev_ops vc_subdev_ops = {
@@ -243,6 +825,37 @@ static int vc_ctrl_init_ctrl(struct vc_device *device, struct v4l2_ctrl_handler
 	return 0;
 }
 
+static struct v4l2_ctrl *vc_ctrl_new_std(struct vc_device *device, const struct v4l2_ctrl_ops *ops, int id, struct vc_control* control) 
+{
+	struct device *dev = vc_core_get_sen_device(&device->cam);
+	struct v4l2_ctrl *ctrl;
+
+	ctrl = v4l2_ctrl_new_std(&device->ctrl_handler, ops, id, control->min, control->max, 1, control->def);
+	if (ctrl == NULL)
+		vc_err(dev, "%s(): Failed to init 0x%08x ctrl\n", __FUNCTION__, id);
+
+	return ctrl;
+}
+
+static int vc_ctrl_init_test_pattern(struct vc_device *device)
+{
+	struct vc_ctrl *ctrl = &device->cam.ctrl;
+	struct device *dev = vc_core_get_sen_device(&device->cam);
+	int num = min_t(int, ctrl->num_test_patterns, VC_TEST_PATTERN_MAX);
+	int index;
+
+	for (index = 0; index < num; index++)
+		device->test_pattern_menu[index] = ctrl->test_patterns[index].name;
+
+	if (v4l2_ctrl_new_std_menu_items(&device->ctrl_handler, &vc_ctrl_ops, V4L2_CID_TEST_PATTERN, num - 1, 0, 0, 
+			device->test_pattern_menu) == NULL) {
+		vc_err(dev, "%s(): Failed to init test pattern ctrl\n", __FUNCTION__);
+		return -EIO;
+	}
+
+	return 0;
+}
+
 static int vc_ctrl_init_custom_ctrl(struct vc_device *device, struct v4l2_ctrl_handler *hdl, const struct v4l2_ctrl_config *config) 
 {
 	struct i2c_client *client = device->cam.ctrl.client_sen;
@@ -306,10 +919,140 @@ static const struct v4l2_ctrl_config ctrl_single_trigger = {
 	.def = 0,
 };
 
+static const struct v4l2_ctrl_config ctrl_streamon_latency = {
+        .id = V4L2_CID_STREAMON_LATENCY,
+        .name = "StreamOn Latency",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .flags = V4L2_CTRL_FLAG_READ_ONLY,
+	.min = 0,
+        .max = S32_MAX,
+        .step = 1,
+	.def = 0,
+};
+
+static const struct v4l2_ctrl_config ctrl_timed_exposure_bracket = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_TIMED_EXPOSURE_BRACKET,
+        .name = "Timed Exposure Bracket",
+        .type = V4L2_CTRL_TYPE_U32,
+        .flags = V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+	.min = 0,
+        .max = U32_MAX,
+        .step = 1,
+	.def = 0,
+	.dims = { VC_BRACKET_MAX },
+};
+
+// No module supports the multi ROI readout yet, every list with windows is rejected (-EINVAL).
+static const struct v4l2_ctrl_config ctrl_multi_roi = {
+        .ops = &vc_ctrl_ops,
+        .id = V4L2_CID_MULTI_ROI,
+        .name = "Multi ROI",
+        .type = V4L2_CTRL_TYPE_U32,
+	.min = 0,
+        .max = U16_MAX,
+        .step = 1,
+	.def = 0,
+	.dims = { VC_ROI_MAX, 4 },
+};
+
+static const struct v4l2_ctrl_config ctrl_bracket_interval = {
+        .id = V4L2_CID_BRACKET_INTERVAL,
+        .name = "Bracket Interval",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .flags = V4L2_CTRL_FLAG_READ_ONLY,
+	.min = 0,
+        .max = S32_MAX,
+        .step = 1,
+	.def = 0,
+};
+
+static const struct v4l2_ctrl_config ctrl_recovery_count = {
+        .id = V4L2_CID_RECOVERY_COUNT,
+        .name = "Recovery Count",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .flags = V4L2_CTRL_FLAG_READ_ONLY,
+	.min = 0,
+        .max = S32_MAX,
+        .step = 1,
+	.def = 0,
+};
+
+static const struct v4l2_ctrl_config ctrl_recovery_failures = {
+        .id = V4L2_CID_RECOVERY_FAILURES,
+        .name = "Recovery Failures",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .flags = V4L2_CTRL_FLAG_READ_ONLY,
+	.min = 0,
+        .max = S32_MAX,
+        .step = 1,
+	.def = 0,
+};
+
+// Frames from the register write until exposure and gain take effect. The control events of
+// these controls report the values only. The driver doesn't know the sequence number of the frame
+// in which a value applies, an application can only estimate it with the frame delay.
+static const struct v4l2_ctrl_config ctrl_frame_delay = {
+        .id = V4L2_CID_FRAME_DELAY,
+        .name = "Frame Delay",
+        .type = V4L2_CTRL_TYPE_INTEGER,
+        .flags = V4L2_CTRL_FLAG_READ_ONLY,
+	.min = 0,
+        .max = 255,
+        .step = 1,
+	.def = 0,
+};
+
+// Read only controls for the CSI-2 receiver. The link frequencies are taken from the mode table
+// of the module descriptor.
+static int vc_sd_init_link_ctrls(struct vc_device *device)
+{
+	struct vc_cam *cam = &device->cam;
+	struct device *dev = vc_core_get_sen_device(cam);
+	int num_freqs;
+	int mode;
+	__s64 pixel_rate_max = 0;
+
+	num_freqs = vc_core_get_link_freqs(cam, device->link_freqs, ARRAY_SIZE(device->link_freqs));
+	if (num_freqs == 0) {
+		vc_err(dev, "%s(): No link frequencies in the module descriptor\n", __FUNCTION__);
+		return -EINVAL;
+	}
+	for (mode = 0; mode < cam->desc.num_modes; mode++) {
+		pixel_rate_max = max(pixel_rate_max, vc_core_get_pixel_rate(cam, mode));
+	}
+
+	device->link_freq = v4l2_ctrl_new_int_menu(&device->ctrl_handler, NULL, V4L2_CID_LINK_FREQ, 
+		num_freqs - 1, 0, device->link_freqs);
+	device->pixel_rate = v4l2_ctrl_new_std(&device->ctrl_handler, NULL, V4L2_CID_PIXEL_RATE, 
+		1, max_t(__s64, pixel_rate_max, 1), 1, max_t(__s64, pixel_rate_max, 1));
+	if (device->link_freq == NULL || device->pixel_rate == NULL) {
+		vc_err(dev, "%s(): Failed to init link ctrls\n", __FUNCTION__);
+		return -EIO;
+	}
+	device->link_freq->flags |= V4L2_CTRL_FLAG_READ_ONLY;
+	device->pixel_rate->flags |= V4L2_CTRL_FLAG_READ_ONLY;
+
+	// Blanking is only meaningful if the frame time is set through VMAX.
+	if (vc_core_has_line_timing(cam)) {
+		struct vc_control vblank;
+		vc_core_get_vblank_range(cam, &vblank);
+		device->vblank = vc_ctrl_new_std(device, &vc_ctrl_ops, V4L2_CID_VBLANK, &vblank);
+		device->hblank = vc_ctrl_new_std(device, NULL, V4L2_CID_HBLANK, &(struct vc_control) { 0, 0, 0 });
+		if (device->hblank)
+			device->hblank->flags |= V4L2_CTRL_FLAG_READ_ONLY;
+	}
+
+	vc_sd_update_link(device, vc_mod_plan_mode(cam));
+
+	return 0;
+}
+
 static int vc_sd_init(struct vc_device *device)
 {
 	struct i2c_client *client = device->cam.ctrl.client_sen;
 	struct device *dev = &client->dev;
+	struct v4l2_ctrl *frame_delay;
 	int ret;
 
 	// Initializes the subdevice
@@ -321,17 +1064,55 @@ static int vc_sd_init(struct vc_device *device)
 		vc_err(dev, "%s(): Failed to init control handler\n", __FUNCTION__);
 		return ret;
 	}
+	// Controls and hardware sequences share the camera mutex
+	device->ctrl_handler.lock = &device->cam.mutex;
 	// Hook the control handler into the driver
 	device->sd.ctrl_handler = &device->ctrl_handler;
 
 	// Add controls
-	ret |= vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_EXPOSURE, &device->cam.ctrl.exposure);
-	ret |= vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_GAIN, &device->cam.ctrl.gain);
+	if (device->exposure_lines && !vc_core_has_line_timing(&device->cam)) {
+		vc_warn(dev, "%s(): No line timing for this module. (Exposure in us)\n", __FUNCTION__);
+		device->exposure_lines = 0;
+	}
+	if (device->exposure_lines) {
+		struct vc_control lines;
+		vc_core_get_exposure_lines_range(&device->cam, &lines);
+		ret |= vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_EXPOSURE, &lines);
+	} else {
+		ret |= vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_EXPOSURE, &device->cam.ctrl.exposure);
+	}
+	device->gain = vc_ctrl_new_std(device, &vc_ctrl_ops, V4L2_CID_GAIN, &device->cam.ctrl.gain);
+	device->analogue_gain = vc_ctrl_new_std(device, &vc_ctrl_ops, V4L2_CID_ANALOGUE_GAIN, &device->cam.ctrl.gain);
+	if (!device->gain || !device->analogue_gain)
+		ret |= -EIO;
 	ret |= vc_ctrl_init_ctrl(device, &device->ctrl_handler, V4L2_CID_BLACK_LEVEL, &device->cam.ctrl.blacklevel);
+	if (device->cam.ctrl.num_test_patterns > 0)
+		ret |= vc_ctrl_init_test_pattern(device);
+	ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_multi_roi);
+	if (device->watchdog_ms) {
+		ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_recovery_count);
+		device->recovery_count = v4l2_ctrl_find(&device->ctrl_handler, V4L2_CID_RECOVERY_COUNT);
+		ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_recovery_failures);
+		device->recovery_failures = v4l2_ctrl_find(&device->ctrl_handler, V4L2_CID_RECOVERY_FAILURES);
+		INIT_DELAYED_WORK(&device->watchdog_work, vc_watchdog_work);
+	}
 	ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_trigger_mode);
 	ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_flash_mode);
 	ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_frame_rate);
         ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_single_trigger);
+	ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_streamon_latency);
+	device->streamon_latency = v4l2_ctrl_find(&device->ctrl_handler, V4L2_CID_STREAMON_LATENCY);
+	ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_frame_delay);
+	frame_delay = v4l2_ctrl_find(&device->ctrl_handler, V4L2_CID_FRAME_DELAY);
+	if (frame_delay)
+		v4l2_ctrl_s_ctrl(frame_delay, device->cam.ctrl.frame_delay);
+	if (device->cam.ctrl.flags & FLAG_TRIGGER_SINGLE) {
+		ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_timed_exposure_bracket);
+		ret |= vc_ctrl_init_custom_ctrl(device, &device->ctrl_handler, &ctrl_bracket_interval);
+		device->bracket_interval = v4l2_ctrl_find(&device->ctrl_handler, V4L2_CID_BRACKET_INTERVAL);
+	}
+
+	ret |= vc_sd_init_link_ctrls(device);
 
 	return 0;
 }
@@ -358,6 +1139,8 @@ static int vc_probe(struct i2c_client *client)
 	if (!device)
 		return -ENOMEM;
 	cam = &device->cam;
+	init_waitqueue_head(&device->reset_done);
+	INIT_WORK(&device->bracket_work, vc_bracket_work);
 
 	endpoint = fwnode_graph_get_next_endpoint(dev_fwnode(dev), NULL);
 	if (!endpoint) {
@@ -409,9 +1192,13 @@ static int vc_remove(struct i2c_client *client)
 	struct v4l2_subdev *sd = i2c_get_clientdata(client);
 	struct vc_device *device = to_vc_device(sd);
 
+	cancel_work_sync(&device->bracket_work);
+	if (device->watchdog_ms)
+		cancel_delayed_work_sync(&device->watchdog_work);
 	v4l2_async_unregister_subdev(&device->sd);
 	media_entity_cleanup(&device->sd.entity);
 	v4l2_ctrl_handler_free(&device->ctrl_handler);
+	mutex_destroy(&device->cam.mutex);
 
 	return 0;
 }
@@ -51,7 +51,44 @@
 #define M_BYTE(value) (__u8)((value >>  8) & 0xff)
 #define L_BYTE(value) (__u8)((value >>  0) & 0xff)
 
-static __u8 i2c_read_reg(struct i2c_client *client, const __u16 addr)
+// Bus model: START + address byte + ACK + STOP (or repeated START) per message, 
+// 8 data bits + ACK per payload byte.
+#define I2C_MSG_OVERHEAD_BITS	11
+#define I2C_BYTE_BITS		9
+
+// All I2C traffic of the driver goes through this function. It is the single place where 
+// transactions are accounted and where a simulated bus can be hooked in.
+static int vc_i2c_transfer(struct vc_ctrl *ctrl, struct i2c_client *client, struct i2c_msg *msgs, int num)
+{
+	struct vc_i2c_stats *stats;
+	int ret;
+	int i;
+
+	ret = i2c_transfer(client->adapter, msgs, num);
+
+	if (ctrl) {
+		stats = &ctrl->i2c_stats;
+		stats->transfers++;
+		for (i = 0; i < num; i++) {
+			stats->msgs++;
+			stats->bytes += msgs[i].len;
+			stats->bits += I2C_MSG_OVERHEAD_BITS + I2C_BYTE_BITS * msgs[i].len;
+		}
+		if (ret != num)
+			stats->errors++;
+	}
+
+	return ret;
+}
+
+// The caller has to hold the mutex, the sleep is accounted in the bus cost.
+static void vc_sleep_range(struct vc_ctrl *ctrl, unsigned long min, unsigned long max)
+{
+	ctrl->i2c_stats.sleep_us += min;
+	usleep_range(min, max);
+}
+
+static int i2c_read_reg(struct vc_ctrl *ctrl, struct i2c_client *client, const __u16 addr)
 {
 	__u8 buf[2] = { addr >> 8, addr & 0xff };
 	int ret;
@@ -70,18 +107,18 @@ static __u8 i2c_read_reg(struct i2c_client *client, const __u16 addr)
 		},
 	};
 
-	ret = i2c_transfer(client->adapter, msgs, ARRAY_SIZE(msgs));
+	ret = vc_i2c_transfer(ctrl, client, msgs, ARRAY_SIZE(msgs));
 	if (ret < 0) {
-		vc_err(&client->dev, "%s(): Reading register 0x%04x from 0x%02x failed\n", __FUNCTION__, addr, client->addr);
+		vc_err(&client->dev, "%s(): Reading register 0x%04x from 0x%02x failed\n", __FUNCTION__, addr, client->addr);
 		return ret;
 	}
 
 	return buf[0];
 }
 
-static int i2c_write_reg(struct device *dev, struct i2c_client *client, const __u16 addr, const __u8 value, const char* func)
+static int i2c_write_reg(struct vc_ctrl *ctrl, struct i2c_client *client, const __u16 addr, const __u8 value, const char* func)
 {
-	struct i2c_adapter *adap = client->adapter;
+	struct device *dev = &client->dev;
 	struct i2c_msg msg;
 	__u8 tx[3];
 	int ret;
@@ -95,83 +132,83 @@ static int i2c_write_reg(struct device *dev, struct i2c_client *client, const __
 	tx[0] = addr >> 8;
 	tx[1] = addr & 0xff;
 	tx[2] = value;
-	ret = i2c_transfer(adap, &msg, 1);
+	ret = vc_i2c_transfer(ctrl, client, &msg, 1);
 
 	return ret == 1 ? 0 : -EIO;
 }
 
-static __u32 i2c_read_reg2(struct device *dev, struct i2c_client *client, struct vc_csr2 *csr)
+static __u32 i2c_read_reg2(struct vc_ctrl *ctrl, struct i2c_client *client, struct vc_csr2 *csr)
 {
-	__u32 reg = 0;
+	int reg = 0;
 	__u32 value = 0;
 
-	reg = i2c_read_reg(client, csr->l);
-	if (reg)
+	reg = i2c_read_reg(ctrl, client, csr->l);
+	if (reg > 0)
 		value |= (0x000000ff & reg);
-	reg = i2c_read_reg(client, csr->m);
-	if (reg)
+	reg = i2c_read_reg(ctrl, client, csr->m);
+	if (reg > 0)
 		value |= (0x000000ff & reg) <<  8;
 
 	return value;
 }
 
-static int i2c_write_reg2(struct device *dev, struct i2c_client *client, struct vc_csr2 *csr, const __u16 value, const char* func)
+static int i2c_write_reg2(struct vc_ctrl *ctrl, struct i2c_client *client, const struct vc_csr2 *csr, const __u16 value, const char* func)
 {
 	int ret = 0;
 
 	if (csr->l)		
-		ret  = i2c_write_reg(dev, client, csr->l, L_BYTE(value), func);
+		ret  = i2c_write_reg(ctrl, client, csr->l, L_BYTE(value), func);
 	if (csr->m)
-		ret |= i2c_write_reg(dev, client, csr->m, M_BYTE(value), func);
+		ret |= i2c_write_reg(ctrl, client, csr->m, M_BYTE(value), func);
 
 	return ret;
 }
 
-static __u32 i2c_read_reg4(struct device *dev, struct i2c_client *client, struct vc_csr4 *csr)
+static __u32 i2c_read_reg4(struct vc_ctrl *ctrl, struct i2c_client *client, struct vc_csr4 *csr)
 {
-	__u32 reg = 0;
+	int reg = 0;
 	__u32 value = 0;
 
-	reg = i2c_read_reg(client, csr->l);
-	if (reg)
+	reg = i2c_read_reg(ctrl, client, csr->l);
+	if (reg > 0)
 		value |= (0x000000ff & reg);
-	reg = i2c_read_reg(client, csr->m);
-	if (reg)
+	reg = i2c_read_reg(ctrl, client, csr->m);
+	if (reg > 0)
 		value |= (0x000000ff & reg) <<  8;
-	reg = i2c_read_reg(client, csr->h);
-	if (reg)
+	reg = i2c_read_reg(ctrl, client, csr->h);
+	if (reg > 0)
 		value |= (0x000000ff & reg) << 16;
-	reg = i2c_read_reg(client, csr->u);
-	if (reg)
+	reg = i2c_read_reg(ctrl, client, csr->u);
+	if (reg > 0)
 		value |= (0x000000ff & reg) << 24;
 
 	return value;
 }
 
-static int i2c_write_reg4(struct device *dev, struct i2c_client *client, struct vc_csr4 *csr, const __u32 value, const char *func)
+static int i2c_write_reg4(struct vc_ctrl *ctrl, struct i2c_client *client, struct vc_csr4 *csr, const __u32 value, const char *func)
 {
 	int ret = 0;
 
 	if (csr->l)
-		ret = i2c_write_reg(dev, client, csr->l, L_BYTE(value), func);
+		ret = i2c_write_reg(ctrl, client, csr->l, L_BYTE(value), func);
 	if (csr->m)
-		ret |= i2c_write_reg(dev, client, csr->m, M_BYTE(value), func);
+		ret |= i2c_write_reg(ctrl, client, csr->m, M_BYTE(value), func);
 	if (csr->h)
-		ret |= i2c_write_reg(dev, client, csr->h, H_BYTE(value), func);
+		ret |= i2c_write_reg(ctrl, client, csr->h, H_BYTE(value), func);
 	if (csr->u)
-		ret |= i2c_write_reg(dev, client, csr->u, U_BYTE(value), func);
+		ret |= i2c_write_reg(ctrl, client, csr->u, U_BYTE(value), func);
 
 	return ret;
 }
 
 int vc_read_i2c_reg(struct i2c_client *client, const __u16 addr)
 {
-	return i2c_read_reg(client, addr);
+	return i2c_read_reg(NULL, client, addr);
 }
 
 int vc_write_i2c_reg(struct i2c_client *client, const __u16 addr, const __u8 value)
 {
-	return i2c_write_reg(&client->dev, client, addr, value, __FUNCTION__);
+	return i2c_write_reg(NULL, client, addr, value, __FUNCTION__);
 }
 
 
@@ -241,6 +278,90 @@ static void vc_core_print_modes(struct device *dev, struct vc_desc *desc)
 	vc_notice(dev, "+----+---------+---------+---------+---------+---------+\n");
 }
 
+// ------------------------------------------------------------------------------------------------
+//  Helper functions for bus cost accounting
+
+void vc_core_stats_snapshot(struct vc_cam *cam, struct vc_i2c_stats *snapshot)
+{
+	*snapshot = cam->ctrl.i2c_stats;
+}
+
+// Accounts a sleep which the caller has done without holding the mutex. The caller has to hold it
+// again.
+void vc_core_stats_sleep(struct vc_cam *cam, __u32 us)
+{
+	lockdep_assert_held(&cam->mutex);
+	cam->ctrl.i2c_stats.sleep_us += us;
+}
+
+// Prints the bus traffic caused since the snapshot was taken as one key=value line. The bus time 
+// is modeled from the number of bus clocks for standard (100 kHz) and fast mode (400 kHz).
+void vc_core_stats_report(struct vc_cam *cam, struct vc_i2c_stats *snapshot, const char *op)
+{
+	struct vc_i2c_stats *stats = &cam->ctrl.i2c_stats;
+	struct device *dev = vc_core_get_sen_device(cam);
+	__u32 bits = stats->bits - snapshot->bits;
+
+	vc_info(dev, "%s(): bus-cost op=%s mod_id=0x%04x transfers=%u msgs=%u bytes=%u bits=%u errors=%u "
+		"sleep_us=%u bus100k_us=%llu bus400k_us=%llu\n", __FUNCTION__, op, cam->desc.mod_id,
+		stats->transfers - snapshot->transfers, stats->msgs - snapshot->msgs,
+		stats->bytes - snapshot->bytes, bits, stats->errors - snapshot->errors,
+		stats->sleep_us - snapshot->sleep_us,
+		((__u64)bits * 1000000) / 100000, ((__u64)bits * 1000000) / 400000);
+}
+
+// Accounts the time from STREAMON until the sensor is operating.
+void vc_core_stats_streamon(struct vc_cam *cam, __u32 latency_us)
+{
+	struct vc_stream_stats *stats = &cam->ctrl.stream_stats;
+	struct device *dev = vc_core_get_sen_device(cam);
+
+	if (stats->count == 0 || latency_us < stats->min_us)
+		stats->min_us = latency_us;
+	if (latency_us > stats->max_us)
+		stats->max_us = latency_us;
+	stats->last_us = latency_us;
+	stats->total_us += latency_us;
+	stats->count++;
+
+	vc_info(dev, "%s(): streamon-latency mod_id=0x%04x last_us=%u min_us=%u max_us=%u avg_us=%llu count=%u\n",
+		__FUNCTION__, cam->desc.mod_id, stats->last_us, stats->min_us, stats->max_us, 
+		stats->total_us / stats->count, stats->count);
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Helper functions for locking
+
+void vc_core_lock(struct vc_cam *cam)
+{
+	mutex_lock(&cam->mutex);
+}
+
+void vc_core_unlock(struct vc_cam *cam)
+{
+	vc_core_publish_state(cam);
+	mutex_unlock(&cam->mutex);
+}
+
+// Copies the state for readers which don't take the mutex. The caller has to hold the mutex.
+void vc_core_publish_state(struct vc_cam *cam)
+{
+	write_seqcount_begin(&cam->snapshot_seq);
+	cam->snapshot = cam->state;
+	write_seqcount_end(&cam->snapshot_seq);
+}
+
+// Returns the last published state without taking the mutex.
+void vc_core_get_state(struct vc_cam *cam, struct vc_state *state)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&cam->snapshot_seq);
+		*state = cam->snapshot;
+	} while (read_seqcount_retry(&cam->snapshot_seq, seq));
+}
+
 // ------------------------------------------------------------------------------------------------
 //  Helper functions for internal data structures
 
@@ -382,6 +503,7 @@ int vc_core_set_frame(struct vc_cam *cam, __u32 x, __u32 y, __u32 width, __u32 h
 	struct vc_ctrl *ctrl = &cam->ctrl;
 	struct vc_state *state = &cam->state;
 	struct vc_frame *frame = &state->frame;
+	struct vc_frame old = *frame;
 	struct device *dev = vc_core_get_sen_device(cam);
 
 	vc_notice(dev, "%s(): Set frame (x: %u, y: %u, width: %u, height: %u)\n", __FUNCTION__, x, y, width, height);
@@ -415,6 +537,12 @@ int vc_core_set_frame(struct vc_cam *cam, __u32 x, __u32 y, __u32 width, __u32 h
 		frame->x, frame->y, frame->width, frame->height);
 	}
 
+	if (frame->x != old.x || frame->y != old.y || frame->width != old.width || frame->height != old.height)
+		state->dirty |= RESTORE_ROI;
+	// The exposure (VMAX) depends on the image height.
+	if (frame->height != old.height)
+		state->dirty |= RESTORE_EXPOSURE;
+
 	return 0;
 }
 
@@ -471,6 +599,9 @@ int vc_core_set_framerate(struct vc_cam *cam, __u32 framerate)
 	if (framerate > ctrl->framerate.max) {
 		framerate = ctrl->framerate.max;
 	}
+	// The exposure (VMAX) depends on the frame rate.
+	if (framerate != state->framerate)
+		state->dirty |= RESTORE_EXPOSURE;
 	state->framerate = framerate;
 
 	return 0;
@@ -524,7 +655,7 @@ int vc_mod_set_power(struct vc_cam *cam, int on)
 
 	vc_info(dev, "%s(): Set module power: %s\n", __FUNCTION__, on ? "up" : "down");
 
-	ret = i2c_write_reg(dev, client_mod, MOD_REG_RESET, on ? REG_RESET_PWR_UP : REG_RESET_PWR_DOWN, __FUNCTION__);
+	ret = i2c_write_reg(ctrl, client_mod, MOD_REG_RESET, on ? REG_RESET_PWR_UP : REG_RESET_PWR_DOWN, __FUNCTION__);
 	if (ret) {
 		vc_err(dev, "%s(): Unable to power %s the module (error: %d)\n", __FUNCTION__,
 			(on == REG_RESET_PWR_UP) ? "up" : "down", ret);
@@ -536,12 +667,13 @@ int vc_mod_set_power(struct vc_cam *cam, int on)
 	return 0;
 }
 
-static int vc_mod_read_status(struct i2c_client *client)
+static int vc_mod_read_status(struct vc_ctrl *ctrl)
 {
+	struct i2c_client *client = ctrl->client_mod;
 	struct device *dev = &client->dev;
 	int ret;
 
-	ret = i2c_read_reg(client, MOD_REG_STATUS);
+	ret = i2c_read_reg(ctrl, client, MOD_REG_STATUS);
 	if (ret < 0)
 		vc_err(dev, "%s(): Unable to get module status (error: %d)\n", __FUNCTION__, ret);
 	else
@@ -550,48 +682,52 @@ static int vc_mod_read_status(struct i2c_client *client)
 	return ret;
 }
 
-static int vc_mod_write_trigger_mode(struct i2c_client *client, int mode)
+static int vc_mod_write_trigger_mode(struct vc_ctrl *ctrl, int mode)
 {
+	struct i2c_client *client = ctrl->client_mod;
 	struct device *dev = &client->dev;
 	int ret;
 
 	vc_dbg(dev, "%s(): Write trigger mode: 0x%02x\n", __FUNCTION__, mode);
 
-	ret = i2c_write_reg(dev, client, MOD_REG_EXTTRIG, mode, __FUNCTION__);
+	ret = i2c_write_reg(ctrl, client, MOD_REG_EXTTRIG, mode, __FUNCTION__);
 	if (ret)
 		vc_err(dev, "%s(): Unable to write external trigger (error: %d)\n", __FUNCTION__, ret);
 
 	return ret;
 }
 
-static int vc_mod_write_io_mode(struct i2c_client *client, int mode)
+static int vc_mod_write_io_mode(struct vc_ctrl *ctrl, int mode)
 {
+	struct i2c_client *client = ctrl->client_mod;
 	struct device *dev = &client->dev;
 	int ret;
 
 	vc_dbg(dev, "%s(): Write IO mode: %s\n", __FUNCTION__, mode ? "ON" : "OFF");
 
-	ret = i2c_write_reg(dev, client, MOD_REG_IOCTRL, mode, __FUNCTION__);
+	ret = i2c_write_reg(ctrl, client, MOD_REG_IOCTRL, mode, __FUNCTION__);
 	if (ret)
 		vc_err(dev, "%s(): Unable to write IO mode (error: %d)\n", __FUNCTION__, ret);
 
 	return ret;
 }
 
-static int vc_mod_wait_until_module_is_ready(struct i2c_client *client)
+// Checks once if the module has booted after a reset. Returns -EAGAIN as long as it doesn't
+// communicate. The caller waits between the checks without holding the mutex.
+int vc_mod_poll_ready(struct vc_cam *cam)
 {
-	struct device *dev = &client->dev;
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct device *dev = &ctrl->client_mod->dev;
 	int status;
-	int try;
 
-	vc_dbg(dev, "%s(): Wait until module is ready\n", __FUNCTION__);
+	lockdep_assert_held(&cam->mutex);
 
-	status = REG_STATUS_NO_COM;
-	try = 0;
-	while (status == REG_STATUS_NO_COM && try < 10) {
-		usleep_range(200000, 200000);
-		status = vc_mod_read_status(client);
-		try++;
+	status = vc_mod_read_status(ctrl);
+	if (status == REG_STATUS_NO_COM) {
+		return -EAGAIN;
+	}
+	if (status < 0) {
+		return status;
 	}
 	if (status == REG_STATUS_ERROR) {
 		vc_err(dev, "%s(): Internal Error!", __func__);
@@ -626,7 +762,7 @@ static int vc_mod_setup(struct vc_ctrl *ctrl, int mod_i2c_addr, struct vc_desc *
 	
 	dev_mod = &client_mod->dev;
 	for (addr = 0; addr < sizeof(*desc); addr++) {
-		reg = i2c_read_reg(client_mod, addr + 0x1000);
+		reg = i2c_read_reg(ctrl, client_mod, addr + 0x1000);
 		if (reg < 0) {
 			i2c_unregister_device(client_mod);
 			return -EIO;
@@ -659,11 +795,15 @@ static void vc_core_state_init(struct vc_cam *cam)
 	state->exposure = ctrl->exposure.def;
 	state->gain = ctrl->gain.def;
 	state->blacklevel = ctrl->blacklevel.def;
+	state->test_pattern = 0;
 	state->shs = 0;
 	state->vmax = 0;
 	state->exposure_cnt = 0;
 	state->retrigger_cnt = 0;
 	state->framerate = ctrl->framerate.def;
+	state->vblank = 0;
+	state->dirty = RESTORE_ALL;
+	state->hold = 0;
 	state->format_code = vc_core_get_default_format(cam);
 	state->frame.x = 0;
 	state->frame.y = 0;
@@ -679,9 +819,13 @@ int vc_core_init(struct vc_cam *cam, struct i2c_client *client)
 {
 	struct vc_desc *desc = &cam->desc;
 	struct vc_ctrl *ctrl = &cam->ctrl;	
+	struct vc_i2c_stats stats;
 	int ret;
 
+	mutex_init(&cam->mutex);
+	seqcount_init(&cam->snapshot_seq);
 	ctrl->client_sen = client;
+	vc_core_stats_snapshot(cam, &stats);
 	ret = vc_mod_setup(ctrl, 0x10, desc);
 	if (ret) {
 		return -EIO;
@@ -694,66 +838,178 @@ int vc_core_init(struct vc_cam *cam, struct i2c_client *client)
 		vc_sen_read_image_size(ctrl, &ctrl->frame);
 	}
 	vc_core_state_init(cam);
+	vc_core_publish_state(cam);
+	vc_core_stats_report(cam, &stats, "probe");
 
 	vc_notice(&ctrl->client_mod->dev, "VC MIPI Core succesfully initialized");
 	return 0;
 }
 
-static int vc_mod_write_exposure(struct i2c_client *client, __u32 value)
+static int vc_mod_write_exposure(struct vc_ctrl *ctrl, __u32 value)
 {
+	struct i2c_client *client = ctrl->client_mod;
 	struct device *dev = &client->dev;
 	int ret;
 
 	vc_dbg(dev, "%s(): Write module exposure = 0x%08x (%u)\n", __FUNCTION__, value, value);
 
-	ret  = i2c_write_reg(dev, client, MOD_REG_EXPO_L, L_BYTE(value), __FUNCTION__);
-	ret |= i2c_write_reg(dev, client, MOD_REG_EXPO_M, M_BYTE(value), __FUNCTION__);
-	ret |= i2c_write_reg(dev, client, MOD_REG_EXPO_H, H_BYTE(value), __FUNCTION__);
-	ret |= i2c_write_reg(dev, client, MOD_REG_EXPO_U, U_BYTE(value), __FUNCTION__);
+	ret  = i2c_write_reg(ctrl, client, MOD_REG_EXPO_L, L_BYTE(value), __FUNCTION__);
+	ret |= i2c_write_reg(ctrl, client, MOD_REG_EXPO_M, M_BYTE(value), __FUNCTION__);
+	ret |= i2c_write_reg(ctrl, client, MOD_REG_EXPO_H, H_BYTE(value), __FUNCTION__);
+	ret |= i2c_write_reg(ctrl, client, MOD_REG_EXPO_U, U_BYTE(value), __FUNCTION__);
 	
 	return ret;
 }
 
-static int vc_mod_write_retrigger(struct i2c_client *client, __u32 value)
+static int vc_mod_write_retrigger(struct vc_ctrl *ctrl, __u32 value)
 {
+	struct i2c_client *client = ctrl->client_mod;
 	struct device *dev = &client->dev;
 	int ret;
 
 	vc_dbg(dev, "%s(): Write module retrigger = 0x%08x (%u)\n", __FUNCTION__, value, value);
 
-	ret  = i2c_write_reg(dev, client, MOD_REG_RETRIG_L, L_BYTE(value), __FUNCTION__);
-	ret |= i2c_write_reg(dev, client, MOD_REG_RETRIG_M, M_BYTE(value), __FUNCTION__);
-	ret |= i2c_write_reg(dev, client, MOD_REG_RETRIG_H, H_BYTE(value), __FUNCTION__);
-	ret |= i2c_write_reg(dev, client, MOD_REG_RETRIG_U, U_BYTE(value), __FUNCTION__);
+	ret  = i2c_write_reg(ctrl, client, MOD_REG_RETRIG_L, L_BYTE(value), __FUNCTION__);
+	ret |= i2c_write_reg(ctrl, client, MOD_REG_RETRIG_M, M_BYTE(value), __FUNCTION__);
+	ret |= i2c_write_reg(ctrl, client, MOD_REG_RETRIG_H, H_BYTE(value), __FUNCTION__);
+	ret |= i2c_write_reg(ctrl, client, MOD_REG_RETRIG_U, U_BYTE(value), __FUNCTION__);
 	
 	return ret;
 }
 
-static __u8 vc_mod_find_mode(struct vc_cam *cam, __u8 num_lanes, __u8 format, __u8 type, __u8 binning)
+static __u32 vc_core_format_bits(__u8 format)
+{
+	switch (format) {
+	case FORMAT_RAW08: return 8;
+	case FORMAT_RAW10: return 10;
+	case FORMAT_RAW12: return 12;
+	case FORMAT_RAW14: return 14;
+	}
+	return 16;
+}
+
+// Returns the link capacity of the mode in bit/s. The descriptor holds the data rate per lane.
+static __u64 vc_mod_mode_capacity(struct vc_desc_mode *mode)
+{
+	return (__u64)(*(__u32*)mode->data_rate) * mode->num_lanes;
+}
+
+// Returns the payload bandwidth in bit/s the current ROI and frame rate need. A frame rate of 0
+// (free running) is planned with the maximum frame rate of the sensor.
+static __u64 vc_mod_required_bandwidth(struct vc_cam *cam, __u8 format)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+	__u32 framerate = state->framerate ? state->framerate : ctrl->framerate.max;
+
+	return (__u64)state->frame.width * state->frame.height * vc_core_format_bits(format) * framerate;
+}
+
+__s64 vc_core_get_link_freq(struct vc_cam *cam, int mode)
+{
+	if (mode < 0 || mode >= cam->desc.num_modes)
+		return 0;
+
+	// CSI-2 D-PHY transfers on both clock edges.
+	return (*(__u32*)cam->desc.modes[mode].data_rate) / 2;
+}
+
+__s64 vc_core_get_pixel_rate(struct vc_cam *cam, int mode)
+{
+	struct vc_desc_mode *desc_mode;
+
+	if (mode < 0 || mode >= cam->desc.num_modes)
+		return 0;
+
+	desc_mode = &cam->desc.modes[mode];
+	return vc_mod_mode_capacity(desc_mode) / vc_core_format_bits(desc_mode->format);
+}
+
+int vc_core_get_link_freqs(struct vc_cam *cam, __s64 *freqs, int size)
+{
+	__s64 freq;
+	int count = 0;
+	int mode, i, j;
+
+	for (mode = 0; mode < cam->desc.num_modes; mode++) {
+		freq = vc_core_get_link_freq(cam, mode);
+		for (i = 0; i < count && freqs[i] < freq; i++);
+		if ((i < count && freqs[i] == freq) || count == size)
+			continue;
+		for (j = count; j > i; j--)
+			freqs[j] = freqs[j - 1];
+		freqs[i] = freq;
+		count++;
+	}
+
+	return count;
+}
+
+// Plans the module mode. Only modes with the lane count of the CSI-2 receiver (device tree)
+// and the requested format, type and binning are candidates. Of these the mode with the lowest
+// capacity that still carries the required bandwidth is selected. If no mode is fast enough the
+// fastest one is used and the frame rate will be limited by the link.
+static int vc_mod_find_mode(struct vc_cam *cam, __u8 num_lanes, __u8 format, __u8 type, __u8 binning)
 {
 	struct vc_desc *desc = &cam->desc;
 	struct device *dev = vc_core_get_mod_device(cam);
+	__u64 required = vc_mod_required_bandwidth(cam, format);
+	__u64 capacity, best_capacity = 0;
+	int best = -1;
+	int fits = 0;
 	__u8 index = 0;
 
 	for (index = 0; index < desc->num_modes; index++) {
 		struct vc_desc_mode *mode = &desc->modes[index];
 		vc_dbg(dev, "%s(): Checking mode (#%02u, lanes: %u, format: 0x%02x, type: 0x%02x, binning: 0x%02x)", __FUNCTION__, 
 			index, mode->num_lanes, mode->format, mode->type, mode->binning);
-		if(mode->num_lanes == num_lanes && mode->format == format && mode->type == type && mode->binning == binning) {
-			return index;
+		if (mode->num_lanes != num_lanes || mode->format != format || mode->type != type || mode->binning != binning) {
+			continue;
+		}
+
+		capacity = vc_mod_mode_capacity(mode);
+		if (capacity >= required) {
+			if (!fits || capacity < best_capacity) {
+				best = index;
+				best_capacity = capacity;
+			}
+			fits = 1;
+		} else if (!fits && capacity > best_capacity) {
+			best = index;
+			best_capacity = capacity;
 		}
 	}
-	return 0;
+
+	if (best < 0) {
+		vc_err(dev, "%s(): No module mode for lanes: %u, format: 0x%02x, type: 0x%02x, binning: 0x%02x!\n", __FUNCTION__, 
+			num_lanes, format, type, binning);
+		return -EINVAL;
+	}
+
+	if (fits) {
+		vc_dbg(dev, "%s(): Mode %d: capacity %llu Mbit/s, required %llu Mbit/s, headroom %llu %%\n", __FUNCTION__, 
+			best, best_capacity/1000000, required/1000000, 
+			best_capacity ? ((best_capacity - required)*100)/best_capacity : 0);
+	} else if (cam->state.framerate == 0) {
+		vc_dbg(dev, "%s(): Mode %d: capacity %llu Mbit/s (free running, fastest mode)\n", __FUNCTION__, 
+			best, best_capacity/1000000);
+	} else {
+		vc_warn(dev, "%s(): Mode %d: capacity %llu Mbit/s below required %llu Mbit/s! (Frame rate limited by the link)\n", __FUNCTION__, 
+			best, best_capacity/1000000, required/1000000);
+	}
+
+	return best;
 }
 
-static int vc_mod_write_mode(struct i2c_client *client, __u8 mode)
+static int vc_mod_write_mode(struct vc_ctrl *ctrl, __u8 mode)
 {
+	struct i2c_client *client = ctrl->client_mod;
 	struct device *dev = &client->dev;
 	int ret;
 
 	vc_dbg(dev, "%s(): Write module mode: 0x%02x\n", __FUNCTION__, mode);
 
-	ret = i2c_write_reg(dev, client, MOD_REG_MODE, mode, __FUNCTION__);
+	ret = i2c_write_reg(ctrl, client, MOD_REG_MODE, mode, __FUNCTION__);
 	if (ret)
 		vc_err(dev, "%s(): Unable to write module mode: 0x%02x (error: %d)\n", __FUNCTION__, mode, ret);
 
@@ -770,69 +1026,149 @@ static int vc_mod_reset_module(struct vc_cam *cam, __u8 mode)
 	vc_dbg(dev, "%s(): Reset the module!\n", __FUNCTION__);
 
 	ret = vc_mod_set_power(cam, 0);
-	ret |= vc_mod_write_mode(client, mode);
+	ret |= vc_mod_write_mode(ctrl, mode);
 	ret |= vc_mod_set_power(cam, 1);
-	ret |= vc_mod_wait_until_module_is_ready(client);
+	if (ret == 0)
+		cam->state.resetting = 1;
 
 	return ret;
 }
 
-int vc_mod_set_mode(struct vc_cam *cam, int *reset)
+static __u8 vc_mod_get_mode_type(struct vc_cam *cam, char **stype)
 {
-	struct vc_ctrl *ctrl = &cam->ctrl;
-	struct vc_state *state = &cam->state;
-	struct device *dev = vc_core_get_mod_device(cam);
-	__u8 num_lanes = state->num_lanes;
-	__u8 format = vc_core_v4l2_code_to_format(state->format_code);
-	char fourcc[5];
-	char *stype;
-	__u8 type = 0;
-	__u8 binning = 0; // TODO: Not implemented yet
-	__u8 mode = 0;
-	int ret = 0;
-
 	switch (cam->state.trigger_mode) {
 	case REG_TRIGGER_DISABLE:
 	case REG_TRIGGER_SYNC:
 	case REG_TRIGGER_STREAM_EDGE:
 	case REG_TRIGGER_STREAM_LEVEL:
 	default:
-		type = 0x01;
-		stype = "STREAM";
-		break;
+		*stype = "STREAM";
+		return 0x01;
 	case REG_TRIGGER_EXTERNAL:
 	case REG_TRIGGER_PULSEWIDTH:
 	case REG_TRIGGER_SELF:
 	case REG_TRIGGER_SINGLE:
-		type = 0x02;
-		stype = "EXT.TRG";
-		break;
+		*stype = "EXT.TRG";
+		return 0x02;
 	}
+}
+
+int vc_mod_plan_mode(struct vc_cam *cam)
+{
+	struct vc_state *state = &cam->state;
+	__u8 format = vc_core_v4l2_code_to_format(state->format_code);
+	__u8 binning = 0; // TODO: Not implemented yet
+	char *stype;
+
+	return vc_mod_find_mode(cam, state->num_lanes, format, vc_mod_get_mode_type(cam, &stype), binning);
+}
 
-	mode = vc_mod_find_mode(cam, num_lanes, format, type, binning);
-	if (mode == state->mode && !(ctrl->flags & FLAG_RESET_ALWAYS)) {
-		vc_dbg(dev, "%s(): Module mode %u already set!\n", __FUNCTION__, mode);
-		*reset = 0;
+// Checks if a streaming module is still alive. Returns an error if the module doesn't report to be
+// ready, e.g. after a brown-out or an I2C disturbance.
+int vc_mod_check_status(struct vc_cam *cam)
+{
+	struct vc_state *state = &cam->state;
+	int status;
+
+	if (!state->streaming || state->resetting)
 		return 0;
+
+	status = vc_mod_read_status(&cam->ctrl);
+	if (status < 0)
+		return status;
+
+	return status == REG_STATUS_READY ? 0 : -EIO;
+}
+
+// Checks if the module can restart streaming in the current mode without a reset. This is the case
+// when it is powered up and reports to be ready.
+static int vc_mod_can_restart(struct vc_cam *cam)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+
+	if (!cam->state.power_on)
+		return 0;
+
+	return vc_mod_read_status(ctrl) == REG_STATUS_READY;
+}
+
+// Sets the module mode. On return restore holds the sensor settings (RESTORE_*) which have to be
+// written again before streaming starts. If the module has been reset, state.resetting is set and
+// the caller has to wait with vc_mod_poll_ready() until it has booted and to finish the reset with
+// vc_mod_end_reset() before the hardware is accessed again.
+int vc_mod_set_mode(struct vc_cam *cam, int *restore)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+	struct device *dev = vc_core_get_mod_device(cam);
+	__u8 num_lanes = state->num_lanes;
+	char fourcc[5];
+	char *stype;
+	int mode = 0;
+	int ret = 0;
+
+	lockdep_assert_held(&cam->mutex);
+
+	vc_mod_get_mode_type(cam, &stype);
+	mode = vc_mod_plan_mode(cam);
+	if (mode < 0) {
+		return mode;
+	}
+	if (mode == state->mode) {
+		if (!(ctrl->flags & FLAG_RESET_ALWAYS)) {
+			vc_dbg(dev, "%s(): Module mode %d already set!\n", __FUNCTION__, mode);
+			*restore = 0;
+			return 0;
+		}
+		// The module firmware only clobbers some sensor registers when the stream stops.
+		// Switching the sensor from standby to operating is enough if they are written again.
+		if (vc_mod_can_restart(cam)) {
+			vc_dbg(dev, "%s(): Module mode %d already set! Restart without reset.\n", 
+				__FUNCTION__, mode);
+			*restore = ctrl->restore;
+			state->dirty |= ctrl->restore;
+			return 0;
+		}
+		vc_notice(dev, "%s(): Module not ready! Falling back to reset.\n", __FUNCTION__);
 	}
 
 	vc_core_get_v4l2_fmt(state->format_code, fourcc);
-	vc_notice(dev, "%s(): Set module mode: %u (lanes: %u, format: %s, type: %s)\n", __FUNCTION__, 
+	vc_notice(dev, "%s(): Set module mode: %d (lanes: %u, format: %s, type: %s)\n", __FUNCTION__, 
 		mode, num_lanes, fourcc, stype);
 
 	ret = vc_mod_reset_module(cam, mode);
 	if (ret) {
-		vc_err(dev, "%s(): Unable to set module mode: %u (lanes: %u, format: %s, type: %s) (error: %d)\n", __func__, 
+		vc_err(dev, "%s(): Unable to set module mode: %d (lanes: %u, format: %s, type: %s) (error: %d)\n", __func__, 
 			mode, num_lanes, fourcc, stype, ret);
 		return ret;
 	}
 
 	state->mode = mode;
-	*reset = 1;
+	*restore = RESTORE_ALL;
+	state->dirty |= RESTORE_ALL;
 
 	return ret;
 }
 
+// Finishes the module reset with the result of the wait. A module which didn't boot is reset again
+// with the next call of vc_mod_set_mode().
+void vc_mod_end_reset(struct vc_cam *cam, int ret)
+{
+	struct device *dev = vc_core_get_mod_device(cam);
+
+	cam->state.resetting = 0;
+	if (ret) {
+		vc_err(dev, "%s(): Module not ready after reset (error: %d)\n", __FUNCTION__, ret);
+		vc_mod_invalidate_mode(cam);
+	}
+}
+
+// Forces a module reset with the next call of vc_mod_set_mode().
+void vc_mod_invalidate_mode(struct vc_cam *cam)
+{
+	cam->state.mode = 0xff;
+}
+
 int vc_mod_is_trigger_enabled(struct vc_cam *cam)
 {
 	return cam->state.trigger_mode != REG_TRIGGER_DISABLE;
@@ -843,6 +1179,7 @@ int vc_mod_set_trigger_mode(struct vc_cam *cam, int mode)
 	struct vc_ctrl *ctrl = &cam->ctrl;
 	struct vc_state *state = &cam->state;
 	struct device *dev = vc_core_get_mod_device(cam);
+	__u8 trigger_mode = state->trigger_mode;
 	char *mode_desc;
 
 	if (mode == 0) {
@@ -884,6 +1221,10 @@ int vc_mod_set_trigger_mode(struct vc_cam *cam, int mode)
 
 	vc_notice(dev, "%s(): Set trigger mode: %s\n", __FUNCTION__, mode_desc);
 
+	// The exposure registers depend on the trigger mode.
+	if (state->trigger_mode != trigger_mode)
+		state->dirty |= RESTORE_TRIGGER | RESTORE_EXPOSURE;
+
 	return 0;
 }
 
@@ -904,12 +1245,29 @@ int vc_mod_get_trigger_mode(struct vc_cam *cam)
 
 int vc_mod_set_single_trigger(struct vc_cam *cam)
 {
-	struct i2c_client *client = cam->ctrl.client_mod;
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct i2c_client *client = ctrl->client_mod;
 	struct device *dev = &client->dev;
 
 	vc_notice(dev, "%s(): Set single trigger\n", __FUNCTION__);
 
-	return i2c_write_reg(dev, client, MOD_REG_EXTTRIG, REG_TRIGGER_SINGLE, __FUNCTION__);
+	if (cam->state.resetting)
+		return -EBUSY;
+
+	return i2c_write_reg(ctrl, client, MOD_REG_EXTTRIG, REG_TRIGGER_SINGLE, __FUNCTION__);
+}
+
+// Software trigger for the trigger ioctl. Unlike vc_mod_set_single_trigger() it doesn't log and
+// rejects the trigger if the module isn't streaming in single trigger mode.
+int vc_mod_fire_single_trigger(struct vc_cam *cam)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+
+	if (!state->streaming || state->resetting || state->trigger_mode != REG_TRIGGER_SINGLE)
+		return -EBUSY;
+
+	return i2c_write_reg(ctrl, ctrl->client_mod, MOD_REG_EXTTRIG, REG_TRIGGER_SINGLE, __FUNCTION__);
 }
 
 int vc_mod_is_io_enabled(struct vc_cam *cam)
@@ -922,6 +1280,7 @@ int vc_mod_set_io_mode(struct vc_cam *cam, int mode)
 	struct vc_ctrl *ctrl = &cam->ctrl;
 	struct vc_state *state = &cam->state;
 	struct device *dev = vc_core_get_mod_device(cam);
+	__u8 io_mode = state->io_mode;
 	char *mode_desc;
 
 	if (mode == 0) {
@@ -937,6 +1296,9 @@ int vc_mod_set_io_mode(struct vc_cam *cam, int mode)
 
 	vc_notice(dev, "%s(): Set IO mode: %s\n", __FUNCTION__, mode_desc);
 
+	if (state->io_mode != io_mode)
+		state->dirty |= RESTORE_IO;
+
 	return 0;
 }
 
@@ -966,18 +1328,18 @@ static int vc_sen_write_mode(struct vc_ctrl *ctrl, int mode)
 	if(mode == ctrl->csr.sen.mode_standby) {
 		value = ctrl->csr.sen.mode_standby;
 		if(ctrl->csr.sen.mode.l) {
-			ret = i2c_write_reg(dev, client, ctrl->csr.sen.mode.l, value, __FUNCTION__);
+			ret = i2c_write_reg(ctrl, client, ctrl->csr.sen.mode.l, value, __FUNCTION__);
 		}
 		if(ctrl->csr.sen.mode.m) {
-			ret |= i2c_write_reg(dev, client, ctrl->csr.sen.mode.m, value, __FUNCTION__);
+			ret |= i2c_write_reg(ctrl, client, ctrl->csr.sen.mode.m, value, __FUNCTION__);
 		}
 	} else {
 		value = ctrl->csr.sen.mode_operating;
 		if(ctrl->csr.sen.mode.m) {
-			ret |= i2c_write_reg(dev, client, ctrl->csr.sen.mode.m, value, __FUNCTION__);
+			ret |= i2c_write_reg(ctrl, client, ctrl->csr.sen.mode.m, value, __FUNCTION__);
 		}
 		if(ctrl->csr.sen.mode.l) {
-			ret = i2c_write_reg(dev, client, ctrl->csr.sen.mode.l, value, __FUNCTION__);
+			ret = i2c_write_reg(ctrl, client, ctrl->csr.sen.mode.l, value, __FUNCTION__);
 		}
 	}
 	if (ret) 
@@ -986,13 +1348,39 @@ static int vc_sen_write_mode(struct vc_ctrl *ctrl, int mode)
 	return ret;
 }
 
+// Holds back the sensor settings until the hold is released, so that a group of registers takes
+// effect in the same frame. Calls can be nested.
+static int vc_sen_hold(struct vc_cam *cam, int on)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+	struct i2c_client *client = ctrl->client_sen;
+	int ret = 0;
+
+	if (ctrl->csr.sen.hold == 0)
+		return 0;
+
+	if (on) {
+		if (state->hold++ == 0)
+			ret = i2c_write_reg(ctrl, client, ctrl->csr.sen.hold, 0x01, __FUNCTION__);
+	} else if (state->hold > 0) {
+		if (--state->hold == 0)
+			ret = i2c_write_reg(ctrl, client, ctrl->csr.sen.hold, 0x00, __FUNCTION__);
+	}
+	if (ret)
+		vc_err(&client->dev, "%s(): Couldn't %s register hold (error: %d)\n", __FUNCTION__, 
+			on ? "set" : "release", ret);
+
+	return ret;
+}
+
 static int vc_sen_read_image_size(struct vc_ctrl *ctrl, struct vc_frame *size)
 {
 	struct i2c_client *client = ctrl->client_sen;
 	struct device *dev = &client->dev;
 
-	size->width = i2c_read_reg2(dev, client, &ctrl->csr.sen.o_width);
-	size->height = i2c_read_reg2(dev, client, &ctrl->csr.sen.o_height);
+	size->width = i2c_read_reg2(ctrl, client, &ctrl->csr.sen.o_width);
+	size->height = i2c_read_reg2(ctrl, client, &ctrl->csr.sen.o_height);
 
 	vc_dbg(dev, "%s(): Read image size (width: %u, height: %u)\n", __FUNCTION__, size->width, size->height);
 	
@@ -1015,13 +1403,14 @@ int vc_sen_set_roi(struct vc_cam *cam, int x, int y, int width, int height)
 		w_height = 2*height;
 	}
 
-	ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.h_start, x, __FUNCTION__);
-	ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.v_start, w_y, __FUNCTION__);
-	ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.o_width, width, __FUNCTION__);
-	ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.o_height, w_height, __FUNCTION__);
+	ret |= i2c_write_reg2(ctrl, client, &ctrl->csr.sen.h_start, x, __FUNCTION__);
+	ret |= i2c_write_reg2(ctrl, client, &ctrl->csr.sen.v_start, w_y, __FUNCTION__);
+	ret |= i2c_write_reg2(ctrl, client, &ctrl->csr.sen.o_width, width, __FUNCTION__);
+	ret |= i2c_write_reg2(ctrl, client, &ctrl->csr.sen.o_height, w_height, __FUNCTION__);
 	if (ret) {
 		vc_err(dev, "%s(): Couldn't set sensor roi: (x: %u, y: %u, width: %u, height: %u) (error: %d)\n", __FUNCTION__, 
 			x, y, width, height, ret);
+		cam->state.dirty |= RESTORE_ROI;
 		return ret;
 	}
 
@@ -1029,14 +1418,86 @@ int vc_sen_set_roi(struct vc_cam *cam, int x, int y, int width, int height)
 	cam->state.frame.y = y;
 	cam->state.frame.width = width;
 	cam->state.frame.height = height;
+	cam->state.dirty &= ~RESTORE_ROI;
 	return 0;
 }
 
+// Moves the ROI while streaming. Width and height are kept, so that the buffer size and the
+// module mode don't change. Only the changed start registers are written under register hold,
+// so that the new position takes effect at a frame boundary.
+int vc_sen_move_roi(struct vc_cam *cam, __u32 x, __u32 y)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+	struct vc_frame *frame = &state->frame;
+	struct i2c_client *client = ctrl->client_sen;
+	struct device *dev = &client->dev;
+	int ret = 0;
+
+	if (state->resetting)
+		return -EBUSY;
+	if (ctrl->csr.sen.h_start.l == 0 || ctrl->csr.sen.v_start.l == 0) {
+		vc_err(dev, "%s(): ROI can't be moved on this module!\n", __FUNCTION__);
+		return -EINVAL;
+	}
+
+	x = min_t(__u32, x, ctrl->frame.width - frame->width);
+	y = min_t(__u32, y, ctrl->frame.height - frame->height);
+	// An odd offset would change the order of the color filter array.
+	if (vc_mod_is_color_sensor(&cam->desc)) {
+		x &= ~1;
+		y &= ~1;
+	}
+
+	vc_dbg(dev, "%s(): Move sensor roi: (x: %u, y: %u)\n", __FUNCTION__, x, y);
+
+	if (x == frame->x && y == frame->y)
+		return 0;
+	// Without register hold the sensor could read out a frame with only one start register written.
+	if (state->streaming && !ctrl->csr.sen.hold) {
+		vc_err(dev, "%s(): ROI can't be moved while streaming without register hold!\n", __FUNCTION__);
+		return -EBUSY;
+	}
+
+	ret |= vc_sen_hold(cam, 1);
+	if (x != frame->x)
+		ret |= i2c_write_reg2(ctrl, client, &ctrl->csr.sen.h_start, x, __FUNCTION__);
+	if (y != frame->y)
+		ret |= i2c_write_reg2(ctrl, client, &ctrl->csr.sen.v_start, 
+			(ctrl->flags & FLAG_DOUBLE_HEIGHT) ? 2*y : y, __FUNCTION__);
+	ret |= vc_sen_hold(cam, 0);
+	if (ret) {
+		// The restore writes the last ROI which was set successfully.
+		vc_err(dev, "%s(): Couldn't move sensor roi: (x: %u, y: %u) (error: %d)\n", __FUNCTION__, 
+			x, y, ret);
+		state->dirty |= RESTORE_ROI;
+		return ret;
+	}
+
+	frame->x = x;
+	frame->y = y;
+	return 0;
+}
+
+// Sets the windows of the sensor side multi ROI readout. count = 0 selects the single ROI of the
+// crop rectangle. The Pregius sensors (IMX250, IMX252, IMX264) can read out several windows, but
+// the window registers of the modules aren't known, so no module supports the readout yet.
+int vc_sen_set_multi_roi(struct vc_cam *cam, struct vc_frame *rois, int count)
+{
+	struct device *dev = vc_core_get_sen_device(cam);
+
+	if (count == 0)
+		return 0;
+
+	vc_err(dev, "%s(): Multi roi not supported by this module!\n", __FUNCTION__);
+	return -EINVAL;
+}
+
 static __u32 vc_sen_read_vmax(struct vc_ctrl *ctrl)
 {
 	struct i2c_client *client = ctrl->client_sen;
 	struct device *dev = &client->dev;
-	__u32 vmax = i2c_read_reg4(dev, client, &ctrl->csr.sen.vmax);
+	__u32 vmax = i2c_read_reg4(ctrl, client, &ctrl->csr.sen.vmax);
 
 	vc_dbg(dev, "%s(): Read sensor VMAX: 0x%08x (%u)\n", __FUNCTION__, vmax, vmax);
 
@@ -1047,7 +1508,7 @@ static __u32 vc_sen_read_vmax(struct vc_ctrl *ctrl)
 // {
 // 	struct i2c_client *client = ctrl->client_sen;
 // 	struct device *dev = &client->dev;
-// 	__u32 hmax = i2c_read_reg4(dev, client, &ctrl->csr.sen.hmax);
+// 	__u32 hmax = i2c_read_reg4(ctrl, client, &ctrl->csr.sen.hmax);
 
 // 	vc_dbg(dev, "%s(): Read sensor HMAX: 0x%08x (%u)\n", __FUNCTION__, hmax, hmax);
 
@@ -1061,7 +1522,7 @@ static int vc_sen_write_vmax(struct vc_ctrl *ctrl, __u32 vmax)
 
 	vc_dbg(dev, "%s(): Write sensor VMAX: 0x%08x (%u)\n", __FUNCTION__, vmax, vmax);
 
-	return i2c_write_reg4(dev, client, &ctrl->csr.sen.vmax, vmax, __FUNCTION__);
+	return i2c_write_reg4(ctrl, client, &ctrl->csr.sen.vmax, vmax, __FUNCTION__);
 }
 
 static int vc_sen_write_shs(struct vc_ctrl *ctrl, __u32 shs)
@@ -1071,7 +1532,7 @@ static int vc_sen_write_shs(struct vc_ctrl *ctrl, __u32 shs)
 
 	vc_dbg(dev, "%s(): Write sensor SHS: 0x%08x (%u)\n", __FUNCTION__, shs, shs);
 
-	return i2c_write_reg4(dev, client, &ctrl->csr.sen.shs, shs, __FUNCTION__);
+	return i2c_write_reg4(ctrl, client, &ctrl->csr.sen.shs, shs, __FUNCTION__);
 }
 
 static int vc_sen_write_flash_duration(struct vc_ctrl *ctrl, __u32 duration)
@@ -1081,7 +1542,7 @@ static int vc_sen_write_flash_duration(struct vc_ctrl *ctrl, __u32 duration)
 
 	vc_dbg(dev, "%s(): Write sensor flash duration: 0x%08x (%u)\n", __FUNCTION__, duration, duration);
 
-	return i2c_write_reg4(dev, client, &ctrl->csr.sen.flash_duration, duration, __FUNCTION__);
+	return i2c_write_reg4(ctrl, client, &ctrl->csr.sen.flash_duration, duration, __FUNCTION__);
 }
 
 static int vc_sen_write_flash_offset(struct vc_ctrl *ctrl, __u32 offset)
@@ -1091,7 +1552,7 @@ static int vc_sen_write_flash_offset(struct vc_ctrl *ctrl, __u32 offset)
 
 	vc_dbg(dev, "%s(): Write sensor flash offset: 0x%08x (%u)\n", __FUNCTION__, offset, offset);
 
-	return i2c_write_reg4(dev, client, &ctrl->csr.sen.flash_offset, offset, __FUNCTION__);
+	return i2c_write_reg4(ctrl, client, &ctrl->csr.sen.flash_offset, offset, __FUNCTION__);
 }
 
 int vc_sen_set_gain(struct vc_cam *cam, int gain)
@@ -1108,13 +1569,24 @@ int vc_sen_set_gain(struct vc_cam *cam, int gain)
 
 	vc_notice(dev, "%s(): Set sensor gain: %u\n", __FUNCTION__, gain);
 
-	ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.gain, gain, __FUNCTION__);
+	if (cam->state.resetting) {
+		// Written by vc_sen_restore() when the module is ready.
+		cam->state.gain = gain;
+		cam->state.dirty |= RESTORE_GAIN;
+		return 0;
+	}
+
+	ret |= vc_sen_hold(cam, 1);
+	ret |= i2c_write_reg2(ctrl, client, &ctrl->csr.sen.gain, gain, __FUNCTION__);
+	ret |= vc_sen_hold(cam, 0);
 	if (ret) {
 		vc_err(dev, "%s(): Couldn't set gain (error: %d)\n", __FUNCTION__, ret);
+		cam->state.dirty |= RESTORE_GAIN;
 		return ret;
 	}
 
 	cam->state.gain = gain;
+	cam->state.dirty &= ~RESTORE_GAIN;
 	return 0;
 }
 
@@ -1132,22 +1604,133 @@ int vc_sen_set_blacklevel(struct vc_cam *cam, int blacklevel)
 
 	vc_notice(dev, "%s(): Set sensor black level: %u\n", __FUNCTION__, blacklevel);
 
-	ret |= i2c_write_reg2(dev, client, &ctrl->csr.sen.blacklevel, blacklevel, __FUNCTION__);
+	if (cam->state.resetting) {
+		cam->state.blacklevel = blacklevel;
+		cam->state.dirty |= RESTORE_BLACKLEVEL;
+		return 0;
+	}
+
+	ret |= i2c_write_reg2(ctrl, client, &ctrl->csr.sen.blacklevel, blacklevel, __FUNCTION__);
 	if (ret) {
 		vc_err(dev, "%s(): Couldn't set black level (error: %d)\n", __FUNCTION__, ret);
+		cam->state.dirty |= RESTORE_BLACKLEVEL;
 		return ret;
 	}
 
 	cam->state.blacklevel = blacklevel;
+	cam->state.dirty &= ~RESTORE_BLACKLEVEL;
+	return 0;
+}
+
+// The test patterns of some sensors (IMX290, IMX327) are offset by the black level. It is saved
+// and set to 0 while a pattern is active and written back when the pattern is disabled. A pattern
+// which is replayed after a reset saves the black level the module has loaded again. A read of 0
+// means the driver has zeroed it already (e.g. switch between two patterns), so the saved value
+// is kept.
+static int vc_sen_set_pattern_blacklevel(struct vc_cam *cam, int pattern)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+	struct i2c_client *client = ctrl->client_sen;
+	struct vc_csr2 *csr = &ctrl->csr.sen.pattern_blacklevel;
+	__u32 blacklevel;
+	int ret = 0;
+
+	if (!csr->l)
+		return 0;
+
+	if (pattern == 0) {
+		if (state->pattern_blacklevel == 0)
+			return 0;
+		ret = i2c_write_reg2(ctrl, client, csr, state->pattern_blacklevel, __FUNCTION__);
+		if (!ret)
+			state->pattern_blacklevel = 0;
+		return ret;
+	}
+
+	blacklevel = i2c_read_reg2(ctrl, client, csr);
+	if (blacklevel)
+		state->pattern_blacklevel = blacklevel;
+	return i2c_write_reg2(ctrl, client, csr, 0, __FUNCTION__);
+}
+
+int vc_sen_set_test_pattern(struct vc_cam *cam, int pattern)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct i2c_client *client = ctrl->client_sen;
+	struct device *dev = &client->dev;
+	int ret = 0;
+
+	if (pattern < 0 || pattern >= ctrl->num_test_patterns) {
+		vc_err(dev, "%s(): Test pattern %d not supported!\n", __FUNCTION__, pattern);
+		return -EINVAL;
+	}
+
+	vc_notice(dev, "%s(): Set sensor test pattern: %s\n", __FUNCTION__, ctrl->test_patterns[pattern].name);
+
+	if (cam->state.resetting) {
+		cam->state.test_pattern = pattern;
+		cam->state.dirty |= RESTORE_TEST_PATTERN;
+		return 0;
+	}
+
+	ret |= vc_sen_hold(cam, 1);
+	ret |= vc_sen_set_pattern_blacklevel(cam, pattern);
+	ret |= i2c_write_reg2(ctrl, client, &ctrl->csr.sen.test_pattern, ctrl->test_patterns[pattern].value, 
+		__FUNCTION__);
+	ret |= vc_sen_hold(cam, 0);
+	if (ret) {
+		vc_err(dev, "%s(): Couldn't set test pattern (error: %d)\n", __FUNCTION__, ret);
+		cam->state.dirty |= RESTORE_TEST_PATTERN;
+		return ret;
+	}
+
+	cam->state.test_pattern = pattern;
+	cam->state.dirty &= ~RESTORE_TEST_PATTERN;
 	return 0;
 }
 
+static void vc_calculate_retrigger(struct vc_cam *cam);
+
+// Writes the sensor settings which were changed or lost since the sensor has seen them.
+int vc_sen_restore(struct vc_cam *cam)
+{
+	struct vc_state *state = &cam->state;
+	struct vc_frame *frame = &state->frame;
+	struct device *dev = vc_core_get_sen_device(cam);
+	int ret = 0;
+
+	vc_dbg(dev, "%s(): Dirty settings: 0x%02x\n", __FUNCTION__, state->dirty);
+
+	// The test pattern generator is disabled after a reset or restart of the sensor.
+	if (state->test_pattern == 0)
+		state->dirty &= ~RESTORE_TEST_PATTERN;
+	if (!(state->dirty & (RESTORE_ROI | RESTORE_EXPOSURE | RESTORE_GAIN | RESTORE_BLACKLEVEL | 
+			RESTORE_TEST_PATTERN)))
+		return 0;
+
+	ret |= vc_sen_hold(cam, 1);
+	if (state->dirty & RESTORE_ROI)
+		ret |= vc_sen_set_roi(cam, frame->x, frame->y, frame->width, frame->height);
+	if (state->dirty & RESTORE_EXPOSURE)
+		ret |= vc_sen_set_exposure(cam, state->exposure);
+	if (state->dirty & RESTORE_GAIN)
+		ret |= vc_sen_set_gain(cam, state->gain);
+	if (state->dirty & RESTORE_BLACKLEVEL)
+		ret |= vc_sen_set_blacklevel(cam, state->blacklevel);
+	if (state->dirty & RESTORE_TEST_PATTERN)
+		ret |= vc_sen_set_test_pattern(cam, state->test_pattern);
+	ret |= vc_sen_hold(cam, 0);
+
+	return ret;
+}
+
 int vc_sen_start_stream(struct vc_cam *cam)
 {
 	struct vc_ctrl *ctrl = &cam->ctrl;
 	struct vc_state *state = &cam->state;
-	struct i2c_client *client_mod = ctrl->client_mod;
 	struct device *dev = &ctrl->client_sen->dev;
+	__u32 retrigger_cnt;
 	int ret = 0;
 	
 	vc_notice(dev, "%s(): Start streaming\n", __FUNCTION__);
@@ -1158,29 +1741,28 @@ int vc_sen_start_stream(struct vc_cam *cam)
 		vc_sen_stop_stream(cam);
 	}
 
-	state->retrigger_cnt = 0;
+	// Only the module settings which differ from the module registers are written.
 	if (state->trigger_mode == REG_TRIGGER_SELF) {
-		if (state->framerate > 0) {
-			__u32 frametime;
-			__u32 retrigger = 0;
-
-			frametime = 1000000 / state->framerate;
-			if (frametime >= state->exposure) {
-				retrigger = frametime - state->exposure;
-			} 
-			state->retrigger_cnt = ((__u64)retrigger * cam->ctrl.sen_clk) / 1000000;
-			if (state->retrigger_cnt < ctrl->retrigger_def) {
-				state->retrigger_cnt = ctrl->retrigger_def;
-			}
-			
-		} else {
-			state->retrigger_cnt = ctrl->retrigger_def;
+		retrigger_cnt = state->retrigger_cnt;
+		vc_calculate_retrigger(cam);
+		if ((state->dirty & RESTORE_RETRIGGER) || state->retrigger_cnt != retrigger_cnt) {
+			state->dirty |= RESTORE_RETRIGGER;
+			if (vc_mod_write_retrigger(ctrl, state->retrigger_cnt) == 0)
+				state->dirty &= ~RESTORE_RETRIGGER;
 		}
-		ret |= vc_mod_write_retrigger(client_mod, state->retrigger_cnt);
 	}
-
-	ret |= vc_mod_write_trigger_mode(client_mod, state->trigger_mode);
-	ret |= vc_mod_write_io_mode(client_mod, state->io_mode);
+	if (state->dirty & RESTORE_TRIGGER) {
+		if (vc_mod_write_trigger_mode(ctrl, state->trigger_mode) == 0)
+			state->dirty &= ~RESTORE_TRIGGER;
+	}
+	if (state->dirty & RESTORE_IO) {
+		if (vc_mod_write_io_mode(ctrl, state->io_mode) == 0)
+			state->dirty &= ~RESTORE_IO;
+	}
+	if (state->dirty & (RESTORE_TRIGGER | RESTORE_IO))
+		ret = -EIO;
+	if (state->trigger_mode == REG_TRIGGER_SELF && (state->dirty & RESTORE_RETRIGGER))
+		ret = -EIO;
 
 	ret |= vc_sen_write_mode(ctrl, ctrl->csr.sen.mode_operating);
 	if (ret)
@@ -1195,14 +1777,19 @@ int vc_sen_stop_stream(struct vc_cam *cam)
 {
 	struct vc_ctrl *ctrl = &cam->ctrl;
 	struct vc_state *state = &cam->state;
-	struct i2c_client *client_mod = ctrl->client_mod;
 	struct device *dev = &ctrl->client_sen->dev;
 	int ret = 0;
 
 	vc_notice(dev, "%s(): Stop streaming\n", __FUNCTION__);
 
-	ret |= vc_mod_write_trigger_mode(client_mod, REG_TRIGGER_DISABLE);
-	ret |= vc_mod_write_io_mode(client_mod, REG_IO_DISABLE);
+	ret |= vc_mod_write_trigger_mode(ctrl, REG_TRIGGER_DISABLE);
+	ret |= vc_mod_write_io_mode(ctrl, REG_IO_DISABLE);
+
+	// The module registers now only match the state if trigger and IO are disabled.
+	if (ret || state->trigger_mode != REG_TRIGGER_DISABLE)
+		state->dirty |= RESTORE_TRIGGER;
+	if (ret || state->io_mode != REG_IO_DISABLE)
+		state->dirty |= RESTORE_IO;
 
 	ret |= vc_sen_write_mode(ctrl, ctrl->csr.sen.mode_standby);
 	if (ret)
@@ -1218,17 +1805,56 @@ int vc_sen_stop_stream(struct vc_cam *cam)
 
 // ------------------------------------------------------------------------------------------------
 
+// Converts a time in µs into ticks of the given clock. The module registers (MOD_REG_EXPO_* and 
+// MOD_REG_RETRIG_*) are 32 bit wide. Larger values are clamped instead of silently truncated.
+static __u32 vc_core_us_to_ticks(struct device *dev, __u64 time_us, __u32 clk, const char *name)
+{
+	__u64 ticks = (time_us * clk) / 1000000;
+
+	if (ticks > U32_MAX) {
+		vc_warn(dev, "%s(): %s %llu exceeds 32 bit! (Clamped to 0x%08x)\n", __FUNCTION__, 
+			name, ticks, U32_MAX);
+		return U32_MAX;
+	}
+
+	return ticks;
+}
+
+// Returns the largest value that fits into the sensor register described by csr.
+static __u32 vc_core_csr4_max(struct vc_csr4 *csr)
+{
+	__u32 bytes = (csr->l ? 1 : 0) + (csr->m ? 1 : 0) + (csr->h ? 1 : 0) + (csr->u ? 1 : 0);
+
+	return (bytes >= 4) ? U32_MAX : (1U << (8*bytes)) - 1;
+}
+
 static void vc_calculate_exposure_simple(struct vc_cam *cam, __u32 exposure)
 {
 	struct vc_ctrl *ctrl = &cam->ctrl;
 	struct vc_state *state = &cam->state;
-	__u32 factor = ctrl->expo_factor;
-	__u32 toffset = ctrl->expo_toffset;
+	struct device *dev = &ctrl->client_sen->dev;
+	__u64 shs = (((__u64)exposure)*ctrl->expo_factor)/1000000;
+	__s64 toffset = ctrl->expo_toffset;
+
+	// The sensor can't expose shorter than the time offset.
+	if ((__s64)shs < toffset) {
+		vc_warn(dev, "%s(): Exposure %u us is below the time offset! (SHS clamped to 0)\n", 
+			__FUNCTION__, exposure);
+		shs = 0;
+	} else {
+		shs -= toffset;
+	}
+
+	if (shs > vc_core_csr4_max(&ctrl->csr.sen.shs)) {
+		vc_warn(dev, "%s(): SHS %llu exceeds register width! (Clamped)\n", __FUNCTION__, shs);
+		shs = vc_core_csr4_max(&ctrl->csr.sen.shs);
+	}
 
-	state->shs = (((__u64)exposure)*factor)/1000000 - toffset;
+	state->shs = shs;
 }
 
-static void vc_core_get_timing(struct vc_cam *cam, __u32 *period_1H_ns)
+// Looks up the 1H period (line time) for the current number of lanes and format.
+static int vc_core_find_period_1H(struct vc_cam *cam, __u32 *period_1H_ns)
 {
 	struct vc_desc *desc = &cam->desc;
 	struct vc_ctrl *ctrl = &cam->ctrl;
@@ -1237,50 +1863,80 @@ static void vc_core_get_timing(struct vc_cam *cam, __u32 *period_1H_ns)
 	__u8 format = vc_core_v4l2_code_to_format(state->format_code);
 	__u8 index = 0;
 
-	for (index = 0; index < 6; index++) {
+	for (index = 0; index < ARRAY_SIZE(ctrl->expo_timing); index++) {
 		struct vc_timing *timing = &ctrl->expo_timing[index];
-		if (timing->num_lanes == num_lanes && timing->format == format) {
+		if (timing->num_lanes == 0) {
+			break;
+		}
+		if (timing->num_lanes == num_lanes && timing->format == format && desc->clk_pixel) {
 			*period_1H_ns = ((__u64)timing->clk * 1000000000) / desc->clk_pixel;
-			return;
+			break;
 		}
 	}
 
-	*period_1H_ns = ctrl->expo_period_1H;
+	if (*period_1H_ns == 0) {
+		*period_1H_ns = ctrl->expo_period_1H;
+	}
+
+	return (*period_1H_ns == 0) ? -EINVAL : 0;
+}
+
+static int vc_core_get_timing(struct vc_cam *cam, __u32 *period_1H_ns)
+{
+	struct vc_state *state = &cam->state;
+	struct device *dev = vc_core_get_sen_device(cam);
+
+	if (vc_core_find_period_1H(cam, period_1H_ns)) {
+		vc_err(dev, "%s(): No 1H period for lanes: %u, format: 0x%02x!\n", __FUNCTION__, 
+			state->num_lanes, vc_core_v4l2_code_to_format(state->format_code));
+		return -EINVAL;
+	}
+
+	return 0;
 }
 
-static void vc_calculate_exposure_vmax(struct vc_cam *cam, __u32 exposure)
+static int vc_calculate_exposure_vmax(struct vc_cam *cam, __u32 exposure)
 {
 	struct vc_ctrl *ctrl = &cam->ctrl;
 	struct vc_state *state = &cam->state;
 	struct device *dev = &ctrl->client_sen->dev;
 	__u32 period_1H_ns = 0;
 	__u32 shs_min = ctrl->expo_shs_min;
+	__u32 vmax_max = vc_core_csr4_max(&ctrl->csr.sen.vmax);
+	__u64 vmax;
 	__u64 frametime_ns;
 	__u64 frametime_1H;
 	__u64 exposure_ns;
 	__u64 exposure_1H;
 	// __u64 hmax;
 
-	vc_core_get_timing(cam, &period_1H_ns);
+	if (vc_core_get_timing(cam, &period_1H_ns)) {
+		return -EINVAL;
+	}
 	
 	vc_dbg(dev, "%s(): flags: 0x%04x, period_1H_ns: %u, shs_min: %u, vmax: %u\n", __FUNCTION__, 
 		ctrl->flags, period_1H_ns, shs_min, ctrl->expo_vmax);
 
 	if (ctrl->flags & FLAG_EXPOSURE_READ_VMAX) {	
-		state->vmax = vc_sen_read_vmax(&cam->ctrl);
-		if (state->vmax == 0) {
+		vmax = vc_sen_read_vmax(&cam->ctrl);
+		if (vmax == 0) {
 			vc_err(dev, "%s(): VMAX should not be zero! Using default value.\n", __FUNCTION__);
-			state->vmax = ctrl->expo_vmax;
+			vmax = ctrl->expo_vmax;
 		}
 	} else {
-		state->vmax = ctrl->expo_vmax;	
+		vmax = ctrl->expo_vmax;	
+	}
+
+	// A requested vertical blanking extends the frame to height + vblank lines.
+	if (state->vblank > 0 && state->frame.height + state->vblank > vmax) {
+		vmax = state->frame.height + state->vblank;
 	}
 
 	if (state->framerate > 0) {
 		frametime_ns = 1000000000 / state->framerate;
 		frametime_1H = frametime_ns / period_1H_ns;
-		if (frametime_1H > state->vmax) {
-			state->vmax = frametime_1H;
+		if (frametime_1H > vmax) {
+			vmax = frametime_1H;
 		}
 
 		vc_dbg(dev, "%s(): framerate: %u, frametime: %llu ns, %llu 1H", __FUNCTION__, 
@@ -1299,27 +1955,62 @@ static void vc_calculate_exposure_vmax(struct vc_cam *cam, __u32 exposure)
 	exposure_1H = exposure_ns / period_1H_ns;
 
 	// Is exposure time less than frame time?
-	if (exposure_1H < state->vmax - shs_min) {
+	if (exposure_1H + shs_min < vmax) {
 		// Yes then calculate exposure delay (shs) in between frame time.
 		// |                 VMAX (frame time)             ---> |
 		// | SHS_MIN |                                          |
 		// +----------------------------+-----------------------+
 		// | SHS (exposure delay) --->  |    exposure time ---> | 
-		state->shs = state->vmax - exposure_1H;
+		state->shs = vmax - exposure_1H;
 	
 	} else {
 		// No, then increase frame time and set exposure delay to the minimal value.
 		// |                 VMAX (frame time)                   ---> |
 		// +---------+------------------------------------------------+
 		// | SHS     |                             exposure time ---> | 
-		state->vmax = shs_min + exposure_1H;
+		vmax = shs_min + exposure_1H;
+		state->shs = shs_min;
+	}
+
+	// The frame time can't be extended beyond the width of the VMAX register. The exposure time
+	// is limited accordingly.
+	if (vmax > vmax_max) {
+		vc_warn(dev, "%s(): VMAX %llu exceeds register width! (Clamped to %u)\n", __FUNCTION__, 
+			vmax, vmax_max);
+		vmax = vmax_max;
 		state->shs = shs_min;
 	}
+	state->vmax = vmax;
 
 	// Special case: Framerate of slave module has to be a little bit faster (Tested with IMX183)
 	if (state->trigger_mode == REG_TRIGGER_SYNC) {
 		state->vmax--;
 	}
+
+	return 0;
+}
+
+static void vc_calculate_retrigger(struct vc_cam *cam)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+	struct device *dev = &ctrl->client_sen->dev;
+	__u32 frametime;
+	__u32 retrigger = 0;
+
+	if (state->framerate == 0) {
+		state->retrigger_cnt = ctrl->retrigger_def;
+		return;
+	}
+
+	frametime = 1000000 / state->framerate;
+	if (frametime >= state->exposure) {
+		retrigger = frametime - state->exposure;
+	} 
+	state->retrigger_cnt = vc_core_us_to_ticks(dev, retrigger, ctrl->sen_clk, "Retrigger");
+	if (state->retrigger_cnt < ctrl->retrigger_def) {
+		state->retrigger_cnt = ctrl->retrigger_def;
+	}
 }
 
 int vc_sen_set_exposure(struct vc_cam *cam, int exposure)
@@ -1327,7 +2018,6 @@ int vc_sen_set_exposure(struct vc_cam *cam, int exposure)
 	struct vc_ctrl *ctrl = &cam->ctrl;
 	struct vc_state *state = &cam->state;
 	struct device *dev = vc_core_get_sen_device(cam);
-	struct i2c_client *client_mod = ctrl->client_mod;
 	int ret = 0;
 
 	vc_notice(dev, "%s(): Set sensor exposure: %u us\n", __FUNCTION__, exposure);
@@ -1337,6 +2027,12 @@ int vc_sen_set_exposure(struct vc_cam *cam, int exposure)
 	if (exposure > ctrl->exposure.max)
 		exposure = ctrl->exposure.max;
 
+	if (state->resetting) {
+		state->exposure = exposure;
+		state->dirty |= RESTORE_EXPOSURE;
+		return 0;
+	}
+
 	state->vmax = 0;
 	state->shs = 0;
 	state->exposure_cnt = 0;
@@ -1344,19 +2040,19 @@ int vc_sen_set_exposure(struct vc_cam *cam, int exposure)
 	switch (state->trigger_mode) {
 	case REG_TRIGGER_EXTERNAL:
 	case REG_TRIGGER_SINGLE:
-		state->exposure_cnt = ((__u64)exposure * cam->ctrl.sen_clk) / 1000000;
-		ret  = vc_mod_write_exposure(client_mod, state->exposure_cnt);
+		state->exposure_cnt = vc_core_us_to_ticks(dev, exposure, ctrl->sen_clk, "Exposure");
+		ret  = vc_mod_write_exposure(ctrl, state->exposure_cnt);
 		break;
 	case REG_TRIGGER_PULSEWIDTH:
 		break;
 	case REG_TRIGGER_SELF:
-		state->exposure_cnt = ((__u64)exposure * cam->ctrl.sen_clk) / 1000000;
+		state->exposure_cnt = vc_core_us_to_ticks(dev, exposure, ctrl->sen_clk, "Exposure");
 		if (state->streaming && state->framerate > 0) {
 			vc_notice(dev, "%s(): Need to restart streaming!\n", __FUNCTION__);
 			// Workaround to be able to change exposure time and keep framerate.
 			ret |= vc_sen_stop_stream(cam);
-			usleep_range(100000, 100000);
-			ret |= vc_mod_write_exposure(client_mod, state->exposure_cnt);
+			vc_sleep_range(ctrl, 100000, 100000);
+			ret |= vc_mod_write_exposure(ctrl, state->exposure_cnt);
 			if (ret == 0) {
 				// It is necessary to update state.exposure so that the retrigger counter
 				// can be calculated correctly.
@@ -1364,7 +2060,7 @@ int vc_sen_set_exposure(struct vc_cam *cam, int exposure)
 				ret |= vc_sen_start_stream(cam);
 			}
 		} else {
-			ret |= vc_mod_write_exposure(client_mod, state->exposure_cnt);
+			ret |= vc_mod_write_exposure(ctrl, state->exposure_cnt);
 		}
 		break;
 	case REG_TRIGGER_DISABLE:
@@ -1375,26 +2071,202 @@ int vc_sen_set_exposure(struct vc_cam *cam, int exposure)
 			vc_calculate_exposure_simple(cam, exposure);
 
 		} else if (ctrl->flags & (FLAG_EXPOSURE_READ_VMAX | FLAG_EXPOSURE_WRITE_VMAX)) {
-			vc_calculate_exposure_vmax(cam, exposure);
+			ret = vc_calculate_exposure_vmax(cam, exposure);
+			if (ret)
+				break;
 		} 
-		ret = vc_sen_write_shs(ctrl, state->shs);
+		// SHS and VMAX have to change in the same frame.
+		ret = vc_sen_hold(cam, 1);
+		ret |= vc_sen_write_shs(ctrl, state->shs);
 		if (ctrl->flags & FLAG_EXPOSURE_WRITE_VMAX) {
 			ret |= vc_sen_write_vmax(ctrl, state->vmax);
 		}
+		ret |= vc_sen_hold(cam, 0);
 	}
 
 	if (ctrl->flags & FLAG_IO_FLASH_DURATION) {
-		__u32 duration = (((__u64)exposure)*ctrl->flash_factor)/1000000;
+		__u32 duration = vc_core_us_to_ticks(dev, exposure, ctrl->flash_factor, "Flash duration");
 		ret |= vc_sen_write_flash_duration(ctrl, duration);
 		ret |= vc_sen_write_flash_offset(ctrl, ctrl->flash_toffset);
 	}
 
 	if (ret == 0) {
 		cam->state.exposure = exposure;
+		state->dirty &= ~RESTORE_EXPOSURE;
+	} else {
+		state->dirty |= RESTORE_EXPOSURE;
 	}
 
 	vc_dbg(dev, "%s(): VMAX: %5u, SHS: %5u, EXPC: %6u, RETC: %6u\n",
 		__FUNCTION__, state->vmax, state->shs, state->exposure_cnt, state->retrigger_cnt);
 
 	return ret;
-}
\ No newline at end of file
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Sensor timing in lines (VMAX based exposure only)
+
+int vc_core_has_line_timing(struct vc_cam *cam)
+{
+	__u32 period_1H_ns = 0;
+
+	return (cam->ctrl.flags & FLAG_EXPOSURE_WRITE_VMAX) && 
+		vc_core_find_period_1H(cam, &period_1H_ns) == 0;
+}
+
+// Horizontal blanking in pixels at the given pixel rate, so that (width + hblank) / pixel_rate
+// equals the 1H period of the exposure calculation.
+__u32 vc_core_get_hblank(struct vc_cam *cam, __s64 pixel_rate)
+{
+	__u32 period_1H_ns = 0;
+	__u64 line_length;
+
+	if (vc_core_find_period_1H(cam, &period_1H_ns) || pixel_rate <= 0)
+		return 0;
+
+	line_length = ((__u64)period_1H_ns * pixel_rate) / 1000000000;
+	if (line_length <= cam->state.frame.width)
+		return 0;
+
+	return line_length - cam->state.frame.width;
+}
+
+void vc_core_get_vblank_range(struct vc_cam *cam, struct vc_control *vblank)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	__u32 height = cam->state.frame.height;
+	__u32 vmax_max = vc_core_csr4_max(&ctrl->csr.sen.vmax);
+
+	vblank->min = (ctrl->expo_vmax > height) ? ctrl->expo_vmax - height : 0;
+	vblank->max = (vmax_max > height) ? vmax_max - height : vblank->min;
+	vblank->def = vblank->min;
+}
+
+int vc_core_set_vblank(struct vc_cam *cam, __u32 vblank)
+{
+	struct device *dev = vc_core_get_sen_device(cam);
+
+	vc_notice(dev, "%s(): Set vertical blanking: %u lines\n", __FUNCTION__, vblank);
+
+	cam->state.vblank = vblank;
+	return vc_sen_set_exposure(cam, cam->state.exposure);
+}
+
+void vc_core_get_exposure_lines_range(struct vc_cam *cam, struct vc_control *lines)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	__u32 period_1H_ns = 0;
+
+	*lines = (vc_control) { .min = 1, .max = 1, .def = 1 };
+	if (vc_core_find_period_1H(cam, &period_1H_ns))
+		return;
+
+	lines->max = vc_core_csr4_max(&ctrl->csr.sen.vmax) - ctrl->expo_shs_min;
+	lines->def = clamp_t(__u32, ((__u64)ctrl->exposure.def * 1000) / period_1H_ns, lines->min, lines->max);
+}
+
+// Converts the exposure time from lines into µs (rounded up, so that the exposure calculation
+// gets back the same number of lines) and sets it.
+int vc_sen_set_exposure_lines(struct vc_cam *cam, __u32 lines)
+{
+	__u32 period_1H_ns = 0;
+
+	if (vc_core_get_timing(cam, &period_1H_ns))
+		return -EINVAL;
+
+	return vc_sen_set_exposure(cam, DIV_ROUND_UP((__u64)lines * period_1H_ns, 1000));
+}
+
+
+// ------------------------------------------------------------------------------------------------
+//  Timed exposure bracket in single trigger mode
+
+// Writes only the bytes of the module exposure which differ from the last written value.
+static int vc_mod_update_exposure(struct vc_cam *cam, __u32 exposure_cnt)
+{
+	static const __u16 regs[] = { MOD_REG_EXPO_L, MOD_REG_EXPO_M, MOD_REG_EXPO_H, MOD_REG_EXPO_U };
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+	__u32 changed = state->exposure_cnt ^ exposure_cnt;
+	int index;
+	int ret = 0;
+
+	if (state->dirty & RESTORE_EXPOSURE)
+		changed = U32_MAX;
+
+	for (index = 0; index < ARRAY_SIZE(regs); index++) {
+		if ((changed >> (8*index)) & 0xff)
+			ret |= i2c_write_reg(ctrl, ctrl->client_mod, regs[index], 
+				(exposure_cnt >> (8*index)) & 0xff, __FUNCTION__);
+	}
+	if (ret) {
+		state->dirty |= RESTORE_EXPOSURE;
+		return ret;
+	}
+
+	state->exposure_cnt = exposure_cnt;
+	state->dirty &= ~RESTORE_EXPOSURE;
+	return 0;
+}
+
+// Estimates the time the module needs to expose and read out a frame.
+static __u32 vc_core_get_frame_time(struct vc_cam *cam, __u32 exposure)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	__u32 period_1H_ns = 0;
+
+	if (vc_core_find_period_1H(cam, &period_1H_ns) == 0)
+		return exposure + ((__u64)cam->state.frame.height * period_1H_ns) / 1000;
+	if (ctrl->framerate.max > 0)
+		return exposure + 1000000 / ctrl->framerate.max;
+
+	return exposure + 1000000 / 30;
+}
+
+// Sets the exposure of the next frame and triggers it. Returns the time the module needs for the
+// frame in frame_us. The caller has to wait this time before the next trigger.
+int vc_mod_bracket_trigger(struct vc_cam *cam, __u32 exposure, __u32 *frame_us)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+	struct device *dev = vc_core_get_mod_device(cam);
+	int ret;
+
+	if (!state->streaming || state->resetting || state->trigger_mode != REG_TRIGGER_SINGLE)
+		return -EBUSY;
+
+	exposure = clamp_t(__u32, exposure, ctrl->exposure.min, ctrl->exposure.max);
+	vc_dbg(dev, "%s(): Trigger bracket exposure: %u us\n", __FUNCTION__, exposure);
+
+	ret  = vc_mod_update_exposure(cam, vc_core_us_to_ticks(dev, exposure, ctrl->sen_clk, "Exposure"));
+	ret |= i2c_write_reg(ctrl, ctrl->client_mod, MOD_REG_EXTTRIG, REG_TRIGGER_SINGLE, __FUNCTION__);
+	if (ret) {
+		vc_err(dev, "%s(): Unable to trigger bracket exposure: %u us (error: %d)\n", __FUNCTION__, 
+			exposure, ret);
+		return ret;
+	}
+
+	*frame_us = vc_core_get_frame_time(cam, exposure);
+	return 0;
+}
+
+// Writes back the exposure of the control after the bracket.
+int vc_mod_bracket_end(struct vc_cam *cam)
+{
+	struct vc_ctrl *ctrl = &cam->ctrl;
+	struct vc_state *state = &cam->state;
+	struct device *dev = vc_core_get_mod_device(cam);
+
+	if (state->trigger_mode != REG_TRIGGER_SINGLE)
+		return 0;
+	if (state->resetting) {
+		state->dirty |= RESTORE_EXPOSURE;
+		return 0;
+	}
+
+	return vc_mod_update_exposure(cam, vc_core_us_to_ticks(dev, state->exposure, ctrl->sen_clk, "Exposure"));
+}
+
+#ifdef CONFIG_VIDEO_VC_MIPI_KUNIT_TEST
+#include "vc_mipi_core_test.c"
+#endif
@@ -5,6 +5,8 @@
 
 #include <linux/types.h>
 #include <linux/i2c.h>
+#include <linux/mutex.h>
+#include <linux/seqlock.h>
 #include <linux/videodev2.h>
 
 #define vc_dbg(dev, fmt, ...) dev_dbg(dev, fmt, ##__VA_ARGS__)
@@ -32,6 +34,24 @@
 #define FLAG_TRIGGER_STREAM_EDGE  	0x4000
 #define FLAG_TRIGGER_STREAM_LEVEL 	0x8000
 
+// Sensor settings which have to be written again before streaming starts.
+#define RESTORE_ROI			0x01
+#define RESTORE_EXPOSURE		0x02
+#define RESTORE_GAIN			0x04
+#define RESTORE_BLACKLEVEL		0x08
+#define RESTORE_TRIGGER			0x10
+#define RESTORE_IO			0x20
+#define RESTORE_RETRIGGER		0x40
+#define RESTORE_TEST_PATTERN		0x80
+#define RESTORE_ALL			0xff
+
+// Maximum number of exposures of a bracket
+#define VC_BRACKET_MAX			8
+// Maximum number of test patterns incl. the disabled generator
+#define VC_TEST_PATTERN_MAX		8
+// Maximum number of windows of the sensor side multi ROI readout
+#define VC_ROI_MAX			8
+
 #define FORMAT_RAW08			0x2a
 #define FORMAT_RAW10			0x2b
 #define FORMAT_RAW12			0x2c
@@ -103,6 +123,11 @@ typedef struct vc_frame {
 	__u32 height;
 } vc_frame;
 
+struct vc_test_pattern {
+	char *name;
+	__u16 value;			// Value of the test pattern register
+};
+
 typedef struct vc_csr2 {
 	__u32 l;
 	__u32 m;
@@ -130,12 +155,33 @@ struct vc_sen_csr {
 	struct vc_csr2 o_height;
 	struct vc_csr4 flash_duration;
 	struct vc_csr4 flash_offset;
+	__u32 hold;			// Register hold (0 = not available)
+	struct vc_csr2 test_pattern;
+	struct vc_csr2 pattern_blacklevel;	// Zeroed while a test pattern is active (0 = not needed)
 };
 
 struct vc_csr {
 	struct vc_sen_csr sen;
 };
 
+// Counters wrap around. Consumers should only evaluate differences between two snapshots.
+struct vc_i2c_stats {
+	__u32 transfers;		// Calls to i2c_transfer()
+	__u32 msgs;			// I2C messages
+	__u32 bytes;			// Payload bytes incl. register address
+	__u32 bits;			// Modeled bus clocks incl. START, address, ACK and STOP
+	__u32 errors;			// Failed transfers
+	__u32 sleep_us;			// Time spent waiting for the module
+};
+
+struct vc_stream_stats {
+	__u32 count;			// Successful STREAMON
+	__u32 last_us;			// Time from STREAMON until the sensor is operating
+	__u32 min_us;
+	__u32 max_us;
+	__u64 total_us;
+};
+
 typedef struct vc_timing {
 	__u8 num_lanes;
 	__u8 format;
@@ -147,6 +193,8 @@ struct vc_ctrl {
 	int mod_i2c_addr;
 	struct i2c_client *client_sen;
 	struct i2c_client *client_mod;
+	struct vc_i2c_stats i2c_stats;
+	struct vc_stream_stats stream_stats;
 	// Controls
 	struct vc_control exposure;
 	struct vc_control gain;
@@ -164,6 +212,10 @@ struct vc_ctrl {
 	__u32 expo_period_1H;
 	__u32 expo_shs_min;
 	__u32 expo_vmax;
+	__u8 frame_delay;		// Frames until exposure and gain take effect (0 = unknown)
+	// Test pattern generator, the first pattern disables it
+	const struct vc_test_pattern *test_patterns;
+	__u8 num_test_patterns;
 	// Framerate
 	__u32 retrigger_def;
 	// Flash
@@ -171,6 +223,8 @@ struct vc_ctrl {
 	__s32 flash_toffset;
 	// Special features
 	__u16 flags;
+	// Settings lost on a restart without module reset (FLAG_RESET_ALWAYS only)
+	__u8 restore;
 };
 
 struct vc_state {
@@ -180,9 +234,13 @@ struct vc_state {
 	__u32 exposure;			// µs
 	__u32 gain;
 	__u32 blacklevel;
+	__u8 test_pattern;
+	__u16 pattern_blacklevel;	// Black level saved while a test pattern is active, 0 = none
 	__u32 exposure_cnt;
 	__u32 retrigger_cnt;
 	__u32 framerate;
+	__u32 vblank;			// Lines, 0 = not requested
+	__u8 dirty;			// Settings (RESTORE_*) not written to the module yet
 	__u32 format_code;
 	struct vc_frame frame;		// Pixel
 	__u8 num_lanes;
@@ -190,13 +248,21 @@ struct vc_state {
 	__u8 trigger_mode;
 	int power_on;
 	int streaming;
+	int resetting;			// Module boots, the mutex is released meanwhile (see vc_mod_set_mode())
+	int hold;			// Nesting depth of the register hold
 	__u8 flags;
 };
 
+// The mutex serializes all hardware sequences and changes of the state. The camera driver also uses
+// it as lock of the V4L2 control handler. Readers which must not wait for a module reset take the
+// snapshot, which is published when the mutex is released.
 struct vc_cam {
 	struct vc_desc desc;
 	struct vc_ctrl ctrl;
 	struct vc_state state;
+	struct mutex mutex;
+	seqcount_t snapshot_seq;
+	struct vc_state snapshot;
 };
 
 // --- Helper functions to allow i2c communication for customization ----------
@@ -215,25 +281,60 @@ int vc_core_set_num_lanes(struct vc_cam *cam, __u32 number);
 __u32 vc_core_get_num_lanes(struct vc_cam *cam);
 int vc_core_set_framerate(struct vc_cam *cam, __u32 framerate);
 __u32 vc_core_get_framerate(struct vc_cam *cam);
+int vc_core_get_link_freqs(struct vc_cam *cam, __s64 *freqs, int size);
+__s64 vc_core_get_link_freq(struct vc_cam *cam, int mode);
+__s64 vc_core_get_pixel_rate(struct vc_cam *cam, int mode);
+
+// --- Helper functions for the sensor timing in lines -------------------------
+int vc_core_has_line_timing(struct vc_cam *cam);
+__u32 vc_core_get_hblank(struct vc_cam *cam, __s64 pixel_rate);
+void vc_core_get_vblank_range(struct vc_cam *cam, struct vc_control *vblank);
+int vc_core_set_vblank(struct vc_cam *cam, __u32 vblank);
+void vc_core_get_exposure_lines_range(struct vc_cam *cam, struct vc_control *lines);
+
+// --- Helper functions for bus cost accounting --------------------------------
+void vc_core_stats_snapshot(struct vc_cam *cam, struct vc_i2c_stats *snapshot);
+void vc_core_stats_report(struct vc_cam *cam, struct vc_i2c_stats *snapshot, const char *op);
+void vc_core_stats_streamon(struct vc_cam *cam, __u32 latency_us);
+void vc_core_stats_sleep(struct vc_cam *cam, __u32 us);
 
 // --- Function to initialize the vc core --------------------------------------
 int vc_core_init(struct vc_cam *cam, struct i2c_client *client);
 
+// --- Functions for locking ---------------------------------------------------
+void vc_core_lock(struct vc_cam *cam);
+void vc_core_unlock(struct vc_cam *cam);
+void vc_core_publish_state(struct vc_cam *cam);
+void vc_core_get_state(struct vc_cam *cam, struct vc_state *state);
+
 // --- Functions for the VC MIPI Controller Module ----------------------------
-int vc_mod_set_mode(struct vc_cam *cam, int *reset);
+int vc_mod_plan_mode(struct vc_cam *cam);
+int vc_mod_set_mode(struct vc_cam *cam, int *restore);
+int vc_mod_poll_ready(struct vc_cam *cam);
+void vc_mod_end_reset(struct vc_cam *cam, int ret);
+void vc_mod_invalidate_mode(struct vc_cam *cam);
+int vc_mod_check_status(struct vc_cam *cam);
 int vc_mod_is_trigger_enabled(struct vc_cam *cam);
 int vc_mod_set_trigger_mode(struct vc_cam *cam, int mode);
 int vc_mod_get_trigger_mode(struct vc_cam *cam);
 int vc_mod_set_single_trigger(struct vc_cam *cam);
+int vc_mod_fire_single_trigger(struct vc_cam *cam);
 int vc_mod_is_io_enabled(struct vc_cam *cam);
 int vc_mod_set_io_mode(struct vc_cam *cam, int mode);
 int vc_mod_get_io_mode(struct vc_cam *cam);
+int vc_mod_bracket_trigger(struct vc_cam *cam, __u32 exposure, __u32 *frame_us);
+int vc_mod_bracket_end(struct vc_cam *cam);
 
 // --- Functions for the VC MIPI Sensors --------------------------------------
 int vc_sen_set_roi(struct vc_cam *cam, int x, int y, int width, int height);
+int vc_sen_move_roi(struct vc_cam *cam, __u32 x, __u32 y);
+int vc_sen_set_multi_roi(struct vc_cam *cam, struct vc_frame *rois, int count);
 int vc_sen_set_exposure(struct vc_cam *cam, int exposure);
+int vc_sen_set_exposure_lines(struct vc_cam *cam, __u32 lines);
 int vc_sen_set_gain(struct vc_cam *cam, int gain);
 int vc_sen_set_blacklevel(struct vc_cam *cam, int blacklevel);
+int vc_sen_set_test_pattern(struct vc_cam *cam, int pattern);
+int vc_sen_restore(struct vc_cam *cam);
 int vc_sen_start_stream(struct vc_cam *cam);
 int vc_sen_stop_stream(struct vc_cam *cam);
 
@@ -0,0 +1,368 @@
+// KUnit tests for the exposure, VMAX and retrigger calculation of vc_mipi_core.c
+//
+// The file is included at the end of vc_mipi_core.c if CONFIG_VIDEO_VC_MIPI_KUNIT_TEST is set, so
+// that the static helpers can be tested directly. The calculation doesn't access the module, the
+// I2C clients only provide the devices for the log messages.
+//
+// KUnit is available from Linux 5.5 on (e.g. CONFIG_KUNIT and CONFIG_VIDEO_VC_MIPI_KUNIT_TEST in
+// an UML or QEMU kernel). On older kernels the suite runs in the host build: make -C test/host check
+//
+// The golden values are the register values of the modules at a pixel clock of 74.25 MHz (modules
+// without own clock setting), i.e. they change only if the timing of a module changes.
+
+#include <kunit/test.h>
+
+#define VC_TEST_CLK		74250000
+
+static struct vc_cam *vc_test_cam(struct kunit *test, __u16 mod_id, __u32 num_lanes, __u32 code)
+{
+	struct vc_cam *cam = kunit_kzalloc(test, sizeof(*cam), GFP_KERNEL);
+
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, cam);
+	cam->ctrl.client_sen = kunit_kzalloc(test, sizeof(struct i2c_client), GFP_KERNEL);
+	cam->ctrl.client_mod = kunit_kzalloc(test, sizeof(struct i2c_client), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, cam->ctrl.client_sen);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, cam->ctrl.client_mod);
+
+	cam->desc.mod_id = mod_id;
+	cam->desc.clk_ext_trigger = VC_TEST_CLK;
+	cam->desc.clk_pixel = VC_TEST_CLK;
+	// 24 bit SHS register
+	cam->desc.csr_exposure_l = 0x3020;
+	cam->desc.csr_exposure_m = 0x3021;
+	cam->desc.csr_exposure_h = 0x3022;
+	KUNIT_ASSERT_EQ(test, vc_mod_ctrl_init(&cam->ctrl, &cam->desc), 0);
+
+	vc_core_state_init(cam);
+	cam->state.num_lanes = num_lanes;
+	cam->state.format_code = code;
+	cam->state.trigger_mode = REG_TRIGGER_DISABLE;
+
+	return cam;
+}
+
+// --- Clamping of 32 bit values ------------------------------------------------------------------
+
+static void vc_test_us_to_ticks(struct kunit *test)
+{
+	struct device *dev = NULL;
+
+	KUNIT_EXPECT_EQ(test, vc_core_us_to_ticks(dev, 0, VC_TEST_CLK, "Test"), 0U);
+	KUNIT_EXPECT_EQ(test, vc_core_us_to_ticks(dev, 1, 1000000, "Test"), 1U);
+	KUNIT_EXPECT_EQ(test, vc_core_us_to_ticks(dev, 10000, VC_TEST_CLK, "Test"), 742500U);
+	KUNIT_EXPECT_EQ(test, vc_core_us_to_ticks(dev, 57843, VC_TEST_CLK, "Test"), 4294842U);
+	// 57.84 s at 74.25 MHz is the largest time which fits into the module registers.
+	KUNIT_EXPECT_EQ(test, vc_core_us_to_ticks(dev, 57844000, VC_TEST_CLK, "Test"), 4294917000U);
+	KUNIT_EXPECT_EQ(test, vc_core_us_to_ticks(dev, 57845000, VC_TEST_CLK, "Test"), U32_MAX);
+	KUNIT_EXPECT_EQ(test, vc_core_us_to_ticks(dev, 100000000, VC_TEST_CLK, "Test"), U32_MAX);
+	KUNIT_EXPECT_EQ(test, vc_core_us_to_ticks(dev, U32_MAX, U32_MAX, "Test"), U32_MAX);
+}
+
+static void vc_test_csr4_max(struct kunit *test)
+{
+	struct vc_csr4 csr = { 0 };
+
+	KUNIT_EXPECT_EQ(test, vc_core_csr4_max(&csr), 0U);
+	csr.l = 0x3018;
+	KUNIT_EXPECT_EQ(test, vc_core_csr4_max(&csr), 0xffU);
+	csr.m = 0x3019;
+	KUNIT_EXPECT_EQ(test, vc_core_csr4_max(&csr), 0xffffU);
+	csr.h = 0x301a;
+	KUNIT_EXPECT_EQ(test, vc_core_csr4_max(&csr), 0xffffffU);
+	csr.u = 0x301b;
+	KUNIT_EXPECT_EQ(test, vc_core_csr4_max(&csr), U32_MAX);
+}
+
+// --- 1H period ----------------------------------------------------------------------------------
+
+struct vc_test_period {
+	__u16 mod_id;
+	__u8 num_lanes;
+	__u32 code;
+	__u32 period_1H_ns;		// 0 = no timing for lanes and format
+};
+
+static const struct vc_test_period vc_test_periods[] = {
+	// All entries of the IMX178 table, [6] and [7] were not searched before.
+	{ MOD_ID_IMX178, 2, MEDIA_BUS_FMT_Y8_1X8,   9158 },
+	{ MOD_ID_IMX178, 2, MEDIA_BUS_FMT_Y10_1X10, 11313 },
+	{ MOD_ID_IMX178, 2, MEDIA_BUS_FMT_Y12_1X12, 13252 },
+	{ MOD_ID_IMX178, 2, MEDIA_BUS_FMT_Y14_1X14, 15569 },
+	{ MOD_ID_IMX178, 4, MEDIA_BUS_FMT_Y8_1X8,   8080 },
+	{ MOD_ID_IMX178, 4, MEDIA_BUS_FMT_Y10_1X10, 8080 },
+	{ MOD_ID_IMX178, 4, MEDIA_BUS_FMT_Y12_1X12, 9158 },
+	{ MOD_ID_IMX178, 4, MEDIA_BUS_FMT_Y14_1X14, 15569 },
+	{ MOD_ID_IMX178, 1, MEDIA_BUS_FMT_Y10_1X10, 0 },
+	{ MOD_ID_IMX183, 4, MEDIA_BUS_FMT_Y12_1X12, 11609 },
+	{ MOD_ID_IMX226, 4, MEDIA_BUS_FMT_Y12_1X12, 8673 },
+	{ MOD_ID_IMX226, 2, MEDIA_BUS_FMT_Y14_1X14, 0 },
+	{ MOD_ID_IMX250, 4, MEDIA_BUS_FMT_Y8_1X8,   4713 },
+	{ MOD_ID_IMX252, 2, MEDIA_BUS_FMT_Y12_1X12, 9050 },
+	{ MOD_ID_IMX264, 2, MEDIA_BUS_FMT_Y10_1X10, 13414 },
+	{ MOD_ID_IMX264, 4, MEDIA_BUS_FMT_Y10_1X10, 0 },
+	{ MOD_ID_IMX265, 2, MEDIA_BUS_FMT_Y12_1X12, 11393 },
+	{ MOD_ID_IMX273, 4, MEDIA_BUS_FMT_Y10_1X10, 3905 },
+	{ MOD_ID_IMX290, 2, MEDIA_BUS_FMT_Y10_1X10, 14814 },
+	{ MOD_ID_IMX290, 4, MEDIA_BUS_FMT_Y12_1X12, 14814 },
+	// The IMX296 has one fixed 1H period.
+	{ MOD_ID_IMX296, 1, MEDIA_BUS_FMT_Y10_1X10, 14815 },
+	{ MOD_ID_IMX327, 2, MEDIA_BUS_FMT_Y12_1X12, 14814 },
+	{ MOD_ID_IMX392, 4, MEDIA_BUS_FMT_Y12_1X12, 5939 },
+	{ MOD_ID_IMX415, 2, MEDIA_BUS_FMT_Y10_1X10, 14033 },
+	{ MOD_ID_IMX415, 4, MEDIA_BUS_FMT_Y10_1X10, 7420 },
+};
+
+static void vc_test_period_1H(struct kunit *test)
+{
+	const struct vc_test_period *golden;
+	struct vc_cam *cam;
+	__u32 period_1H_ns;
+	int index, ret;
+
+	for (index = 0; index < ARRAY_SIZE(vc_test_periods); index++) {
+		golden = &vc_test_periods[index];
+		cam = vc_test_cam(test, golden->mod_id, golden->num_lanes, golden->code);
+		period_1H_ns = 0;
+		ret = vc_core_find_period_1H(cam, &period_1H_ns);
+		KUNIT_EXPECT_EQ_MSG(test, period_1H_ns, golden->period_1H_ns,
+			"MOD_ID 0x%04x, lanes %u, code 0x%04x", golden->mod_id, golden->num_lanes, golden->code);
+		KUNIT_EXPECT_EQ(test, ret, golden->period_1H_ns ? 0 : -EINVAL);
+	}
+}
+
+// --- VMAX based exposure ------------------------------------------------------------------------
+
+struct vc_test_vmax {
+	__u16 mod_id;
+	__u8 num_lanes;
+	__u32 code;
+	__u32 exposure;			// µs
+	__u32 framerate;		// Hz, 0 = free running
+	__u32 vmax;
+	__u32 shs;
+};
+
+static const struct vc_test_vmax vc_test_vmaxs[] = {
+	// Exposure within the default frame, longer than the frame, frame rate limited frame
+	{ MOD_ID_IMX178, 4, MEDIA_BUS_FMT_Y12_1X12, 10000, 0, 2145, 1054 },
+	{ MOD_ID_IMX178, 4, MEDIA_BUS_FMT_Y12_1X12, 100000, 0, 10928, 9 },
+	{ MOD_ID_IMX178, 4, MEDIA_BUS_FMT_Y12_1X12, 10000, 10, 10919, 9828 },
+	{ MOD_ID_IMX178, 4, MEDIA_BUS_FMT_Y14_1X14, 10000, 0, 2145, 1503 },
+	{ MOD_ID_IMX178, 4, MEDIA_BUS_FMT_Y14_1X14, 100000000, 0, 6423029, 9 },
+	{ MOD_ID_IMX178, 2, MEDIA_BUS_FMT_Y8_1X8, 1, 0, 2145, 2145 },
+	{ MOD_ID_IMX183, 2, MEDIA_BUS_FMT_Y10_1X10, 33333, 0, 3728, 2010 },
+	{ MOD_ID_IMX226, 4, MEDIA_BUS_FMT_Y10_1X10, 33333, 25, 5541, 923 },
+	{ MOD_ID_IMX250, 2, MEDIA_BUS_FMT_Y12_1X12, 5000, 0, 2094, 1619 },
+	{ MOD_ID_IMX252, 4, MEDIA_BUS_FMT_Y8_1X8, 1000000, 0, 239530, 10 },
+	{ MOD_ID_IMX273, 2, MEDIA_BUS_FMT_Y10_1X10, 20000, 60, 3551, 15 },
+	{ MOD_ID_IMX290, 2, MEDIA_BUS_FMT_Y10_1X10, 10000, 0, 1125, 450 },
+	{ MOD_ID_IMX290, 4, MEDIA_BUS_FMT_Y12_1X12, 15000000, 0, 1012556, 1 },
+	{ MOD_ID_IMX296, 1, MEDIA_BUS_FMT_Y10_1X10, 10000, 30, 2249, 1575 },
+	{ MOD_ID_IMX327, 2, MEDIA_BUS_FMT_Y12_1X12, 40000, 0, 2701, 1 },
+	{ MOD_ID_IMX415, 4, MEDIA_BUS_FMT_Y10_1X10, 10000, 0, 2250, 903 },
+	{ MOD_ID_IMX415, 2, MEDIA_BUS_FMT_Y10_1X10, 5000000, 0, 356311, 8 },
+};
+
+static void vc_test_exposure_vmax(struct kunit *test)
+{
+	const struct vc_test_vmax *golden;
+	struct vc_cam *cam;
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_test_vmaxs); index++) {
+		golden = &vc_test_vmaxs[index];
+		cam = vc_test_cam(test, golden->mod_id, golden->num_lanes, golden->code);
+		cam->state.framerate = golden->framerate;
+		KUNIT_ASSERT_EQ(test, vc_calculate_exposure_vmax(cam, golden->exposure), 0);
+		KUNIT_EXPECT_EQ_MSG(test, cam->state.vmax, golden->vmax, "MOD_ID 0x%04x, exposure %u us",
+			golden->mod_id, golden->exposure);
+		KUNIT_EXPECT_EQ_MSG(test, cam->state.shs, golden->shs, "MOD_ID 0x%04x, exposure %u us",
+			golden->mod_id, golden->exposure);
+	}
+}
+
+// A frame longer than the VMAX register is clamped and the exposure limited to it.
+static void vc_test_exposure_vmax_clamp(struct kunit *test)
+{
+	struct vc_cam *cam = vc_test_cam(test, MOD_ID_IMX290, 2, MEDIA_BUS_FMT_Y10_1X10);
+
+	// 16 bit VMAX register
+	cam->ctrl.csr.sen.vmax.h = 0;
+	KUNIT_ASSERT_EQ(test, vc_calculate_exposure_vmax(cam, 970000), 0);
+	KUNIT_EXPECT_EQ(test, cam->state.vmax, 65479U);
+	KUNIT_EXPECT_EQ(test, cam->state.shs, 1U);
+	KUNIT_ASSERT_EQ(test, vc_calculate_exposure_vmax(cam, 971000), 0);
+	KUNIT_EXPECT_EQ(test, cam->state.vmax, 0xffffU);
+	KUNIT_EXPECT_EQ(test, cam->state.shs, 1U);
+	KUNIT_ASSERT_EQ(test, vc_calculate_exposure_vmax(cam, U32_MAX), 0);
+	KUNIT_EXPECT_EQ(test, cam->state.vmax, 0xffffU);
+	KUNIT_EXPECT_EQ(test, cam->state.shs, 1U);
+}
+
+// Without 1H period the calculation fails instead of dividing by zero.
+static void vc_test_exposure_vmax_no_timing(struct kunit *test)
+{
+	struct vc_cam *cam = vc_test_cam(test, MOD_ID_IMX178, 1, MEDIA_BUS_FMT_Y10_1X10);
+
+	KUNIT_EXPECT_EQ(test, vc_calculate_exposure_vmax(cam, 10000), -EINVAL);
+}
+
+// The extended frame of a requested vertical blanking limits the exposure delay.
+static void vc_test_exposure_vmax_vblank(struct kunit *test)
+{
+	struct vc_cam *cam = vc_test_cam(test, MOD_ID_IMX290, 2, MEDIA_BUS_FMT_Y10_1X10);
+
+	cam->state.vblank = 1000;
+	KUNIT_ASSERT_EQ(test, vc_calculate_exposure_vmax(cam, 10000), 0);
+	KUNIT_EXPECT_EQ(test, cam->state.vmax, 2080U);
+	KUNIT_EXPECT_EQ(test, cam->state.shs, 1405U);
+}
+
+// Sweeps all modules with line timing through all timings and a range of exposure times and
+// checks the invariants of the calculation.
+static void vc_test_exposure_vmax_sweep(struct kunit *test)
+{
+	static const __u16 mod_ids[] = {
+		MOD_ID_IMX178, MOD_ID_IMX183, MOD_ID_IMX226, MOD_ID_IMX250, MOD_ID_IMX252,
+		MOD_ID_IMX264, MOD_ID_IMX265, MOD_ID_IMX273, MOD_ID_IMX290, MOD_ID_IMX327,
+		MOD_ID_IMX392, MOD_ID_IMX415,
+	};
+	static const __u32 codes[] = {
+		0, MEDIA_BUS_FMT_Y8_1X8, MEDIA_BUS_FMT_Y10_1X10, MEDIA_BUS_FMT_Y12_1X12,
+		MEDIA_BUS_FMT_Y14_1X14,
+	};
+	static const __u32 exposures[] = { 1, 100, 1000, 33333, 1000000, 100000000 };
+	struct vc_timing *timing;
+	struct vc_cam *cam;
+	__u32 period_1H_ns, vmax_max;
+	int mod, index, expo;
+
+	for (mod = 0; mod < ARRAY_SIZE(mod_ids); mod++) {
+		cam = vc_test_cam(test, mod_ids[mod], 2, 0);
+		vmax_max = vc_core_csr4_max(&cam->ctrl.csr.sen.vmax);
+		for (index = 0; index < ARRAY_SIZE(cam->ctrl.expo_timing); index++) {
+			timing = &cam->ctrl.expo_timing[index];
+			if (timing->num_lanes == 0)
+				break;
+			cam->state.num_lanes = timing->num_lanes;
+			for (expo = 1; expo < ARRAY_SIZE(codes); expo++) {
+				if (vc_core_v4l2_code_to_format(codes[expo]) == timing->format)
+					cam->state.format_code = codes[expo];
+			}
+			period_1H_ns = 0;
+			KUNIT_ASSERT_EQ(test, vc_core_find_period_1H(cam, &period_1H_ns), 0);
+
+			for (expo = 0; expo < ARRAY_SIZE(exposures); expo++) {
+				KUNIT_ASSERT_EQ(test, vc_calculate_exposure_vmax(cam, exposures[expo]), 0);
+				KUNIT_EXPECT_LE(test, cam->state.vmax, vmax_max);
+				KUNIT_EXPECT_GE(test, cam->state.vmax, cam->ctrl.expo_vmax);
+				KUNIT_EXPECT_GE(test, cam->state.shs, cam->ctrl.expo_shs_min);
+				KUNIT_EXPECT_LE(test, cam->state.shs, cam->state.vmax);
+				// The exposure is the frame without the exposure delay.
+				if (cam->state.vmax < vmax_max) {
+					KUNIT_EXPECT_EQ_MSG(test, cam->state.vmax - cam->state.shs,
+						(__u32)(exposures[expo] * 1000ULL / period_1H_ns),
+						"MOD_ID 0x%04x, timing %d, exposure %u us", mod_ids[mod], index,
+						exposures[expo]);
+				}
+			}
+		}
+	}
+}
+
+// --- Simple exposure ----------------------------------------------------------------------------
+
+struct vc_test_simple {
+	__u16 mod_id;
+	__u32 exposure;			// µs
+	__u32 shs;
+};
+
+static const struct vc_test_simple vc_test_simples[] = {
+	// Below the time offset of the IMX412
+	{ MOD_ID_IMX412, 100, 0 },
+	{ MOD_ID_IMX412, 190, 58 },
+	{ MOD_ID_IMX412, 10000, 311575 },
+	{ MOD_ID_IMX412, 405947, 12884871 },
+	{ MOD_ID_OV9281, 1, 1 },
+	{ MOD_ID_OV9281, 10000, 17582 },
+	// Beyond the 24 bit SHS register
+	{ MOD_ID_OV9281, 100000000, 0xffffff },
+};
+
+static void vc_test_exposure_simple(struct kunit *test)
+{
+	const struct vc_test_simple *golden;
+	struct vc_cam *cam;
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_test_simples); index++) {
+		golden = &vc_test_simples[index];
+		cam = vc_test_cam(test, golden->mod_id, 2, MEDIA_BUS_FMT_Y10_1X10);
+		vc_calculate_exposure_simple(cam, golden->exposure);
+		KUNIT_EXPECT_EQ_MSG(test, cam->state.shs, golden->shs, "MOD_ID 0x%04x, exposure %u us",
+			golden->mod_id, golden->exposure);
+	}
+}
+
+// --- Retrigger ----------------------------------------------------------------------------------
+
+struct vc_test_retrigger {
+	__u16 mod_id;
+	__u32 exposure;			// µs
+	__u32 framerate;		// Hz
+	__u32 retrigger_cnt;
+};
+
+static const struct vc_test_retrigger vc_test_retriggers[] = {
+	// Without frame rate the default is used.
+	{ MOD_ID_IMX178, 10000, 0, 0x00292d40 },
+	{ MOD_ID_IMX178, 10000, 10, 6682500 },
+	// Shorter than the default
+	{ MOD_ID_IMX178, 30000, 30, 0x00292d40 },
+	// Exposure longer than the frame
+	{ MOD_ID_IMX178, 200000, 10, 0x00292d40 },
+	{ MOD_ID_IMX183, 1000, 1, 74175750 },
+	{ MOD_ID_IMX296, 10000, 10, 4860000 },
+	// 1 Hz at 74.25 MHz is still within 32 bit.
+	{ MOD_ID_IMX273, 1, 1, 74249925 },
+};
+
+static void vc_test_retrigger(struct kunit *test)
+{
+	const struct vc_test_retrigger *golden;
+	struct vc_cam *cam;
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_test_retriggers); index++) {
+		golden = &vc_test_retriggers[index];
+		cam = vc_test_cam(test, golden->mod_id, 2, MEDIA_BUS_FMT_Y10_1X10);
+		cam->state.exposure = golden->exposure;
+		cam->state.framerate = golden->framerate;
+		vc_calculate_retrigger(cam);
+		KUNIT_EXPECT_EQ_MSG(test, cam->state.retrigger_cnt, golden->retrigger_cnt,
+			"MOD_ID 0x%04x, exposure %u us, %u Hz", golden->mod_id, golden->exposure,
+			golden->framerate);
+	}
+}
+
+static struct kunit_case vc_mipi_core_test_cases[] = {
+	KUNIT_CASE(vc_test_us_to_ticks),
+	KUNIT_CASE(vc_test_csr4_max),
+	KUNIT_CASE(vc_test_period_1H),
+	KUNIT_CASE(vc_test_exposure_vmax),
+	KUNIT_CASE(vc_test_exposure_vmax_clamp),
+	KUNIT_CASE(vc_test_exposure_vmax_no_timing),
+	KUNIT_CASE(vc_test_exposure_vmax_vblank),
+	KUNIT_CASE(vc_test_exposure_vmax_sweep),
+	KUNIT_CASE(vc_test_exposure_simple),
+	KUNIT_CASE(vc_test_retrigger),
+	{}
+};
+
+static struct kunit_suite vc_mipi_core_test_suite = {
+	.name = "vc_mipi_core",
+	.test_cases = vc_mipi_core_test_cases,
+};
+
+kunit_test_suite(vc_mipi_core_test_suite);
@@ -0,0 +1,867 @@
+// Emulation of a VC MIPI module on a virtual I2C adapter
+//
+// The emulator registers an I2C adapter which answers like the module controller (0x10) and the
+// sensor (0x1A) of a VC MIPI camera module. The unmodified vc-mipi-cam driver can be bound to it
+// through the device tree, so probing, mode changes and stream control run without hardware.
+//
+//   vc_mipi_emu {
+//           compatible = "vc,vc_mipi_emu";
+//           #address-cells = <1>;
+//           #size-cells = <0>;
+//           mod_id = <0x0290>;
+//
+//           imx_mipi@1a {
+//                   compatible = "vc,vc_mipi";
+//                   reg = <0x1a>;
+//                   num_lanes = "2";
+//                   port {
+//                           endpoint {
+//                                   data-lanes = <1 2>;
+//                           };
+//                   };
+//           };
+//   };
+//
+// Profile: The module parameter profile selects the emulated sensor by name (e.g. profile=IMX415),
+// otherwise the DT property mod_id or the module parameter mod_id selects it by MOD_ID.
+//
+// Module controller: The descriptor of the selected profile is served at 0x1000. Powering up
+// the module (MOD_REG_RESET) keeps MOD_REG_STATUS at REG_STATUS_NO_COM for ready_delay_ms,
+// afterwards it reports REG_STATUS_READY or REG_STATUS_ERROR for an unknown mode. While the
+// module is powered down, held in reset or not ready yet, the sensor doesn't acknowledge.
+//
+// Sensor: A plain 16 bit register file which is loaded with the defaults of the profile each
+// time the module gets ready. There is a profile for every MOD_ID of vc_mipi_modules.c. The
+// VMAX and black level registers are the ones of vc_mipi_modules.c, the descriptor registers
+// of the Pregius modules (IMX178 to IMX392) follow the register map of their module family.
+//
+// Bus timing: Each transfer is delayed by latency_us plus the time of the modeled bus clocks at
+// bus_khz (same model as the bus cost accounting of the core). fault_rate injects NAKs.
+
+#include <linux/delay.h>
+#include <linux/errno.h>
+#include <linux/i2c.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include "vc_mipi_core.h"
+#include "vc_mipi_modules.h"
+
+#define EMU_MOD_ADDR		0x10
+#define EMU_SEN_ADDR		0x1a
+#define EMU_DESC_ADDR		0x1000
+#define EMU_REGS		0x10000
+
+// Registers of the module controller (see vc_mipi_core.c)
+#define EMU_REG_RESET		0x0100
+#define EMU_REG_STATUS		0x0101
+#define EMU_REG_MODE		0x0102
+#define EMU_REG_IOCTRL		0x0103
+#define EMU_REG_MOD_ADDR	0x0104
+#define EMU_REG_SEN_ADDR	0x0105
+#define EMU_REG_INPUT		0x0107
+#define EMU_REG_EXTTRIG		0x0108
+#define EMU_REG_EXPO_L		0x0109
+#define EMU_REG_RETRIG_L	0x010D
+
+#define EMU_RESET_SENSOR	0x01
+#define EMU_RESET_PWR_DOWN	0x02
+#define EMU_STATUS_NO_COM	0x00
+#define EMU_STATUS_READY	0x80
+#define EMU_STATUS_ERROR	0x01
+#define EMU_TRIGGER_SINGLE	0x08
+
+// Same bus model as I2C_MSG_OVERHEAD_BITS and I2C_BYTE_BITS in vc_mipi_core.c
+#define EMU_MSG_OVERHEAD_BITS	11
+#define EMU_BYTE_BITS		9
+
+static unsigned int mod_id = MOD_ID_IMX290;
+module_param(mod_id, uint, 0444);
+MODULE_PARM_DESC(mod_id, "Emulated module (MOD_ID, e.g. 0x0290), overridden by the DT property mod_id");
+
+static char *profile;
+module_param(profile, charp, 0444);
+MODULE_PARM_DESC(profile, "Emulated sensor (e.g. IMX415), overrides mod_id and the DT property mod_id");
+
+static unsigned int ready_delay_ms = 100;
+module_param(ready_delay_ms, uint, 0644);
+MODULE_PARM_DESC(ready_delay_ms, "Time from power up until the module reports ready (ms)");
+
+static unsigned int latency_us;
+module_param(latency_us, uint, 0644);
+MODULE_PARM_DESC(latency_us, "Additional latency of each I2C transfer (us)");
+
+static unsigned int bus_khz;
+module_param(bus_khz, uint, 0644);
+MODULE_PARM_DESC(bus_khz, "Emulated bus clock (kHz, 0 = no transfer time)");
+
+static unsigned int fault_rate;
+module_param(fault_rate, uint, 0644);
+MODULE_PARM_DESC(fault_rate, "Transfers which aren't acknowledged (per mille)");
+
+static bool fail_ready;
+module_param(fail_ready, bool, 0644);
+MODULE_PARM_DESC(fail_ready, "Report REG_STATUS_ERROR after power up");
+
+#define EMU_BYTE(n, value) (__u8)(((value) >> (8*(n))) & 0xff)
+#define EMU_LE32(value) { (value) & 0xff, ((value) >> 8) & 0xff, ((value) >> 16) & 0xff, ((value) >> 24) & 0xff }
+#define EMU_MODE(mbps, lanes, fmt, typ) \
+	{ .data_rate = EMU_LE32((mbps)*1000000U), .num_lanes = lanes, .format = fmt, .type = typ }
+#define EMU_STREAM			0x01
+#define EMU_EXT_TRG			0x02
+
+struct vc_emu_profile {
+	struct vc_desc desc;
+	__u32 width;
+	__u32 height;
+	__u8 mode_standby;
+	__u16 vmax[3];			// l, m, h
+	__u32 vmax_def;
+	__u16 blklevel[2];		// l, m
+	__u16 blklevel_def;
+};
+
+static const struct vc_emu_profile vc_emu_profiles[] = {
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX178", .mod_id = MOD_ID_IMX178,
+			.csr_mode = 0x7000,
+			.csr_h_start_h = 0x6014, .csr_h_start_l = 0x6013,
+			.csr_v_start_h = 0x600f, .csr_v_start_l = 0x600e,
+			.csr_o_width_h = 0x6016, .csr_o_width_l = 0x6015,
+			.csr_o_height_h = 0x6011, .csr_o_height_l = 0x6010,
+			.csr_exposure_h = 0x700e, .csr_exposure_m = 0x700d, .csr_exposure_l = 0x700c,
+			.csr_gain_h = 0x3020, .csr_gain_l = 0x301f,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 12,
+			.modes = {
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW14, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW14, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW14, EMU_EXT_TRG),
+			},
+		},
+		.width = 3104, .height = 2076,
+		.mode_standby = 0x00,
+		.vmax = { 0x7004, 0x7005, 0x7006 }, .vmax_def = 2145,
+		.blklevel = { 0x3015, 0x3016 }, .blklevel_def = 0x3c,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX183", .mod_id = MOD_ID_IMX183,
+			.csr_mode = 0x7000,
+			.csr_h_start_h = 0x6014, .csr_h_start_l = 0x6013,
+			.csr_v_start_h = 0x600f, .csr_v_start_l = 0x600e,
+			.csr_o_width_h = 0x6016, .csr_o_width_l = 0x6015,
+			.csr_o_height_h = 0x6011, .csr_o_height_l = 0x6010,
+			.csr_exposure_h = 0x700e, .csr_exposure_m = 0x700d, .csr_exposure_l = 0x700c,
+			.csr_gain_h = 0x000a, .csr_gain_l = 0x0009,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 9,
+			.modes = {
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_EXT_TRG),
+			},
+		},
+		.width = 5440, .height = 3648,
+		.mode_standby = 0x00,
+		.vmax = { 0x7004, 0x7005, 0x7006 }, .vmax_def = 3728,
+		.blklevel = { 0x0045, 0x0000 }, .blklevel_def = 0x32,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX226", .mod_id = MOD_ID_IMX226,
+			.csr_mode = 0x7000,
+			.csr_h_start_h = 0x6014, .csr_h_start_l = 0x6013,
+			.csr_v_start_h = 0x600f, .csr_v_start_l = 0x600e,
+			.csr_o_width_h = 0x6016, .csr_o_width_l = 0x6015,
+			.csr_o_height_h = 0x6011, .csr_o_height_l = 0x6010,
+			.csr_exposure_h = 0x700e, .csr_exposure_m = 0x700d, .csr_exposure_l = 0x700c,
+			.csr_gain_h = 0x000a, .csr_gain_l = 0x0009,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 6,
+			.modes = {
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_EXT_TRG),
+			},
+		},
+		.width = 3840, .height = 3046,
+		.mode_standby = 0x00,
+		.vmax = { 0x7004, 0x7005, 0x7006 }, .vmax_def = 3079,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX250", .mod_id = MOD_ID_IMX250,
+			.csr_mode = 0x0200,
+			.csr_h_start_h = 0x0311, .csr_h_start_l = 0x0310,
+			.csr_v_start_h = 0x0313, .csr_v_start_l = 0x0312,
+			.csr_o_width_h = 0x0315, .csr_o_width_l = 0x0314,
+			.csr_o_height_h = 0x0317, .csr_o_height_l = 0x0316,
+			.csr_exposure_h = 0x020f, .csr_exposure_m = 0x020e, .csr_exposure_l = 0x020d,
+			.csr_gain_h = 0x0205, .csr_gain_l = 0x0204,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 9,
+			.modes = {
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_EXT_TRG),
+			},
+		},
+		.width = 2448, .height = 2048,
+		.mode_standby = 0x00,
+		.vmax = { 0x0210, 0x0211, 0x0212 }, .vmax_def = 2094,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX252", .mod_id = MOD_ID_IMX252,
+			.csr_mode = 0x0200,
+			.csr_h_start_h = 0x0311, .csr_h_start_l = 0x0310,
+			.csr_v_start_h = 0x0313, .csr_v_start_l = 0x0312,
+			.csr_o_width_h = 0x0315, .csr_o_width_l = 0x0314,
+			.csr_o_height_h = 0x0317, .csr_o_height_l = 0x0316,
+			.csr_exposure_h = 0x020f, .csr_exposure_m = 0x020e, .csr_exposure_l = 0x020d,
+			.csr_gain_h = 0x0205, .csr_gain_l = 0x0204,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 9,
+			.modes = {
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_EXT_TRG),
+			},
+		},
+		.width = 2048, .height = 1536,
+		.mode_standby = 0x00,
+		.vmax = { 0x0210, 0x0211, 0x0212 }, .vmax_def = 2094,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX264", .mod_id = MOD_ID_IMX264,
+			.csr_mode = 0x0200,
+			.csr_h_start_h = 0x0311, .csr_h_start_l = 0x0310,
+			.csr_v_start_h = 0x0313, .csr_v_start_l = 0x0312,
+			.csr_o_width_h = 0x0315, .csr_o_width_l = 0x0314,
+			.csr_o_height_h = 0x0317, .csr_o_height_l = 0x0316,
+			.csr_exposure_h = 0x020f, .csr_exposure_m = 0x020e, .csr_exposure_l = 0x020d,
+			.csr_gain_h = 0x0205, .csr_gain_l = 0x0204,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 6,
+			.modes = {
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_EXT_TRG),
+			},
+		},
+		.width = 2432, .height = 2048,
+		.mode_standby = 0x00,
+		.vmax = { 0x0210, 0x0211, 0x0212 }, .vmax_def = 2094,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX265", .mod_id = MOD_ID_IMX265,
+			.csr_mode = 0x0200,
+			.csr_h_start_h = 0x0311, .csr_h_start_l = 0x0310,
+			.csr_v_start_h = 0x0313, .csr_v_start_l = 0x0312,
+			.csr_o_width_h = 0x0315, .csr_o_width_l = 0x0314,
+			.csr_o_height_h = 0x0317, .csr_o_height_l = 0x0316,
+			.csr_exposure_h = 0x020f, .csr_exposure_m = 0x020e, .csr_exposure_l = 0x020d,
+			.csr_gain_h = 0x0205, .csr_gain_l = 0x0204,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 6,
+			.modes = {
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_EXT_TRG),
+			},
+		},
+		.width = 2048, .height = 1536,
+		.mode_standby = 0x00,
+		.vmax = { 0x0210, 0x0211, 0x0212 }, .vmax_def = 2094,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX273", .mod_id = MOD_ID_IMX273,
+			.csr_mode = 0x0200,
+			.csr_h_start_h = 0x0311, .csr_h_start_l = 0x0310,
+			.csr_v_start_h = 0x0313, .csr_v_start_l = 0x0312,
+			.csr_o_width_h = 0x0315, .csr_o_width_l = 0x0314,
+			.csr_o_height_h = 0x0317, .csr_o_height_l = 0x0316,
+			.csr_exposure_h = 0x020f, .csr_exposure_m = 0x020e, .csr_exposure_l = 0x020d,
+			.csr_gain_h = 0x0205, .csr_gain_l = 0x0204,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 9,
+			.modes = {
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_EXT_TRG),
+			},
+		},
+		.width = 1440, .height = 1080,
+		.mode_standby = 0x00,
+		.vmax = { 0x0210, 0x0211, 0x0212 }, .vmax_def = 1130,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX290", .mod_id = MOD_ID_IMX290,
+			.csr_mode = 0x3000,
+			.csr_h_start_h = 0x303d, .csr_h_start_l = 0x303c,
+			.csr_v_start_h = 0x3039, .csr_v_start_l = 0x3038,
+			.csr_o_width_h = 0x303f, .csr_o_width_l = 0x303e,
+			.csr_o_height_h = 0x303b, .csr_o_height_l = 0x303a,
+			.csr_exposure_h = 0x3022, .csr_exposure_m = 0x3021, .csr_exposure_l = 0x3020,
+			.csr_gain_h = 0x0000, .csr_gain_l = 0x3014,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 4,
+			.modes = {
+				EMU_MODE(891, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(891, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(446, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(446, 4, FORMAT_RAW12, EMU_STREAM),
+			},
+		},
+		.width = 1920, .height = 1080,
+		.mode_standby = 0x01,
+		.vmax = { 0x3018, 0x3019, 0x301a }, .vmax_def = 1125,
+		.blklevel = { 0x300a, 0x300b }, .blklevel_def = 0xf0,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX296", .mod_id = MOD_ID_IMX296,
+			.csr_mode = 0x3000,
+			.csr_h_start_h = 0x3311, .csr_h_start_l = 0x3310,
+			.csr_v_start_h = 0x3313, .csr_v_start_l = 0x3312,
+			.csr_o_width_h = 0x3315, .csr_o_width_l = 0x3314,
+			.csr_o_height_h = 0x3317, .csr_o_height_l = 0x3316,
+			.csr_exposure_h = 0x308f, .csr_exposure_m = 0x308e, .csr_exposure_l = 0x308d,
+			.csr_gain_h = 0x3205, .csr_gain_l = 0x3204,
+			.clk_ext_trigger = 54000000, .clk_pixel = 54000000,
+			.num_modes = 2,
+			.modes = {
+				EMU_MODE(1188, 1, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 1, FORMAT_RAW10, EMU_EXT_TRG),
+			},
+		},
+		.width = 1440, .height = 1080,
+		.mode_standby = 0x01,
+		.vmax = { 0x3010, 0x3011, 0x3012 }, .vmax_def = 1118,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX327C", .mod_id = MOD_ID_IMX327,
+			.csr_mode = 0x3000,
+			.csr_h_start_h = 0x303d, .csr_h_start_l = 0x303c,
+			.csr_v_start_h = 0x3039, .csr_v_start_l = 0x3038,
+			.csr_o_width_h = 0x303f, .csr_o_width_l = 0x303e,
+			.csr_o_height_h = 0x303b, .csr_o_height_l = 0x303a,
+			.csr_exposure_h = 0x3022, .csr_exposure_m = 0x3021, .csr_exposure_l = 0x3020,
+			.csr_gain_h = 0x0000, .csr_gain_l = 0x3014,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 4,
+			.modes = {
+				EMU_MODE(891, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(891, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(446, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(446, 4, FORMAT_RAW12, EMU_STREAM),
+			},
+		},
+		.width = 1920, .height = 1080,
+		.mode_standby = 0x01,
+		.vmax = { 0x3018, 0x3019, 0x301a }, .vmax_def = 1125,
+		.blklevel = { 0x300a, 0x300b }, .blklevel_def = 0xf0,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX392", .mod_id = MOD_ID_IMX392,
+			.csr_mode = 0x0200,
+			.csr_h_start_h = 0x0311, .csr_h_start_l = 0x0310,
+			.csr_v_start_h = 0x0313, .csr_v_start_l = 0x0312,
+			.csr_o_width_h = 0x0315, .csr_o_width_l = 0x0314,
+			.csr_o_height_h = 0x0317, .csr_o_height_l = 0x0316,
+			.csr_exposure_h = 0x020f, .csr_exposure_m = 0x020e, .csr_exposure_l = 0x020d,
+			.csr_gain_h = 0x0205, .csr_gain_l = 0x0204,
+			.clk_ext_trigger = 74250000, .clk_pixel = 74250000,
+			.num_modes = 9,
+			.modes = {
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(594, 4, FORMAT_RAW12, EMU_STREAM),
+				EMU_MODE(1188, 2, FORMAT_RAW08, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW10, EMU_EXT_TRG),
+				EMU_MODE(1188, 2, FORMAT_RAW12, EMU_EXT_TRG),
+			},
+		},
+		.width = 1920, .height = 1200,
+		.mode_standby = 0x00,
+		.vmax = { 0x0210, 0x0211, 0x0212 }, .vmax_def = 2094,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX412C", .mod_id = MOD_ID_IMX412,
+			.csr_mode = 0x0100,
+			.csr_h_start_h = 0x0344, .csr_h_start_l = 0x0345,
+			.csr_v_start_h = 0x0346, .csr_v_start_l = 0x0347,
+			.csr_o_width_h = 0x034c, .csr_o_width_l = 0x034d,
+			.csr_o_height_h = 0x034e, .csr_o_height_l = 0x034f,
+			.csr_exposure_h = 0x0000, .csr_exposure_m = 0x0202, .csr_exposure_l = 0x0203,
+			.csr_gain_h = 0x0204, .csr_gain_l = 0x0205,
+			.clk_ext_trigger = 24000000, .clk_pixel = 24000000,
+			.num_modes = 3,
+			.modes = {
+				EMU_MODE(1400, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(760, 4, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(760, 4, FORMAT_RAW12, EMU_STREAM),
+			},
+		},
+		.width = 4056, .height = 3040,
+		.mode_standby = 0x00,
+	},
+	{
+		.desc = {
+			.sen_manuf = "SONY", .sen_type = "IMX415C", .mod_id = MOD_ID_IMX415,
+			.csr_mode = 0x3000,
+			.csr_h_start_h = 0x3041, .csr_h_start_l = 0x3040,
+			.csr_v_start_h = 0x3045, .csr_v_start_l = 0x3044,
+			.csr_o_width_h = 0x3043, .csr_o_width_l = 0x3042,
+			.csr_o_height_h = 0x3047, .csr_o_height_l = 0x3046,
+			.csr_exposure_h = 0x3052, .csr_exposure_m = 0x3051, .csr_exposure_l = 0x3050,
+			.csr_gain_h = 0x3091, .csr_gain_l = 0x3090,
+			.clk_ext_trigger = 37125000, .clk_pixel = 37125000,
+			.num_modes = 2,
+			.modes = {
+				EMU_MODE(1485, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(891, 4, FORMAT_RAW10, EMU_STREAM),
+			},
+		},
+		.width = 3840, .height = 2160,
+		.mode_standby = 0x01,
+		.vmax = { 0x3024, 0x3025, 0x3026 }, .vmax_def = 2250,
+	},
+	{
+		.desc = {
+			.sen_manuf = "OV", .sen_type = "OV9281", .mod_id = MOD_ID_OV9281,
+			.csr_mode = 0x0100,
+			.csr_h_start_h = 0x3800, .csr_h_start_l = 0x3801,
+			.csr_v_start_h = 0x3802, .csr_v_start_l = 0x3803,
+			.csr_o_width_h = 0x3808, .csr_o_width_l = 0x3809,
+			.csr_o_height_h = 0x380a, .csr_o_height_l = 0x380b,
+			.csr_exposure_h = 0x3500, .csr_exposure_m = 0x3501, .csr_exposure_l = 0x3502,
+			.csr_gain_h = 0x0000, .csr_gain_l = 0x3509,
+			.clk_ext_trigger = 25000000, .clk_pixel = 25000000,
+			.num_modes = 4,
+			.modes = {
+				EMU_MODE(800, 2, FORMAT_RAW08, EMU_STREAM),
+				EMU_MODE(800, 2, FORMAT_RAW10, EMU_STREAM),
+				EMU_MODE(800, 2, FORMAT_RAW08, EMU_EXT_TRG),
+				EMU_MODE(800, 2, FORMAT_RAW10, EMU_EXT_TRG),
+			},
+		},
+		.width = 1280, .height = 800,
+		.mode_standby = 0x00,
+	},
+};
+
+struct vc_emu_stats {
+	__u32 transfers;
+	__u32 faults;
+	__u32 resets;
+	__u32 mode_errors;
+	__u32 stream_starts;
+	__u32 single_triggers;
+};
+
+struct vc_emu_target {
+	__u8 *regs;
+	__u16 pointer;
+	int pointer_bytes;		// Address bytes received in the current write message
+};
+
+struct vc_emu {
+	struct device *dev;
+	struct i2c_adapter adapter;
+	const struct vc_emu_profile *profile;
+	struct vc_emu_target mod;
+	struct vc_emu_target sen;
+	int powered;
+	int ready;
+	ktime_t ready_at;
+	struct vc_emu_stats stats;
+};
+
+static const struct vc_emu_profile *vc_emu_find_profile(__u32 id)
+{
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_emu_profiles); index++) {
+		if (vc_emu_profiles[index].desc.mod_id == id)
+			return &vc_emu_profiles[index];
+	}
+	return NULL;
+}
+
+// Matches the sensor type case insensitive, the suffix C of the color sensors is optional.
+static const struct vc_emu_profile *vc_emu_find_profile_by_name(const char *name)
+{
+	const char *type;
+	size_t len = strlen(name);
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_emu_profiles); index++) {
+		type = vc_emu_profiles[index].desc.sen_type;
+		if (strncasecmp(type, name, len) == 0 && (type[len] == 0 || strcmp(&type[len], "C") == 0))
+			return &vc_emu_profiles[index];
+	}
+	return NULL;
+}
+
+static void vc_emu_write_csr(__u8 *regs, __u16 addr, __u8 value)
+{
+	if (addr)
+		regs[addr] = value;
+}
+
+static void vc_emu_load_sensor(struct vc_emu *emu)
+{
+	const struct vc_emu_profile *profile = emu->profile;
+	const struct vc_desc *desc = &profile->desc;
+	__u8 *regs = emu->sen.regs;
+
+	memset(regs, 0, EMU_REGS);
+	vc_emu_write_csr(regs, desc->csr_mode, profile->mode_standby);
+	vc_emu_write_csr(regs, desc->csr_o_width_l, EMU_BYTE(0, profile->width));
+	vc_emu_write_csr(regs, desc->csr_o_width_h, EMU_BYTE(1, profile->width));
+	vc_emu_write_csr(regs, desc->csr_o_height_l, EMU_BYTE(0, profile->height));
+	vc_emu_write_csr(regs, desc->csr_o_height_h, EMU_BYTE(1, profile->height));
+	vc_emu_write_csr(regs, profile->vmax[0], EMU_BYTE(0, profile->vmax_def));
+	vc_emu_write_csr(regs, profile->vmax[1], EMU_BYTE(1, profile->vmax_def));
+	vc_emu_write_csr(regs, profile->vmax[2], EMU_BYTE(2, profile->vmax_def));
+	vc_emu_write_csr(regs, profile->blklevel[0], EMU_BYTE(0, profile->blklevel_def));
+	vc_emu_write_csr(regs, profile->blklevel[1], EMU_BYTE(1, profile->blklevel_def));
+}
+
+static void vc_emu_load_module(struct vc_emu *emu)
+{
+	__u8 *regs = emu->mod.regs;
+	struct vc_desc *desc = (struct vc_desc *)&regs[EMU_DESC_ADDR];
+
+	memset(regs, 0, EMU_REGS);
+	*desc = emu->profile->desc;
+	memcpy(desc->magic, "@VC-MIPI-EMU", sizeof(desc->magic));
+	strscpy((char *)desc->manuf, "Vision Components (emulated)", sizeof(desc->manuf));
+	desc->mod_rev = 1;
+	desc->bytes_per_mode = sizeof(struct vc_desc_mode);
+
+	regs[EMU_REG_STATUS] = EMU_STATUS_READY;
+	regs[EMU_REG_MOD_ADDR] = EMU_MOD_ADDR;
+	regs[EMU_REG_SEN_ADDR] = EMU_SEN_ADDR;
+	// Defaults of the exposure (10000) and retrigger (0x00292d40) registers
+	regs[EMU_REG_EXPO_L + 0] = 0x10;
+	regs[EMU_REG_EXPO_L + 1] = 0x27;
+	regs[EMU_REG_RETRIG_L + 0] = 0x40;
+	regs[EMU_REG_RETRIG_L + 1] = 0x2d;
+	regs[EMU_REG_RETRIG_L + 2] = 0x29;
+
+	emu->powered = 1;
+	emu->ready = 1;
+	vc_emu_load_sensor(emu);
+}
+
+// Completes a pending power up once the ready delay has passed.
+static void vc_emu_update(struct vc_emu *emu)
+{
+	__u8 *regs = emu->mod.regs;
+
+	if (!emu->powered || emu->ready || ktime_before(ktime_get(), emu->ready_at))
+		return;
+
+	if (fail_ready || regs[EMU_REG_MODE] >= emu->profile->desc.num_modes) {
+		dev_warn(emu->dev, "%s(): Module failed to initialize (mode: %u)\n", __FUNCTION__,
+			regs[EMU_REG_MODE]);
+		regs[EMU_REG_STATUS] = EMU_STATUS_ERROR;
+		emu->stats.mode_errors++;
+		return;
+	}
+
+	vc_emu_load_sensor(emu);
+	regs[EMU_REG_STATUS] = EMU_STATUS_READY;
+	emu->ready = 1;
+	dev_dbg(emu->dev, "%s(): Module ready (mode: %u)\n", __FUNCTION__, regs[EMU_REG_MODE]);
+}
+
+static void vc_emu_write_module(struct vc_emu *emu, __u16 addr, __u8 value)
+{
+	__u8 *regs = emu->mod.regs;
+
+	switch (addr) {
+	case EMU_REG_RESET:
+		regs[addr] = value;
+		regs[EMU_REG_STATUS] = EMU_STATUS_NO_COM;
+		emu->ready = 0;
+		emu->powered = !(value & (EMU_RESET_PWR_DOWN | EMU_RESET_SENSOR));
+		if (emu->powered) {
+			emu->ready_at = ktime_add_ms(ktime_get(), ready_delay_ms);
+			emu->stats.resets++;
+		}
+		break;
+	case EMU_REG_STATUS:
+	case EMU_REG_INPUT:
+		break;			// Read only
+	case EMU_REG_EXTTRIG:
+		regs[addr] = value;
+		if (value == EMU_TRIGGER_SINGLE)
+			emu->stats.single_triggers++;
+		break;
+	default:
+		// The descriptor is stored in a ROM
+		if (addr < EMU_DESC_ADDR || addr >= EMU_DESC_ADDR + sizeof(struct vc_desc))
+			regs[addr] = value;
+		break;
+	}
+}
+
+static void vc_emu_write_sensor(struct vc_emu *emu, __u16 addr, __u8 value)
+{
+	const struct vc_emu_profile *profile = emu->profile;
+
+	if (addr == profile->desc.csr_mode && addr && value != profile->mode_standby &&
+	    emu->sen.regs[addr] == profile->mode_standby) {
+		emu->stats.stream_starts++;
+	}
+	emu->sen.regs[addr] = value;
+}
+
+// Register access like the EEPROM protocol of the modules: the first two bytes of a write message
+// set the register pointer, further bytes are written with auto increment. Reads start at the
+// register pointer.
+static int vc_emu_xfer_msg(struct vc_emu *emu, struct vc_emu_target *target, struct i2c_msg *msg)
+{
+	int i;
+
+	if (msg->flags & I2C_M_RD) {
+		for (i = 0; i < msg->len; i++) {
+			msg->buf[i] = target->regs[target->pointer];
+			target->pointer++;
+		}
+		return 0;
+	}
+
+	target->pointer_bytes = 0;
+	for (i = 0; i < msg->len; i++) {
+		if (target->pointer_bytes < 2) {
+			target->pointer = (target->pointer << 8) | msg->buf[i];
+			target->pointer_bytes++;
+			continue;
+		}
+		if (target == &emu->mod)
+			vc_emu_write_module(emu, target->pointer, msg->buf[i]);
+		else
+			vc_emu_write_sensor(emu, target->pointer, msg->buf[i]);
+		target->pointer++;
+	}
+	return 0;
+}
+
+static void vc_emu_delay(struct i2c_msg *msgs, int num)
+{
+	unsigned long bits = 0;
+	unsigned long delay_us = latency_us;
+	int i;
+
+	if (bus_khz) {
+		for (i = 0; i < num; i++)
+			bits += EMU_MSG_OVERHEAD_BITS + EMU_BYTE_BITS * msgs[i].len;
+		delay_us += DIV_ROUND_UP(bits * 1000, bus_khz);
+	}
+	if (delay_us)
+		usleep_range(delay_us, delay_us + delay_us/8 + 1);
+}
+
+static int vc_emu_master_xfer(struct i2c_adapter *adapter, struct i2c_msg *msgs, int num)
+{
+	struct vc_emu *emu = i2c_get_adapdata(adapter);
+	__u8 *regs = emu->mod.regs;
+	struct vc_emu_target *target;
+	int i;
+
+	vc_emu_delay(msgs, num);
+	emu->stats.transfers++;
+
+	if (fault_rate && prandom_u32_max(1000) < fault_rate) {
+		emu->stats.faults++;
+		return -EREMOTEIO;
+	}
+
+	vc_emu_update(emu);
+
+	for (i = 0; i < num; i++) {
+		if (msgs[i].addr == regs[EMU_REG_MOD_ADDR]) {
+			target = &emu->mod;
+		} else if (msgs[i].addr == regs[EMU_REG_SEN_ADDR] && emu->ready) {
+			target = &emu->sen;
+		} else {
+			return -ENXIO;
+		}
+		vc_emu_xfer_msg(emu, target, &msgs[i]);
+	}
+
+	return num;
+}
+
+static u32 vc_emu_functionality(struct i2c_adapter *adapter)
+{
+	return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm vc_emu_algorithm = {
+	.master_xfer = vc_emu_master_xfer,
+	.functionality = vc_emu_functionality,
+};
+
+static ssize_t stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct vc_emu *emu = dev_get_drvdata(dev);
+	struct vc_emu_stats *stats = &emu->stats;
+
+	return sprintf(buf, "transfers %u\nfaults %u\nresets %u\nmode_errors %u\n"
+		"stream_starts %u\nsingle_triggers %u\n", stats->transfers, stats->faults,
+		stats->resets, stats->mode_errors, stats->stream_starts, stats->single_triggers);
+}
+static DEVICE_ATTR_RO(stats);
+
+static int vc_emu_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct vc_emu *emu;
+	u32 id = mod_id;
+	int ret;
+
+	emu = devm_kzalloc(dev, sizeof(*emu), GFP_KERNEL);
+	if (!emu)
+		return -ENOMEM;
+	emu->dev = dev;
+
+	if (profile && *profile) {
+		emu->profile = vc_emu_find_profile_by_name(profile);
+		if (!emu->profile) {
+			dev_err(dev, "%s(): No profile for sensor %s!\n", __FUNCTION__, profile);
+			return -EINVAL;
+		}
+		id = emu->profile->desc.mod_id;
+	} else {
+		of_property_read_u32(dev->of_node, "mod_id", &id);
+		emu->profile = vc_emu_find_profile(id);
+		if (!emu->profile) {
+			dev_err(dev, "%s(): No profile for MOD_ID 0x%04x!\n", __FUNCTION__, id);
+			return -EINVAL;
+		}
+	}
+
+	emu->mod.regs = devm_kzalloc(dev, EMU_REGS, GFP_KERNEL);
+	emu->sen.regs = devm_kzalloc(dev, EMU_REGS, GFP_KERNEL);
+	if (!emu->mod.regs || !emu->sen.regs)
+		return -ENOMEM;
+	vc_emu_load_module(emu);
+
+	platform_set_drvdata(pdev, emu);
+	ret = device_create_file(dev, &dev_attr_stats);
+	if (ret)
+		return ret;
+
+	emu->adapter.owner = THIS_MODULE;
+	emu->adapter.algo = &vc_emu_algorithm;
+	emu->adapter.dev.parent = dev;
+	emu->adapter.dev.of_node = dev->of_node;
+	snprintf(emu->adapter.name, sizeof(emu->adapter.name), "VC MIPI emulator %s",
+		emu->profile->desc.sen_type);
+	i2c_set_adapdata(&emu->adapter, emu);
+
+	// Instantiates the camera nodes below the emulator node.
+	ret = i2c_add_adapter(&emu->adapter);
+	if (ret) {
+		device_remove_file(dev, &dev_attr_stats);
+		return ret;
+	}
+
+	dev_notice(dev, "%s(): Emulating %s (MOD_ID 0x%04x) on i2c-%d\n", __FUNCTION__,
+		emu->profile->desc.sen_type, id, emu->adapter.nr);
+	return 0;
+}
+
+static int vc_emu_remove(struct platform_device *pdev)
+{
+	struct vc_emu *emu = platform_get_drvdata(pdev);
+
+	i2c_del_adapter(&emu->adapter);
+	device_remove_file(&pdev->dev, &dev_attr_stats);
+
+	return 0;
+}
+
+static const struct of_device_id vc_emu_dt_ids[] = {
+	{ .compatible = "vc,vc_mipi_emu" },
+	{ /* sentinel */ }
+};
+MODULE_DEVICE_TABLE(of, vc_emu_dt_ids);
+
+static struct platform_driver vc_emu_driver = {
+	.driver = {
+		.name = "vc-mipi-emu",
+		.of_match_table = vc_emu_dt_ids,
+	},
+	.probe = vc_emu_probe,
+	.remove = vc_emu_remove,
+};
+
+module_platform_driver(vc_emu_driver);
+
+MODULE_VERSION("0.5.1");
+MODULE_DESCRIPTION("Vision Components GmbH - VC MIPI module emulator");
+MODULE_LICENSE("GPL v2");
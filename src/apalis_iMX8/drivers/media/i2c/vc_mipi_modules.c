@@ -81,6 +81,18 @@ static void vc_init_ctrl_imx252_base(struct vc_ctrl *ctrl, struct vc_desc* desc)
 					   FLAG_TRIGGER_SELF | FLAG_TRIGGER_SINGLE;
 }
 
+// PGCTRL: PGMODE in bits 7:4, PGTHRU and PGREGEN in bits 1:0
+static const struct vc_test_pattern imx290_test_patterns[] = {
+	{ "Disabled",				0x00 },
+	{ "Sequence Pattern 1",			0x13 },
+	{ "Horizontal Color Bars",		0x23 },
+	{ "Vertical Color Bars",		0x33 },
+	{ "Sequence Pattern 2",			0x43 },
+	{ "Gradation Pattern 1",		0x53 },
+	{ "Gradation Pattern 2",		0x63 },
+	{ "000/555h Toggle Pattern",		0x73 },
+};
+
 static void vc_init_ctrl_imx290_base(struct vc_ctrl *ctrl, struct vc_desc* desc)
 {
 	ctrl->frame.width		= 1920;
@@ -93,6 +105,9 @@ static void vc_init_ctrl_imx290_base(struct vc_ctrl *ctrl, struct vc_desc* desc)
 	ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x3018, .m = 0x3019, .h = 0x301A, .u = 0x0000 };
 	ctrl->csr.sen.mode_standby	= 0x01;
 	ctrl->csr.sen.mode_operating	= 0x00;
+	ctrl->csr.sen.hold		= 0x3001;
+	ctrl->csr.sen.test_pattern	= (vc_csr2) { .l = 0x308C, .m = 0x0000 };
+	ctrl->csr.sen.pattern_blacklevel = (vc_csr2) { .l = 0x300A, .m = 0x300B };
 
 	ctrl->expo_timing[0] 		= (vc_timing) { 2, FORMAT_RAW10, .clk =  1100 };
 	ctrl->expo_timing[1] 		= (vc_timing) { 2, FORMAT_RAW12, .clk =  1100 };
@@ -104,6 +119,9 @@ static void vc_init_ctrl_imx290_base(struct vc_ctrl *ctrl, struct vc_desc* desc)
 	ctrl->sen_clk                   = desc->clk_ext_trigger;
 	ctrl->expo_shs_min              = 1;
 	ctrl->expo_vmax 		= 1125;
+	ctrl->frame_delay		= 2;
+	ctrl->test_patterns		= imx290_test_patterns;
+	ctrl->num_test_patterns		= ARRAY_SIZE(imx290_test_patterns);
 
 	ctrl->flags			= FLAG_EXPOSURE_WRITE_VMAX;
 }
@@ -393,6 +411,15 @@ static void vc_init_ctrl_imx392(struct vc_ctrl *ctrl, struct vc_desc* desc)
 // ------------------------------------------------------------------------------------------------
 //  Settings for IMX412C
 
+// TEST_PATTERN_MODE (0x0600/0x0601)
+static const struct vc_test_pattern imx412_test_patterns[] = {
+	{ "Disabled",				0x0000 },
+	{ "Solid Color",			0x0001 },
+	{ "Color Bars",				0x0002 },
+	{ "Fade to Grey Color Bars",		0x0003 },
+	{ "PN9",				0x0004 },
+};
+
 static void vc_init_ctrl_imx412(struct vc_ctrl *ctrl, struct vc_desc* desc)
 {
 	struct device *dev = &ctrl->client_mod->dev;
@@ -403,16 +430,22 @@ static void vc_init_ctrl_imx412(struct vc_ctrl *ctrl, struct vc_desc* desc)
 	ctrl->gain			= (vc_control) { .min =   0, .max =      1023, .def =      0 };
 	ctrl->framerate 		= (vc_control) { .min =   0, .max =        41, .def =      0 };
 
+	ctrl->csr.sen.test_pattern	= (vc_csr2) { .l = 0x0601, .m = 0x0600 };
+
 	ctrl->frame.width		= 4056;
 	ctrl->frame.height		= 3040;
 
 	ctrl->expo_factor               = 31755000;
 	ctrl->expo_toffset 		= 5975;
+	ctrl->test_patterns		= imx412_test_patterns;
+	ctrl->num_test_patterns		= ARRAY_SIZE(imx412_test_patterns);
 
 	// No VMAX value present. No TRIGGER and FLASH capability.
 	ctrl->flags			= FLAG_RESET_ALWAYS;
 	ctrl->flags		       |= FLAG_EXPOSURE_SIMPLE;
 	ctrl->flags		       |= FLAG_IO_FLASH_ENABLED;
+	// Exposure, gain and test pattern are lost when the stream stops.
+	ctrl->restore			= RESTORE_EXPOSURE | RESTORE_GAIN | RESTORE_TEST_PATTERN;
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -430,6 +463,7 @@ static void vc_init_ctrl_imx415(struct vc_ctrl *ctrl, struct vc_desc* desc)
 	ctrl->csr.sen.vmax              = (vc_csr4) { .l = 0x3024, .m = 0x3025, .h = 0x3026, .u = 0x0000 };
 	ctrl->csr.sen.mode_standby	= 0x01;
 	ctrl->csr.sen.mode_operating	= 0x00;
+	ctrl->csr.sen.hold		= 0x3001;
 
 	ctrl->frame.width		= 3840;
 	ctrl->frame.height		= 2160;
@@ -439,6 +473,7 @@ static void vc_init_ctrl_imx415(struct vc_ctrl *ctrl, struct vc_desc* desc)
 
 	ctrl->expo_shs_min              = 8;
 	ctrl->expo_vmax 		= 2250;
+	ctrl->frame_delay		= 2;
 
 	ctrl->flags                     = FLAG_EXPOSURE_WRITE_VMAX;
 	ctrl->flags		       |= FLAG_DOUBLE_HEIGHT;
@@ -455,6 +490,12 @@ static void vc_init_ctrl_imx415(struct vc_ctrl *ctrl, struct vc_desc* desc)
 //    {0x380E, 0x380F}
 //  - Trigger mode could not be activated. When 0x0108 = 0x01 exposure time has no effect.
 
+// Test pattern enable in bit 7 of 0x5E00
+static const struct vc_test_pattern ov9281_test_patterns[] = {
+	{ "Disabled",				0x00 },
+	{ "Color Bars",				0x80 },
+};
+
 static void vc_init_ctrl_ov9281(struct vc_ctrl *ctrl, struct vc_desc* desc)
 {
 	struct device *dev = &ctrl->client_mod->dev;
@@ -463,12 +504,13 @@ static void vc_init_ctrl_ov9281(struct vc_ctrl *ctrl, struct vc_desc* desc)
 
 	// exposure max => L4T 32.5.0+: 8253, L4T 32.6.1+: 8244 (if > black line in image)
 	ctrl->exposure			= (vc_control) { .min =  29, .max =      8244, .def =   1000 };
-	ctrl->gain			= (vc_control) { .min =   1, .max =       255, .def =      0 };
+	ctrl->gain			= (vc_control) { .min =   1, .max =       255, .def =      1 };
 
 	ctrl->csr.sen.flash_duration	= (vc_csr4) { .l = 0x3928, .m = 0x3927, .h = 0x3926, .u = 0x3925 };
 	ctrl->csr.sen.flash_offset	= (vc_csr4) { .l = 0x3924, .m = 0x3923, .h = 0x3922, .u = 0x0000 };
 	// NOTE: Modules rom table contains swapped address assigment.
 	ctrl->csr.sen.gain 		= (vc_csr2) { .l = 0x3509, .m = 0x0000 };
+	ctrl->csr.sen.test_pattern	= (vc_csr2) { .l = 0x5E00, .m = 0x0000 };
 
 	ctrl->frame.width		= 1280;
 	ctrl->frame.height		= 800;
@@ -478,6 +520,8 @@ static void vc_init_ctrl_ov9281(struct vc_ctrl *ctrl, struct vc_desc* desc)
 	ctrl->expo_toffset 		= 0;
 	ctrl->flash_factor		= ctrl->expo_factor >> 4;
 	ctrl->flash_toffset		= 4;
+	ctrl->test_patterns		= ov9281_test_patterns;
+	ctrl->num_test_patterns		= ARRAY_SIZE(ov9281_test_patterns);
 
 	ctrl->flags		 	= FLAG_EXPOSURE_SIMPLE;
 	ctrl->flags		       |= FLAG_IO_FLASH_DURATION;
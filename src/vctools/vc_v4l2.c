@@ -0,0 +1,500 @@
+#include "vc_v4l2.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/v4l2-subdev.h>
+
+static int xioctl(int fd, unsigned long request, void *arg)
+{
+	int ret;
+
+	do {
+		ret = ioctl(fd, request, arg);
+	} while (ret == -1 && errno == EINTR);
+
+	return ret;
+}
+
+static int is_mplane(struct vc_v4l2_dev *dev)
+{
+	return dev->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+}
+
+
+// *** Video device ***********************************************************
+
+int vc_v4l2_open(struct vc_v4l2_dev *dev, const char *name)
+{
+	struct v4l2_capability cap;
+	__u32 caps;
+
+	memset(dev, 0, sizeof(*dev));
+
+	dev->fd = open(name, O_RDWR | O_NONBLOCK);
+	if (dev->fd < 0) {
+		fprintf(stderr, "%s(): Unable to open %s (%s)\n", __FUNCTION__, name, strerror(errno));
+		return -errno;
+	}
+
+	if (xioctl(dev->fd, VIDIOC_QUERYCAP, &cap) < 0) {
+		fprintf(stderr, "%s(): %s is no V4L2 device (%s)\n", __FUNCTION__, name, strerror(errno));
+		close(dev->fd);
+		return -ENODEV;
+	}
+
+	caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+	if (!(caps & V4L2_CAP_STREAMING)) {
+		fprintf(stderr, "%s(): %s does not support streaming\n", __FUNCTION__, name);
+		close(dev->fd);
+		return -ENODEV;
+	}
+
+	// The i.MX8 ISI capture device only supports the multi-planar API.
+	if (caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE)
+		dev->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	else
+		dev->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	return vc_v4l2_get_format(dev);
+}
+
+void vc_v4l2_close(struct vc_v4l2_dev *dev)
+{
+	vc_v4l2_free_buffers(dev);
+	if (dev->fd >= 0)
+		close(dev->fd);
+	dev->fd = -1;
+}
+
+static void vc_v4l2_read_format(struct vc_v4l2_dev *dev, struct v4l2_format *fmt)
+{
+	if (is_mplane(dev)) {
+		dev->width = fmt->fmt.pix_mp.width;
+		dev->height = fmt->fmt.pix_mp.height;
+		dev->pixelformat = fmt->fmt.pix_mp.pixelformat;
+		dev->bytesperline = fmt->fmt.pix_mp.plane_fmt[0].bytesperline;
+		dev->sizeimage = fmt->fmt.pix_mp.plane_fmt[0].sizeimage;
+	} else {
+		dev->width = fmt->fmt.pix.width;
+		dev->height = fmt->fmt.pix.height;
+		dev->pixelformat = fmt->fmt.pix.pixelformat;
+		dev->bytesperline = fmt->fmt.pix.bytesperline;
+		dev->sizeimage = fmt->fmt.pix.sizeimage;
+	}
+}
+
+int vc_v4l2_get_format(struct vc_v4l2_dev *dev)
+{
+	struct v4l2_format fmt;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = dev->type;
+	if (xioctl(dev->fd, VIDIOC_G_FMT, &fmt) < 0) {
+		fprintf(stderr, "%s(): VIDIOC_G_FMT failed (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+	vc_v4l2_read_format(dev, &fmt);
+
+	return 0;
+}
+
+int vc_v4l2_set_format(struct vc_v4l2_dev *dev, __u32 width, __u32 height, __u32 pixelformat)
+{
+	struct v4l2_format fmt;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = dev->type;
+	if (xioctl(dev->fd, VIDIOC_G_FMT, &fmt) < 0) {
+		fprintf(stderr, "%s(): VIDIOC_G_FMT failed (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+
+	if (is_mplane(dev)) {
+		if (width)
+			fmt.fmt.pix_mp.width = width;
+		if (height)
+			fmt.fmt.pix_mp.height = height;
+		if (pixelformat)
+			fmt.fmt.pix_mp.pixelformat = pixelformat;
+		fmt.fmt.pix_mp.num_planes = 1;
+	} else {
+		if (width)
+			fmt.fmt.pix.width = width;
+		if (height)
+			fmt.fmt.pix.height = height;
+		if (pixelformat)
+			fmt.fmt.pix.pixelformat = pixelformat;
+	}
+
+	if (xioctl(dev->fd, VIDIOC_S_FMT, &fmt) < 0) {
+		fprintf(stderr, "%s(): VIDIOC_S_FMT failed (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+	vc_v4l2_read_format(dev, &fmt);
+
+	return 0;
+}
+
+static int vc_v4l2_request_buffers(struct vc_v4l2_dev *dev, unsigned int count)
+{
+	struct v4l2_requestbuffers req;
+
+	memset(&req, 0, sizeof(req));
+	req.count = count;
+	req.type = dev->type;
+	req.memory = V4L2_MEMORY_MMAP;
+	if (xioctl(dev->fd, VIDIOC_REQBUFS, &req) < 0) {
+		fprintf(stderr, "%s(): VIDIOC_REQBUFS failed (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+
+	return req.count;
+}
+
+static int vc_v4l2_map_buffer(struct vc_v4l2_dev *dev, unsigned int index)
+{
+	struct vc_v4l2_buffer *buffer = &dev->buffers[index];
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	struct v4l2_exportbuffer expbuf;
+	struct v4l2_buffer buf;
+	__u32 offset;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.type = dev->type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = index;
+	if (is_mplane(dev)) {
+		buf.m.planes = planes;
+		buf.length = VIDEO_MAX_PLANES;
+	}
+	if (xioctl(dev->fd, VIDIOC_QUERYBUF, &buf) < 0) {
+		fprintf(stderr, "%s(): VIDIOC_QUERYBUF failed (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+
+	if (is_mplane(dev)) {
+		buffer->length = planes[0].length;
+		offset = planes[0].m.mem_offset;
+	} else {
+		buffer->length = buf.length;
+		offset = buf.m.offset;
+	}
+	buffer->dmabuf_fd = -1;
+
+	if (dev->io == VC_IO_DMABUF) {
+		// Export the buffer like a zero-copy consumer (e.g. GStreamer
+		// io-mode=dmabuf) would do and access the pixels through the
+		// dmabuf file descriptor.
+		memset(&expbuf, 0, sizeof(expbuf));
+		expbuf.type = dev->type;
+		expbuf.index = index;
+		expbuf.plane = 0;
+		expbuf.flags = O_RDONLY | O_CLOEXEC;
+		if (xioctl(dev->fd, VIDIOC_EXPBUF, &expbuf) < 0) {
+			fprintf(stderr, "%s(): VIDIOC_EXPBUF failed (%s)\n", __FUNCTION__, strerror(errno));
+			return -errno;
+		}
+		buffer->dmabuf_fd = expbuf.fd;
+		buffer->start = mmap(NULL, buffer->length, PROT_READ, MAP_SHARED, expbuf.fd, 0);
+	} else {
+		buffer->start = mmap(NULL, buffer->length, PROT_READ, MAP_SHARED, dev->fd, offset);
+	}
+
+	if (buffer->start == MAP_FAILED) {
+		fprintf(stderr, "%s(): mmap failed (%s)\n", __FUNCTION__, strerror(errno));
+		buffer->start = NULL;
+		return -errno;
+	}
+
+	return 0;
+}
+
+int vc_v4l2_alloc_buffers(struct vc_v4l2_dev *dev, enum vc_v4l2_io io, unsigned int count)
+{
+	unsigned int index;
+	int ret;
+
+	if (count > VC_V4L2_MAX_BUFFERS)
+		count = VC_V4L2_MAX_BUFFERS;
+
+	dev->io = io;
+	ret = vc_v4l2_request_buffers(dev, count);
+	if (ret < 0)
+		return ret;
+	if (ret < 2) {
+		fprintf(stderr, "%s(): Insufficient buffer memory (%d buffers)\n", __FUNCTION__, ret);
+		return -ENOMEM;
+	}
+	dev->num_buffers = ret;
+
+	for (index = 0; index < dev->num_buffers; index++) {
+		ret = vc_v4l2_map_buffer(dev, index);
+		if (ret) {
+			vc_v4l2_free_buffers(dev);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+void vc_v4l2_free_buffers(struct vc_v4l2_dev *dev)
+{
+	unsigned int index;
+
+	if (dev->num_buffers == 0)
+		return;
+
+	for (index = 0; index < dev->num_buffers; index++) {
+		struct vc_v4l2_buffer *buffer = &dev->buffers[index];
+		if (buffer->start)
+			munmap(buffer->start, buffer->length);
+		if (buffer->dmabuf_fd >= 0)
+			close(buffer->dmabuf_fd);
+		memset(buffer, 0, sizeof(*buffer));
+	}
+	dev->num_buffers = 0;
+	vc_v4l2_request_buffers(dev, 0);
+}
+
+int vc_v4l2_queue(struct vc_v4l2_dev *dev, unsigned int index)
+{
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	struct v4l2_buffer buf;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.type = dev->type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = index;
+	if (is_mplane(dev)) {
+		buf.m.planes = planes;
+		buf.length = 1;
+	}
+	if (xioctl(dev->fd, VIDIOC_QBUF, &buf) < 0) {
+		fprintf(stderr, "%s(): VIDIOC_QBUF failed (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+int vc_v4l2_dequeue(struct vc_v4l2_dev *dev, struct vc_v4l2_frame *frame, int timeout_ms)
+{
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	struct pollfd pfd;
+	struct v4l2_buffer buf;
+	int ret;
+
+	pfd.fd = dev->fd;
+	pfd.events = POLLIN;
+	do {
+		ret = poll(&pfd, 1, timeout_ms);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		return -errno;
+	if (ret == 0)
+		return -ETIMEDOUT;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.type = dev->type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	if (is_mplane(dev)) {
+		buf.m.planes = planes;
+		buf.length = 1;
+	}
+	if (xioctl(dev->fd, VIDIOC_DQBUF, &buf) < 0) {
+		if (errno == EAGAIN)
+			return -EAGAIN;
+		fprintf(stderr, "%s(): VIDIOC_DQBUF failed (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+
+	frame->index = buf.index;
+	frame->sequence = buf.sequence;
+	frame->timestamp_us = (__u64)buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec;
+	frame->data = dev->buffers[buf.index].start;
+	frame->bytesused = is_mplane(dev) ? planes[0].bytesused : buf.bytesused;
+
+	return 0;
+}
+
+int vc_v4l2_start(struct vc_v4l2_dev *dev)
+{
+	enum v4l2_buf_type type = dev->type;
+	unsigned int index;
+	int ret;
+
+	for (index = 0; index < dev->num_buffers; index++) {
+		ret = vc_v4l2_queue(dev, index);
+		if (ret)
+			return ret;
+	}
+
+	if (xioctl(dev->fd, VIDIOC_STREAMON, &type) < 0) {
+		fprintf(stderr, "%s(): VIDIOC_STREAMON failed (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+int vc_v4l2_stop(struct vc_v4l2_dev *dev)
+{
+	enum v4l2_buf_type type = dev->type;
+
+	if (xioctl(dev->fd, VIDIOC_STREAMOFF, &type) < 0) {
+		fprintf(stderr, "%s(): VIDIOC_STREAMOFF failed (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+
+// *** Sub device *************************************************************
+
+int vc_v4l2_subdev_open(const char *name)
+{
+	int fd;
+
+	fd = open(name, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "%s(): Unable to open %s (%s)\n", __FUNCTION__, name, strerror(errno));
+		return -errno;
+	}
+
+	return fd;
+}
+
+int vc_v4l2_set_ctrl(int fd, __u32 id, __s32 value)
+{
+	struct v4l2_control control;
+
+	control.id = id;
+	control.value = value;
+	if (xioctl(fd, VIDIOC_S_CTRL, &control) < 0) {
+		fprintf(stderr, "%s(): Unable to set control 0x%08x to %d (%s)\n", __FUNCTION__, id, value, strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+int vc_v4l2_get_ctrl(int fd, __u32 id, __s32 *value)
+{
+	struct v4l2_control control;
+
+	control.id = id;
+	control.value = 0;
+	if (xioctl(fd, VIDIOC_G_CTRL, &control) < 0) {
+		fprintf(stderr, "%s(): Unable to get control 0x%08x (%s)\n", __FUNCTION__, id, strerror(errno));
+		return -errno;
+	}
+	*value = control.value;
+
+	return 0;
+}
+
+// Sets all controls with one ioctl. The driver applies them in the order of
+// the array. On failure, error_idx is the index of the failing control or
+// count if the error is not related to a single control.
+int vc_v4l2_set_ctrls(int fd, const __u32 *ids, const __s32 *values, unsigned int count, unsigned int *error_idx)
+{
+	struct v4l2_ext_control controls[VC_V4L2_MAX_CTRLS];
+	struct v4l2_ext_controls ext;
+	unsigned int index;
+
+	if (count > VC_V4L2_MAX_CTRLS)
+		return -EINVAL;
+
+	memset(controls, 0, sizeof(controls));
+	for (index = 0; index < count; index++) {
+		controls[index].id = ids[index];
+		controls[index].value = values[index];
+	}
+
+	memset(&ext, 0, sizeof(ext));
+	ext.which = V4L2_CTRL_WHICH_CUR_VAL;
+	ext.count = count;
+	ext.controls = controls;
+	if (xioctl(fd, VIDIOC_S_EXT_CTRLS, &ext) < 0) {
+		if (error_idx)
+			*error_idx = ext.error_idx;
+		return -errno;
+	}
+
+	return 0;
+}
+
+int vc_v4l2_set_crop(int fd, __u32 left, __u32 top, __u32 width, __u32 height)
+{
+	struct v4l2_subdev_selection sel;
+
+	memset(&sel, 0, sizeof(sel));
+	sel.which = V4L2_SUBDEV_FORMAT_ACTIVE;
+	sel.pad = 0;
+	sel.target = V4L2_SEL_TGT_CROP;
+	sel.r.left = left;
+	sel.r.top = top;
+	sel.r.width = width;
+	sel.r.height = height;
+	if (xioctl(fd, VIDIOC_SUBDEV_S_SELECTION, &sel) < 0) {
+		fprintf(stderr, "%s(): Unable to set the crop rectangle (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+// Fires a software trigger in trigger mode 4 (single). The driver returns the
+// time when the trigger was written to the module.
+int vc_v4l2_trigger(int fd, struct vc_trigger *trigger)
+{
+	memset(trigger, 0, sizeof(*trigger));
+	if (xioctl(fd, VIDIOC_VC_TRIGGER, trigger) < 0) {
+		fprintf(stderr, "%s(): Unable to trigger (%s)\n", __FUNCTION__, strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+
+// *** Time measurement *******************************************************
+
+__u64 vc_v4l2_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+__u64 vc_v4l2_cpu_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (__u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+const char *vc_v4l2_fourcc(__u32 pixelformat, char *str)
+{
+	str[0] = pixelformat & 0xff;
+	str[1] = (pixelformat >> 8) & 0xff;
+	str[2] = (pixelformat >> 16) & 0xff;
+	str[3] = (pixelformat >> 24) & 0xff;
+	str[4] = 0;
+
+	return str;
+}
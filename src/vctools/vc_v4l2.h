@@ -0,0 +1,129 @@
+#ifndef _VC_V4L2_H
+#define _VC_V4L2_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/videodev2.h>
+
+// The VC MIPI driver controls are added to v4l2-controls.h by the kernel
+// patches 0001-Added-CIDs-for-trigger_mode-flash_mode-frame_rate-an.patch,
+// 0006-Added-CID-for-streamon_latency.patch, 0007-Added-CID-for-frame_delay.patch,
+// 0008-Added-CIDs-for-timed_exposure_bracket-and-bracket_in.patch,
+// 0010-Added-CIDs-for-recovery_count-and-recovery_failures.patch and
+// 0012-Added-CID-for-multi_roi.patch.
+// The toolchain headers usually don't contain them.
+#ifndef V4L2_CID_TRIGGER_MODE
+#define V4L2_CID_TRIGGER_MODE           (V4L2_CID_BASE+50)
+#endif
+#ifndef V4L2_CID_FLASH_MODE
+#define V4L2_CID_FLASH_MODE             (V4L2_CID_BASE+51)
+#endif
+#ifndef V4L2_CID_FRAME_RATE
+#define V4L2_CID_FRAME_RATE             (V4L2_CID_BASE+52)
+#endif
+#ifndef V4L2_CID_SINGLE_TRIGGER
+#define V4L2_CID_SINGLE_TRIGGER         (V4L2_CID_BASE+53)
+#endif
+#ifndef V4L2_CID_STREAMON_LATENCY
+#define V4L2_CID_STREAMON_LATENCY       (V4L2_CID_BASE+54)
+#endif
+#ifndef V4L2_CID_FRAME_DELAY
+#define V4L2_CID_FRAME_DELAY            (V4L2_CID_BASE+55)
+#endif
+#ifndef V4L2_CID_TIMED_EXPOSURE_BRACKET
+#define V4L2_CID_TIMED_EXPOSURE_BRACKET (V4L2_CID_BASE+56)
+#endif
+#ifndef V4L2_CID_BRACKET_INTERVAL
+#define V4L2_CID_BRACKET_INTERVAL       (V4L2_CID_BASE+57)
+#endif
+#ifndef V4L2_CID_RECOVERY_COUNT
+#define V4L2_CID_RECOVERY_COUNT         (V4L2_CID_BASE+58)
+#endif
+#ifndef V4L2_CID_RECOVERY_FAILURES
+#define V4L2_CID_RECOVERY_FAILURES      (V4L2_CID_BASE+59)
+#endif
+#ifndef V4L2_CID_MULTI_ROI
+#define V4L2_CID_MULTI_ROI              (V4L2_CID_BASE+60)
+#endif
+#ifndef V4L2_PIX_FMT_Y14
+#define V4L2_PIX_FMT_Y14                v4l2_fourcc('Y', '1', '4', ' ')
+#endif
+
+// The software trigger ioctl of the sub device is declared in linux/vc_mipi_camera.h, which is
+// added by the kernel patch 0009-Added-uapi-header-with-the-VC-MIPI-software-trigger-.patch.
+#if defined(__has_include)
+#if __has_include(<linux/vc_mipi_camera.h>)
+#include <linux/vc_mipi_camera.h>
+#endif
+#endif
+#ifndef VIDIOC_VC_TRIGGER
+struct vc_trigger {
+	__u64 timestamp;                // CLOCK_MONOTONIC in ns when the trigger was written to the module
+	__u32 duration;                 // ns the I2C write took
+	__u32 sequence;                 // Number of software triggers since the stream was started
+	__u32 reserved[4];
+};
+#define VIDIOC_VC_TRIGGER               _IOR('V', BASE_VIDIOC_PRIVATE + 0, struct vc_trigger)
+#endif
+
+#define VC_V4L2_MAX_BUFFERS             32
+#define VC_V4L2_MAX_CTRLS               16
+
+enum vc_v4l2_io {
+	VC_IO_MMAP = 0,                 // Driver allocated buffers, mapped into user space
+	VC_IO_DMABUF,                   // Driver allocated buffers, exported as dmabuf file descriptors
+};
+
+struct vc_v4l2_buffer {
+	void *start;
+	size_t length;
+	int dmabuf_fd;
+};
+
+struct vc_v4l2_dev {
+	int fd;
+	enum v4l2_buf_type type;
+	enum vc_v4l2_io io;
+	__u32 width;
+	__u32 height;
+	__u32 pixelformat;
+	__u32 bytesperline;
+	__u32 sizeimage;
+	struct vc_v4l2_buffer buffers[VC_V4L2_MAX_BUFFERS];
+	unsigned int num_buffers;
+};
+
+struct vc_v4l2_frame {
+	unsigned int index;
+	__u32 sequence;
+	__u64 timestamp_us;
+	void *data;
+	size_t bytesused;
+};
+
+// --- Helper functions for the video device -----------------------------------
+int vc_v4l2_open(struct vc_v4l2_dev *dev, const char *name);
+void vc_v4l2_close(struct vc_v4l2_dev *dev);
+int vc_v4l2_set_format(struct vc_v4l2_dev *dev, __u32 width, __u32 height, __u32 pixelformat);
+int vc_v4l2_get_format(struct vc_v4l2_dev *dev);
+int vc_v4l2_alloc_buffers(struct vc_v4l2_dev *dev, enum vc_v4l2_io io, unsigned int count);
+void vc_v4l2_free_buffers(struct vc_v4l2_dev *dev);
+int vc_v4l2_start(struct vc_v4l2_dev *dev);
+int vc_v4l2_stop(struct vc_v4l2_dev *dev);
+int vc_v4l2_dequeue(struct vc_v4l2_dev *dev, struct vc_v4l2_frame *frame, int timeout_ms);
+int vc_v4l2_queue(struct vc_v4l2_dev *dev, unsigned int index);
+
+// --- Helper functions for the sub device -------------------------------------
+int vc_v4l2_subdev_open(const char *name);
+int vc_v4l2_set_ctrl(int fd, __u32 id, __s32 value);
+int vc_v4l2_get_ctrl(int fd, __u32 id, __s32 *value);
+int vc_v4l2_set_ctrls(int fd, const __u32 *ids, const __s32 *values, unsigned int count, unsigned int *error_idx);
+int vc_v4l2_set_crop(int fd, __u32 left, __u32 top, __u32 width, __u32 height);
+int vc_v4l2_trigger(int fd, struct vc_trigger *trigger);
+
+// --- Helper functions for time measurement -----------------------------------
+__u64 vc_v4l2_now_us(void);
+__u64 vc_v4l2_cpu_us(void);
+const char *vc_v4l2_fourcc(__u32 pixelformat, char *str);
+
+#endif // _VC_V4L2_H
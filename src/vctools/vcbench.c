@@ -0,0 +1,400 @@
+// vcbench - Benchmark harness for the userspace kernels in src/vctools
+//
+// Every case is verified against the scalar reference before it is timed.
+// The result is printed as CSV. The throughput is related to the size of
+// the 16 bit input image.
+
+#include "vcdemosaic.h"
+#include "vcpack.h"
+#include "vcraw.h"
+#include "vc_v4l2.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct vc_bench {
+	size_t width;
+	size_t height;
+	unsigned int iterations;
+	unsigned int threads;
+	const char *filter;
+	__u16 *src;
+	void *dst;
+	void *ref;
+};
+
+typedef void (*vc_bench_fn)(struct vc_bench *bench, const struct vc_raw_ops *ops, void *dst);
+
+struct vc_bench_case {
+	const char *group;
+	const char *name;
+	vc_bench_fn run;
+	size_t dst_size;            // Bytes of the output per pixel
+};
+
+struct vc_demosaic_case {
+	const char *name;
+	enum vc_demosaic_method method;
+	enum vc_demosaic_pattern pattern;
+};
+
+struct vc_pack_case {
+	const char *sensor;
+	size_t width;
+	size_t height;
+	unsigned int bits;          // Highest bit depth of the sensor
+};
+
+static __u8 lut[VC_RAW_LUT_SIZE];
+
+// Fills the image with 12 bit samples in the ISI memory layout.
+static void vc_bench_fill(struct vc_bench *bench)
+{
+	size_t n = bench->width * bench->height;
+	__u32 seed = 0x12345678;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		seed = seed * 1664525 + 1013904223;
+		bench->src[i] = ((seed >> 20) & 0xfff) << 2;
+	}
+}
+
+static size_t pixels(struct vc_bench *bench)
+{
+	return bench->width * bench->height;
+}
+
+
+// *** RAW conversion cases ***************************************************
+
+static void raw_to8_shift(struct vc_bench *bench, const struct vc_raw_ops *ops, void *dst)
+{
+	ops->to8_shift(bench->src, dst, pixels(bench), VC_RAW_TO8_SHIFT);
+}
+
+static void raw_to8_lut(struct vc_bench *bench, const struct vc_raw_ops *ops, void *dst)
+{
+	ops->to8_lut(bench->src, dst, pixels(bench), lut);
+}
+
+static void raw_minmax(struct vc_bench *bench, const struct vc_raw_ops *ops, void *dst)
+{
+	__u16 *result = dst;
+
+	ops->minmax(bench->src, pixels(bench), &result[0], &result[1]);
+}
+
+static void raw_histogram(struct vc_bench *bench, const struct vc_raw_ops *ops, void *dst)
+{
+	memset(dst, 0, sizeof(__u32) << 8);
+	ops->histogram(bench->src, pixels(bench), dst, 8);
+}
+
+static void raw_normalize(struct vc_bench *bench, const struct vc_raw_ops *ops, void *dst)
+{
+	ops->shift16(bench->src, dst, pixels(bench), -2);
+}
+
+static void raw_expand(struct vc_bench *bench, const struct vc_raw_ops *ops, void *dst)
+{
+	ops->shift16(bench->src, dst, pixels(bench), 2);
+}
+
+static const struct vc_bench_case cases[] = {
+	{ "raw", "to8_shift", raw_to8_shift, 1 },
+	{ "raw", "to8_lut",   raw_to8_lut,   1 },
+	{ "raw", "minmax",    raw_minmax,    0 },
+	{ "raw", "histogram", raw_histogram, 0 },
+	{ "raw", "normalize", raw_normalize, 2 },
+	{ "raw", "expand",    raw_expand,    2 },
+};
+
+
+// *** Demosaic cases *********************************************************
+
+static const struct vc_demosaic_case demosaic_cases[] = {
+	{ "bilinear_rggb", VC_DEMOSAIC_BILINEAR, VC_BAYER_RGGB },
+	{ "bilinear_gbrg", VC_DEMOSAIC_BILINEAR, VC_BAYER_GBRG },
+	{ "mhc_rggb",      VC_DEMOSAIC_MHC,      VC_BAYER_RGGB },
+	{ "mhc_gbrg",      VC_DEMOSAIC_MHC,      VC_BAYER_GBRG },
+};
+
+
+// *** Compression cases ******************************************************
+
+// Full resolution and highest bit depth of the sensors in vc_mipi_modules.c
+static const struct vc_pack_case pack_cases[] = {
+	{ "imx178", 3104, 2076, 14 },
+	{ "imx183", 5440, 3648, 12 },
+	{ "imx226", 3840, 3046, 12 },
+	{ "imx250", 2448, 2048, 12 },
+	{ "imx252", 2048, 1536, 12 },
+	{ "imx264", 2432, 2048, 12 },
+	{ "imx265", 2048, 1536, 12 },
+	{ "imx273", 1440, 1080, 12 },
+	{ "imx290", 1920, 1080, 12 },
+	{ "imx296", 1440, 1080, 10 },
+	{ "imx327", 1920, 1080, 12 },
+	{ "imx392", 1920, 1200, 12 },
+	{ "imx412", 4056, 3040, 10 },
+	{ "imx415", 3840, 2160, 10 },
+	{ "ov9281", 1280,  800, 10 },
+};
+
+
+// *** Harness ****************************************************************
+
+static size_t output_size(struct vc_bench *bench, const struct vc_bench_case *c)
+{
+	// Cases without an image output write at most one histogram.
+	return c->dst_size ? c->dst_size * pixels(bench) : sizeof(__u32) << 16;
+}
+
+// The ratio column is only filled by the compression cases.
+static void vc_bench_print(struct vc_bench *bench, const char *group, const char *name, const char *variant, __u64 elapsed, int ok, double ratio)
+{
+	size_t bytes = pixels(bench) * sizeof(__u16);
+
+	printf("%s,%s,%s,%zux%zu,%u,%.3f,%.3f,%s,", group, name, variant,
+		bench->width, bench->height, bench->iterations,
+		(double)elapsed / bench->iterations / 1000.0,
+		elapsed ? (double)bytes * bench->iterations / elapsed / 1000.0 : 0.0,
+		ok ? "ok" : "FAIL");
+	if (ratio > 0)
+		printf("%.3f", ratio);
+	printf("\n");
+}
+
+static int vc_bench_verify(struct vc_bench *bench, const struct vc_bench_case *c, const struct vc_raw_ops *ops)
+{
+	size_t size = output_size(bench, c);
+
+	memset(bench->ref, 0, size);
+	memset(bench->dst, 0, size);
+	c->run(bench, &vc_raw_ops_scalar, bench->ref);
+	c->run(bench, ops, bench->dst);
+
+	return memcmp(bench->ref, bench->dst, size) == 0;
+}
+
+static void vc_bench_run(struct vc_bench *bench, const struct vc_bench_case *c, const struct vc_raw_ops *ops)
+{
+	__u64 start, elapsed;
+	unsigned int iteration;
+	int ok;
+
+	ok = vc_bench_verify(bench, c, ops);
+
+	start = vc_v4l2_now_us();
+	for (iteration = 0; iteration < bench->iterations; iteration++)
+		c->run(bench, ops, bench->dst);
+	elapsed = vc_v4l2_now_us() - start;
+
+	vc_bench_print(bench, c->group, c->name, ops->name, elapsed, ok, 0);
+}
+
+// Runs the scalar reference, the vector implementation and the vector
+// implementation split across the threads of the pool.
+static void vc_bench_demosaic(struct vc_bench *bench, const struct vc_demosaic_case *c, struct vc_pool *pool)
+{
+	struct vc_demosaic_params params = {
+		.width = bench->width,
+		.height = bench->height,
+		.pattern = c->pattern,
+		.method = c->method,
+		.output = VC_DEMOSAIC_BGRX,
+		.sample_size = 2,
+		.msb = VC_RAW_MSB_BIT,
+		.src_stride = bench->width * sizeof(__u16),
+		.dst_stride = bench->width * 4,
+	};
+	size_t size = pixels(bench) * 4;
+	struct vc_pool *pools[3] = { NULL, NULL, pool };
+	char variant[32];
+	unsigned int v, iteration;
+	__u64 start, elapsed;
+	int ok;
+
+	params.scalar = 1;
+	vc_demosaic(&params, bench->src, bench->ref, NULL);
+
+	for (v = 0; v < 3; v++) {
+		params.scalar = v == 0;
+		memset(bench->dst, 0, size);
+		vc_demosaic(&params, bench->src, bench->dst, pools[v]);
+		ok = memcmp(bench->ref, bench->dst, size) == 0;
+
+		start = vc_v4l2_now_us();
+		for (iteration = 0; iteration < bench->iterations; iteration++)
+			vc_demosaic(&params, bench->src, bench->dst, pools[v]);
+		elapsed = vc_v4l2_now_us() - start;
+
+		if (v == 2)
+			snprintf(variant, sizeof(variant), "vector_%ut", vc_pool_threads(pool));
+		else
+			snprintf(variant, sizeof(variant), "%s", v == 0 ? "scalar" : "vector");
+		vc_bench_print(bench, "demosaic", c->name, variant, elapsed, ok, 0);
+	}
+}
+
+// Compresses a scene in the resolution and bit depth of the sensor and
+// verifies the decompressed frame. The throughput is related to the 16 bit
+// raw frame, the ratio to the bits per sample of the sensor.
+static void vc_bench_pack(struct vc_bench *bench, const struct vc_pack_case *c, struct vc_pool *pool)
+{
+	struct vc_bench frame = *bench;
+	struct vc_pack_params params = {
+		.width = c->width,
+		.height = c->height,
+		.bits = c->bits,
+		.msb = VC_RAW_MSB_BIT,
+		.bayer = 1,
+		.stride = c->width * sizeof(__u16),
+	};
+	struct vc_pack *pack;
+	__u16 *src, *dst;
+	void *packed;
+	char name[32], variant[32];
+	unsigned int iteration;
+	__u64 start, elapsed;
+	ssize_t size = 0;
+	double ratio;
+	int ok;
+
+	frame.width = c->width;
+	frame.height = c->height;
+	snprintf(name, sizeof(name), "%s_raw%u", c->sensor, c->bits);
+
+	pack = vc_pack_create(&params, pool);
+	src = malloc(pixels(&frame) * sizeof(__u16));
+	dst = malloc(pixels(&frame) * sizeof(__u16));
+	packed = pack ? malloc(vc_pack_bound(pack)) : NULL;
+	if (!pack || !src || !dst || !packed) {
+		fprintf(stderr, "Unable to allocate the buffers of %s\n", name);
+		goto free;
+	}
+	vc_raw_fill_scene(src, c->width, c->height, c->bits);
+
+	memset(dst, 0, pixels(&frame) * sizeof(__u16));
+	size = vc_pack_compress(pack, src, packed);
+	ok = vc_pack_decompress(pack, packed, size, dst) == 0 &&
+		memcmp(src, dst, pixels(&frame) * sizeof(__u16)) == 0;
+	ratio = (double)pixels(&frame) * c->bits / 8 / size;
+
+	start = vc_v4l2_now_us();
+	for (iteration = 0; iteration < bench->iterations; iteration++)
+		vc_pack_compress(pack, src, packed);
+	elapsed = vc_v4l2_now_us() - start;
+	snprintf(variant, sizeof(variant), "compress_%ut", vc_pool_threads(pool));
+	vc_bench_print(&frame, "pack", name, variant, elapsed, ok, ratio);
+
+	start = vc_v4l2_now_us();
+	for (iteration = 0; iteration < bench->iterations; iteration++)
+		vc_pack_decompress(pack, packed, size, dst);
+	elapsed = vc_v4l2_now_us() - start;
+	snprintf(variant, sizeof(variant), "decompress_%ut", vc_pool_threads(pool));
+	vc_bench_print(&frame, "pack", name, variant, elapsed, ok, ratio);
+
+free:
+	free(packed);
+	free(dst);
+	free(src);
+	vc_pack_destroy(pack);
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [options]\n", name);
+	printf("\n");
+	printf("Benchmarks the userspace kernels and prints the results as CSV.\n");
+	printf("\n");
+	printf("Supported options:\n");
+	printf("-f, --filter <group>       Only run the cases of a group (e.g. raw)\n");
+	printf("-h, --height <pixel>       Image height (Default: 3040)\n");
+	printf("-i, --iterations <n>       Iterations per case (Default: 20)\n");
+	printf("-t, --threads <n>          Threads for the multithreaded cases (Default: 0 = all CPUs)\n");
+	printf("-w, --width <pixel>        Image width (Default: 4032)\n");
+	printf("    --help                 Show this help text\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "filter",     required_argument, NULL, 'f' },
+		{ "height",     required_argument, NULL, 'h' },
+		{ "iterations", required_argument, NULL, 'i' },
+		{ "threads",    required_argument, NULL, 't' },
+		{ "width",      required_argument, NULL, 'w' },
+		{ "help",       no_argument,       NULL, 'H' },
+		{ NULL, 0, NULL, 0 }
+	};
+	struct vc_bench bench = {
+		.width = 4032,
+		.height = 3040,
+		.iterations = 20,
+	};
+	const struct vc_raw_ops *ops;
+	struct vc_pool *pool;
+	size_t index, size;
+	int isa, opt;
+
+	while ((opt = getopt_long(argc, argv, "f:h:i:t:w:", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'f': bench.filter = optarg; break;
+		case 'h': bench.height = strtoul(optarg, NULL, 0); break;
+		case 'i': bench.iterations = strtoul(optarg, NULL, 0); break;
+		case 't': bench.threads = strtoul(optarg, NULL, 0); break;
+		case 'w': bench.width = strtoul(optarg, NULL, 0); break;
+		case 'H': usage(argv[0]); return 0;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (bench.iterations == 0)
+		bench.iterations = 1;
+
+	size = pixels(&bench) * 4;
+	if (size < sizeof(__u32) << 16)
+		size = sizeof(__u32) << 16;
+	bench.src = malloc(pixels(&bench) * sizeof(__u16));
+	bench.dst = malloc(size);
+	bench.ref = malloc(size);
+	if (!bench.src || !bench.dst || !bench.ref) {
+		fprintf(stderr, "Unable to allocate the image buffers\n");
+		return 1;
+	}
+	vc_bench_fill(&bench);
+	vc_raw_lut_linear(lut, 0x0400, 0x3c00);
+
+	printf("group,case,variant,size,iterations,ms,GB/s,check,ratio\n");
+	for (index = 0; index < sizeof(cases)/sizeof(cases[0]); index++) {
+		if (bench.filter && strcmp(bench.filter, cases[index].group) != 0)
+			continue;
+		for (isa = 0; isa < VC_RAW_ISA_COUNT; isa++) {
+			ops = vc_raw_get_ops(isa);
+			if (ops)
+				vc_bench_run(&bench, &cases[index], ops);
+		}
+	}
+
+	pool = vc_pool_create(bench.threads);
+	for (index = 0; index < sizeof(demosaic_cases)/sizeof(demosaic_cases[0]); index++) {
+		if (bench.filter && strcmp(bench.filter, "demosaic") != 0)
+			continue;
+		vc_bench_demosaic(&bench, &demosaic_cases[index], pool);
+	}
+	for (index = 0; index < sizeof(pack_cases)/sizeof(pack_cases[0]); index++) {
+		if (bench.filter && strcmp(bench.filter, "pack") != 0)
+			continue;
+		vc_bench_pack(&bench, &pack_cases[index], pool);
+	}
+	vc_pool_destroy(pool);
+
+	free(bench.src);
+	free(bench.dst);
+	free(bench.ref);
+
+	return 0;
+}
@@ -0,0 +1,489 @@
+// vccapture - Zero-copy capture and benchmark tool for VC MIPI cameras
+//
+// The frames are dequeued from driver allocated buffers (MMAP) or from the
+// same buffers exported as dmabuf file descriptors (DMABUF). In null sink mode
+// (default) the pixel data is never touched by the CPU. This measures what the
+// driver and the ISI deliver on their own.
+//
+// In latency mode the camera runs in trigger mode 4 (single). Every frame is
+// requested by the software trigger ioctl of the sub device and the time from
+// the completed trigger to the buffer timestamp is measured.
+//
+// In verify mode every frame is compared with a reference frame by a checksum.
+// With the sensor test pattern generator (-p) the frames are identical, so a
+// mismatch is a corrupted frame.
+
+#include "vc_v4l2.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct vc_stats {
+	__u64 frames;
+	__u64 dropped;
+	__u64 errors;
+	__u64 first_ts;
+	__u64 last_ts;
+	__u32 last_sequence;
+	double interval_sum;
+	double interval_sqsum;
+	__u64 interval_min;
+	__u64 interval_max;
+	__u64 cpu_start;
+	__u64 wall_start;
+};
+
+// Frames skipped before the reference is taken, until the test pattern takes effect
+#define VERIFY_SKIP 3
+
+struct vc_verify {
+	__u64 checked;
+	__u64 corrupted;
+	__u64 reference;
+	size_t bytesused;
+	unsigned int skip;
+};
+
+struct vc_latency {
+	__u64 triggers;
+	__u64 stale;
+	double latency_sum;
+	double latency_sqsum;
+	__s64 latency_min;
+	__s64 latency_max;
+	double write_sum;
+	__u32 write_max;
+};
+
+static volatile sig_atomic_t stop;
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [options]\n", name);
+	printf("\n");
+	printf("Captures frames from a VC MIPI camera and reports the streaming statistics.\n");
+	printf("\n");
+	printf("Supported options:\n");
+	printf("-b, --buffers <n>          Number of V4L2 buffers (Default: 4)\n");
+	printf("-d, --device <dev>         Video device (Default: /dev/video0)\n");
+	printf("-e, --exposure <us>        Set the exposure time in µs\n");
+	printf("-f, --format <fourcc>      Set the pixel format (e.g. GREY, 'Y10 ', RGGB)\n");
+	printf("-g, --gain <value>         Set the gain\n");
+	printf("-h, --height <pixel>       Set the image height\n");
+	printf("-i, --interval <n>         Print the statistics every n frames (Default: 0 = only at the end)\n");
+	printf("-l, --latency              Trigger every frame by software and measure the trigger to buffer latency\n");
+	printf("-m, --io <mode>            Streaming I/O mode: mmap or dmabuf (Default: mmap)\n");
+	printf("-n, --count <n>            Number of frames to capture (Default: 0 = until Ctrl+C)\n");
+	printf("-o, --output <file>        Write the frames to a file. '-' writes to stdout.\n");
+	printf("-p, --pattern <n>          Set the sensor test pattern (Options: see the menu of test_pattern)\n");
+	printf("-r, --framerate <mHz>      Set the frame rate in mHz\n");
+	printf("-s, --subdev <dev>         Sub device for the controls (Default: /dev/v4l-subdev1)\n");
+	printf("-t, --trigger <mode>       Set the trigger mode (Options: 0-7)\n");
+	printf("-v, --verify               Compare every frame with a reference frame by a checksum (needs a static test pattern)\n");
+	printf("-w, --width <pixel>        Set the image width\n");
+	printf("    --help                 Show this help text\n");
+}
+
+static void signal_handler(int signal)
+{
+	(void)signal;
+	stop = 1;
+}
+
+static __u32 parse_fourcc(const char *str)
+{
+	char fourcc[4] = { ' ', ' ', ' ', ' ' };
+	size_t len = strlen(str);
+
+	memcpy(fourcc, str, len > 4 ? 4 : len);
+	return v4l2_fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]);
+}
+
+static void stats_init(struct vc_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->interval_min = UINT64_MAX;
+	stats->cpu_start = vc_v4l2_cpu_us();
+	stats->wall_start = vc_v4l2_now_us();
+}
+
+static void stats_update(struct vc_stats *stats, struct vc_v4l2_frame *frame)
+{
+	__u64 interval;
+
+	if (stats->frames > 0) {
+		// The ISI increments the sequence for every frame received from
+		// the CSI-2 receiver. A gap means that no buffer was available.
+		if (frame->sequence > stats->last_sequence + 1)
+			stats->dropped += frame->sequence - stats->last_sequence - 1;
+
+		interval = frame->timestamp_us - stats->last_ts;
+		stats->interval_sum += interval;
+		stats->interval_sqsum += (double)interval * interval;
+		if (interval < stats->interval_min)
+			stats->interval_min = interval;
+		if (interval > stats->interval_max)
+			stats->interval_max = interval;
+	} else {
+		stats->first_ts = frame->timestamp_us;
+	}
+
+	stats->last_ts = frame->timestamp_us;
+	stats->last_sequence = frame->sequence;
+	stats->frames++;
+}
+
+static void stats_print(struct vc_stats *stats, struct vc_v4l2_dev *dev)
+{
+	__u64 intervals = stats->frames > 1 ? stats->frames - 1 : 0;
+	__u64 cpu_us = vc_v4l2_cpu_us() - stats->cpu_start;
+	__u64 wall_us = vc_v4l2_now_us() - stats->wall_start;
+	double fps = 0, mean = 0, jitter = 0, mbps = 0;
+
+	if (intervals > 0) {
+		mean = stats->interval_sum / intervals;
+		jitter = sqrt(fabs(stats->interval_sqsum / intervals - mean * mean));
+		fps = 1000000.0 / mean;
+		mbps = fps * dev->sizeimage / 1000000.0;
+	}
+
+	fprintf(stderr, "frames: %llu, dropped: %llu, errors: %llu, fps: %.3f, throughput: %.1f MB/s\n",
+		(unsigned long long)stats->frames, (unsigned long long)stats->dropped,
+		(unsigned long long)stats->errors, fps, mbps);
+	fprintf(stderr, "interval: mean %.1f us, jitter %.1f us, min %llu us, max %llu us\n",
+		mean, jitter,
+		(unsigned long long)(intervals ? stats->interval_min : 0),
+		(unsigned long long)stats->interval_max);
+	fprintf(stderr, "cpu: %.1f us/frame, %.1f %% load\n",
+		stats->frames ? (double)cpu_us / stats->frames : 0.0,
+		wall_us ? 100.0 * cpu_us / wall_us : 0.0);
+}
+
+// FNV-1a on 64 bit words. The frame is read once, which costs CPU time for
+// uncached buffers.
+static __u64 frame_checksum(const void *data, size_t size)
+{
+	const __u64 *words = data;
+	const __u8 *bytes = data;
+	size_t count = size / sizeof(__u64);
+	__u64 hash = 0xcbf29ce484222325ULL;
+	size_t index;
+
+	for (index = 0; index < count; index++)
+		hash = (hash ^ words[index]) * 0x100000001b3ULL;
+	for (index = count * sizeof(__u64); index < size; index++)
+		hash = (hash ^ bytes[index]) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+static void verify_init(struct vc_verify *verify)
+{
+	memset(verify, 0, sizeof(*verify));
+	verify->skip = VERIFY_SKIP;
+}
+
+static void verify_update(struct vc_verify *verify, struct vc_v4l2_frame *frame)
+{
+	__u64 checksum;
+
+	if (verify->skip > 0) {
+		verify->skip--;
+		return;
+	}
+
+	checksum = frame_checksum(frame->data, frame->bytesused);
+	if (verify->checked == 0) {
+		verify->reference = checksum;
+		verify->bytesused = frame->bytesused;
+	} else if (checksum != verify->reference || frame->bytesused != verify->bytesused) {
+		verify->corrupted++;
+	}
+	verify->checked++;
+}
+
+static void verify_print(struct vc_verify *verify)
+{
+	fprintf(stderr, "verify: checked %llu, corrupted %llu, reference 0x%016llx\n",
+		(unsigned long long)verify->checked, (unsigned long long)verify->corrupted,
+		(unsigned long long)verify->reference);
+}
+
+static void latency_init(struct vc_latency *latency)
+{
+	memset(latency, 0, sizeof(*latency));
+	latency->latency_min = INT64_MAX;
+}
+
+static void latency_update(struct vc_latency *latency, struct vc_trigger *trigger, struct vc_v4l2_frame *frame)
+{
+	__s64 value = (__s64)frame->timestamp_us - (__s64)(trigger->timestamp / 1000);
+
+	// A frame older than the trigger was not started by it.
+	if (value < 0) {
+		latency->stale++;
+		return;
+	}
+
+	latency->latency_sum += value;
+	latency->latency_sqsum += (double)value * value;
+	if (value < latency->latency_min)
+		latency->latency_min = value;
+	if (value > latency->latency_max)
+		latency->latency_max = value;
+	latency->write_sum += trigger->duration;
+	if (trigger->duration > latency->write_max)
+		latency->write_max = trigger->duration;
+	latency->triggers++;
+}
+
+static void latency_print(struct vc_latency *latency)
+{
+	double mean = 0, jitter = 0, write = 0;
+
+	if (latency->triggers > 0) {
+		mean = latency->latency_sum / latency->triggers;
+		jitter = sqrt(fabs(latency->latency_sqsum / latency->triggers - mean * mean));
+		write = latency->write_sum / latency->triggers / 1000.0;
+	}
+
+	fprintf(stderr, "latency: triggers %llu, stale %llu, mean %.1f us, jitter %.1f us, min %lld us, max %lld us\n",
+		(unsigned long long)latency->triggers, (unsigned long long)latency->stale, mean, jitter,
+		(long long)(latency->triggers ? latency->latency_min : 0), (long long)latency->latency_max);
+	fprintf(stderr, "trigger write: mean %.1f us, max %.1f us\n", write, latency->write_max / 1000.0);
+}
+
+static int write_frame(FILE *file, struct vc_v4l2_frame *frame)
+{
+	if (fwrite(frame->data, 1, frame->bytesused, file) != frame->bytesused) {
+		fprintf(stderr, "%s(): Unable to write frame (%s)\n", __FUNCTION__, strerror(errno));
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int set_ctrls(const char *subdev, long exposure, long gain, long trigger, long framerate, long pattern)
+{
+	int ret = 0;
+	int fd;
+
+	if (exposure < 0 && gain < 0 && trigger < 0 && framerate < 0 && pattern < 0)
+		return 0;
+
+	fd = vc_v4l2_subdev_open(subdev);
+	if (fd < 0)
+		return fd;
+
+	// The trigger mode and the frame rate influence the exposure limits.
+	if (trigger >= 0)
+		ret |= vc_v4l2_set_ctrl(fd, V4L2_CID_TRIGGER_MODE, trigger);
+	if (framerate >= 0)
+		ret |= vc_v4l2_set_ctrl(fd, V4L2_CID_FRAME_RATE, framerate);
+	if (exposure >= 0)
+		ret |= vc_v4l2_set_ctrl(fd, V4L2_CID_EXPOSURE, exposure);
+	if (gain >= 0)
+		ret |= vc_v4l2_set_ctrl(fd, V4L2_CID_GAIN, gain);
+	if (pattern >= 0)
+		ret |= vc_v4l2_set_ctrl(fd, V4L2_CID_TEST_PATTERN, pattern);
+
+	close(fd);
+
+	return ret ? -EINVAL : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "buffers",   required_argument, NULL, 'b' },
+		{ "device",    required_argument, NULL, 'd' },
+		{ "exposure",  required_argument, NULL, 'e' },
+		{ "format",    required_argument, NULL, 'f' },
+		{ "gain",      required_argument, NULL, 'g' },
+		{ "height",    required_argument, NULL, 'h' },
+		{ "interval",  required_argument, NULL, 'i' },
+		{ "latency",   no_argument,       NULL, 'l' },
+		{ "io",        required_argument, NULL, 'm' },
+		{ "count",     required_argument, NULL, 'n' },
+		{ "output",    required_argument, NULL, 'o' },
+		{ "pattern",   required_argument, NULL, 'p' },
+		{ "framerate", required_argument, NULL, 'r' },
+		{ "subdev",    required_argument, NULL, 's' },
+		{ "trigger",   required_argument, NULL, 't' },
+		{ "verify",    no_argument,       NULL, 'v' },
+		{ "width",     required_argument, NULL, 'w' },
+		{ "help",      no_argument,       NULL, 'H' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const char *device = "/dev/video0";
+	const char *subdev = "/dev/v4l-subdev1";
+	const char *output = NULL;
+	enum vc_v4l2_io io = VC_IO_MMAP;
+	unsigned int buffers = 4;
+	unsigned long count = 0;
+	unsigned long interval = 0;
+	int latency_mode = 0;
+	int verify_mode = 0;
+	int trigger_fd = -1;
+	__u32 width = 0, height = 0, pixelformat = 0;
+	long exposure = -1, gain = -1, trigger = -1, framerate = -1, pattern = -1;
+	struct vc_v4l2_dev dev;
+	struct vc_v4l2_frame frame;
+	struct vc_stats stats;
+	struct vc_latency latency;
+	struct vc_verify verify;
+	struct vc_trigger trig;
+	FILE *file = NULL;
+	char fourcc[5];
+	int ret, opt;
+
+	while ((opt = getopt_long(argc, argv, "b:d:e:f:g:h:i:lm:n:o:p:r:s:t:vw:", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'b': buffers = strtoul(optarg, NULL, 0); break;
+		case 'd': device = optarg; break;
+		case 'e': exposure = strtol(optarg, NULL, 0); break;
+		case 'f': pixelformat = parse_fourcc(optarg); break;
+		case 'g': gain = strtol(optarg, NULL, 0); break;
+		case 'h': height = strtoul(optarg, NULL, 0); break;
+		case 'i': interval = strtoul(optarg, NULL, 0); break;
+		case 'l': latency_mode = 1; break;
+		case 'm':
+			if (strcmp(optarg, "mmap") == 0) {
+				io = VC_IO_MMAP;
+			} else if (strcmp(optarg, "dmabuf") == 0) {
+				io = VC_IO_DMABUF;
+			} else {
+				fprintf(stderr, "Unknown I/O mode %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'n': count = strtoul(optarg, NULL, 0); break;
+		case 'o': output = optarg; break;
+		case 'p': pattern = strtol(optarg, NULL, 0); break;
+		case 'r': framerate = strtol(optarg, NULL, 0); break;
+		case 's': subdev = optarg; break;
+		case 't': trigger = strtol(optarg, NULL, 0); break;
+		case 'v': verify_mode = 1; break;
+		case 'w': width = strtoul(optarg, NULL, 0); break;
+		case 'H': usage(argv[0]); return 0;
+		default: usage(argv[0]); return 1;
+		}
+	}
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	if (output) {
+		file = strcmp(output, "-") == 0 ? stdout : fopen(output, "wb");
+		if (file == NULL) {
+			fprintf(stderr, "Unable to open %s (%s)\n", output, strerror(errno));
+			return 1;
+		}
+	}
+
+	ret = vc_v4l2_open(&dev, device);
+	if (ret)
+		return 1;
+
+	if (width || height || pixelformat) {
+		ret = vc_v4l2_set_format(&dev, width, height, pixelformat);
+		if (ret)
+			goto close;
+	}
+
+	if (latency_mode) {
+		if (trigger < 0)
+			trigger = 4;
+		trigger_fd = vc_v4l2_subdev_open(subdev);
+		if (trigger_fd < 0) {
+			ret = trigger_fd;
+			goto close;
+		}
+	}
+
+	ret = set_ctrls(subdev, exposure, gain, trigger, framerate, pattern);
+	if (ret)
+		goto close;
+
+	ret = vc_v4l2_alloc_buffers(&dev, io, buffers);
+	if (ret)
+		goto close;
+
+	fprintf(stderr, "%s: %ux%u %s, bytesperline: %u, sizeimage: %u, buffers: %u (%s)\n",
+		device, dev.width, dev.height, vc_v4l2_fourcc(dev.pixelformat, fourcc),
+		dev.bytesperline, dev.sizeimage, dev.num_buffers, io == VC_IO_DMABUF ? "dmabuf" : "mmap");
+
+	ret = vc_v4l2_start(&dev);
+	if (ret)
+		goto free;
+
+	stats_init(&stats);
+	latency_init(&latency);
+	verify_init(&verify);
+	trig.timestamp = 0;
+	while (!stop && (count == 0 || stats.frames < count)) {
+		if (latency_mode && trig.timestamp == 0) {
+			ret = vc_v4l2_trigger(trigger_fd, &trig);
+			if (ret)
+				break;
+		}
+
+		ret = vc_v4l2_dequeue(&dev, &frame, 5000);
+		if (ret == -EAGAIN || ret == -EINTR)
+			continue;
+		if (ret == -ETIMEDOUT) {
+			fprintf(stderr, "Timeout while waiting for a frame\n");
+			stats.errors++;
+			trig.timestamp = 0;
+			continue;
+		}
+		if (ret)
+			break;
+
+		stats_update(&stats, &frame);
+		if (latency_mode) {
+			latency_update(&latency, &trig, &frame);
+			trig.timestamp = 0;
+		}
+		if (verify_mode)
+			verify_update(&verify, &frame);
+		if (file && write_frame(file, &frame))
+			stop = 1;
+
+		ret = vc_v4l2_queue(&dev, frame.index);
+		if (ret)
+			break;
+
+		if (interval && stats.frames % interval == 0) {
+			stats_print(&stats, &dev);
+			if (latency_mode)
+				latency_print(&latency);
+			if (verify_mode)
+				verify_print(&verify);
+		}
+	}
+
+	vc_v4l2_stop(&dev);
+	stats_print(&stats, &dev);
+	if (latency_mode)
+		latency_print(&latency);
+	if (verify_mode)
+		verify_print(&verify);
+
+free:
+	vc_v4l2_free_buffers(&dev);
+close:
+	if (trigger_fd >= 0)
+		close(trigger_fd);
+	vc_v4l2_close(&dev);
+	if (file && file != stdout)
+		fclose(file);
+
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,247 @@
+#include "vcconfig.h"
+#include "vc_v4l2.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct vc_config_ctrl_desc {
+	const char *key;
+	const char *alias;
+	__u32 id;
+};
+
+// Indexed by enum vc_config_ctrl
+static const struct vc_config_ctrl_desc ctrl_descs[VC_CONFIG_NUM_CTRLS] = {
+	{ "trigger_mode", NULL,      V4L2_CID_TRIGGER_MODE },
+	{ "flash_mode",   "io_mode", V4L2_CID_FLASH_MODE },
+	{ "frame_rate",   NULL,      V4L2_CID_FRAME_RATE },
+	{ "exposure",     "shutter", V4L2_CID_EXPOSURE },
+	{ "gain",         NULL,      V4L2_CID_GAIN },
+	{ "black_level",  NULL,      V4L2_CID_BLACK_LEVEL },
+};
+
+void vc_config_init(struct vc_config *config)
+{
+	memset(config, 0, sizeof(*config));
+	snprintf(config->device, sizeof(config->device), "/dev/video0");
+	snprintf(config->subdev, sizeof(config->subdev), "/dev/v4l-subdev1");
+}
+
+static int vc_config_number(const char *value, __s32 *number)
+{
+	char *end;
+	long n;
+
+	errno = 0;
+	n = strtol(value, &end, 0);
+	if (errno || end == value || *end != '\0')
+		return -EINVAL;
+	*number = n;
+
+	return 0;
+}
+
+int vc_config_set(struct vc_config *config, const char *key, const char *value)
+{
+	char fourcc[4] = { ' ', ' ', ' ', ' ' };
+	unsigned int index;
+	__s32 number;
+
+	if (strcmp(key, "device") == 0) {
+		snprintf(config->device, sizeof(config->device), "%s", value);
+		return 0;
+	}
+	if (strcmp(key, "subdev") == 0) {
+		snprintf(config->subdev, sizeof(config->subdev), "%s", value);
+		return 0;
+	}
+	if (strcmp(key, "format") == 0) {
+		if (strlen(value) == 0 || strlen(value) > 4)
+			return -EINVAL;
+		memcpy(fourcc, value, strlen(value));
+		config->pixelformat = v4l2_fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]);
+		return 0;
+	}
+
+	if (vc_config_number(value, &number))
+		return -EINVAL;
+
+	if (strcmp(key, "width") == 0) {
+		config->width = number;
+	} else if (strcmp(key, "height") == 0) {
+		config->height = number;
+	} else if (strcmp(key, "left") == 0) {
+		config->left = number;
+		config->roi = 1;
+	} else if (strcmp(key, "top") == 0) {
+		config->top = number;
+		config->roi = 1;
+	} else {
+		for (index = 0; index < VC_CONFIG_NUM_CTRLS; index++) {
+			if (strcmp(key, ctrl_descs[index].key) == 0 ||
+			    (ctrl_descs[index].alias && strcmp(key, ctrl_descs[index].alias) == 0))
+				break;
+		}
+		if (index == VC_CONFIG_NUM_CTRLS)
+			return -EINVAL;
+		config->ctrls[index] = number;
+		config->ctrls_set |= 1 << index;
+	}
+
+	return 0;
+}
+
+static char *vc_config_trim(char *str)
+{
+	char *end;
+
+	while (isspace((unsigned char)*str))
+		str++;
+	end = str + strlen(str);
+	while (end > str && isspace((unsigned char)end[-1]))
+		*--end = '\0';
+
+	return str;
+}
+
+int vc_config_parse(struct vc_config *config, const char *setting)
+{
+	char buf[256];
+	char *value;
+
+	snprintf(buf, sizeof(buf), "%s", setting);
+	value = strchr(buf, '=');
+	if (value == NULL)
+		return -EINVAL;
+	*value++ = '\0';
+
+	return vc_config_set(config, vc_config_trim(buf), vc_config_trim(value));
+}
+
+int vc_config_load(struct vc_config *config, const char *name)
+{
+	char line[256];
+	char *setting, *comment;
+	unsigned int number = 0;
+	FILE *file;
+	int ret = 0;
+
+	file = fopen(name, "r");
+	if (file == NULL) {
+		fprintf(stderr, "%s(): Unable to open %s (%s)\n", __FUNCTION__, name, strerror(errno));
+		return -errno;
+	}
+
+	while (fgets(line, sizeof(line), file)) {
+		number++;
+		comment = strchr(line, '#');
+		if (comment)
+			*comment = '\0';
+		setting = vc_config_trim(line);
+		if (*setting == '\0')
+			continue;
+		if (vc_config_parse(config, setting)) {
+			fprintf(stderr, "%s(): Invalid setting in %s line %u: %s\n", __FUNCTION__, name, number, setting);
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	fclose(file);
+	return ret;
+}
+
+void vc_config_print(const struct vc_config *config)
+{
+	unsigned int index;
+	char fourcc[5];
+
+	printf("device = %s\n", config->device);
+	printf("subdev = %s\n", config->subdev);
+	if (config->width)
+		printf("width = %u\n", config->width);
+	if (config->height)
+		printf("height = %u\n", config->height);
+	if (config->pixelformat)
+		printf("format = %s\n", vc_v4l2_fourcc(config->pixelformat, fourcc));
+	if (config->roi)
+		printf("left = %u\ntop = %u\n", config->left, config->top);
+	for (index = 0; index < VC_CONFIG_NUM_CTRLS; index++) {
+		if (config->ctrls_set & (1 << index))
+			printf("%s = %d\n", ctrl_descs[index].key, config->ctrls[index]);
+	}
+}
+
+int vc_config_apply(const struct vc_config *config, struct vc_config_timing *timing)
+{
+	__u32 ids[VC_CONFIG_NUM_CTRLS];
+	__s32 values[VC_CONFIG_NUM_CTRLS];
+	struct vc_v4l2_dev dev;
+	unsigned int index, count = 0, error_idx;
+	__u64 start, now;
+	int subdev = -1;
+	int ret = 0;
+
+	memset(timing, 0, sizeof(*timing));
+	start = vc_v4l2_now_us();
+
+	if (config->width || config->height || config->pixelformat) {
+		if (vc_v4l2_open(&dev, config->device))
+			return -ENODEV;
+		now = vc_v4l2_now_us();
+		timing->open_us += now - start;
+
+		ret = vc_v4l2_set_format(&dev, config->width, config->height, config->pixelformat);
+		vc_v4l2_close(&dev);
+		timing->format_us = vc_v4l2_now_us() - now;
+		if (ret)
+			return ret;
+	}
+
+	if (config->roi || config->ctrls_set) {
+		now = vc_v4l2_now_us();
+		subdev = vc_v4l2_subdev_open(config->subdev);
+		if (subdev < 0)
+			return subdev;
+		timing->open_us += vc_v4l2_now_us() - now;
+	}
+
+	if (config->roi) {
+		now = vc_v4l2_now_us();
+		ret = vc_v4l2_set_crop(subdev, config->left, config->top, config->width, config->height);
+		timing->selection_us = vc_v4l2_now_us() - now;
+		if (ret)
+			goto close;
+	}
+
+	if (config->ctrls_set) {
+		for (index = 0; index < VC_CONFIG_NUM_CTRLS; index++) {
+			if (config->ctrls_set & (1 << index)) {
+				ids[count] = ctrl_descs[index].id;
+				values[count] = config->ctrls[index];
+				count++;
+			}
+		}
+
+		now = vc_v4l2_now_us();
+		ret = vc_v4l2_set_ctrls(subdev, ids, values, count, &error_idx);
+		timing->ctrls_us = vc_v4l2_now_us() - now;
+		if (ret) {
+			fprintf(stderr, "%s(): Unable to set the controls (%s)", __FUNCTION__, strerror(-ret));
+			if (error_idx < count)
+				fprintf(stderr, ", failing control: 0x%08x", ids[error_idx]);
+			fprintf(stderr, "\n");
+		}
+	}
+
+close:
+	if (subdev >= 0)
+		close(subdev);
+	timing->total_us = vc_v4l2_now_us() - start;
+
+	return ret;
+}
@@ -0,0 +1,60 @@
+#ifndef _VC_CONFIG_H
+#define _VC_CONFIG_H
+
+#include <linux/types.h>
+
+// Camera configuration which is applied with a minimum of ioctls:
+//   1. VIDIOC_S_FMT on the video device (size and pixel format)
+//   2. VIDIOC_SUBDEV_S_SELECTION on the sub device (ROI position)
+//   3. VIDIOC_S_EXT_CTRLS on the sub device (all controls in one batch)
+// The driver resets the ROI position when the format is set, so the
+// selection follows the format.
+//
+// Configuration file, one setting per line, # starts a comment:
+//   width = 1920
+//   format = RG12
+//   exposure = 10000
+
+enum vc_config_ctrl {
+	// Order of the controls in the batch. Trigger mode and frame rate
+	// limit the exposure time, so they are set first.
+	VC_CONFIG_TRIGGER_MODE = 0,
+	VC_CONFIG_FLASH_MODE,
+	VC_CONFIG_FRAME_RATE,
+	VC_CONFIG_EXPOSURE,
+	VC_CONFIG_GAIN,
+	VC_CONFIG_BLACK_LEVEL,
+	VC_CONFIG_NUM_CTRLS,
+};
+
+struct vc_config {
+	char device[64];
+	char subdev[64];
+	__u32 width;                    // 0 = unchanged
+	__u32 height;                   // 0 = unchanged
+	__u32 pixelformat;              // 0 = unchanged
+	int roi;                        // ROI position is set
+	__u32 left;
+	__u32 top;
+	unsigned int ctrls_set;         // Bit mask of enum vc_config_ctrl
+	__s32 ctrls[VC_CONFIG_NUM_CTRLS];
+};
+
+struct vc_config_timing {
+	__u64 open_us;
+	__u64 format_us;
+	__u64 selection_us;
+	__u64 ctrls_us;
+	__u64 total_us;
+};
+
+void vc_config_init(struct vc_config *config);
+// Returns -EINVAL for unknown keys or invalid values.
+int vc_config_set(struct vc_config *config, const char *key, const char *value);
+// Accepts "key=value".
+int vc_config_parse(struct vc_config *config, const char *setting);
+int vc_config_load(struct vc_config *config, const char *name);
+void vc_config_print(const struct vc_config *config);
+int vc_config_apply(const struct vc_config *config, struct vc_config_timing *timing);
+
+#endif // _VC_CONFIG_H
@@ -0,0 +1,84 @@
+// vcctl - Applies a complete camera configuration at once
+//
+// Replaces the sequence of v4l2-ctl calls of the startup scripts. The format
+// is set on the video device, then all sub device controls are set with a
+// single VIDIOC_S_EXT_CTRLS call. The time of each step is reported.
+
+#include "vcconfig.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [options] [key=value ...]\n", name);
+	printf("\n");
+	printf("Applies a camera configuration. The settings of the command line override\n");
+	printf("the settings of the configuration file.\n");
+	printf("\n");
+	printf("Supported options:\n");
+	printf("-c, --config <file>        Configuration file\n");
+	printf("-n, --dry-run              Print the configuration without applying it\n");
+	printf("-q, --quiet                Do not print the timing\n");
+	printf("    --help                 Show this help text\n");
+	printf("\n");
+	printf("Settings:\n");
+	printf("  device, subdev           Video device and sub device (Default: /dev/video0, /dev/v4l-subdev1)\n");
+	printf("  width, height, format    Image size and pixel format (fourcc)\n");
+	printf("  left, top                Position of the ROI\n");
+	printf("  trigger_mode, flash_mode (io_mode), frame_rate, exposure (shutter), gain, black_level\n");
+	printf("\n");
+	printf("Example: %s width=1920 height=1080 format=RG12 exposure=10000 gain=10\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "config",  required_argument, NULL, 'c' },
+		{ "dry-run", no_argument,       NULL, 'n' },
+		{ "quiet",   no_argument,       NULL, 'q' },
+		{ "help",    no_argument,       NULL, 'H' },
+		{ NULL, 0, NULL, 0 }
+	};
+	struct vc_config_timing timing;
+	struct vc_config config;
+	int dry_run = 0, quiet = 0;
+	int index, opt, ret;
+
+	vc_config_init(&config);
+
+	while ((opt = getopt_long(argc, argv, "c:nq", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'c':
+			if (vc_config_load(&config, optarg))
+				return 1;
+			break;
+		case 'n': dry_run = 1; break;
+		case 'q': quiet = 1; break;
+		case 'H': usage(argv[0]); return 0;
+		default: usage(argv[0]); return 1;
+		}
+	}
+
+	for (index = optind; index < argc; index++) {
+		if (vc_config_parse(&config, argv[index])) {
+			fprintf(stderr, "Invalid setting: %s\n", argv[index]);
+			return 1;
+		}
+	}
+
+	if (dry_run) {
+		vc_config_print(&config);
+		return 0;
+	}
+
+	ret = vc_config_apply(&config, &timing);
+	if (ret == 0 && !quiet)
+		printf("applied in %.3f ms (open: %.3f ms, format: %.3f ms, selection: %.3f ms, controls: %.3f ms)\n",
+			timing.total_us / 1000.0, timing.open_us / 1000.0, timing.format_us / 1000.0,
+			timing.selection_us / 1000.0, timing.ctrls_us / 1000.0);
+
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,363 @@
+#include "vcdemosaic.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The kernels are written with GCC vector extensions. The compiler maps them
+// to NEON on aarch64 and to SSE/AVX on x86. The same formulas are
+// instantiated for plain integers as scalar reference.
+
+#define VC_VEC          4               // One 128 bit NEON/SSE register of 32 bit lanes
+#define VC_BAND_HEIGHT  32
+
+typedef __s32 vc_vec __attribute__((vector_size(VC_VEC * sizeof(__s32))));
+
+// The 13 taps of the 5x5 neighbourhood used by the kernels.
+#define VC_TAPS(T) struct { T c, n, s, w, e, n2, s2, w2, e2, nw, ne, sw, se; }
+
+typedef VC_TAPS(__s32) vc_taps_s32;
+typedef VC_TAPS(vc_vec) vc_taps_vec;
+
+enum vc_site {
+	VC_SITE_R = 0,          // Red pixel
+	VC_SITE_GR,             // Green pixel in a red line
+	VC_SITE_GB,             // Green pixel in a blue line
+	VC_SITE_B,              // Blue pixel
+};
+
+struct vc_demosaic_job {
+	const struct vc_demosaic_params *params;
+	const __u8 *src;
+	__u8 *dst;
+	unsigned int band_height;
+};
+
+// --- Kernels ------------------------------------------------------------------
+// All weights are scaled by 16. Bilinear averages the nearest neighbours of
+// the same color. Malvar-He-Cutler adds a gradient correction from the center
+// pixel (IEEE ICASSP 2004).
+
+#define VC_KERNEL(T, TAPS, name)                                                        \
+static inline void name(const TAPS *t, enum vc_site site, int mhc, T *r, T *g, T *b)    \
+{                                                                                       \
+	T cross1 = t->n + t->s + t->w + t->e;                                           \
+	T diag = t->nw + t->ne + t->sw + t->se;                                         \
+	T c16 = t->c * 16;                                                              \
+	T at_rb, at_diag, row, col;                                                     \
+                                                                                        \
+	if (mhc) {                                                                      \
+		T hor2 = t->w2 + t->e2;                                                 \
+		T ver2 = t->n2 + t->s2;                                                 \
+		at_rb = t->c * 8 + cross1 * 4 - (hor2 + ver2) * 2;                      \
+		at_diag = t->c * 12 + diag * 4 - (hor2 + ver2) * 3;                     \
+		row = t->c * 10 + (t->w + t->e) * 8 - hor2 * 2 - diag * 2 + ver2;       \
+		col = t->c * 10 + (t->n + t->s) * 8 - ver2 * 2 - diag * 2 + hor2;       \
+	} else {                                                                        \
+		at_rb = cross1 * 4;                                                     \
+		at_diag = diag * 4;                                                     \
+		row = (t->w + t->e) * 8;                                                \
+		col = (t->n + t->s) * 8;                                                \
+	}                                                                               \
+                                                                                        \
+	switch (site) {                                                                 \
+	case VC_SITE_R:  *r = c16;     *g = at_rb; *b = at_diag; break;                 \
+	case VC_SITE_GR: *r = row;     *g = c16;   *b = col;     break;                 \
+	case VC_SITE_GB: *r = col;     *g = c16;   *b = row;     break;                 \
+	case VC_SITE_B:  *r = at_diag; *g = at_rb; *b = c16;     break;                 \
+	}                                                                               \
+}
+
+VC_KERNEL(__s32, vc_taps_s32, vc_kernel_s32)
+VC_KERNEL(vc_vec, vc_taps_vec, vc_kernel_vec)
+
+// Rounds, clamps to the sample range and reduces to 8 bit.
+static inline __s32 vc_to8_s32(__s32 value, __s32 max, int shift)
+{
+	value = (value + 8) >> 4;
+	if (value < 0)
+		value = 0;
+	if (value > max)
+		value = max;
+	return value >> shift;
+}
+
+static inline vc_vec vc_to8_vec(vc_vec value, __s32 max, int shift)
+{
+	vc_vec mask;
+
+	value = (value + 8) >> 4;
+	mask = value < 0;
+	value &= ~mask;
+	mask = value > max;
+	value = (value & ~mask) | (max & mask);
+	return value >> shift;
+}
+
+static inline int vc_reflect(int i, int n)
+{
+	if (i < 0)
+		return -i;
+	if (i >= n)
+		return 2 * n - 2 - i;
+	return i;
+}
+
+static inline __s32 vc_sample(const struct vc_demosaic_params *params, const __u8 *line, int x)
+{
+	x = vc_reflect(x, params->width);
+	if (params->sample_size == 1)
+		return line[x];
+	return ((const __u16 *)line)[x];
+}
+
+static inline enum vc_site vc_site(const struct vc_demosaic_params *params, unsigned int y, unsigned int x)
+{
+	unsigned int flip = params->pattern == VC_BAYER_GBRG;
+	return (((y ^ flip) & 1) << 1) | (x & 1);
+}
+
+static inline void vc_store(const struct vc_demosaic_params *params, __u8 *dst, unsigned int x, __s32 r, __s32 g, __s32 b)
+{
+	if (params->output == VC_DEMOSAIC_BGRX) {
+		dst += x * 4;
+		dst[0] = b; dst[1] = g; dst[2] = r; dst[3] = 0xff;
+	} else {
+		dst += x * 3;
+		dst[0] = r; dst[1] = g; dst[2] = b;
+	}
+}
+
+
+// *** Scalar reference *******************************************************
+
+static void vc_demosaic_band_scalar(struct vc_demosaic_job *job, unsigned int y0, unsigned int y1)
+{
+	const struct vc_demosaic_params *params = job->params;
+	const int mhc = params->method == VC_DEMOSAIC_MHC;
+	const __s32 max = (1 << (params->msb + 1)) - 1;
+	const int shift = params->msb - 7;
+	const __u8 *line[5];
+	vc_taps_s32 t;
+	__s32 r, g, b;
+	unsigned int y;
+	int x, d;
+
+	for (y = y0; y < y1; y++) {
+		__u8 *dst = job->dst + y * params->dst_stride;
+
+		for (d = 0; d < 5; d++)
+			line[d] = job->src + vc_reflect((int)y + d - 2, params->height) * params->src_stride;
+
+		for (x = 0; x < (int)params->width; x++) {
+			t.c  = vc_sample(params, line[2], x);
+			t.n  = vc_sample(params, line[1], x);
+			t.s  = vc_sample(params, line[3], x);
+			t.w  = vc_sample(params, line[2], x - 1);
+			t.e  = vc_sample(params, line[2], x + 1);
+			t.n2 = vc_sample(params, line[0], x);
+			t.s2 = vc_sample(params, line[4], x);
+			t.w2 = vc_sample(params, line[2], x - 2);
+			t.e2 = vc_sample(params, line[2], x + 2);
+			t.nw = vc_sample(params, line[1], x - 1);
+			t.ne = vc_sample(params, line[1], x + 1);
+			t.sw = vc_sample(params, line[3], x - 1);
+			t.se = vc_sample(params, line[3], x + 1);
+
+			vc_kernel_s32(&t, vc_site(params, y, x), mhc, &r, &g, &b);
+			vc_store(params, dst, x, vc_to8_s32(r, max, shift),
+				vc_to8_s32(g, max, shift), vc_to8_s32(b, max, shift));
+		}
+	}
+}
+
+
+// *** Vector implementation **************************************************
+
+// A line is split into its even and odd columns. Both halves get one
+// reflected column on each side and padding for the last vector.
+struct vc_line {
+	__s32 *even;
+	__s32 *odd;
+};
+
+static inline vc_vec vc_load(const __s32 *p)
+{
+	vc_vec v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static void vc_split_line(const struct vc_demosaic_params *params, const __u8 *src, struct vc_line *line)
+{
+	unsigned int half = params->width / 2;
+	unsigned int k;
+
+	if (params->sample_size == 1) {
+		for (k = 0; k < half; k++) {
+			line->even[k] = src[2 * k];
+			line->odd[k] = src[2 * k + 1];
+		}
+	} else {
+		const __u16 *src16 = (const __u16 *)src;
+		for (k = 0; k < half; k++) {
+			line->even[k] = src16[2 * k];
+			line->odd[k] = src16[2 * k + 1];
+		}
+	}
+
+	// x = -2 -> 2, x = -1 -> 1, x = width -> width - 2, x = width + 1 -> width - 3
+	line->even[-1] = line->even[1];
+	line->odd[-1] = line->odd[0];
+	line->even[half] = line->even[half - 1];
+	line->odd[half] = line->odd[half - 2];
+}
+
+static void vc_demosaic_band_vec(struct vc_demosaic_job *job, unsigned int y0, unsigned int y1)
+{
+	const struct vc_demosaic_params *params = job->params;
+	const int mhc = params->method == VC_DEMOSAIC_MHC;
+	const __s32 max = (1 << (params->msb + 1)) - 1;
+	const int shift = params->msb - 7;
+	const unsigned int half = params->width / 2;
+	const size_t length = ((half + 2 + VC_VEC) / VC_VEC + 1) * VC_VEC;
+	struct vc_line lines[5], tmp;
+	__s32 out[6][VC_VEC];
+	__s32 *memory;
+	vc_taps_vec te, to;
+	vc_vec r, g, b, r2, g2, b2;
+	unsigned int y, k, i;
+	int d;
+
+	memory = calloc(10 * length, sizeof(__s32));
+	if (memory == NULL) {
+		vc_demosaic_band_scalar(job, y0, y1);
+		return;
+	}
+	for (d = 0; d < 5; d++) {
+		lines[d].even = memory + (2 * d) * length + 1;
+		lines[d].odd = memory + (2 * d + 1) * length + 1;
+	}
+
+	for (d = 0; d < 4; d++)
+		vc_split_line(params, job->src + vc_reflect((int)y0 + d - 2, params->height) * params->src_stride, &lines[d + 1]);
+
+	for (y = y0; y < y1; y++) {
+		__u8 *dst = job->dst + y * params->dst_stride;
+		enum vc_site site = vc_site(params, y, 0);
+
+		// Rotate the window by one line and load the new bottom line.
+		tmp = lines[0];
+		for (d = 0; d < 4; d++)
+			lines[d] = lines[d + 1];
+		lines[4] = tmp;
+		vc_split_line(params, job->src + vc_reflect((int)y + 2, params->height) * params->src_stride, &lines[4]);
+
+		for (k = 0; k < half; k += VC_VEC) {
+			// Even columns
+			te.c  = vc_load(lines[2].even + k);
+			te.w  = vc_load(lines[2].odd + k - 1);
+			te.e  = vc_load(lines[2].odd + k);
+			te.w2 = vc_load(lines[2].even + k - 1);
+			te.e2 = vc_load(lines[2].even + k + 1);
+			te.n  = vc_load(lines[1].even + k);
+			te.s  = vc_load(lines[3].even + k);
+			te.n2 = vc_load(lines[0].even + k);
+			te.s2 = vc_load(lines[4].even + k);
+			te.nw = vc_load(lines[1].odd + k - 1);
+			te.ne = vc_load(lines[1].odd + k);
+			te.sw = vc_load(lines[3].odd + k - 1);
+			te.se = vc_load(lines[3].odd + k);
+
+			// Odd columns
+			to.c  = te.e;
+			to.w  = te.c;
+			to.e  = te.e2;
+			to.w2 = te.w;
+			to.e2 = vc_load(lines[2].odd + k + 1);
+			to.n  = te.ne;
+			to.s  = te.se;
+			to.n2 = vc_load(lines[0].odd + k);
+			to.s2 = vc_load(lines[4].odd + k);
+			to.nw = te.n;
+			to.ne = vc_load(lines[1].even + k + 1);
+			to.sw = te.s;
+			to.se = vc_load(lines[3].even + k + 1);
+
+			vc_kernel_vec(&te, site, mhc, &r, &g, &b);
+			r = vc_to8_vec(r, max, shift);
+			g = vc_to8_vec(g, max, shift);
+			b = vc_to8_vec(b, max, shift);
+			vc_kernel_vec(&to, site + 1, mhc, &r2, &g2, &b2);
+			r2 = vc_to8_vec(r2, max, shift);
+			g2 = vc_to8_vec(g2, max, shift);
+			b2 = vc_to8_vec(b2, max, shift);
+
+			if (params->output == VC_DEMOSAIC_BGRX && k + VC_VEC <= half) {
+				// Pack to BGRx words and interleave even and odd columns.
+				vc_vec even = b | (g << 8) | (r << 16) | (__s32)0xff000000;
+				vc_vec odd = b2 | (g2 << 8) | (r2 << 16) | (__s32)0xff000000;
+				vc_vec lo = __builtin_shuffle(even, odd, (vc_vec){ 0, 4, 1, 5 });
+				vc_vec hi = __builtin_shuffle(even, odd, (vc_vec){ 2, 6, 3, 7 });
+				memcpy(dst + 8 * k, &lo, sizeof(lo));
+				memcpy(dst + 8 * k + sizeof(lo), &hi, sizeof(hi));
+				continue;
+			}
+
+			memcpy(out[0], &r, sizeof(r));
+			memcpy(out[1], &g, sizeof(g));
+			memcpy(out[2], &b, sizeof(b));
+			memcpy(out[3], &r2, sizeof(r2));
+			memcpy(out[4], &g2, sizeof(g2));
+			memcpy(out[5], &b2, sizeof(b2));
+			for (i = 0; i < VC_VEC && k + i < half; i++) {
+				vc_store(params, dst, 2 * (k + i), out[0][i], out[1][i], out[2][i]);
+				vc_store(params, dst, 2 * (k + i) + 1, out[3][i], out[4][i], out[5][i]);
+			}
+		}
+	}
+
+	free(memory);
+}
+
+
+// *** Frame processing *******************************************************
+
+static void vc_demosaic_band(void *arg, unsigned int index)
+{
+	struct vc_demosaic_job *job = arg;
+	unsigned int y0 = index * job->band_height;
+	unsigned int y1 = y0 + job->band_height;
+
+	if (y1 > job->params->height)
+		y1 = job->params->height;
+
+	if (job->params->scalar)
+		vc_demosaic_band_scalar(job, y0, y1);
+	else
+		vc_demosaic_band_vec(job, y0, y1);
+}
+
+int vc_demosaic(const struct vc_demosaic_params *params, const void *src, __u8 *dst, struct vc_pool *pool)
+{
+	struct vc_demosaic_job job;
+	unsigned int bands;
+
+	if (params->width < 4 || params->width & 1 || params->height < 3)
+		return -EINVAL;
+	if (params->sample_size != 1 && params->sample_size != 2)
+		return -EINVAL;
+	if (params->msb < 7 || params->msb >= 8 * params->sample_size)
+		return -EINVAL;
+
+	job.params = params;
+	job.src = src;
+	job.dst = dst;
+	job.band_height = params->band_height ? params->band_height : VC_BAND_HEIGHT;
+	bands = (params->height + job.band_height - 1) / job.band_height;
+
+	vc_pool_run(pool, bands, vc_demosaic_band, &job);
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef _VC_DEMOSAIC_H
+#define _VC_DEMOSAIC_H
+
+#include <stddef.h>
+#include <linux/types.h>
+
+#include "vcpool.h"
+
+// Demosaic for the Bayer formats of the color modules. The driver selects
+// RGGB or GBRG (FLAG_FORMAT_GBRG) depending on the module.
+
+enum vc_demosaic_pattern {
+	VC_BAYER_RGGB = 0,
+	VC_BAYER_GBRG,
+};
+
+enum vc_demosaic_method {
+	VC_DEMOSAIC_BILINEAR = 0,
+	VC_DEMOSAIC_MHC,                // Malvar-He-Cutler, gradient corrected 5x5
+};
+
+enum vc_demosaic_output {
+	VC_DEMOSAIC_RGB = 0,            // 3 bytes per pixel
+	VC_DEMOSAIC_BGRX,               // 4 bytes per pixel
+};
+
+struct vc_demosaic_params {
+	unsigned int width;             // Must be even and >= 4
+	unsigned int height;            // Must be >= 3
+	enum vc_demosaic_pattern pattern;
+	enum vc_demosaic_method method;
+	enum vc_demosaic_output output;
+	unsigned int sample_size;       // Bytes per input sample (1 or 2)
+	unsigned int msb;               // Position of the sample MSB (13 for the ISI, 7 for 8 bit)
+	size_t src_stride;              // Bytes per input line
+	size_t dst_stride;              // Bytes per output line
+	unsigned int band_height;       // Lines per work item (0 = default)
+	int scalar;                     // Use the scalar reference implementation
+};
+
+// Demosaics one frame into 8 bit RGB or BGRx. If a pool is given, the frame
+// is split into bands of lines which are processed by the pool threads.
+int vc_demosaic(const struct vc_demosaic_params *params, const void *src, __u8 *dst, struct vc_pool *pool);
+
+#endif // _VC_DEMOSAIC_H
@@ -0,0 +1,454 @@
+#include "vcpack.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Quotients from VC_PACK_ESCAPE on are coded as escape code followed by the
+// residual in VC_PACK_ESCAPE_BITS bits. This limits a sample to 41 bits.
+#define VC_PACK_ESCAPE          24
+#define VC_PACK_ESCAPE_BITS     16
+#define VC_PACK_K_BITS          4
+
+struct vc_pack_stripe {
+	__u32 *data;
+	size_t size;                    // Bytes
+	__u16 *residuals;               // One line
+	int error;
+};
+
+struct vc_pack {
+	struct vc_pack_params params;
+	struct vc_pool *pool;
+	unsigned int shift;             // Padding LSBs
+	unsigned int dx;                // Distance to the left neighbour of the same color
+	unsigned int dy;                // Distance to the upper neighbour of the same color
+	unsigned int num_stripes;
+	size_t stripe_capacity;         // Bytes
+	struct vc_pack_stripe *stripes;
+
+	// Arguments of the current job
+	const __u8 *src;
+	__u8 *dst;
+	const __u8 *packed;
+	const __u32 *stripe_sizes;
+};
+
+// --- Bit I/O ------------------------------------------------------------------
+// The bits are written LSB first into 32 bit little endian words.
+
+struct vc_bit_writer {
+	__u64 acc;
+	unsigned int count;
+	__u32 *out;
+};
+
+struct vc_bit_reader {
+	__u64 acc;
+	unsigned int count;
+	const __u32 *in;
+	const __u32 *end;
+};
+
+// len must be <= 32.
+static inline void vc_bits_put(struct vc_bit_writer *w, __u32 value, unsigned int len)
+{
+	w->acc |= (__u64)value << w->count;
+	w->count += len;
+	if (w->count >= 32) {
+		*w->out++ = (__u32)w->acc;
+		w->acc >>= 32;
+		w->count -= 32;
+	}
+}
+
+static inline void vc_bits_flush(struct vc_bit_writer *w)
+{
+	if (w->count > 0)
+		*w->out++ = (__u32)w->acc;
+	w->acc = 0;
+	w->count = 0;
+}
+
+// Ensures at least 32 bits in the accumulator.
+static inline void vc_bits_refill(struct vc_bit_reader *r)
+{
+	if (r->count <= 32) {
+		r->acc |= (__u64)(r->in < r->end ? *r->in++ : 0) << r->count;
+		r->count += 32;
+	}
+}
+
+// len must be <= 32 and the reader refilled.
+static inline __u32 vc_bits_get(struct vc_bit_reader *r, unsigned int len)
+{
+	__u32 value = r->acc & ((1ULL << len) - 1);
+
+	r->acc >>= len;
+	r->count -= len;
+	return value;
+}
+
+// Returns the number of zeros before the next one or -1 for a corrupt stream.
+static inline int vc_bits_unary(struct vc_bit_reader *r)
+{
+	int zeros;
+
+	vc_bits_refill(r);
+	if ((__u32)r->acc == 0)
+		return -1;
+	zeros = __builtin_ctz((__u32)r->acc);
+	r->acc >>= zeros + 1;
+	r->count -= zeros + 1;
+	return zeros;
+}
+
+// --- Prediction -----------------------------------------------------------------
+
+static inline __s32 vc_med(__s32 a, __s32 b, __s32 c)
+{
+	__s32 mx = a > b ? a : b;
+	__s32 mn = a > b ? b : a;
+
+	return c >= mx ? mn : c <= mn ? mx : a + b - c;
+}
+
+static inline __u16 vc_zigzag(__s32 e)
+{
+	return (e << 1) ^ (e >> 31);
+}
+
+static inline __s32 vc_unzigzag(__u32 u)
+{
+	return (__s32)(u >> 1) ^ -(__s32)(u & 1);
+}
+
+// Computes the residuals of one line. up is NULL in the first line(s) of a
+// stripe. The main loop has no dependencies between the samples and is
+// vectorized by the compiler.
+static void vc_pack_residuals(const struct vc_pack *pack, const __u16 *cur, const __u16 *up, __u16 *res)
+{
+	unsigned int width = pack->params.width;
+	unsigned int shift = pack->shift;
+	unsigned int dx = pack->dx;
+	unsigned int x;
+
+	if (up == NULL) {
+		for (x = 0; x < dx && x < width; x++)
+			res[x] = vc_zigzag((cur[x] >> shift) - (1 << (pack->params.bits - 1)));
+		for (; x < width; x++)
+			res[x] = vc_zigzag((cur[x] >> shift) - (cur[x - dx] >> shift));
+		return;
+	}
+
+	for (x = 0; x < dx && x < width; x++)
+		res[x] = vc_zigzag((cur[x] >> shift) - (up[x] >> shift));
+	for (; x < width; x++) {
+		__s32 a = cur[x - dx] >> shift;
+		__s32 b = up[x] >> shift;
+		__s32 c = up[x - dx] >> shift;
+		res[x] = vc_zigzag((__s32)(cur[x] >> shift) - vc_med(a, b, c));
+	}
+}
+
+// The inverse of vc_pack_residuals(). Each sample depends on its left
+// neighbour, so this loop stays scalar.
+static void vc_pack_reconstruct(const struct vc_pack *pack, __u16 *cur, const __u16 *up, const __u16 *res)
+{
+	unsigned int width = pack->params.width;
+	unsigned int shift = pack->shift;
+	unsigned int dx = pack->dx;
+	unsigned int x;
+	__s32 pred;
+
+	for (x = 0; x < width; x++) {
+		if (up == NULL)
+			pred = x < dx ? 1 << (pack->params.bits - 1) : cur[x - dx] >> shift;
+		else if (x < dx)
+			pred = up[x] >> shift;
+		else
+			pred = vc_med(cur[x - dx] >> shift, up[x] >> shift, up[x - dx] >> shift);
+		cur[x] = (__u16)((pred + vc_unzigzag(res[x])) << shift);
+	}
+}
+
+// --- Rice coding ----------------------------------------------------------------
+
+static void vc_pack_encode_line(struct vc_bit_writer *w, const __u16 *res, unsigned int width)
+{
+	unsigned int x, i, n, k;
+	__u32 sum, mean, u, q;
+
+	for (x = 0; x < width; x += VC_PACK_BLOCK) {
+		n = width - x < VC_PACK_BLOCK ? width - x : VC_PACK_BLOCK;
+
+		sum = 0;
+		for (i = 0; i < n; i++)
+			sum += res[x + i];
+		mean = sum / n;
+		k = mean ? 31 - __builtin_clz(mean) : 0;
+		if (k > 15)
+			k = 15;
+		vc_bits_put(w, k, VC_PACK_K_BITS);
+
+		for (i = 0; i < n; i++) {
+			u = res[x + i];
+			q = u >> k;
+			if (q < VC_PACK_ESCAPE && q + 1 + k <= 32) {
+				vc_bits_put(w, (1 << q) | ((u & ((1 << k) - 1)) << (q + 1)), q + 1 + k);
+			} else if (q < VC_PACK_ESCAPE) {
+				vc_bits_put(w, 1 << q, q + 1);
+				vc_bits_put(w, u & ((1 << k) - 1), k);
+			} else {
+				vc_bits_put(w, 1 << VC_PACK_ESCAPE, VC_PACK_ESCAPE + 1);
+				vc_bits_put(w, u, VC_PACK_ESCAPE_BITS);
+			}
+		}
+	}
+}
+
+static int vc_pack_decode_line(struct vc_bit_reader *r, __u16 *res, unsigned int width)
+{
+	unsigned int x, i, n, k;
+	int q;
+
+	for (x = 0; x < width; x += VC_PACK_BLOCK) {
+		n = width - x < VC_PACK_BLOCK ? width - x : VC_PACK_BLOCK;
+
+		vc_bits_refill(r);
+		k = vc_bits_get(r, VC_PACK_K_BITS);
+
+		for (i = 0; i < n; i++) {
+			q = vc_bits_unary(r);
+			if (q < 0)
+				return -EINVAL;
+			vc_bits_refill(r);
+			if (q == VC_PACK_ESCAPE)
+				res[x + i] = vc_bits_get(r, VC_PACK_ESCAPE_BITS);
+			else
+				res[x + i] = (q << k) | (k ? vc_bits_get(r, k) : 0);
+		}
+	}
+
+	return 0;
+}
+
+// --- Stripes --------------------------------------------------------------------
+
+static void vc_pack_stripe_lines(const struct vc_pack *pack, unsigned int index, unsigned int *y0, unsigned int *y1)
+{
+	*y0 = index * pack->params.stripe_height;
+	*y1 = *y0 + pack->params.stripe_height;
+	if (*y1 > pack->params.height)
+		*y1 = pack->params.height;
+}
+
+static void vc_pack_compress_stripe(void *arg, unsigned int index)
+{
+	struct vc_pack *pack = arg;
+	struct vc_pack_stripe *stripe = &pack->stripes[index];
+	struct vc_bit_writer w = { 0, 0, stripe->data };
+	size_t stride = pack->params.stride;
+	const __u16 *cur, *up;
+	unsigned int y, y0, y1;
+
+	vc_pack_stripe_lines(pack, index, &y0, &y1);
+	for (y = y0; y < y1; y++) {
+		cur = (const __u16 *)(pack->src + y * stride);
+		up = y - y0 >= pack->dy ? (const __u16 *)(pack->src + (y - pack->dy) * stride) : NULL;
+		vc_pack_residuals(pack, cur, up, stripe->residuals);
+		vc_pack_encode_line(&w, stripe->residuals, pack->params.width);
+	}
+	vc_bits_flush(&w);
+
+	stripe->size = (w.out - stripe->data) * sizeof(__u32);
+}
+
+static void vc_pack_decompress_stripe(void *arg, unsigned int index)
+{
+	struct vc_pack *pack = arg;
+	struct vc_pack_stripe *stripe = &pack->stripes[index];
+	struct vc_bit_reader r;
+	size_t stride = pack->params.stride;
+	const __u8 *data = pack->packed;
+	unsigned int i, y, y0, y1;
+	__u16 *cur, *up;
+
+	// The stripe offsets are the sums of the previous stripe sizes.
+	for (i = 0; i < index; i++)
+		data += pack->stripe_sizes[i];
+	r.acc = 0;
+	r.count = 0;
+	r.in = (const __u32 *)data;
+	r.end = (const __u32 *)(data + pack->stripe_sizes[index]);
+
+	stripe->error = 0;
+	vc_pack_stripe_lines(pack, index, &y0, &y1);
+	for (y = y0; y < y1; y++) {
+		cur = (__u16 *)(pack->dst + y * stride);
+		up = y - y0 >= pack->dy ? (__u16 *)(pack->dst + (y - pack->dy) * stride) : NULL;
+		if (vc_pack_decode_line(&r, stripe->residuals, pack->params.width)) {
+			stripe->error = -EINVAL;
+			return;
+		}
+		vc_pack_reconstruct(pack, cur, up, stripe->residuals);
+	}
+}
+
+// --- API ------------------------------------------------------------------------
+
+struct vc_pack *vc_pack_create(const struct vc_pack_params *params, struct vc_pool *pool)
+{
+	struct vc_pack *pack;
+	unsigned int index;
+	size_t bits;
+
+	if (params->width == 0 || params->height == 0)
+		return NULL;
+	if (params->bits < 8 || params->bits > 14 || params->msb > 15 || params->msb + 1 < params->bits)
+		return NULL;
+	if (params->stride < params->width * sizeof(__u16))
+		return NULL;
+
+	pack = calloc(1, sizeof(*pack));
+	if (pack == NULL)
+		return NULL;
+
+	pack->params = *params;
+	pack->pool = pool;
+	pack->shift = params->msb + 1 - params->bits;
+	pack->dx = params->bayer ? 2 : 1;
+	pack->dy = params->bayer ? 2 : 1;
+	if (pack->params.stripe_height == 0)
+		pack->params.stripe_height = VC_PACK_STRIPE_HEIGHT;
+	// Keep the Bayer phase of every stripe.
+	pack->params.stripe_height = (pack->params.stripe_height + pack->dy - 1) / pack->dy * pack->dy;
+	pack->num_stripes = (params->height + pack->params.stripe_height - 1) / pack->params.stripe_height;
+
+	bits = (size_t)pack->params.stripe_height * params->width * (VC_PACK_ESCAPE + 1 + VC_PACK_ESCAPE_BITS) +
+		(size_t)pack->params.stripe_height * (params->width / VC_PACK_BLOCK + 1) * VC_PACK_K_BITS;
+	pack->stripe_capacity = (bits / 32 + 2) * sizeof(__u32);
+
+	pack->stripes = calloc(pack->num_stripes, sizeof(*pack->stripes));
+	if (pack->stripes == NULL)
+		goto error;
+	for (index = 0; index < pack->num_stripes; index++) {
+		pack->stripes[index].data = malloc(pack->stripe_capacity);
+		pack->stripes[index].residuals = malloc(params->width * sizeof(__u16));
+		if (!pack->stripes[index].data || !pack->stripes[index].residuals)
+			goto error;
+	}
+
+	return pack;
+
+error:
+	vc_pack_destroy(pack);
+	return NULL;
+}
+
+void vc_pack_destroy(struct vc_pack *pack)
+{
+	unsigned int index;
+
+	if (pack == NULL)
+		return;
+
+	if (pack->stripes) {
+		for (index = 0; index < pack->num_stripes; index++) {
+			free(pack->stripes[index].data);
+			free(pack->stripes[index].residuals);
+		}
+		free(pack->stripes);
+	}
+	free(pack);
+}
+
+size_t vc_pack_bound(struct vc_pack *pack)
+{
+	return sizeof(struct vc_pack_header) + pack->num_stripes * (sizeof(__u32) + pack->stripe_capacity);
+}
+
+ssize_t vc_pack_compress(struct vc_pack *pack, const void *src, void *dst)
+{
+	struct vc_pack_header *header = dst;
+	__u32 *sizes = (__u32 *)(header + 1);
+	__u8 *data = (__u8 *)(sizes + pack->num_stripes);
+	unsigned int index;
+
+	pack->src = src;
+	vc_pool_run(pack->pool, pack->num_stripes, vc_pack_compress_stripe, pack);
+
+	header->magic = VC_PACK_MAGIC;
+	header->version = VC_PACK_VERSION;
+	header->flags = pack->params.bayer ? VC_PACK_FLAG_BAYER : 0;
+	header->width = pack->params.width;
+	header->height = pack->params.height;
+	header->bits = pack->params.bits;
+	header->msb = pack->params.msb;
+	header->stripe_height = pack->params.stripe_height;
+	header->num_stripes = pack->num_stripes;
+
+	for (index = 0; index < pack->num_stripes; index++) {
+		sizes[index] = pack->stripes[index].size;
+		memcpy(data, pack->stripes[index].data, pack->stripes[index].size);
+		data += pack->stripes[index].size;
+	}
+
+	return data - (__u8 *)dst;
+}
+
+int vc_pack_info(const void *src, size_t size, struct vc_pack_params *params)
+{
+	const struct vc_pack_header *header = src;
+
+	if (size < sizeof(*header) || header->magic != VC_PACK_MAGIC || header->version != VC_PACK_VERSION)
+		return -EINVAL;
+	if (size < sizeof(*header) + header->num_stripes * sizeof(__u32))
+		return -EINVAL;
+
+	memset(params, 0, sizeof(*params));
+	params->width = header->width;
+	params->height = header->height;
+	params->bits = header->bits;
+	params->msb = header->msb;
+	params->bayer = (header->flags & VC_PACK_FLAG_BAYER) != 0;
+	params->stride = header->width * sizeof(__u16);
+	params->stripe_height = header->stripe_height;
+
+	return 0;
+}
+
+int vc_pack_decompress(struct vc_pack *pack, const void *src, size_t size, void *dst)
+{
+	const struct vc_pack_header *header = src;
+	struct vc_pack_params params;
+	size_t total = 0;
+	unsigned int index;
+	int ret;
+
+	ret = vc_pack_info(src, size, &params);
+	if (ret)
+		return ret;
+	if (params.width != pack->params.width || params.height != pack->params.height ||
+	    params.bits != pack->params.bits || params.msb != pack->params.msb ||
+	    params.bayer != pack->params.bayer || params.stripe_height != pack->params.stripe_height ||
+	    header->num_stripes != pack->num_stripes)
+		return -EINVAL;
+
+	pack->stripe_sizes = (const __u32 *)(header + 1);
+	pack->packed = (const __u8 *)(pack->stripe_sizes + pack->num_stripes);
+	for (index = 0; index < pack->num_stripes; index++)
+		total += pack->stripe_sizes[index];
+	if (total > size - (pack->packed - (const __u8 *)src))
+		return -EINVAL;
+
+	pack->dst = dst;
+	vc_pool_run(pack->pool, pack->num_stripes, vc_pack_decompress_stripe, pack);
+
+	for (index = 0; index < pack->num_stripes; index++) {
+		if (pack->stripes[index].error)
+			return pack->stripes[index].error;
+	}
+
+	return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef _VC_PACK_H
+#define _VC_PACK_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <linux/types.h>
+
+#include "vcpool.h"
+
+// Lossless compression of the RAW formats of the driver. Every sample is
+// predicted from its neighbours of the same color (MED predictor of
+// LOCO-I) and the residual is Rice coded in blocks of VC_PACK_BLOCK samples
+// with an own parameter per block. The frame is split into stripes of lines
+// which are coded independently, so compression and decompression run on all
+// threads of the pool.
+//
+// The samples are expected in the ISI memory layout (see vcraw.h): 16 bit
+// containers, MSB at params.msb and zero padded LSBs.
+//
+// Stream layout:
+//   struct vc_pack_header
+//   __u32 stripe_size[num_stripes]     // Bytes, multiple of 4
+//   stripe data
+
+#define VC_PACK_MAGIC           0x4b504356      // "VCPK"
+#define VC_PACK_VERSION         1
+#define VC_PACK_BLOCK           32
+#define VC_PACK_STRIPE_HEIGHT   64
+
+#define VC_PACK_FLAG_BAYER      0x0001
+
+struct vc_pack_header {
+	__u32 magic;
+	__u16 version;
+	__u16 flags;
+	__u32 width;
+	__u32 height;
+	__u8 bits;
+	__u8 msb;
+	__u16 stripe_height;
+	__u32 num_stripes;
+};
+
+struct vc_pack_params {
+	unsigned int width;
+	unsigned int height;
+	unsigned int bits;              // Bits per sample (8 to 14)
+	unsigned int msb;               // Position of the sample MSB (13 for the ISI)
+	int bayer;                      // Predict from the neighbours of the same color
+	size_t stride;                  // Bytes per line of the raw frame
+	unsigned int stripe_height;     // Lines per stripe (0 = VC_PACK_STRIPE_HEIGHT)
+};
+
+struct vc_pack;
+
+// The pool is optional, without pool the stripes are coded by the caller.
+struct vc_pack *vc_pack_create(const struct vc_pack_params *params, struct vc_pool *pool);
+void vc_pack_destroy(struct vc_pack *pack);
+// Returns the maximum size of a compressed frame.
+size_t vc_pack_bound(struct vc_pack *pack);
+// Returns the size of the compressed frame in dst (vc_pack_bound() bytes).
+ssize_t vc_pack_compress(struct vc_pack *pack, const void *src, void *dst);
+int vc_pack_decompress(struct vc_pack *pack, const void *src, size_t size, void *dst);
+// Reads the parameters of a compressed frame.
+int vc_pack_info(const void *src, size_t size, struct vc_pack_params *params);
+
+#endif // _VC_PACK_H
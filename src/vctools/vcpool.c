@@ -0,0 +1,227 @@
+#include "vcpool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define RANGE(begin, end)       (((uint64_t)(begin) << 32) | (uint32_t)(end))
+#define RANGE_BEGIN(range)      ((uint32_t)((range) >> 32))
+#define RANGE_END(range)        ((uint32_t)(range))
+
+struct vc_pool_worker {
+	// Keep the ranges of the workers in separate cache lines.
+	_Alignas(64) _Atomic uint64_t range;
+	struct vc_pool *pool;
+	unsigned int id;
+	pthread_t thread;
+};
+
+struct vc_pool {
+	unsigned int num_workers;
+	struct vc_pool_worker *workers;
+
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned int generation;
+	unsigned int active;
+	int quit;
+
+	vc_pool_fn fn;
+	void *arg;
+};
+
+// Takes the next item from the front of the own range.
+static int vc_pool_pop(struct vc_pool_worker *worker, unsigned int *index)
+{
+	uint64_t range = atomic_load(&worker->range);
+	uint32_t begin, end;
+
+	do {
+		begin = RANGE_BEGIN(range);
+		end = RANGE_END(range);
+		if (begin >= end)
+			return 0;
+	} while (!atomic_compare_exchange_weak(&worker->range, &range, RANGE(begin + 1, end)));
+
+	*index = begin;
+	return 1;
+}
+
+// Moves the back half of the largest range of the other workers into the own
+// (empty) range.
+static int vc_pool_steal(struct vc_pool_worker *worker)
+{
+	struct vc_pool *pool = worker->pool;
+	struct vc_pool_worker *victim;
+	uint64_t range;
+	uint32_t begin, end, mid, best, left;
+	unsigned int i, id;
+
+	for (;;) {
+		victim = NULL;
+		best = 0;
+		for (i = 1; i < pool->num_workers; i++) {
+			id = (worker->id + i) % pool->num_workers;
+			range = atomic_load(&pool->workers[id].range);
+			begin = RANGE_BEGIN(range);
+			end = RANGE_END(range);
+			left = begin < end ? end - begin : 0;
+			if (left > best) {
+				best = left;
+				victim = &pool->workers[id];
+			}
+		}
+		if (victim == NULL)
+			return 0;
+
+		range = atomic_load(&victim->range);
+		begin = RANGE_BEGIN(range);
+		end = RANGE_END(range);
+		if (begin >= end)
+			continue;
+
+		mid = begin + (end - begin) / 2;
+		if (atomic_compare_exchange_strong(&victim->range, &range, RANGE(begin, mid))) {
+			atomic_store(&worker->range, RANGE(mid, end));
+			return 1;
+		}
+	}
+}
+
+static void vc_pool_work(struct vc_pool_worker *worker)
+{
+	struct vc_pool *pool = worker->pool;
+	unsigned int index;
+
+	do {
+		while (vc_pool_pop(worker, &index))
+			pool->fn(pool->arg, index);
+	} while (vc_pool_steal(worker));
+}
+
+static void *vc_pool_thread(void *arg)
+{
+	struct vc_pool_worker *worker = arg;
+	struct vc_pool *pool = worker->pool;
+	unsigned int generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->quit)
+			break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		vc_pool_work(worker);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->active == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+struct vc_pool *vc_pool_create(unsigned int threads)
+{
+	struct vc_pool *pool;
+	unsigned int id;
+
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? cpus : 1;
+	}
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return NULL;
+
+	pool->workers = aligned_alloc(64, threads * sizeof(struct vc_pool_worker));
+	if (pool->workers == NULL) {
+		free(pool);
+		return NULL;
+	}
+	pool->num_workers = threads;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	// Worker 0 is the thread which calls vc_pool_run().
+	for (id = 0; id < threads; id++) {
+		struct vc_pool_worker *worker = &pool->workers[id];
+		atomic_init(&worker->range, RANGE(0, 0));
+		worker->pool = pool;
+		worker->id = id;
+		if (id > 0 && pthread_create(&worker->thread, NULL, vc_pool_thread, worker)) {
+			pool->num_workers = id;
+			break;
+		}
+	}
+
+	return pool;
+}
+
+void vc_pool_destroy(struct vc_pool *pool)
+{
+	unsigned int id;
+
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (id = 1; id < pool->num_workers; id++)
+		pthread_join(pool->workers[id].thread, NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->workers);
+	free(pool);
+}
+
+unsigned int vc_pool_threads(struct vc_pool *pool)
+{
+	return pool ? pool->num_workers : 1;
+}
+
+void vc_pool_run(struct vc_pool *pool, unsigned int count, vc_pool_fn fn, void *arg)
+{
+	unsigned int id, begin, end;
+
+	if (pool == NULL || pool->num_workers == 1 || count < 2) {
+		for (id = 0; id < count; id++)
+			fn(arg, id);
+		return;
+	}
+
+	for (id = 0; id < pool->num_workers; id++) {
+		begin = (unsigned long long)count * id / pool->num_workers;
+		end = (unsigned long long)count * (id + 1) / pool->num_workers;
+		atomic_store(&pool->workers[id].range, RANGE(begin, end));
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->fn = fn;
+	pool->arg = arg;
+	pool->active = pool->num_workers - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	vc_pool_work(&pool->workers[0]);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->active > 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,25 @@
+#ifndef _VC_POOL_H
+#define _VC_POOL_H
+
+// Work-stealing thread pool
+//
+// vc_pool_run() splits the items [0, count) into one contiguous range per
+// thread. A thread takes items from the front of its own range. When its range
+// is empty it steals the back half of the largest remaining range of another
+// thread. Each range is a packed 64 bit atomic (begin << 32 | end), so taking
+// and stealing is a single compare and swap without locks.
+
+struct vc_pool;
+
+typedef void (*vc_pool_fn)(void *arg, unsigned int index);
+
+// Creates a pool with the given number of threads including the calling
+// thread. 0 uses one thread per online CPU.
+struct vc_pool *vc_pool_create(unsigned int threads);
+void vc_pool_destroy(struct vc_pool *pool);
+unsigned int vc_pool_threads(struct vc_pool *pool);
+// Calls fn(arg, index) for every index in [0, count) and returns when all
+// calls have finished. The calling thread works on the items, too.
+void vc_pool_run(struct vc_pool *pool, unsigned int count, vc_pool_fn fn, void *arg);
+
+#endif // _VC_POOL_H
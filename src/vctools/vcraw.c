@@ -0,0 +1,253 @@
+#include "vcraw.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/videodev2.h>
+
+#include "vc_v4l2.h"
+
+// *** Scalar reference kernels ***********************************************
+
+static void vc_raw_to8_shift_scalar(const __u16 *src, __u8 *dst, size_t n, unsigned int shift)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		__u16 value = src[i] >> shift;
+		dst[i] = value > 255 ? 255 : value;
+	}
+}
+
+void vc_raw_to8_lut_scalar(const __u16 *src, __u8 *dst, size_t n, const __u8 *lut)
+{
+	size_t i = 0;
+
+	// A table lookup can't be vectorized on NEON or SSE. Unrolling hides
+	// the load latency.
+	for (; i + 4 <= n; i += 4) {
+		dst[i + 0] = lut[src[i + 0] >> VC_RAW_LUT_SHIFT];
+		dst[i + 1] = lut[src[i + 1] >> VC_RAW_LUT_SHIFT];
+		dst[i + 2] = lut[src[i + 2] >> VC_RAW_LUT_SHIFT];
+		dst[i + 3] = lut[src[i + 3] >> VC_RAW_LUT_SHIFT];
+	}
+	for (; i < n; i++)
+		dst[i] = lut[src[i] >> VC_RAW_LUT_SHIFT];
+}
+
+static void vc_raw_minmax_scalar(const __u16 *src, size_t n, __u16 *min, __u16 *max)
+{
+	__u16 lo = 0xffff, hi = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (src[i] < lo)
+			lo = src[i];
+		if (src[i] > hi)
+			hi = src[i];
+	}
+	*min = lo;
+	*max = hi;
+}
+
+void vc_raw_histogram_scalar(const __u16 *src, size_t n, __u32 *hist, unsigned int shift)
+{
+	size_t bins = (size_t)1 << (16 - shift);
+	__u32 *sub;
+	size_t i;
+
+	// Four sub histograms avoid the store to load dependency when
+	// neighbouring pixels fall into the same bin.
+	sub = calloc(4 * bins, sizeof(__u32));
+	if (sub == NULL) {
+		for (i = 0; i < n; i++)
+			hist[src[i] >> shift]++;
+		return;
+	}
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		sub[0 * bins + (src[i + 0] >> shift)]++;
+		sub[1 * bins + (src[i + 1] >> shift)]++;
+		sub[2 * bins + (src[i + 2] >> shift)]++;
+		sub[3 * bins + (src[i + 3] >> shift)]++;
+	}
+	for (; i < n; i++)
+		sub[src[i] >> shift]++;
+
+	for (i = 0; i < bins; i++)
+		hist[i] += sub[i] + sub[bins + i] + sub[2 * bins + i] + sub[3 * bins + i];
+
+	free(sub);
+}
+
+static void vc_raw_shift16_scalar(const __u16 *src, __u16 *dst, size_t n, int shift)
+{
+	size_t i;
+
+	if (shift >= 0) {
+		for (i = 0; i < n; i++)
+			dst[i] = src[i] << shift;
+	} else {
+		for (i = 0; i < n; i++)
+			dst[i] = src[i] >> -shift;
+	}
+}
+
+const struct vc_raw_ops vc_raw_ops_scalar = {
+	.name = "scalar",
+	.to8_shift = vc_raw_to8_shift_scalar,
+	.to8_lut = vc_raw_to8_lut_scalar,
+	.minmax = vc_raw_minmax_scalar,
+	.histogram = vc_raw_histogram_scalar,
+	.shift16 = vc_raw_shift16_scalar,
+};
+
+
+// *** Kernel selection *******************************************************
+
+static const char *isa_names[VC_RAW_ISA_COUNT] = { "scalar", "neon", "sse41", "avx2" };
+
+const struct vc_raw_ops *vc_raw_get_ops(enum vc_raw_isa isa)
+{
+	switch (isa) {
+	case VC_RAW_ISA_SCALAR:
+		return &vc_raw_ops_scalar;
+#if defined(__aarch64__)
+	case VC_RAW_ISA_NEON:
+		return &vc_raw_ops_neon;
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+	case VC_RAW_ISA_SSE41:
+		return __builtin_cpu_supports("sse4.1") ? &vc_raw_ops_sse41 : NULL;
+	case VC_RAW_ISA_AVX2:
+		return __builtin_cpu_supports("avx2") ? &vc_raw_ops_avx2 : NULL;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+const struct vc_raw_ops *vc_raw_ops(void)
+{
+	static const struct vc_raw_ops *ops;
+	const char *env;
+	int isa;
+
+	if (ops)
+		return ops;
+
+	env = getenv("VC_RAW_ISA");
+	if (env) {
+		for (isa = 0; isa < VC_RAW_ISA_COUNT; isa++) {
+			if (strcmp(env, isa_names[isa]) == 0)
+				ops = vc_raw_get_ops(isa);
+		}
+	}
+
+	for (isa = VC_RAW_ISA_COUNT - 1; ops == NULL && isa >= 0; isa--)
+		ops = vc_raw_get_ops(isa);
+
+	return ops;
+}
+
+
+// *** Format helpers *********************************************************
+
+static const struct vc_raw_format formats[] = {
+	{ V4L2_PIX_FMT_GREY,    8, 0 },
+	{ V4L2_PIX_FMT_Y10,    10, 0 },
+	{ V4L2_PIX_FMT_Y12,    12, 0 },
+	{ V4L2_PIX_FMT_Y14,    14, 0 },
+	{ V4L2_PIX_FMT_SRGGB8,  8, 1 },
+	{ V4L2_PIX_FMT_SRGGB10, 10, 1 },
+	{ V4L2_PIX_FMT_SRGGB12, 12, 1 },
+	{ V4L2_PIX_FMT_SRGGB14, 14, 1 },
+	{ V4L2_PIX_FMT_SGBRG8,  8, 1 },
+	{ V4L2_PIX_FMT_SGBRG10, 10, 1 },
+	{ V4L2_PIX_FMT_SGBRG12, 12, 1 },
+	{ V4L2_PIX_FMT_SGBRG14, 14, 1 },
+};
+
+const struct vc_raw_format *vc_raw_get_format(__u32 fourcc)
+{
+	size_t index;
+
+	for (index = 0; index < sizeof(formats)/sizeof(formats[0]); index++) {
+		if (formats[index].fourcc == fourcc)
+			return &formats[index];
+	}
+
+	return NULL;
+}
+
+void vc_raw_to8(const struct vc_raw_format *format, const __u16 *src, __u8 *dst, size_t n)
+{
+	(void)format;
+	vc_raw_ops()->to8_shift(src, dst, n, VC_RAW_TO8_SHIFT);
+}
+
+void vc_raw_normalize(const struct vc_raw_format *format, const __u16 *src, __u16 *dst, size_t n)
+{
+	vc_raw_ops()->shift16(src, dst, n, -(int)(VC_RAW_MSB_BIT + 1 - format->bits));
+}
+
+void vc_raw_expand(const struct vc_raw_format *format, const __u16 *src, __u16 *dst, size_t n)
+{
+	(void)format;
+	vc_raw_ops()->shift16(src, dst, n, 15 - VC_RAW_MSB_BIT);
+}
+
+void vc_raw_lut_linear(__u8 *lut, __u16 min, __u16 max)
+{
+	unsigned int lo = min >> VC_RAW_LUT_SHIFT;
+	unsigned int hi = max >> VC_RAW_LUT_SHIFT;
+	unsigned int index;
+
+	if (hi <= lo)
+		hi = lo + 1;
+
+	for (index = 0; index < VC_RAW_LUT_SIZE; index++) {
+		if (index <= lo)
+			lut[index] = 0;
+		else if (index >= hi)
+			lut[index] = 255;
+		else
+			lut[index] = (255 * (index - lo) + (hi - lo) / 2) / (hi - lo);
+	}
+}
+
+// Random samples do not compress. The scene is a smooth RGGB image with about
+// 1 % noise, which is closer to a real image.
+void vc_raw_fill_scene(__u16 *dst, size_t width, size_t height, unsigned int bits)
+{
+	static const float gain[4] = { 0.6f, 1.0f, 1.0f, 0.45f };
+	unsigned int shift = VC_RAW_MSB_BIT + 1 - bits;
+	float max = (1 << bits) - 1;
+	float noise = max / 100;
+	__u32 seed = 0x12345678;
+	float *columns;
+	float value;
+	size_t x, y;
+
+	columns = malloc(width * sizeof(float));
+	if (columns == NULL)
+		return;
+	for (x = 0; x < width; x++)
+		columns[x] = sinf(x / 97.0f);
+
+	for (y = 0; y < height; y++) {
+		float row = cosf(y / 131.0f);
+		for (x = 0; x < width; x++) {
+			seed = seed * 1664525 + 1013904223;
+			value = 0.2f + 0.3f * (1.0f + columns[x] * row);
+			if (((x / 256) ^ (y / 256)) & 1)
+				value *= 0.5f;
+			value = value * gain[(y & 1) * 2 + (x & 1)] * max;
+			value += noise * ((float)((seed >> 16) & 0xff) / 128.0f - 1.0f);
+			value = value < 0 ? 0 : value > max ? max : value;
+			dst[y * width + x] = (__u16)value << shift;
+		}
+	}
+
+	free(columns);
+}
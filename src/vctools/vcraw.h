@@ -0,0 +1,87 @@
+#ifndef _VC_RAW_H
+#define _VC_RAW_H
+
+#include <stddef.h>
+#include <linux/types.h>
+
+// The ISI writes all RAW formats left aligned into 16 bit containers. The MSB
+// is always at BIT[13], Bit[15] and Bit[14] are zero (see README.md).
+//
+//   RAW08 -> 0bxx76543210xxxxxx
+//   RAW10 -> 0bxx9876543210xxxx
+//   RAW12 -> 0bxxba9876543210xx
+//   RAW14 -> 0bxxdcba9876543210
+//
+// All kernels expect this memory layout.
+
+#define VC_RAW_MSB_BIT          13
+#define VC_RAW_TO8_SHIFT        (VC_RAW_MSB_BIT + 1 - 8)
+#define VC_RAW_LUT_SHIFT        2
+#define VC_RAW_LUT_SIZE         (1 << (16 - VC_RAW_LUT_SHIFT))
+
+enum vc_raw_isa {
+	VC_RAW_ISA_SCALAR = 0,
+	VC_RAW_ISA_NEON,
+	VC_RAW_ISA_SSE41,
+	VC_RAW_ISA_AVX2,
+	VC_RAW_ISA_COUNT,
+};
+
+struct vc_raw_format {
+	__u32 fourcc;
+	unsigned int bits;
+	unsigned int bayer;
+};
+
+struct vc_raw_ops {
+	const char *name;
+	// dst = min(src >> shift, 255)
+	void (*to8_shift)(const __u16 *src, __u8 *dst, size_t n, unsigned int shift);
+	// dst = lut[src >> VC_RAW_LUT_SHIFT], lut has VC_RAW_LUT_SIZE entries
+	void (*to8_lut)(const __u16 *src, __u8 *dst, size_t n, const __u8 *lut);
+	void (*minmax)(const __u16 *src, size_t n, __u16 *min, __u16 *max);
+	// hist[src >> shift]++, hist has 1 << (16 - shift) entries and is not cleared
+	void (*histogram)(const __u16 *src, size_t n, __u32 *hist, unsigned int shift);
+	// dst = src << shift (shift > 0) or src >> -shift (shift < 0)
+	void (*shift16)(const __u16 *src, __u16 *dst, size_t n, int shift);
+};
+
+// --- Kernel selection ---------------------------------------------------------
+// Returns the kernels for the given instruction set or NULL if the CPU does not
+// support it.
+const struct vc_raw_ops *vc_raw_get_ops(enum vc_raw_isa isa);
+// Returns the fastest kernels supported by the CPU. The environment variable
+// VC_RAW_ISA (scalar, neon, sse41, avx2) overrides the selection.
+const struct vc_raw_ops *vc_raw_ops(void);
+
+// --- Format helpers -----------------------------------------------------------
+// Supports all formats of vc_core_get_v4l2_fmt() in the driver.
+const struct vc_raw_format *vc_raw_get_format(__u32 fourcc);
+// Converts to 8 bit by dropping the LSBs.
+void vc_raw_to8(const struct vc_raw_format *format, const __u16 *src, __u8 *dst, size_t n);
+// Converts to right aligned samples with the native bit depth of the format.
+void vc_raw_normalize(const struct vc_raw_format *format, const __u16 *src, __u16 *dst, size_t n);
+// Converts to left aligned samples using the full 16 bit range.
+void vc_raw_expand(const struct vc_raw_format *format, const __u16 *src, __u16 *dst, size_t n);
+// Fills a LUT which maps the sample range [min, max] linearly to [0, 255].
+void vc_raw_lut_linear(__u8 *lut, __u16 min, __u16 max);
+
+// --- Test images --------------------------------------------------------------
+// Fills a frame with a noisy RGGB scene in the ISI memory layout.
+void vc_raw_fill_scene(__u16 *dst, size_t width, size_t height, unsigned int bits);
+
+// --- Kernel tables of the instruction sets ------------------------------------
+extern const struct vc_raw_ops vc_raw_ops_scalar;
+#if defined(__aarch64__)
+extern const struct vc_raw_ops vc_raw_ops_neon;
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+extern const struct vc_raw_ops vc_raw_ops_sse41;
+extern const struct vc_raw_ops vc_raw_ops_avx2;
+#endif
+
+// Scalar kernels without a SIMD counterpart are shared by all instruction sets.
+void vc_raw_to8_lut_scalar(const __u16 *src, __u8 *dst, size_t n, const __u8 *lut);
+void vc_raw_histogram_scalar(const __u16 *src, size_t n, __u32 *hist, unsigned int shift);
+
+#endif // _VC_RAW_H
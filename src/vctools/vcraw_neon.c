@@ -0,0 +1,73 @@
+#include "vcraw.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+// NEON is mandatory on aarch64, no runtime check is necessary.
+
+static void vc_raw_to8_shift_neon(const __u16 *src, __u8 *dst, size_t n, unsigned int shift)
+{
+	const int16x8_t count = vdupq_n_s16(-(int)shift);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		uint16x8_t a = vshlq_u16(vld1q_u16(src + i), count);
+		uint16x8_t b = vshlq_u16(vld1q_u16(src + i + 8), count);
+		// vqmovn saturates to 255
+		vst1q_u8(dst + i, vcombine_u8(vqmovn_u16(a), vqmovn_u16(b)));
+	}
+	for (; i < n; i++) {
+		__u16 value = src[i] >> shift;
+		dst[i] = value > 255 ? 255 : value;
+	}
+}
+
+static void vc_raw_minmax_neon(const __u16 *src, size_t n, __u16 *min, __u16 *max)
+{
+	uint16x8_t lo = vdupq_n_u16(0xffff);
+	uint16x8_t hi = vdupq_n_u16(0);
+	__u16 vmin, vmax;
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		uint16x8_t a = vld1q_u16(src + i);
+		lo = vminq_u16(lo, a);
+		hi = vmaxq_u16(hi, a);
+	}
+	vmin = vminvq_u16(lo);
+	vmax = vmaxvq_u16(hi);
+
+	for (; i < n; i++) {
+		if (src[i] < vmin)
+			vmin = src[i];
+		if (src[i] > vmax)
+			vmax = src[i];
+	}
+	*min = vmin;
+	*max = vmax;
+}
+
+static void vc_raw_shift16_neon(const __u16 *src, __u16 *dst, size_t n, int shift)
+{
+	const int16x8_t count = vdupq_n_s16(shift);
+	size_t i = 0;
+
+	// vshl shifts right for negative counts.
+	for (; i + 8 <= n; i += 8)
+		vst1q_u16(dst + i, vshlq_u16(vld1q_u16(src + i), count));
+
+	for (; i < n; i++)
+		dst[i] = shift >= 0 ? src[i] << shift : src[i] >> -shift;
+}
+
+const struct vc_raw_ops vc_raw_ops_neon = {
+	.name = "neon",
+	.to8_shift = vc_raw_to8_shift_neon,
+	.to8_lut = vc_raw_to8_lut_scalar,
+	.minmax = vc_raw_minmax_neon,
+	.histogram = vc_raw_histogram_scalar,
+	.shift16 = vc_raw_shift16_neon,
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "vcraw.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+// The kernels are compiled for their instruction set with the target
+// attribute. vc_raw_get_ops() only hands them out if the CPU supports it.
+
+// *** SSE4.1 *****************************************************************
+
+#define SSE41 __attribute__((target("sse4.1")))
+
+SSE41 static void vc_raw_to8_shift_sse41(const __u16 *src, __u8 *dst, size_t n, unsigned int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	const __m128i limit = _mm_set1_epi16(255);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + i + 8));
+		a = _mm_min_epu16(_mm_srl_epi16(a, count), limit);
+		b = _mm_min_epu16(_mm_srl_epi16(b, count), limit);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+	}
+	for (; i < n; i++) {
+		__u16 value = src[i] >> shift;
+		dst[i] = value > 255 ? 255 : value;
+	}
+}
+
+SSE41 static void vc_raw_minmax_sse41(const __u16 *src, size_t n, __u16 *min, __u16 *max)
+{
+	__m128i lo = _mm_set1_epi16(-1);
+	__m128i hi = _mm_setzero_si128();
+	__u16 vmin = 0xffff, vmax = 0;
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+		lo = _mm_min_epu16(lo, a);
+		hi = _mm_max_epu16(hi, a);
+	}
+
+	// minpos finds the horizontal minimum, the maximum is the inverted
+	// minimum of the inverted values.
+	if (i > 0) {
+		vmin = _mm_cvtsi128_si32(_mm_minpos_epu16(lo));
+		vmax = ~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(hi, _mm_set1_epi16(-1))));
+	}
+
+	for (; i < n; i++) {
+		if (src[i] < vmin)
+			vmin = src[i];
+		if (src[i] > vmax)
+			vmax = src[i];
+	}
+	*min = vmin;
+	*max = vmax;
+}
+
+SSE41 static void vc_raw_shift16_sse41(const __u16 *src, __u16 *dst, size_t n, int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift >= 0 ? shift : -shift);
+	size_t i = 0;
+
+	if (shift >= 0) {
+		for (; i + 8 <= n; i += 8) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_sll_epi16(a, count));
+		}
+		for (; i < n; i++)
+			dst[i] = src[i] << shift;
+	} else {
+		for (; i + 8 <= n; i += 8) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_srl_epi16(a, count));
+		}
+		for (; i < n; i++)
+			dst[i] = src[i] >> -shift;
+	}
+}
+
+const struct vc_raw_ops vc_raw_ops_sse41 = {
+	.name = "sse41",
+	.to8_shift = vc_raw_to8_shift_sse41,
+	.to8_lut = vc_raw_to8_lut_scalar,
+	.minmax = vc_raw_minmax_sse41,
+	.histogram = vc_raw_histogram_scalar,
+	.shift16 = vc_raw_shift16_sse41,
+};
+
+
+// *** AVX2 *******************************************************************
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static void vc_raw_to8_shift_avx2(const __u16 *src, __u8 *dst, size_t n, unsigned int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	const __m256i limit = _mm256_set1_epi16(255);
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 16));
+		a = _mm256_min_epu16(_mm256_srl_epi16(a, count), limit);
+		b = _mm256_min_epu16(_mm256_srl_epi16(b, count), limit);
+		// packus works per 128 bit lane, restore the pixel order.
+		a = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+		_mm256_storeu_si256((__m256i *)(dst + i), a);
+	}
+	for (; i < n; i++) {
+		__u16 value = src[i] >> shift;
+		dst[i] = value > 255 ? 255 : value;
+	}
+}
+
+AVX2 static void vc_raw_minmax_avx2(const __u16 *src, size_t n, __u16 *min, __u16 *max)
+{
+	__m256i lo = _mm256_set1_epi16(-1);
+	__m256i hi = _mm256_setzero_si256();
+	__m128i lo128, hi128;
+	__u16 vmin = 0xffff, vmax = 0;
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+		lo = _mm256_min_epu16(lo, a);
+		hi = _mm256_max_epu16(hi, a);
+	}
+
+	if (i > 0) {
+		lo128 = _mm_min_epu16(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1));
+		hi128 = _mm_max_epu16(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1));
+		vmin = _mm_cvtsi128_si32(_mm_minpos_epu16(lo128));
+		vmax = ~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(hi128, _mm_set1_epi16(-1))));
+	}
+
+	for (; i < n; i++) {
+		if (src[i] < vmin)
+			vmin = src[i];
+		if (src[i] > vmax)
+			vmax = src[i];
+	}
+	*min = vmin;
+	*max = vmax;
+}
+
+AVX2 static void vc_raw_shift16_avx2(const __u16 *src, __u16 *dst, size_t n, int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift >= 0 ? shift : -shift);
+	size_t i = 0;
+
+	if (shift >= 0) {
+		for (; i + 16 <= n; i += 16) {
+			__m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+			_mm256_storeu_si256((__m256i *)(dst + i), _mm256_sll_epi16(a, count));
+		}
+		for (; i < n; i++)
+			dst[i] = src[i] << shift;
+	} else {
+		for (; i + 16 <= n; i += 16) {
+			__m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+			_mm256_storeu_si256((__m256i *)(dst + i), _mm256_srl_epi16(a, count));
+		}
+		for (; i < n; i++)
+			dst[i] = src[i] >> -shift;
+	}
+}
+
+const struct vc_raw_ops vc_raw_ops_avx2 = {
+	.name = "avx2",
+	.to8_shift = vc_raw_to8_shift_avx2,
+	.to8_lut = vc_raw_to8_lut_scalar,
+	.minmax = vc_raw_minmax_avx2,
+	.histogram = vc_raw_histogram_scalar,
+	.shift16 = vc_raw_shift16_avx2,
+};
+
+#endif
@@ -0,0 +1,1150 @@
+// vcrecord - Sustained raw recording of VC MIPI camera streams
+//
+// The capture thread dequeues the V4L2 buffers and passes them through a
+// bounded ring to a dedicated writer thread. The writer writes directly from
+// the mapped V4L2 buffers (no copy) with O_DIRECT pwrite or io_uring and
+// queues the buffer again afterwards. If the ring is full, the capture thread
+// queues the buffer immediately and counts the frame as dropped.
+//
+// Every frame occupies a slot of the output file which is aligned to 4 KiB.
+// The sidecar index <output>.idx contains per frame the sequence, the
+// timestamp, the exposure, the gain and the file offset.
+//
+// With -z the writer compresses the frames losslessly (vcpack.c) on all CPUs
+// before writing. The frames keep their 4 KiB alignment, the index contains
+// the compressed size. -U decompresses such a recording.
+//
+// In pre-trigger mode (-p) the frames are copied into a preallocated ring of
+// the last frames instead. On a trigger (SIGUSR1 or an edge/write on the
+// trigger input) the ring and the following post-trigger frames are passed to
+// the writer.
+
+#define _GNU_SOURCE
+
+#include "vc_v4l2.h"
+#include "vcpack.h"
+#include "vcraw.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#define VC_ALIGN                4096
+#define VC_ALIGN_UP(x)          (((x) + VC_ALIGN - 1) & ~((size_t)VC_ALIGN - 1))
+#define VC_PREALLOC_SLOTS       64
+
+enum vc_record_io {
+	VC_RECORD_DIRECT = 0,
+	VC_RECORD_BUFFERED,
+	VC_RECORD_URING,
+};
+
+struct vc_slot {
+	unsigned int index;             // V4L2 buffer index or synthetic buffer index
+	void *data;
+	size_t length;                  // Length of the mapped buffer
+	size_t bytes;                   // Bytes of the frame
+	__u32 sequence;
+	__u64 timestamp_us;
+	__s32 exposure;
+	__s32 gain;
+	unsigned int event;             // Trigger event in pre-trigger mode
+};
+
+// Bounded single producer, single consumer ring
+struct vc_ring {
+	struct vc_slot *slots;
+	unsigned int size;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int fill;
+	unsigned int max_fill;
+	int closed;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+struct vc_recorder {
+	enum vc_record_io io;
+	int fd;
+	FILE *index;
+	size_t slot_size;
+	__u64 frames;
+	__u64 bytes;                    // Raw bytes of the written frames
+	__u64 stored;                   // Bytes written to the file
+	__u64 offset;
+	__u64 allocated;
+	__u64 errors;
+	struct vc_pack *pack;
+	void **bounce;                  // Lazily allocated, one per write in flight
+	struct vc_ring ring;
+	void (*release)(struct vc_recorder *recorder, struct vc_slot *slot);
+	void *context;
+};
+
+struct vc_synthetic {
+	void **buffers;
+	unsigned int num_buffers;
+	struct vc_ring free;
+};
+
+// The pool holds pre + post frames for the current event and up to queue
+// frames of the previous event which are not written yet.
+struct vc_pretrigger {
+	unsigned int pre;               // Frames before the trigger
+	unsigned int post;              // Frames after the trigger
+	void *memory;
+	size_t memory_size;
+	int locked;
+	unsigned int num_slots;
+	struct vc_ring free;            // Free slots, released by the writer
+	struct vc_ring window;          // The last frames before the trigger
+	struct vc_ring pending;         // Frames of the event waiting for the writer
+	unsigned int remaining;         // Post-trigger frames still to capture
+	unsigned int event;
+	__u64 ignored;                  // Triggers while an event is captured
+	int input;                      // Trigger input (FIFO or GPIO value file)
+	short input_events;
+};
+
+struct vc_counters {
+	__u64 frames;
+	__u64 dropped;
+	__u64 gaps;
+};
+
+static volatile sig_atomic_t stop;
+static volatile sig_atomic_t trigger;
+
+static void signal_handler(int signal)
+{
+	if (signal == SIGUSR1)
+		trigger = 1;
+	else
+		stop = 1;
+}
+
+
+// *** Ring *******************************************************************
+
+static int vc_ring_init(struct vc_ring *ring, unsigned int size)
+{
+	memset(ring, 0, sizeof(*ring));
+	ring->slots = calloc(size, sizeof(struct vc_slot));
+	if (ring->slots == NULL)
+		return -ENOMEM;
+	ring->size = size;
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->cond, NULL);
+
+	return 0;
+}
+
+static void vc_ring_free(struct vc_ring *ring)
+{
+	pthread_cond_destroy(&ring->cond);
+	pthread_mutex_destroy(&ring->lock);
+	free(ring->slots);
+}
+
+// Returns -EAGAIN if the ring is full and not blocking.
+static int vc_ring_push(struct vc_ring *ring, struct vc_slot *slot, int block)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&ring->lock);
+	while (block && ring->fill == ring->size && !ring->closed)
+		pthread_cond_wait(&ring->cond, &ring->lock);
+	if (ring->fill == ring->size) {
+		ret = -EAGAIN;
+	} else {
+		ring->slots[ring->head] = *slot;
+		ring->head = (ring->head + 1) % ring->size;
+		ring->fill++;
+		if (ring->fill > ring->max_fill)
+			ring->max_fill = ring->fill;
+		pthread_cond_broadcast(&ring->cond);
+	}
+	pthread_mutex_unlock(&ring->lock);
+
+	return ret;
+}
+
+// Returns 0 if the ring is empty and (not blocking or closed).
+static int vc_ring_pop(struct vc_ring *ring, struct vc_slot *slot, int block)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&ring->lock);
+	while (block && ring->fill == 0 && !ring->closed)
+		pthread_cond_wait(&ring->cond, &ring->lock);
+	if (ring->fill > 0) {
+		*slot = ring->slots[ring->tail];
+		ring->tail = (ring->tail + 1) % ring->size;
+		ring->fill--;
+		pthread_cond_broadcast(&ring->cond);
+		ret = 1;
+	}
+	pthread_mutex_unlock(&ring->lock);
+
+	return ret;
+}
+
+static int vc_ring_full(struct vc_ring *ring)
+{
+	int ret;
+
+	pthread_mutex_lock(&ring->lock);
+	ret = ring->fill == ring->size;
+	pthread_mutex_unlock(&ring->lock);
+
+	return ret;
+}
+
+static void vc_ring_close(struct vc_ring *ring)
+{
+	pthread_mutex_lock(&ring->lock);
+	ring->closed = 1;
+	pthread_cond_broadcast(&ring->cond);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+
+// *** Writer *****************************************************************
+
+static int vc_recorder_open(struct vc_recorder *recorder, const char *name, size_t frame_size, unsigned long count)
+{
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	char index_name[512];
+
+	recorder->slot_size = VC_ALIGN_UP(frame_size);
+	if (recorder->io != VC_RECORD_BUFFERED)
+		flags |= O_DIRECT;
+
+	recorder->fd = open(name, flags, 0644);
+	if (recorder->fd < 0 && errno == EINVAL && (flags & O_DIRECT)) {
+		// tmpfs does not support O_DIRECT.
+		fprintf(stderr, "O_DIRECT is not supported by the file system of %s, using buffered writes\n", name);
+		recorder->fd = open(name, flags & ~O_DIRECT, 0644);
+	}
+	if (recorder->fd < 0) {
+		fprintf(stderr, "Unable to open %s (%s)\n", name, strerror(errno));
+		return -errno;
+	}
+
+	// Preallocate the whole recording if the number of frames is known.
+	// Otherwise the file grows in steps of VC_PREALLOC_SLOTS frames.
+	if (count > 0 && fallocate(recorder->fd, 0, 0, recorder->slot_size * count) == 0)
+		recorder->allocated = recorder->slot_size * count;
+
+	recorder->bounce = calloc(recorder->ring.size, sizeof(void *));
+	if (recorder->bounce == NULL)
+		return -ENOMEM;
+
+	snprintf(index_name, sizeof(index_name), "%s.idx", name);
+	recorder->index = fopen(index_name, "w");
+	if (recorder->index == NULL) {
+		fprintf(stderr, "Unable to open %s (%s)\n", index_name, strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+static void vc_recorder_close(struct vc_recorder *recorder)
+{
+	if (recorder->fd >= 0) {
+		if (ftruncate(recorder->fd, recorder->offset))
+			fprintf(stderr, "Unable to truncate the output file (%s)\n", strerror(errno));
+		close(recorder->fd);
+	}
+	if (recorder->index)
+		fclose(recorder->index);
+	if (recorder->bounce) {
+		for (unsigned int i = 0; i < recorder->ring.size; i++)
+			free(recorder->bounce[i]);
+		free(recorder->bounce);
+	}
+}
+
+// Returns the file offset of the next frame and grows the preallocation.
+static off_t vc_recorder_offset(struct vc_recorder *recorder, size_t length)
+{
+	off_t offset = recorder->offset;
+
+	if (offset + length > recorder->allocated) {
+		if (fallocate(recorder->fd, 0, offset, recorder->slot_size * VC_PREALLOC_SLOTS) == 0)
+			recorder->allocated = offset + recorder->slot_size * VC_PREALLOC_SLOTS;
+	}
+	recorder->offset += length;
+
+	return offset;
+}
+
+// Returns the data to write, its size and the aligned length of the write.
+// O_DIRECT needs aligned buffers and lengths. The mapped V4L2 buffers are
+// page aligned. If the buffer is shorter than the slot, the frame is copied.
+static void *vc_recorder_data(struct vc_recorder *recorder, struct vc_slot *slot, unsigned int id,
+	size_t *size, size_t *length)
+{
+	size_t capacity = recorder->pack ? VC_ALIGN_UP(vc_pack_bound(recorder->pack)) : recorder->slot_size;
+	__u8 *bounce;
+	ssize_t ret;
+
+	*size = slot->bytes;
+	*length = recorder->slot_size;
+	if (!recorder->pack && slot->length >= recorder->slot_size && ((size_t)slot->data % VC_ALIGN) == 0)
+		return slot->data;
+
+	if (recorder->bounce[id] == NULL) {
+		if (posix_memalign(&recorder->bounce[id], VC_ALIGN, capacity))
+			return NULL;
+		memset(recorder->bounce[id], 0, capacity);
+	}
+	bounce = recorder->bounce[id];
+
+	if (recorder->pack) {
+		ret = vc_pack_compress(recorder->pack, slot->data, bounce);
+		if (ret < 0)
+			return NULL;
+		*size = ret;
+		*length = VC_ALIGN_UP(ret);
+		memset(bounce + *size, 0, *length - *size);
+	} else {
+		memcpy(bounce, slot->data, slot->bytes);
+	}
+
+	return bounce;
+}
+
+static void vc_recorder_index(struct vc_recorder *recorder, struct vc_slot *slot, off_t offset, size_t size)
+{
+	fprintf(recorder->index, "%llu,%u,%llu,%d,%d,%lld,%zu,%u\n",
+		(unsigned long long)recorder->frames, slot->sequence,
+		(unsigned long long)slot->timestamp_us, slot->exposure, slot->gain,
+		(long long)offset, size, slot->event);
+}
+
+static void *vc_writer_pwrite(void *arg)
+{
+	struct vc_recorder *recorder = arg;
+	struct vc_slot slot;
+	size_t size, length;
+	off_t offset;
+	ssize_t ret;
+	void *data;
+
+	while (vc_ring_pop(&recorder->ring, &slot, 1)) {
+		data = vc_recorder_data(recorder, &slot, 0, &size, &length);
+		offset = data ? vc_recorder_offset(recorder, length) : 0;
+		ret = data ? pwrite(recorder->fd, data, length, offset) : -1;
+		if (ret != (ssize_t)length) {
+			fprintf(stderr, "Write failed (%s)\n", ret < 0 ? strerror(errno) : "short write");
+			recorder->errors++;
+		} else {
+			vc_recorder_index(recorder, &slot, offset, size);
+			recorder->frames++;
+			recorder->bytes += slot.bytes;
+			recorder->stored += size;
+		}
+		recorder->release(recorder, &slot);
+	}
+
+	return NULL;
+}
+
+#ifdef HAVE_LIBURING
+// Keeps up to ring size writes in flight. The buffers are released in the
+// order of completion.
+static void *vc_writer_uring(void *arg)
+{
+	struct vc_recorder *recorder = arg;
+	unsigned int depth = recorder->ring.size;
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	struct io_uring uring;
+	struct vc_slot *slots;
+	size_t *lengths, size;
+	unsigned int inflight = 0;
+	unsigned int *free_ids;
+	unsigned int num_free = depth;
+	unsigned int id;
+	off_t offset;
+	void *data;
+
+	slots = calloc(depth, sizeof(*slots));
+	free_ids = calloc(depth, sizeof(*free_ids));
+	lengths = calloc(depth, sizeof(*lengths));
+	if (!slots || !free_ids || !lengths || io_uring_queue_init(depth, &uring, 0) < 0) {
+		fprintf(stderr, "Unable to set up io_uring, using pwrite\n");
+		free(slots);
+		free(free_ids);
+		free(lengths);
+		return vc_writer_pwrite(arg);
+	}
+	for (id = 0; id < depth; id++)
+		free_ids[id] = depth - 1 - id;
+
+	for (;;) {
+		while (num_free > 0) {
+			id = free_ids[num_free - 1];
+			if (!vc_ring_pop(&recorder->ring, &slots[id], inflight == 0))
+				break;
+			num_free--;
+			data = vc_recorder_data(recorder, &slots[id], id, &size, &lengths[id]);
+			if (data == NULL) {
+				recorder->errors++;
+				recorder->release(recorder, &slots[id]);
+				free_ids[num_free++] = id;
+				continue;
+			}
+			offset = vc_recorder_offset(recorder, lengths[id]);
+			sqe = io_uring_get_sqe(&uring);
+			io_uring_prep_write(sqe, recorder->fd, data, lengths[id], offset);
+			io_uring_sqe_set_data(sqe, (void *)(uintptr_t)id);
+			vc_recorder_index(recorder, &slots[id], offset, size);
+			recorder->frames++;
+			recorder->stored += size;
+			inflight++;
+		}
+		if (inflight == 0)
+			break;
+
+		io_uring_submit_and_wait(&uring, 1);
+		while (io_uring_peek_cqe(&uring, &cqe) == 0) {
+			id = (uintptr_t)io_uring_cqe_get_data(cqe);
+			if (cqe->res != (int)lengths[id]) {
+				fprintf(stderr, "Write failed (%s)\n", cqe->res < 0 ? strerror(-cqe->res) : "short write");
+				recorder->errors++;
+			} else {
+				recorder->bytes += slots[id].bytes;
+			}
+			recorder->release(recorder, &slots[id]);
+			io_uring_cqe_seen(&uring, cqe);
+			free_ids[num_free++] = id;
+			inflight--;
+		}
+	}
+
+	io_uring_queue_exit(&uring);
+	free(slots);
+	free(free_ids);
+	free(lengths);
+
+	return NULL;
+}
+#endif
+
+
+// *** Pre-trigger ************************************************************
+
+static void vc_release_pretrigger(struct vc_recorder *recorder, struct vc_slot *slot)
+{
+	struct vc_pretrigger *pretrigger = recorder->context;
+
+	vc_ring_push(&pretrigger->free, slot, 0);
+}
+
+// Opens a FIFO (any write triggers) or a GPIO value file with configured edge
+// (/sys/class/gpio/gpioN/value, an edge triggers).
+static int vc_pretrigger_open_input(struct vc_pretrigger *pretrigger, const char *name)
+{
+	struct stat st;
+	char buf[64];
+
+	// A FIFO opened for reading and writing never reports POLLHUP.
+	pretrigger->input = open(name, O_RDWR | O_NONBLOCK);
+	if (pretrigger->input < 0)
+		pretrigger->input = open(name, O_RDONLY | O_NONBLOCK);
+	if (pretrigger->input < 0 || fstat(pretrigger->input, &st)) {
+		fprintf(stderr, "Unable to open trigger input %s (%s)\n", name, strerror(errno));
+		return -errno;
+	}
+	pretrigger->input_events = S_ISFIFO(st.st_mode) ? POLLIN : POLLPRI;
+	if (read(pretrigger->input, buf, sizeof(buf)) < 0 && errno != EAGAIN)
+		return -errno;
+
+	return 0;
+}
+
+static void vc_pretrigger_poll_input(struct vc_pretrigger *pretrigger)
+{
+	struct pollfd fds = { .fd = pretrigger->input, .events = pretrigger->input_events };
+	char buf[64];
+
+	if (pretrigger->input < 0 || poll(&fds, 1, 0) <= 0 || !(fds.revents & pretrigger->input_events))
+		return;
+
+	if (pretrigger->input_events == POLLPRI)
+		lseek(pretrigger->input, 0, SEEK_SET);
+	while (read(pretrigger->input, buf, sizeof(buf)) == sizeof(buf))
+		;
+	trigger = 1;
+}
+
+static int vc_pretrigger_init(struct vc_pretrigger *pretrigger, unsigned int pre, unsigned int post,
+	unsigned int queue, size_t frame_size)
+{
+	size_t slot_size = VC_ALIGN_UP(frame_size);
+	struct vc_slot slot;
+	unsigned int index;
+
+	pretrigger->pre = pre;
+	pretrigger->post = post;
+	pretrigger->num_slots = pre + post + queue + 1;
+	pretrigger->memory_size = slot_size * pretrigger->num_slots;
+	pretrigger->memory = mmap(NULL, pretrigger->memory_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (pretrigger->memory == MAP_FAILED) {
+		pretrigger->memory = NULL;
+		fprintf(stderr, "Unable to allocate %zu MB for the pre-trigger ring\n", pretrigger->memory_size >> 20);
+		return -ENOMEM;
+	}
+	// Avoid page faults in the capture loop.
+	pretrigger->locked = mlock(pretrigger->memory, pretrigger->memory_size) == 0;
+
+	if (vc_ring_init(&pretrigger->free, pretrigger->num_slots) ||
+	    vc_ring_init(&pretrigger->window, pre ? pre : 1) ||
+	    vc_ring_init(&pretrigger->pending, pretrigger->num_slots))
+		return -ENOMEM;
+
+	memset(&slot, 0, sizeof(slot));
+	for (index = 0; index < pretrigger->num_slots; index++) {
+		slot.index = index;
+		slot.data = (__u8 *)pretrigger->memory + index * slot_size;
+		slot.length = slot_size;
+		vc_ring_push(&pretrigger->free, &slot, 0);
+	}
+
+	return 0;
+}
+
+static void vc_pretrigger_free(struct vc_pretrigger *pretrigger)
+{
+	if (pretrigger->input >= 0)
+		close(pretrigger->input);
+	if (pretrigger->memory)
+		munmap(pretrigger->memory, pretrigger->memory_size);
+	if (pretrigger->free.slots) {
+		vc_ring_free(&pretrigger->free);
+		vc_ring_free(&pretrigger->window);
+		vc_ring_free(&pretrigger->pending);
+	}
+}
+
+// Passes the pending frames to the writer as far as the writer queue allows.
+// With block set, all pending frames are passed.
+static void vc_pretrigger_flush(struct vc_pretrigger *pretrigger, struct vc_recorder *recorder, int block)
+{
+	struct vc_slot slot;
+
+	while (pretrigger->pending.fill > 0 && (block || !vc_ring_full(&recorder->ring))) {
+		vc_ring_pop(&pretrigger->pending, &slot, 0);
+		vc_ring_push(&recorder->ring, &slot, 1);
+	}
+}
+
+// Copies the frame into the pool. Every step is O(1), the copy is the only
+// cost proportional to the frame size.
+static void vc_pretrigger_frame(struct vc_pretrigger *pretrigger, struct vc_recorder *recorder,
+	struct vc_slot *frame, struct vc_counters *counters)
+{
+	struct vc_slot slot;
+
+	if (trigger) {
+		trigger = 0;
+		if (pretrigger->remaining > 0) {
+			pretrigger->ignored++;
+		} else {
+			pretrigger->event++;
+			pretrigger->remaining = pretrigger->post;
+			while (vc_ring_pop(&pretrigger->window, &slot, 0)) {
+				slot.event = pretrigger->event;
+				vc_ring_push(&pretrigger->pending, &slot, 0);
+			}
+			fprintf(stderr, "Trigger %u at sequence %u\n", pretrigger->event, frame->sequence);
+		}
+	}
+
+	// Before the trigger the oldest frame of a full window is replaced. If
+	// the writer still holds the slots of the previous event, the window
+	// is shorter.
+	if (pretrigger->remaining == 0 && pretrigger->window.fill == pretrigger->pre && pretrigger->pre > 0) {
+		vc_ring_pop(&pretrigger->window, &slot, 0);
+	} else if (!vc_ring_pop(&pretrigger->free, &slot, 0) &&
+		   (pretrigger->remaining > 0 || !vc_ring_pop(&pretrigger->window, &slot, 0))) {
+		counters->dropped++;
+		vc_pretrigger_flush(pretrigger, recorder, 0);
+		return;
+	}
+
+	memcpy(slot.data, frame->data, frame->bytes);
+	slot.bytes = frame->bytes;
+	slot.sequence = frame->sequence;
+	slot.timestamp_us = frame->timestamp_us;
+	slot.exposure = frame->exposure;
+	slot.gain = frame->gain;
+	counters->frames++;
+
+	if (pretrigger->remaining > 0) {
+		slot.event = pretrigger->event;
+		vc_ring_push(&pretrigger->pending, &slot, 0);
+		pretrigger->remaining--;
+	} else if (pretrigger->pre > 0) {
+		slot.event = 0;
+		vc_ring_push(&pretrigger->window, &slot, 0);
+	} else {
+		vc_ring_push(&pretrigger->free, &slot, 0);
+	}
+
+	vc_pretrigger_flush(pretrigger, recorder, 0);
+}
+
+
+// *** Sources ****************************************************************
+
+static void vc_release_v4l2(struct vc_recorder *recorder, struct vc_slot *slot)
+{
+	vc_v4l2_queue(recorder->context, slot->index);
+}
+
+static void vc_release_synthetic(struct vc_recorder *recorder, struct vc_slot *slot)
+{
+	struct vc_synthetic *synthetic = recorder->context;
+
+	vc_ring_push(&synthetic->free, slot, 0);
+}
+
+// Returns 1 if the writer took the buffer, 0 if the source keeps it.
+static int vc_record_frame(struct vc_recorder *recorder, struct vc_pretrigger *pretrigger,
+	struct vc_slot *slot, int block, struct vc_counters *counters)
+{
+	if (pretrigger) {
+		vc_pretrigger_poll_input(pretrigger);
+		vc_pretrigger_frame(pretrigger, recorder, slot, counters);
+		return 0;
+	}
+
+	if (vc_ring_push(&recorder->ring, slot, block)) {
+		counters->dropped++;
+		return 0;
+	}
+	counters->frames++;
+	return 1;
+}
+
+static int vc_capture_v4l2(struct vc_recorder *recorder, struct vc_pretrigger *pretrigger,
+	struct vc_v4l2_dev *dev, int subdev, unsigned long count, struct vc_counters *counters)
+{
+	struct vc_v4l2_frame frame;
+	struct vc_slot slot;
+	__u32 last_sequence = 0;
+	int ret;
+
+	memset(&slot, 0, sizeof(slot));
+	while (!stop && (count == 0 || counters->frames + counters->dropped < count)) {
+		ret = vc_v4l2_dequeue(dev, &frame, 5000);
+		if (ret == -EAGAIN || ret == -EINTR)
+			continue;
+		if (ret == -ETIMEDOUT) {
+			fprintf(stderr, "Timeout while waiting for a frame\n");
+			continue;
+		}
+		if (ret)
+			return ret;
+
+		if (counters->frames + counters->dropped > 0 && frame.sequence > last_sequence + 1)
+			counters->gaps += frame.sequence - last_sequence - 1;
+		last_sequence = frame.sequence;
+
+		slot.index = frame.index;
+		slot.data = frame.data;
+		slot.length = dev->buffers[frame.index].length;
+		slot.bytes = frame.bytesused;
+		slot.sequence = frame.sequence;
+		slot.timestamp_us = frame.timestamp_us;
+		// The controls are cached by the driver, reading them costs no
+		// I2C transfer.
+		if (subdev >= 0) {
+			vc_v4l2_get_ctrl(subdev, V4L2_CID_EXPOSURE, &slot.exposure);
+			vc_v4l2_get_ctrl(subdev, V4L2_CID_GAIN, &slot.gain);
+		}
+
+		if (!vc_record_frame(recorder, pretrigger, &slot, 0, counters))
+			vc_v4l2_queue(dev, frame.index);
+	}
+
+	return 0;
+}
+
+// Produces frames at the given rate (0 = as fast as the writer accepts them)
+// from a set of prefilled buffers.
+static int vc_capture_synthetic(struct vc_recorder *recorder, struct vc_pretrigger *pretrigger,
+	struct vc_synthetic *synthetic, size_t frame_size, unsigned int fps, unsigned long count,
+	struct vc_counters *counters)
+{
+	struct timespec next;
+	struct vc_slot slot;
+	__u32 sequence = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop && (count == 0 || sequence < count)) {
+		if (fps > 0) {
+			next.tv_nsec += 1000000000 / fps;
+			if (next.tv_nsec >= 1000000000) {
+				next.tv_nsec -= 1000000000;
+				next.tv_sec++;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+
+		// Like the camera, a frame is lost if no buffer is available.
+		if (!vc_ring_pop(&synthetic->free, &slot, fps == 0)) {
+			counters->dropped++;
+			sequence++;
+			continue;
+		}
+
+		slot.bytes = frame_size;
+		slot.sequence = sequence++;
+		slot.timestamp_us = vc_v4l2_now_us();
+		// Keep the zero padded LSBs of the ISI memory layout.
+		((__u16 *)slot.data)[0] = (slot.sequence & 0xff) << VC_RAW_TO8_SHIFT;
+
+		if (!vc_record_frame(recorder, pretrigger, &slot, fps == 0, counters))
+			vc_ring_push(&synthetic->free, &slot, 0);
+	}
+
+	return 0;
+}
+
+static int vc_synthetic_init(struct vc_synthetic *synthetic, unsigned int num_buffers,
+	unsigned int width, unsigned int height, unsigned int bits)
+{
+	size_t frame_size = (size_t)width * height * sizeof(__u16);
+	size_t length = VC_ALIGN_UP(frame_size);
+	struct vc_slot slot;
+	unsigned int index;
+
+	if (vc_ring_init(&synthetic->free, num_buffers))
+		return -ENOMEM;
+	synthetic->buffers = calloc(num_buffers, sizeof(void *));
+	if (synthetic->buffers == NULL)
+		return -ENOMEM;
+	synthetic->num_buffers = num_buffers;
+
+	memset(&slot, 0, sizeof(slot));
+	for (index = 0; index < num_buffers; index++) {
+		if (posix_memalign(&synthetic->buffers[index], VC_ALIGN, length))
+			return -ENOMEM;
+		if (index == 0)
+			vc_raw_fill_scene(synthetic->buffers[0], width, height, bits);
+		else
+			memcpy(synthetic->buffers[index], synthetic->buffers[0], frame_size);
+		slot.index = index;
+		slot.data = synthetic->buffers[index];
+		slot.length = length;
+		vc_ring_push(&synthetic->free, &slot, 0);
+	}
+
+	return 0;
+}
+
+static void vc_synthetic_free(struct vc_synthetic *synthetic)
+{
+	unsigned int index;
+
+	for (index = 0; index < synthetic->num_buffers; index++)
+		free(synthetic->buffers[index]);
+	free(synthetic->buffers);
+	vc_ring_free(&synthetic->free);
+}
+
+
+// *** Decompression **********************************************************
+
+// Decompresses a recording of vcrecord -z into raw frames with the stride of
+// the width.
+static int vc_unpack(const char *input, const char *output, struct vc_pool *pool)
+{
+	struct vc_pack_params params, current = { 0 };
+	struct vc_pack *pack = NULL;
+	char index_name[512], line[256];
+	FILE *index = NULL, *out = NULL;
+	void *packed = NULL, *raw = NULL;
+	size_t packed_size = 0, bytes, frame_size = 0;
+	__u64 frames = 0, raw_bytes = 0, start, elapsed = 0;
+	long long offset;
+	int fd, ret = -EINVAL;
+
+	fd = open(input, O_RDONLY);
+	snprintf(index_name, sizeof(index_name), "%s.idx", input);
+	index = fopen(index_name, "r");
+	out = strcmp(output, "-") == 0 ? stdout : fopen(output, "w");
+	if (fd < 0 || !index || !out) {
+		fprintf(stderr, "Unable to open %s, %s or %s\n", input, index_name, output);
+		goto close;
+	}
+
+	while (fgets(line, sizeof(line), index)) {
+		if (sscanf(line, "%*u,%*u,%*u,%*d,%*d,%lld,%zu", &offset, &bytes) != 2)
+			continue;
+		if (bytes > packed_size) {
+			free(packed);
+			packed_size = bytes;
+			packed = malloc(packed_size);
+			if (packed == NULL)
+				goto close;
+		}
+		if (pread(fd, packed, bytes, offset) != (ssize_t)bytes ||
+		    vc_pack_info(packed, bytes, &params)) {
+			fprintf(stderr, "Frame %llu is not compressed by vcpack\n", (unsigned long long)frames);
+			goto close;
+		}
+		if (pack == NULL || memcmp(&params, &current, sizeof(params))) {
+			vc_pack_destroy(pack);
+			free(raw);
+			current = params;
+			frame_size = (size_t)params.width * params.height * sizeof(__u16);
+			pack = vc_pack_create(&params, pool);
+			raw = malloc(frame_size);
+			if (!pack || !raw)
+				goto close;
+		}
+
+		start = vc_v4l2_now_us();
+		ret = vc_pack_decompress(pack, packed, bytes, raw);
+		elapsed += vc_v4l2_now_us() - start;
+		if (ret) {
+			fprintf(stderr, "Frame %llu is corrupt\n", (unsigned long long)frames);
+			goto close;
+		}
+		if (fwrite(raw, frame_size, 1, out) != 1) {
+			ret = -EIO;
+			goto close;
+		}
+		frames++;
+		raw_bytes += frame_size;
+	}
+	ret = 0;
+
+	fprintf(stderr, "frames: %llu, decompressed: %.1f MB, %.1f MB/s\n", (unsigned long long)frames,
+		raw_bytes / 1e6, elapsed ? (double)raw_bytes / elapsed : 0.0);
+
+close:
+	if (out && out != stdout)
+		fclose(out);
+	if (index)
+		fclose(index);
+	if (fd >= 0)
+		close(fd);
+	vc_pack_destroy(pack);
+	free(packed);
+	free(raw);
+
+	return ret;
+}
+
+
+// *** Main *******************************************************************
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [options] -o <file>\n", name);
+	printf("\n");
+	printf("Records raw frames to disk. The sidecar index is written to <file>.idx.\n");
+	printf("With -U <file> a compressed recording is decompressed to -o <file>.\n");
+	printf("\n");
+	printf("Supported options:\n");
+	printf("-b, --buffers <n>          Number of V4L2 buffers (Default: 8)\n");
+	printf("-B, --bench                Synthetic benchmark without camera\n");
+	printf("-d, --device <dev>         Video device (Default: /dev/video0)\n");
+	printf("-f, --format <fourcc>      Set the pixel format (Benchmark default: RG12)\n");
+	printf("-h, --height <pixel>       Set the image height\n");
+	printf("-m, --io <mode>            Write mode: direct, buffered or uring (Default: direct)\n");
+	printf("-n, --count <n>            Number of frames (Default: 0 = until Ctrl+C)\n");
+	printf("-o, --output <file>        Output file\n");
+	printf("-p, --pre <n>              Pre-trigger mode, keep the last n frames in memory\n");
+	printf("-P, --post <n>             Frames to record from the trigger on (Default: 0)\n");
+	printf("-q, --queue <n>            Depth of the writer ring (Default: buffers - 2)\n");
+	printf("-r, --framerate <fps>      Frame rate of the synthetic source (Default: 0 = unlimited)\n");
+	printf("-s, --subdev <dev>         Sub device for exposure and gain (Default: /dev/v4l-subdev1)\n");
+	printf("-t, --threads <n>          Compression threads (Default: 0 = all CPUs)\n");
+	printf("-T, --trigger <file>       Trigger input: FIFO or GPIO value file with edge (Default: SIGUSR1 only)\n");
+	printf("-U, --unpack <file>        Decompress a recording\n");
+	printf("-w, --width <pixel>        Set the image width\n");
+	printf("-z, --compress             Compress the frames losslessly\n");
+	printf("    --help                 Show this help text\n");
+	printf("\n");
+	printf("Benchmark: %s -B -w 5440 -h 3648 -r 20 -n 400 -o /mnt/disk/bench.raw\n", name);
+	printf("Pre-trigger: %s -p 120 -P 60 -o event.raw & kill -USR1 $!\n", name);
+}
+
+static __u32 parse_fourcc(const char *str)
+{
+	char fourcc[4] = { ' ', ' ', ' ', ' ' };
+	size_t len = strlen(str);
+
+	memcpy(fourcc, str, len > 4 ? 4 : len);
+	return v4l2_fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "buffers",   required_argument, NULL, 'b' },
+		{ "bench",     no_argument,       NULL, 'B' },
+		{ "device",    required_argument, NULL, 'd' },
+		{ "format",    required_argument, NULL, 'f' },
+		{ "height",    required_argument, NULL, 'h' },
+		{ "io",        required_argument, NULL, 'm' },
+		{ "count",     required_argument, NULL, 'n' },
+		{ "output",    required_argument, NULL, 'o' },
+		{ "pre",       required_argument, NULL, 'p' },
+		{ "post",      required_argument, NULL, 'P' },
+		{ "queue",     required_argument, NULL, 'q' },
+		{ "framerate", required_argument, NULL, 'r' },
+		{ "subdev",    required_argument, NULL, 's' },
+		{ "threads",   required_argument, NULL, 't' },
+		{ "trigger",   required_argument, NULL, 'T' },
+		{ "unpack",    required_argument, NULL, 'U' },
+		{ "width",     required_argument, NULL, 'w' },
+		{ "compress",  no_argument,       NULL, 'z' },
+		{ "help",      no_argument,       NULL, 'H' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const char *device = "/dev/video0";
+	const char *subdev_name = "/dev/v4l-subdev1";
+	const char *output = NULL;
+	const char *trigger_input = NULL;
+	const char *unpack = NULL;
+	unsigned int buffers = 8, queue = 0, fps = 0, pre = 0, post = 0, threads = 0;
+	unsigned long count = 0;
+	__u32 width = 0, height = 0, pixelformat = 0;
+	int bench = 0, compress = 0, subdev = -1, ret = -1, opt;
+	const struct vc_raw_format *format;
+	struct vc_pack_params params;
+	struct vc_pool *pool = NULL;
+	struct vc_pretrigger pretrigger, *pt = NULL;
+	struct vc_recorder recorder;
+	struct vc_synthetic synthetic;
+	struct vc_counters counters;
+	struct vc_v4l2_dev dev;
+	pthread_t writer;
+	void *(*writer_fn)(void *) = vc_writer_pwrite;
+	size_t frame_size;
+	__u64 start, elapsed;
+	char fourcc[5];
+
+	memset(&recorder, 0, sizeof(recorder));
+	memset(&synthetic, 0, sizeof(synthetic));
+	memset(&counters, 0, sizeof(counters));
+	memset(&pretrigger, 0, sizeof(pretrigger));
+	recorder.fd = -1;
+	pretrigger.input = -1;
+
+	while ((opt = getopt_long(argc, argv, "b:Bd:f:h:m:n:o:p:P:q:r:s:t:T:U:w:z", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'b': buffers = strtoul(optarg, NULL, 0); break;
+		case 'B': bench = 1; break;
+		case 'd': device = optarg; break;
+		case 'f': pixelformat = parse_fourcc(optarg); break;
+		case 'h': height = strtoul(optarg, NULL, 0); break;
+		case 'm':
+			if (strcmp(optarg, "direct") == 0) {
+				recorder.io = VC_RECORD_DIRECT;
+			} else if (strcmp(optarg, "buffered") == 0) {
+				recorder.io = VC_RECORD_BUFFERED;
+			} else if (strcmp(optarg, "uring") == 0) {
+#ifdef HAVE_LIBURING
+				recorder.io = VC_RECORD_URING;
+#else
+				fprintf(stderr, "vcrecord was built without liburing\n");
+				return 1;
+#endif
+			} else {
+				fprintf(stderr, "Unknown write mode %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'n': count = strtoul(optarg, NULL, 0); break;
+		case 'o': output = optarg; break;
+		case 'p': pre = strtoul(optarg, NULL, 0); pt = &pretrigger; break;
+		case 'P': post = strtoul(optarg, NULL, 0); pt = &pretrigger; break;
+		case 'q': queue = strtoul(optarg, NULL, 0); break;
+		case 'r': fps = strtoul(optarg, NULL, 0); break;
+		case 's': subdev_name = optarg; break;
+		case 't': threads = strtoul(optarg, NULL, 0); break;
+		case 'T': trigger_input = optarg; pt = &pretrigger; break;
+		case 'U': unpack = optarg; break;
+		case 'w': width = strtoul(optarg, NULL, 0); break;
+		case 'z': compress = 1; break;
+		case 'H': usage(argv[0]); return 0;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (output == NULL) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (unpack) {
+		pool = vc_pool_create(threads);
+		ret = vc_unpack(unpack, output, pool);
+		vc_pool_destroy(pool);
+		return ret ? 1 : 0;
+	}
+	if (buffers < 3)
+		buffers = 3;
+	if (queue == 0)
+		queue = buffers - 2;
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	signal(SIGUSR1, signal_handler);
+
+	if (bench) {
+		if (width == 0 || height == 0) {
+			fprintf(stderr, "The benchmark needs the image size (-w, -h)\n");
+			return 1;
+		}
+		if (pixelformat == 0)
+			pixelformat = V4L2_PIX_FMT_SRGGB12;
+		format = vc_raw_get_format(pixelformat);
+		if (format == NULL) {
+			fprintf(stderr, "Unknown pixel format\n");
+			return 1;
+		}
+		frame_size = (size_t)width * height * 2;
+		if (vc_synthetic_init(&synthetic, buffers, width, height, format->bits)) {
+			fprintf(stderr, "Unable to allocate the frame buffers\n");
+			return 1;
+		}
+		recorder.release = vc_release_synthetic;
+		recorder.context = &synthetic;
+	} else {
+		if (vc_v4l2_open(&dev, device))
+			return 1;
+		if ((width || height || pixelformat) && vc_v4l2_set_format(&dev, width, height, pixelformat))
+			goto close;
+		if (vc_v4l2_alloc_buffers(&dev, VC_IO_MMAP, buffers))
+			goto close;
+		subdev = vc_v4l2_subdev_open(subdev_name);
+		frame_size = dev.sizeimage;
+		width = dev.width;
+		height = dev.height;
+		pixelformat = dev.pixelformat;
+		format = vc_raw_get_format(pixelformat);
+		recorder.release = vc_release_v4l2;
+		recorder.context = &dev;
+	}
+
+	if (compress) {
+		if (format == NULL) {
+			fprintf(stderr, "The pixel format can not be compressed\n");
+			goto close;
+		}
+		memset(&params, 0, sizeof(params));
+		params.width = width;
+		params.height = height;
+		params.bits = format->bits;
+		params.msb = VC_RAW_MSB_BIT;
+		params.bayer = format->bayer;
+		params.stride = bench ? width * sizeof(__u16) : dev.bytesperline;
+		pool = vc_pool_create(threads);
+		recorder.pack = vc_pack_create(&params, pool);
+		if (recorder.pack == NULL) {
+			fprintf(stderr, "Unable to set up the compression\n");
+			goto close;
+		}
+	}
+
+	if (pt) {
+		if (vc_pretrigger_init(pt, pre, post, queue, frame_size))
+			goto close;
+		if (trigger_input && vc_pretrigger_open_input(pt, trigger_input))
+			goto close;
+		recorder.release = vc_release_pretrigger;
+		recorder.context = pt;
+		fprintf(stderr, "pre-trigger: %u + %u frames, pool: %u slots, memory: %.1f MB (%s)\n",
+			pre, post, pt->num_slots, pt->memory_size / 1e6,
+			pt->locked ? "locked" : "not locked");
+	}
+
+	if (vc_ring_init(&recorder.ring, queue) ||
+	    vc_recorder_open(&recorder, output, frame_size, pt ? 0 : count))
+		goto close;
+
+	fprintf(recorder.index, "# width=%u,height=%u,pixelformat=%s,frame_size=%zu,slot_size=%zu,compression=%s\n",
+		width, height, vc_v4l2_fourcc(pixelformat, fourcc), frame_size, recorder.slot_size,
+		recorder.pack ? "vcpack" : "none");
+	fprintf(recorder.index, "frame,sequence,timestamp_us,exposure,gain,offset,bytes,event\n");
+
+#ifdef HAVE_LIBURING
+	if (recorder.io == VC_RECORD_URING)
+		writer_fn = vc_writer_uring;
+#endif
+	pthread_create(&writer, NULL, writer_fn, &recorder);
+
+	start = vc_v4l2_now_us();
+	if (bench) {
+		ret = vc_capture_synthetic(&recorder, pt, &synthetic, frame_size, fps, count, &counters);
+	} else {
+		ret = vc_v4l2_start(&dev);
+		if (ret == 0)
+			ret = vc_capture_v4l2(&recorder, pt, &dev, subdev, count, &counters);
+	}
+	if (pt)
+		vc_pretrigger_flush(pt, &recorder, 1);
+
+	vc_ring_close(&recorder.ring);
+	pthread_join(writer, NULL);
+	elapsed = vc_v4l2_now_us() - start;
+	if (!bench)
+		vc_v4l2_stop(&dev);
+
+	fprintf(stderr, "frames: %llu, written: %llu, dropped: %llu, sequence gaps: %llu, errors: %llu\n",
+		(unsigned long long)(counters.frames + counters.dropped),
+		(unsigned long long)recorder.frames, (unsigned long long)counters.dropped,
+		(unsigned long long)counters.gaps, (unsigned long long)recorder.errors);
+	fprintf(stderr, "written: %.1f MB in %.2f s, sustained: %.1f MB/s, max queue fill: %u/%u\n",
+		recorder.bytes / 1e6, elapsed / 1e6, elapsed ? (double)recorder.bytes / elapsed : 0.0,
+		recorder.ring.max_fill, recorder.ring.size);
+	if (recorder.pack)
+		fprintf(stderr, "compression: %u threads, stored: %.1f MB, %.1f MB/s, ratio: %.2f\n",
+			vc_pool_threads(pool), recorder.stored / 1e6,
+			elapsed ? (double)recorder.stored / elapsed : 0.0,
+			recorder.stored ? (double)recorder.bytes / recorder.stored : 0.0);
+	if (pt)
+		fprintf(stderr, "events: %u, ignored triggers: %llu\n", pt->event, (unsigned long long)pt->ignored);
+
+close:
+	vc_recorder_close(&recorder);
+	vc_pack_destroy(recorder.pack);
+	vc_pool_destroy(pool);
+	vc_pretrigger_free(&pretrigger);
+	if (recorder.ring.slots)
+		vc_ring_free(&recorder.ring);
+	if (bench) {
+		vc_synthetic_free(&synthetic);
+	} else {
+		if (subdev >= 0)
+			close(subdev);
+		vc_v4l2_close(&dev);
+	}
+
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+#!/usr/bin/env bash
+
+usage() {
+        echo "Usage: $0 [options]"
+        echo ""
+        echo "Script to measure the I2C bus cost of the standard driver operations."
+        echo "The result is printed as CSV to stdout."
+        echo ""
+        echo "Supported options:"
+        echo "-d, --device              Video device number (Default: 0)"
+        echo "-e, --emulator            Reload vc_mipi_emu for each of the given profiles, e.g."
+        echo "                          \"IMX290 IMX415\" (Default: all profiles) and append a"
+        echo "                          table of the emulator statistics per profile"
+        echo "-h, --help                Show this help text"
+        echo "-s, --subdevice           Subdevice number (Default: 1)"
+        echo "-t, --trigger             Trigger mode used for the trigger tests (Default: 1)"
+}
+
+device=0
+subdevice=1
+trigger=1
+emulator=0
+profiles="IMX178 IMX183 IMX226 IMX250 IMX252 IMX264 IMX265 IMX273 IMX290 IMX296 IMX327 IMX392 IMX412 IMX415 OV9281"
+
+while [ $# != 0 ] ; do
+	option="$1"
+	shift
+
+	case "${option}" in
+	-d|--device)
+		device="$1"
+		shift
+		;;
+	-e|--emulator)
+		emulator=1
+		if [ $# != 0 ] && [ "${1#-}" = "$1" ]; then
+			profiles="$1"
+			shift
+		fi
+		;;
+	-h|--help)
+		usage
+		exit 0
+		;;
+	-s|--subdevice)
+		subdevice="$1"
+		shift
+		;;
+	-t|--trigger)
+		trigger="$1"
+		shift
+		;;
+	*)
+		echo "Unknown option ${option}"
+		exit 1
+		;;
+	esac
+done
+
+video="/dev/video${device}"
+subdev="/dev/v4l-subdev${subdevice}"
+
+kernel_log() {
+	journalctl -k -o cat 2>/dev/null || dmesg
+}
+
+to_csv() {
+	sed -n 's/.*bus-cost //p' | while read -r line; do
+		row=
+		for pair in ${line}; do
+			row="${row:+${row},}${pair#*=}"
+		done
+		echo "${row}"
+	done
+}
+
+# Prints all bus-cost lines which have been logged since the last call as CSV. In emulator mode
+# each row starts with the profile.
+log_lines=0
+prefix=
+report() {
+	local lines
+	lines="$(kernel_log | grep -e 'bus-cost')"
+	echo "${lines}" | tail -n +$((log_lines + 1)) | to_csv | sed "s/^/${prefix}/"
+	log_lines="$(echo "${lines}" | grep -c -e 'bus-cost')"
+}
+
+stream() {
+	v4l2-ctl -d "${video}" --stream-mmap --stream-count="$1" > /dev/null 2>&1
+}
+
+measure() {
+	# set_fmt and STREAMON from cold (mode change forces a module reset)
+	v4l2-ctl -d "${video}" --set-fmt-video=pixelformat=GREY > /dev/null 2>&1
+	stream 1
+	report
+
+	# STREAMON from warm (mode unchanged)
+	stream 1
+	report
+
+	# Exposure and gain change while streaming
+	stream 30 &
+	sleep 0.5
+	v4l2-ctl -d "${subdev}" -c exposure=20000
+	v4l2-ctl -d "${subdev}" -c gain=10
+	wait
+	report
+
+	# Trigger mode change and single trigger
+	v4l2-ctl -d "${subdev}" -c trigger_mode="${trigger}"
+	v4l2-ctl -d "${subdev}" -c single_trigger=1
+	v4l2-ctl -d "${subdev}" -c trigger_mode=0
+	report
+}
+
+if [ ${emulator} = 0 ]; then
+	echo "op,mod_id,transfers,msgs,bytes,bits,errors,sleep_us,bus100k_us,bus400k_us"
+
+	# probe has been measured at boot time. Only the first report is relevant.
+	kernel_log | grep -e 'bus-cost op=probe' | head -n 1 | to_csv
+	report > /dev/null
+
+	measure
+	exit 0
+fi
+
+# The emulator is reloaded with the module parameter profile for each profile. The probe runs at
+# load time and is reported together with the other operations.
+echo "profile,op,mod_id,transfers,msgs,bytes,bits,errors,sleep_us,bus100k_us,bus400k_us"
+report > /dev/null
+
+stats="profile,transfers,faults,resets,mode_errors,stream_starts,single_triggers"
+for profile in ${profiles}; do
+	prefix="${profile},"
+	modprobe -r vc_mipi_emu
+	if ! modprobe vc_mipi_emu profile="${profile}"; then
+		echo "Failed to load vc_mipi_emu with profile ${profile}" >&2
+		continue
+	fi
+	sleep 1
+
+	# Without a CSI-2 receiver in the graph there is no video device and only the probe runs.
+	if [ -e "${video}" ]; then
+		measure
+	else
+		report
+	fi
+
+	row="${profile}"
+	for file in /sys/bus/platform/drivers/vc-mipi-emu/*/stats; do
+		[ -e "${file}" ] || continue
+		while read -r name value; do
+			row="${row},${value}"
+		done < "${file}"
+	done
+	stats="${stats}
+${row}"
+done
+modprobe -r vc_mipi_emu
+
+echo ""
+echo "${stats}"
@@ -110,7 +110,6 @@ while [ $# != 0 ] ; do
 		;;
 	--gst)
 		gstreamer=1
-		shift
 		;;
 	-h|--help)
 		usage
@@ -156,34 +155,49 @@ while [ $# != 0 ] ; do
 done
 
 get_image_size
-v4l2-ctl -d "/dev/video${device}" --set-fmt-video="width=${width},height=${height}"
 
-if [[ -n ${format} ]]; then
-        echo "Set format: ${format}"
-        v4l2-ctl -d "/dev/video${device}" --set-fmt-video=pixelformat="${format}"
-fi
-if [[ -n ${framerate} ]]; then
-        echo "Set frame rate: ${framerate}"
-        v4l2-ctl -d "/dev/v4l-subdev${subdevice}" -c frame_rate="${framerate}"
-fi
-if [[ -n ${trigger} ]]; then
-        echo "Set trigger mode: ${trigger}"
-        v4l2-ctl -d "/dev/v4l-subdev${subdevice}" -c trigger_mode="${trigger}"
-fi
-if [[ -n ${flash} ]]; then
-        echo "Set flash mode: ${flash}"
-        v4l2-ctl -d "/dev/v4l-subdev${subdevice}" -c flash_mode="${flash}"
-fi
-if [[ -n ${blacklevel} ]]; then
-        echo "Set black level: ${blacklevel}"
-        v4l2-ctl -d "/dev/v4l-subdev${subdevice}" -c black_level="${blacklevel}"
+vcctl="$(command -v vcctl || echo /home/root/test/vcctl)"
+if [[ -x ${vcctl} ]]; then
+	# Applies the format and all controls at once and reports the time.
+	settings=("device=/dev/video${device}" "subdev=/dev/v4l-subdev${subdevice}" "width=${width}" "height=${height}")
+	[[ -n ${format} ]] && settings+=("format=${format}")
+	[[ -n ${framerate} ]] && settings+=("frame_rate=${framerate}")
+	[[ -n ${trigger} ]] && settings+=("trigger_mode=${trigger}")
+	[[ -n ${flash} ]] && settings+=("flash_mode=${flash}")
+	[[ -n ${blacklevel} ]] && settings+=("black_level=${blacklevel}")
+	echo "Set ${settings[*]}"
+	"${vcctl}" "${settings[@]}" || exit 1
+else
+	v4l2-ctl -d "/dev/video${device}" --set-fmt-video="width=${width},height=${height}"
+
+	if [[ -n ${format} ]]; then
+	        echo "Set format: ${format}"
+	        v4l2-ctl -d "/dev/video${device}" --set-fmt-video=pixelformat="${format}"
+	fi
+	if [[ -n ${framerate} ]]; then
+	        echo "Set frame rate: ${framerate}"
+	        v4l2-ctl -d "/dev/v4l-subdev${subdevice}" -c frame_rate="${framerate}"
+	fi
+	if [[ -n ${trigger} ]]; then
+	        echo "Set trigger mode: ${trigger}"
+	        v4l2-ctl -d "/dev/v4l-subdev${subdevice}" -c trigger_mode="${trigger}"
+	fi
+	if [[ -n ${flash} ]]; then
+	        echo "Set flash mode: ${flash}"
+	        v4l2-ctl -d "/dev/v4l-subdev${subdevice}" -c flash_mode="${flash}"
+	fi
+	if [[ -n ${blacklevel} ]]; then
+	        echo "Set black level: ${blacklevel}"
+	        v4l2-ctl -d "/dev/v4l-subdev${subdevice}" -c black_level="${blacklevel}"
+	fi
 fi
 
 if [[ -n ${gstreamer} ]]; then
+	# v4l2src exports the capture buffers as dmabuf, the sink imports them.
 	gst-launch-1.0 -v --gst-debug-level=3 \
-		 v4l2src device="/dev/video${device}" ! \
-		"video/x-raw,width=${width},height=${height},format=NV12,framerate=0/1" ! \
-                 videoconvert ! autovideosink
+		 v4l2src device="/dev/video${device}" io-mode=dmabuf ! \
+		"video/x-raw,width=${width},height=${height},framerate=0/1" ! \
+                 autovideosink sync=false
 
 else 
 	vcmipidemo -d"${device}" -2 -a"${option2}" "${optionY}" -s"${shutter}" -g"${gain}"
@@ -0,0 +1,132 @@
+#!/bin/bash
+
+usage() {
+        echo "Usage: $0 [options]"
+        echo ""
+        echo "Compares CPU load and frame rate of the pipe based capture (vccapture | fdsrc),"
+        echo "the default v4l2src (io-mode=mmap) and the zero-copy v4l2src (io-mode=dmabuf)"
+        echo "in the full resolution mode of the connected sensor. The result is printed as CSV."
+        echo ""
+        echo "Supported options:"
+        echo "-c, --color               Color sensor (uses bayer caps)"
+        echo "-d, --device              Video device (Default: /dev/video0)"
+        echo "-n, --num-buffers         Number of frames per run (Default: 300)"
+        echo "-s, --sink                Sink element (Default: fakesink)"
+        echo "    --help                Show this help text"
+}
+
+device=/dev/video0
+num_buffers=300
+sink=fakesink
+color=
+
+while [ $# != 0 ] ; do
+	option="$1"
+	shift
+
+	case "${option}" in
+	-c|--color)
+		color=1
+		;;
+	-d|--device)
+		device="$1"
+		shift
+		;;
+	-n|--num-buffers)
+		num_buffers="$1"
+		shift
+		;;
+	-s|--sink)
+		sink="$1"
+		shift
+		;;
+	--help)
+		usage
+		exit 0
+		;;
+	*)
+		echo "Unknown option ${option}"
+		exit 1
+		;;
+	esac
+done
+
+test_dir=$(dirname "$0")
+sensor="$(journalctl -k | grep -oe '5-0.*SENSOR.*' | grep -oe 'IMX[0-9]*\|OV[0-9]*' | head -n 1)"
+
+case "${sensor}" in
+	IMX178) width=3072 height=2076 ;;
+	IMX183) width=5440 height=3648 ;;
+	IMX226) width=3840 height=3046 ;;
+	IMX250) width=2448 height=2048 ;;
+	IMX252) width=2048 height=1536 ;;
+	IMX264) width=2432 height=2048 ;;
+	IMX265) width=2048 height=1536 ;;
+	IMX273) width=1440 height=1080 ;;
+	IMX290) width=1920 height=1080 ;;
+	IMX296) width=1440 height=1080 ;;
+	IMX327) width=1920 height=1080 ;;
+	IMX392) width=1920 height=1200 ;;
+	IMX412) width=4032 height=3040 ;;
+	IMX415) width=3840 height=2160 ;;
+	OV9281) width=1280 height=800  ;;
+	*)
+		echo "Connected Sensor Type ${sensor} is unknown!"
+		exit 1
+	;;
+esac
+
+if [[ -n ${color} ]]; then
+	v4l2_format=RGGB
+	gst_format=rggb
+else
+	v4l2_format=GREY
+	gst_format=GRAY8
+fi
+
+# The ISI writes every pixel into a 16 bit container.
+frame_size=$(( width * height * 2 ))
+
+# Prints the busy and total jiffies of all CPUs.
+cpu_jiffies() {
+	awk '/^cpu / { print $2+$3+$4+$7+$8, $2+$3+$4+$5+$6+$7+$8 }' /proc/stat
+}
+
+run() {
+	local mode="$1"
+	shift
+	local busy0 total0 busy1 total1 start end
+
+	read -r busy0 total0 <<< "$(cpu_jiffies)"
+	start=$(date +%s.%N)
+	"$@" > /dev/null 2>&1
+	end=$(date +%s.%N)
+	read -r busy1 total1 <<< "$(cpu_jiffies)"
+
+	awk -v sensor="${sensor}" -v mode="${mode}" -v w="${width}" -v h="${height}" -v fmt="${v4l2_format}" \
+	    -v n="${num_buffers}" -v t0="${start}" -v t1="${end}" \
+	    -v b="$(( busy1 - busy0 ))" -v t="$(( total1 - total0 ))" \
+	    'BEGIN { s = t1 - t0; printf "%s,%s,%d,%d,%s,%d,%.2f,%.2f,%.1f\n", sensor, mode, w, h, fmt, n, s, n / s, t ? 100 * b / t : 0 }'
+}
+
+pipe() {
+	"${test_dir}/vccapture" -d "${device}" -n "${num_buffers}" -o - | \
+	gst-launch-1.0 fdsrc blocksize="${frame_size}" num-buffers="${num_buffers}" ! \
+		rawvideoparse width="${width}" height="${height}" format=gray16-le ! ${sink} sync=false
+}
+
+v4l2src_mmap() {
+	gst-launch-1.0 v4l2src device="${device}" io-mode=mmap num-buffers="${num_buffers}" ! ${sink} sync=false
+}
+
+v4l2src_dmabuf() {
+	"${test_dir}/gst_dmabuf.sh" -d "${device}" -w "${width}" -h "${height}" -f "${gst_format}" \
+		-n "${num_buffers}" -s "${sink}"
+}
+
+v4l2-ctl -d "${device}" --set-fmt-video=width="${width}",height="${height}",pixelformat="${v4l2_format}"
+
+echo "sensor,mode,width,height,format,frames,seconds,fps,cpu_percent"
+run pipe pipe
+run mmap v4l2src_mmap
+run dmabuf v4l2src_dmabuf
@@ -0,0 +1,99 @@
+#!/bin/bash
+
+usage() {
+        echo "Usage: $0 [options]"
+        echo ""
+        echo "Reference zero-copy pipeline. v4l2src exports the capture buffers as dmabuf"
+        echo "and the downstream elements import them without copying the frames."
+        echo ""
+        echo "Supported options:"
+        echo "-d, --device              Video device (Default: /dev/video0)"
+        echo "-f, --format              GStreamer format (Options: GRAY8, rggb, gbrg, ...) (Default: GRAY8)"
+        echo "-h, --height              Image height"
+        echo "-n, --num-buffers         Stop after n frames (Default: endless)"
+        echo "-s, --sink                Sink element (Default: waylandsink, use fakesink to benchmark)"
+        echo "-w, --width               Image width"
+        echo "    --help                Show this help text"
+}
+
+device=/dev/video0
+format=GRAY8
+width=
+height=
+sink=waylandsink
+num_buffers=-1
+
+while [ $# != 0 ] ; do
+	option="$1"
+	shift
+
+	case "${option}" in
+	-d|--device)
+		device="$1"
+		shift
+		;;
+	-f|--format)
+		format="$1"
+		shift
+		;;
+	-h|--height)
+		height="$1"
+		shift
+		;;
+	-n|--num-buffers)
+		num_buffers="$1"
+		shift
+		;;
+	-s|--sink)
+		sink="$1"
+		shift
+		;;
+	-w|--width)
+		width="$1"
+		shift
+		;;
+	--help)
+		usage
+		exit 0
+		;;
+	*)
+		echo "Unknown option ${option}"
+		exit 1
+		;;
+	esac
+done
+
+if [[ -z ${width} || -z ${height} ]]; then
+	usage
+	exit 1
+fi
+
+# Bayer formats are transported as video/x-bayer.
+case "${format}" in
+	rggb|gbrg|grbg|bggr) caps="video/x-bayer,format=${format}" ;;
+	*) caps="video/x-raw,format=${format}" ;;
+esac
+caps="${caps},width=${width},height=${height}"
+
+# imxvideoconvert_g2d imports the dmabuf and scales on the 2D GPU. Without
+# it, videoconvert maps the buffers and the CPU touches every pixel.
+if gst-inspect-1.0 imxvideoconvert_g2d > /dev/null 2>&1; then
+	convert="imxvideoconvert_g2d"
+else
+	echo "imxvideoconvert_g2d is not available, falling back to videoconvert (copies every frame)"
+	convert="videoconvert ! videoscale"
+fi
+
+case "${sink}" in
+	waylandsink)
+		export XDG_RUNTIME_DIR=/run/user/0
+		tail="${convert} ! video/x-raw,width=640,height=400 ! waylandsink sync=false"
+		;;
+	*)
+		tail="${sink} sync=false"
+		;;
+esac
+
+gst-launch-1.0 -v \
+	v4l2src device="${device}" io-mode=dmabuf num-buffers="${num_buffers}" ! "${caps}" ! \
+	${tail}
@@ -0,0 +1,58 @@
+// KUnit of the host build. Supports the test cases, expectations and assertions used by the
+// driver tests, suites are run by vckunit.c.
+#pragma once
+#include <setjmp.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+
+struct kunit {
+	const char *name;
+	int failed;
+	jmp_buf abort;			// Target of failed assertions
+	void **allocs;
+	int num_allocs;
+};
+
+struct kunit_case {
+	void (*run_case)(struct kunit *test);
+	const char *name;
+};
+
+struct kunit_suite {
+	const char *name;
+	int (*init)(struct kunit *test);
+	void (*exit)(struct kunit *test);
+	struct kunit_case *test_cases;
+};
+
+#define KUNIT_CASE(test_name) { .run_case = test_name, .name = #test_name }
+
+void vc_host_kunit_register(struct kunit_suite *suite);
+
+#define kunit_test_suite(suite) \
+	static void __attribute__((constructor)) __kunit_##suite##_register(void) \
+	{ vc_host_kunit_register(&suite); }
+
+void *kunit_kzalloc(struct kunit *test, size_t size, gfp_t gfp);
+void vc_host_kunit_fail(struct kunit *test, int assert, const char *file, int line,
+	const char *fmt, ...) __attribute__((format(printf, 5, 6)));
+
+#define KUNIT_BINARY_CHECK(test, assert, left, op, right, fmt, ...) do { \
+	typeof(left) __left = (left); \
+	typeof(right) __right = (right); \
+	if (!(__left op __right)) \
+		vc_host_kunit_fail(test, assert, __FILE__, __LINE__, \
+			"%s %s %s (%lld %s %lld) " fmt, #left, #op, #right, \
+			(long long)__left, #op, (long long)__right, ##__VA_ARGS__); \
+} while (0)
+
+#define KUNIT_EXPECT_EQ(test, left, right)	KUNIT_BINARY_CHECK(test, 0, left, ==, right, "")
+#define KUNIT_EXPECT_NE(test, left, right)	KUNIT_BINARY_CHECK(test, 0, left, !=, right, "")
+#define KUNIT_EXPECT_LE(test, left, right)	KUNIT_BINARY_CHECK(test, 0, left, <=, right, "")
+#define KUNIT_EXPECT_GE(test, left, right)	KUNIT_BINARY_CHECK(test, 0, left, >=, right, "")
+#define KUNIT_EXPECT_EQ_MSG(test, left, right, fmt, ...) \
+	KUNIT_BINARY_CHECK(test, 0, left, ==, right, fmt, ##__VA_ARGS__)
+#define KUNIT_EXPECT_TRUE(test, cond)		KUNIT_BINARY_CHECK(test, 0, !!(cond), ==, 1, "")
+#define KUNIT_ASSERT_EQ(test, left, right)	KUNIT_BINARY_CHECK(test, 1, left, ==, right, "")
+#define KUNIT_ASSERT_TRUE(test, cond)		KUNIT_BINARY_CHECK(test, 1, !!(cond), ==, 1, "")
+#define KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ptr)	KUNIT_BINARY_CHECK(test, 1, !!(ptr), ==, 1, "")
@@ -0,0 +1,6 @@
+#pragma once
+#include <linux/kernel.h>
+
+void usleep_range(unsigned long min, unsigned long max);
+void msleep(unsigned int msecs);
+void udelay(unsigned long usecs);
@@ -0,0 +1,46 @@
+#pragma once
+#include <linux/kernel.h>
+
+struct device_node;
+struct fwnode_handle;
+
+struct device {
+	struct device *parent;
+	char name[32];
+	struct device_node *of_node;
+	void *driver_data;
+};
+
+struct device_attribute {
+	const char *name;
+	ssize_t (*show)(struct device *dev, struct device_attribute *attr, char *buf);
+	ssize_t (*store)(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+};
+
+#define DEVICE_ATTR_RO(_name) \
+	struct device_attribute dev_attr_##_name = { .name = #_name, .show = _name##_show }
+
+#define LOGLEVEL_ERR		3
+#define LOGLEVEL_WARNING	4
+#define LOGLEVEL_NOTICE		5
+#define LOGLEVEL_INFO		6
+#define LOGLEVEL_DEBUG		7
+
+void vc_host_log(int level, const struct device *dev, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+#define dev_err(dev, fmt, ...)		vc_host_log(LOGLEVEL_ERR, dev, fmt, ##__VA_ARGS__)
+#define dev_warn(dev, fmt, ...)		vc_host_log(LOGLEVEL_WARNING, dev, fmt, ##__VA_ARGS__)
+#define dev_notice(dev, fmt, ...)	vc_host_log(LOGLEVEL_NOTICE, dev, fmt, ##__VA_ARGS__)
+#define dev_info(dev, fmt, ...)		vc_host_log(LOGLEVEL_INFO, dev, fmt, ##__VA_ARGS__)
+#define dev_dbg(dev, fmt, ...)		vc_host_log(LOGLEVEL_DEBUG, dev, fmt, ##__VA_ARGS__)
+
+static inline const char *dev_name(const struct device *dev) { return dev->name; }
+static inline void *dev_get_drvdata(const struct device *dev) { return dev->driver_data; }
+static inline void dev_set_drvdata(struct device *dev, void *data) { dev->driver_data = data; }
+struct fwnode_handle *dev_fwnode(struct device *dev);
+
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t gfp);
+void devm_release_all(struct device *dev);
+int device_create_file(struct device *dev, const struct device_attribute *attr);
+void device_remove_file(struct device *dev, const struct device_attribute *attr);
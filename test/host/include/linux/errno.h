@@ -0,0 +1,6 @@
+#pragma once
+#include_next <linux/errno.h>
+
+// Kernel internal error codes
+#define ENOIOCTLCMD	515
+#define ENOTSUPP	524
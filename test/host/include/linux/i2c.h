@@ -0,0 +1,77 @@
+#pragma once
+#include <linux/kernel.h>
+#include <linux/device.h>
+#include <linux/mod_devicetable.h>
+#include <linux/module.h>
+
+#define I2C_M_RD			0x0001
+#define I2C_FUNC_I2C			0x00000001
+#define I2C_FUNC_SMBUS_BYTE_DATA	0x00180000
+#define I2C_FUNC_SMBUS_EMUL		0x0eff0008
+#define I2C_CLIENT_END			0xfffeU
+#define I2C_NAME_SIZE			20
+
+struct i2c_msg {
+	__u16 addr;
+	__u16 flags;
+	__u16 len;
+	__u8 *buf;
+};
+
+struct i2c_adapter;
+
+struct i2c_algorithm {
+	int (*master_xfer)(struct i2c_adapter *adap, struct i2c_msg *msgs, int num);
+	u32 (*functionality)(struct i2c_adapter *adap);
+};
+
+struct i2c_adapter {
+	struct module *owner;
+	const struct i2c_algorithm *algo;
+	struct device dev;
+	int nr;
+	char name[48];
+	void *algo_data;
+};
+
+struct i2c_client {
+	unsigned short flags;
+	unsigned short addr;
+	char name[I2C_NAME_SIZE];
+	struct i2c_adapter *adapter;
+	struct device dev;
+};
+
+struct i2c_board_info {
+	char type[I2C_NAME_SIZE];
+	unsigned short flags;
+	unsigned short addr;
+	void *platform_data;
+};
+
+#define I2C_BOARD_INFO(dev_type, dev_addr) .type = dev_type, .addr = (dev_addr)
+
+struct i2c_driver {
+	struct device_driver driver;
+	const struct i2c_device_id *id_table;
+	int (*probe_new)(struct i2c_client *client);
+	int (*remove)(struct i2c_client *client);
+};
+
+int i2c_transfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num);
+int i2c_check_functionality(struct i2c_adapter *adap, u32 func);
+int i2c_add_adapter(struct i2c_adapter *adap);
+void i2c_del_adapter(struct i2c_adapter *adap);
+struct i2c_client *i2c_new_probed_device(struct i2c_adapter *adap, struct i2c_board_info *info,
+	unsigned short const *addr_list, int (*probe)(struct i2c_adapter *adap, unsigned short addr));
+void i2c_unregister_device(struct i2c_client *client);
+void vc_host_register_i2c_driver(struct i2c_driver *driver);
+
+static inline void *i2c_get_adapdata(const struct i2c_adapter *adap) { return dev_get_drvdata(&adap->dev); }
+static inline void i2c_set_adapdata(struct i2c_adapter *adap, void *data) { dev_set_drvdata(&adap->dev, data); }
+static inline void *i2c_get_clientdata(const struct i2c_client *client) { return dev_get_drvdata(&client->dev); }
+static inline void i2c_set_clientdata(struct i2c_client *client, void *data) { dev_set_drvdata(&client->dev, data); }
+
+#define module_i2c_driver(__driver) \
+	static void __attribute__((constructor)) __driver##_register(void) \
+	{ vc_host_register_i2c_driver(&__driver); }
@@ -0,0 +1,58 @@
+// Subset of linux/kernel.h. It is included into every translation unit of the host build,
+// because the kernel headers pull it in almost everywhere.
+#pragma once
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#define BIT(n)			(1UL << (n))
+
+#define min(a, b)		({ typeof(a) _a = (a); typeof(b) _b = (b); _a < _b ? _a : _b; })
+#define max(a, b)		({ typeof(a) _a = (a); typeof(b) _b = (b); _a > _b ? _a : _b; })
+#define min_t(t, a, b)		({ t _a = (a); t _b = (b); _a < _b ? _a : _b; })
+#define max_t(t, a, b)		({ t _a = (a); t _b = (b); _a > _b ? _a : _b; })
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+#define clamp_t(t, v, lo, hi)	min_t(t, max_t(t, v, lo), hi)
+
+#define U8_MAX			((u8)~0U)
+#define U16_MAX			((u16)~0U)
+#define U32_MAX			((u32)~0U)
+#define U64_MAX			((u64)~0ULL)
+#define S32_MAX			((s32)(U32_MAX >> 1))
+#define S32_MIN			((s32)(-S32_MAX - 1))
+#define S64_MAX			((s64)(U64_MAX >> 1))
+#define S64_MIN			((s64)(-S64_MAX - 1))
+
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define DIV_ROUND_CLOSEST(x, d)	(((x) + ((d) / 2)) / (d))
+#define do_div(n, base)		({ u32 _rem = (u64)(n) % (base); (n) = (u64)(n) / (base); _rem; })
+
+static inline u64 div_u64(u64 dividend, u32 divisor) { return dividend / divisor; }
+static inline s64 div_s64(s64 dividend, s32 divisor) { return dividend / divisor; }
+static inline u64 div64_u64(u64 dividend, u64 divisor) { return dividend / divisor; }
+
+#define READ_ONCE(x)		(*(volatile typeof(x) *)&(x))
+#define WRITE_ONCE(x, val)	(*(volatile typeof(x) *)&(x) = (val))
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+#define WARN_ON(x)		({ int _c = !!(x); if (_c) fprintf(stderr, "WARNING at %s:%d\n", __FILE__, __LINE__); _c; })
+
+#define __init
+#define __exit
+#define __user
+#define __iomem
+#define __always_unused		__attribute__((unused))
+#define EXPORT_SYMBOL(sym)
+#define EXPORT_SYMBOL_GPL(sym)
+
+#define USEC_PER_MSEC		1000L
+#define USEC_PER_SEC		1000000L
+#define NSEC_PER_USEC		1000L
+#define NSEC_PER_MSEC		1000000L
+#define NSEC_PER_SEC		1000000000L
+
+int kstrtou32(const char *s, unsigned int base, u32 *res);
+int kstrtoint(const char *s, unsigned int base, int *res);
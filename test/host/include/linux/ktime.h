@@ -0,0 +1,14 @@
+#pragma once
+#include <linux/kernel.h>
+
+ktime_t ktime_get(void);
+
+#define ktime_add_ms(kt, ms)	((kt) + (s64)(ms) * NSEC_PER_MSEC)
+#define ktime_add_us(kt, us)	((kt) + (s64)(us) * NSEC_PER_USEC)
+#define ktime_sub(a, b)		((a) - (b))
+#define ktime_before(a, b)	((a) < (b))
+#define ktime_after(a, b)	((a) > (b))
+#define ktime_to_ns(kt)		(kt)
+#define ktime_to_us(kt)		((kt) / NSEC_PER_USEC)
+#define ktime_to_ms(kt)		((kt) / NSEC_PER_MSEC)
+#define ktime_us_delta(a, b)	ktime_to_us(ktime_sub(a, b))
@@ -0,0 +1,19 @@
+#pragma once
+#include <linux/kernel.h>
+
+struct of_device_id {
+	char name[32];
+	char type[32];
+	char compatible[128];
+	const void *data;
+};
+
+struct i2c_device_id {
+	char name[20];
+	unsigned long driver_data;
+};
+
+struct device_driver {
+	const char *name;
+	const struct of_device_id *of_match_table;
+};
@@ -0,0 +1,30 @@
+// Module parameters are registered at startup, so that tests can change them like
+// /sys/module/<module>/parameters does on the target.
+#pragma once
+#include <linux/kernel.h>
+#include <linux/mod_devicetable.h>
+
+struct module {
+	int unused;
+};
+extern struct module __this_module;
+#define THIS_MODULE		(&__this_module)
+
+enum vc_host_param_type {
+	VC_HOST_PARAM_int,
+	VC_HOST_PARAM_uint,
+	VC_HOST_PARAM_bool,
+	VC_HOST_PARAM_charp,
+};
+
+void vc_host_register_param(const char *name, enum vc_host_param_type type, void *value);
+
+#define module_param(name, type, perm) \
+	static void __attribute__((constructor)) __param_##name##_register(void) \
+	{ vc_host_register_param(#name, VC_HOST_PARAM_##type, &name); }
+#define MODULE_PARM_DESC(name, desc)
+#define MODULE_DEVICE_TABLE(type, name)
+#define MODULE_VERSION(version)
+#define MODULE_DESCRIPTION(desc)
+#define MODULE_AUTHOR(author)
+#define MODULE_LICENSE(license)
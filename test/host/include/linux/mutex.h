@@ -0,0 +1,19 @@
+// Mutexes on top of pthreads. The owner is tracked for lockdep_assert_held().
+#pragma once
+#include <linux/kernel.h>
+#include <pthread.h>
+
+struct mutex {
+	pthread_mutex_t lock;
+	pthread_t owner;
+	int locked;
+};
+
+void mutex_init(struct mutex *lock);
+void mutex_destroy(struct mutex *lock);
+void mutex_lock(struct mutex *lock);
+void mutex_unlock(struct mutex *lock);
+int mutex_is_locked(struct mutex *lock);
+void vc_host_assert_held(struct mutex *lock, const char *file, int line);
+
+#define lockdep_assert_held(l)	vc_host_assert_held(l, __FILE__, __LINE__)
@@ -0,0 +1,31 @@
+// Device tree nodes of the host build. All properties are stored as strings, numbers are parsed
+// when they are read.
+#pragma once
+#include <linux/kernel.h>
+#include <linux/mod_devicetable.h>
+
+struct fwnode_handle {
+	int unused;
+};
+
+struct property {
+	const char *name;
+	const char *value;
+};
+
+struct device_node {
+	const char *name;
+	struct property *properties;	// Terminated by an entry without name
+	struct device_node *child;
+	struct device_node *sibling;
+	struct fwnode_handle fwnode;
+};
+
+static inline struct device_node *to_of_node(struct fwnode_handle *fwnode)
+{
+	return fwnode ? container_of(fwnode, struct device_node, fwnode) : NULL;
+}
+
+const char *vc_host_of_get(const struct device_node *np, const char *name);
+int of_property_read_u32(const struct device_node *np, const char *name, u32 *value);
+int of_property_read_string(const struct device_node *np, const char *name, const char **value);
@@ -0,0 +1,25 @@
+#pragma once
+#include <linux/device.h>
+#include <linux/module.h>
+#include <linux/of.h>
+
+struct platform_device {
+	const char *name;
+	int id;
+	struct device dev;
+};
+
+struct platform_driver {
+	int (*probe)(struct platform_device *pdev);
+	int (*remove)(struct platform_device *pdev);
+	struct device_driver driver;
+};
+
+void vc_host_register_platform_driver(struct platform_driver *driver);
+
+static inline void *platform_get_drvdata(const struct platform_device *pdev) { return dev_get_drvdata(&pdev->dev); }
+static inline void platform_set_drvdata(struct platform_device *pdev, void *data) { dev_set_drvdata(&pdev->dev, data); }
+
+#define module_platform_driver(__driver) \
+	static void __attribute__((constructor)) __driver##_register(void) \
+	{ vc_host_register_platform_driver(&__driver); }
@@ -0,0 +1,5 @@
+#pragma once
+#include <linux/kernel.h>
+
+u32 prandom_u32(void);
+u32 prandom_u32_max(u32 ep_ro);
@@ -0,0 +1,35 @@
+#pragma once
+#include <linux/kernel.h>
+
+typedef struct seqcount {
+	unsigned int sequence;
+} seqcount_t;
+
+#define seqcount_init(s)	((s)->sequence = 0)
+
+static inline void write_seqcount_begin(seqcount_t *s)
+{
+	__atomic_add_fetch(&s->sequence, 1, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void write_seqcount_end(seqcount_t *s)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&s->sequence, 1, __ATOMIC_RELEASE);
+}
+
+static inline unsigned int read_seqcount_begin(const seqcount_t *s)
+{
+	unsigned int seq;
+
+	while ((seq = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE)) & 1)
+		;
+	return seq;
+}
+
+static inline int read_seqcount_retry(const seqcount_t *s, unsigned int start)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE) != start;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <linux/kernel.h>
+
+#define GFP_KERNEL	0
+
+void *kzalloc(size_t size, gfp_t flags);
+void *kcalloc(size_t n, size_t size, gfp_t flags);
+void kfree(const void *p);
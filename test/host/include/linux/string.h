@@ -0,0 +1,5 @@
+#pragma once
+#include <linux/kernel.h>
+#include <string.h>
+
+ssize_t strscpy(char *dest, const char *src, size_t count);
@@ -0,0 +1,4 @@
+// The uapi header linux/vc_mipi_camera.h is added by a kernel patch. vc_v4l2.h of the tools
+// contains the same declarations for toolchains without the patch.
+#pragma once
+#include "vc_v4l2.h"
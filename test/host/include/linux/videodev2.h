@@ -0,0 +1,5 @@
+// The uapi header of the host plus the controls which the kernel patches of this repository add
+// to v4l2-controls.h.
+#pragma once
+#include_next <linux/videodev2.h>
+#include "vc_v4l2.h"
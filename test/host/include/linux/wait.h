@@ -0,0 +1,21 @@
+// Wait queues on top of a pthread condition variable. The condition is checked with the lock of
+// the queue held, which orders it with wake_up_all() like the kernel.
+#pragma once
+#include <linux/kernel.h>
+#include <pthread.h>
+
+typedef struct wait_queue_head {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} wait_queue_head_t;
+
+void init_waitqueue_head(wait_queue_head_t *wq_head);
+void wake_up_all(wait_queue_head_t *wq_head);
+
+#define wait_event(wq_head, condition)						\
+	do {									\
+		pthread_mutex_lock(&(wq_head).lock);				\
+		while (!(condition))						\
+			pthread_cond_wait(&(wq_head).cond, &(wq_head).lock);	\
+		pthread_mutex_unlock(&(wq_head).lock);				\
+	} while (0)
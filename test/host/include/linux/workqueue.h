@@ -0,0 +1,42 @@
+// Work items are executed by one worker thread, like the system workqueue of the kernel.
+#pragma once
+#include <linux/kernel.h>
+
+#define HZ	1000
+
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct work_struct {
+	work_func_t func;
+	struct work_struct *next;
+	int pending;
+	int running;
+	int canceling;
+	ktime_t expires;
+};
+
+struct delayed_work {
+	struct work_struct work;
+};
+
+static inline struct delayed_work *to_delayed_work(struct work_struct *work)
+{
+	return container_of(work, struct delayed_work, work);
+}
+
+static inline unsigned long msecs_to_jiffies(unsigned int m)
+{
+	return m;
+}
+
+void vc_host_init_work(struct work_struct *work, work_func_t func);
+bool schedule_work(struct work_struct *work);
+bool schedule_delayed_work(struct delayed_work *dwork, unsigned long delay);
+bool cancel_work_sync(struct work_struct *work);
+bool cancel_delayed_work(struct delayed_work *dwork);
+bool cancel_delayed_work_sync(struct delayed_work *dwork);
+void flush_scheduled_work(void);
+
+#define INIT_WORK(_work, _func)			vc_host_init_work(_work, _func)
+#define INIT_DELAYED_WORK(_dwork, _func)	vc_host_init_work(&(_dwork)->work, _func)
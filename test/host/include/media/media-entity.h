@@ -0,0 +1,28 @@
+#pragma once
+#include <linux/kernel.h>
+#include <linux/media.h>
+
+struct media_entity;
+
+struct media_pad {
+	struct media_entity *entity;
+	u16 index;
+	unsigned long flags;
+};
+
+struct media_entity_operations {
+	int (*link_setup)(struct media_entity *entity, const struct media_pad *local,
+		const struct media_pad *remote, u32 flags);
+};
+
+struct media_entity {
+	const char *name;
+	u32 function;
+	unsigned long flags;
+	u16 num_pads;
+	struct media_pad *pads;
+	const struct media_entity_operations *ops;
+};
+
+int media_entity_pads_init(struct media_entity *entity, u16 num_pads, struct media_pad *pads);
+void media_entity_cleanup(struct media_entity *entity);
@@ -0,0 +1,5 @@
+#pragma once
+#include <media/v4l2-subdev.h>
+
+int v4l2_async_register_subdev_sensor_common(struct v4l2_subdev *sd);
+void v4l2_async_unregister_subdev(struct v4l2_subdev *sd);
@@ -0,0 +1,2 @@
+#pragma once
+#include <media/v4l2-subdev.h>
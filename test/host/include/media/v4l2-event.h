@@ -0,0 +1,5 @@
+#pragma once
+#include <media/v4l2-subdev.h>
+
+int v4l2_event_subdev_unsubscribe(struct v4l2_subdev *sd, struct v4l2_fh *fh,
+	struct v4l2_event_subscription *sub);
@@ -0,0 +1,27 @@
+#pragma once
+#include <linux/of.h>
+#include <media/v4l2-subdev.h>
+
+enum v4l2_mbus_type {
+	V4L2_MBUS_UNKNOWN,
+	V4L2_MBUS_CSI2_DPHY = 5,
+};
+
+struct v4l2_fwnode_bus_mipi_csi2 {
+	unsigned int flags;
+	unsigned char data_lanes[4];
+	unsigned char clock_lane;
+	unsigned short num_data_lanes;
+};
+
+struct v4l2_fwnode_endpoint {
+	enum v4l2_mbus_type bus_type;
+	struct {
+		struct v4l2_fwnode_bus_mipi_csi2 mipi_csi2;
+	} bus;
+};
+
+struct fwnode_handle *fwnode_graph_get_next_endpoint(const struct fwnode_handle *fwnode,
+	struct fwnode_handle *prev);
+void fwnode_handle_put(struct fwnode_handle *fwnode);
+int v4l2_fwnode_endpoint_parse(struct fwnode_handle *fwnode, struct v4l2_fwnode_endpoint *vep);
@@ -0,0 +1,62 @@
+#pragma once
+#include <linux/kernel.h>
+#include <linux/i2c.h>
+#include <linux/videodev2.h>
+#include <linux/v4l2-subdev.h>
+#include <media/media-entity.h>
+
+#define V4L2_SUBDEV_FL_IS_I2C		(1U << 0)
+#define V4L2_SUBDEV_FL_HAS_DEVNODE	(1U << 2)
+#define V4L2_SUBDEV_FL_HAS_EVENTS	(1U << 3)
+
+struct v4l2_subdev;
+struct v4l2_fh;
+struct v4l2_ctrl_handler;
+
+struct v4l2_subdev_pad_config {
+	struct v4l2_mbus_framefmt try_fmt;
+	struct v4l2_rect try_crop;
+};
+
+struct v4l2_subdev_core_ops {
+	int (*s_power)(struct v4l2_subdev *sd, int on);
+	long (*ioctl)(struct v4l2_subdev *sd, unsigned int cmd, void *arg);
+	int (*s_ctrl)(struct v4l2_subdev *sd, struct v4l2_control *control);
+	int (*subscribe_event)(struct v4l2_subdev *sd, struct v4l2_fh *fh,
+		struct v4l2_event_subscription *sub);
+	int (*unsubscribe_event)(struct v4l2_subdev *sd, struct v4l2_fh *fh,
+		struct v4l2_event_subscription *sub);
+};
+
+struct v4l2_subdev_video_ops {
+	int (*s_stream)(struct v4l2_subdev *sd, int enable);
+};
+
+struct v4l2_subdev_pad_ops {
+	int (*get_fmt)(struct v4l2_subdev *sd, struct v4l2_subdev_pad_config *cfg,
+		struct v4l2_subdev_format *format);
+	int (*set_fmt)(struct v4l2_subdev *sd, struct v4l2_subdev_pad_config *cfg,
+		struct v4l2_subdev_format *format);
+	int (*get_selection)(struct v4l2_subdev *sd, struct v4l2_subdev_pad_config *cfg,
+		struct v4l2_subdev_selection *sel);
+	int (*set_selection)(struct v4l2_subdev *sd, struct v4l2_subdev_pad_config *cfg,
+		struct v4l2_subdev_selection *sel);
+};
+
+struct v4l2_subdev_ops {
+	const struct v4l2_subdev_core_ops *core;
+	const struct v4l2_subdev_video_ops *video;
+	const struct v4l2_subdev_pad_ops *pad;
+};
+
+struct v4l2_subdev {
+	struct media_entity entity;
+	u32 flags;
+	const struct v4l2_subdev_ops *ops;
+	struct v4l2_ctrl_handler *ctrl_handler;
+	char name[64];
+	struct device *dev;
+};
+
+void v4l2_i2c_subdev_init(struct v4l2_subdev *sd, struct i2c_client *client,
+	const struct v4l2_subdev_ops *ops);
@@ -0,0 +1,905 @@
+// Kernel services of the host build (see vc_host.h)
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include "vc_host.h"
+
+struct module __this_module;
+
+// ------------------------------------------------------------------------------------------------
+//  Logging
+
+static int vc_host_loglevel = LOGLEVEL_WARNING;
+static void (*vc_host_log_hook)(int level, const char *msg, void *data);
+static void *vc_host_log_data;
+
+void vc_host_set_loglevel(int level)
+{
+	vc_host_loglevel = level;
+}
+
+void vc_host_set_log_hook(void (*hook)(int level, const char *msg, void *data), void *data)
+{
+	vc_host_log_hook = hook;
+	vc_host_log_data = data;
+}
+
+void vc_host_log(int level, const struct device *dev, const char *fmt, ...)
+{
+	char msg[512];
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, args);
+	va_end(args);
+
+	if (vc_host_log_hook)
+		vc_host_log_hook(level, msg, vc_host_log_data);
+	if (level <= vc_host_loglevel)
+		fprintf(stderr, "<%d> %s: %s", level, dev ? dev->name : "-", msg);
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Memory
+
+struct vc_host_devres {
+	struct device *dev;
+	struct vc_host_devres *next;
+	long long data[];
+};
+
+static struct vc_host_devres *vc_host_devres;
+
+void *kzalloc(size_t size, gfp_t flags)
+{
+	return calloc(1, size);
+}
+
+void *kcalloc(size_t n, size_t size, gfp_t flags)
+{
+	return calloc(n, size);
+}
+
+void kfree(const void *p)
+{
+	free((void *)p);
+}
+
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t gfp)
+{
+	struct vc_host_devres *res = calloc(1, sizeof(*res) + size);
+
+	if (!res)
+		return NULL;
+	res->dev = dev;
+	res->next = vc_host_devres;
+	vc_host_devres = res;
+	return res->data;
+}
+
+// Frees the managed memory of the device when it is unbound.
+void devm_release_all(struct device *dev)
+{
+	struct vc_host_devres **link = &vc_host_devres;
+	struct vc_host_devres *res;
+
+	while ((res = *link) != NULL) {
+		if (res->dev == dev) {
+			*link = res->next;
+			free(res);
+		} else {
+			link = &res->next;
+		}
+	}
+}
+
+ssize_t strscpy(char *dest, const char *src, size_t count)
+{
+	size_t len = strnlen(src, count);
+
+	if (count == 0)
+		return -E2BIG;
+	if (len == count) {
+		memcpy(dest, src, count - 1);
+		dest[count - 1] = 0;
+		return -E2BIG;
+	}
+	memcpy(dest, src, len + 1);
+	return len;
+}
+
+int kstrtou32(const char *s, unsigned int base, u32 *res)
+{
+	unsigned long long value;
+	char *end;
+
+	errno = 0;
+	value = strtoull(s, &end, base);
+	if (end == s || (*end && *end != '\n'))
+		return -EINVAL;
+	if (errno || value > U32_MAX)
+		return -ERANGE;
+	*res = value;
+	return 0;
+}
+
+int kstrtoint(const char *s, unsigned int base, int *res)
+{
+	long long value;
+	char *end;
+
+	errno = 0;
+	value = strtoll(s, &end, base);
+	if (end == s || (*end && *end != '\n'))
+		return -EINVAL;
+	if (errno || value > S32_MAX || value < S32_MIN)
+		return -ERANGE;
+	*res = value;
+	return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Random numbers
+
+static pthread_mutex_t vc_host_random_lock = PTHREAD_MUTEX_INITIALIZER;
+static u32 vc_host_random_state = 0x2545f491;
+
+void vc_host_seed(u32 seed)
+{
+	pthread_mutex_lock(&vc_host_random_lock);
+	vc_host_random_state = seed ? seed : 0x2545f491;
+	pthread_mutex_unlock(&vc_host_random_lock);
+}
+
+u32 prandom_u32(void)
+{
+	u32 x;
+
+	pthread_mutex_lock(&vc_host_random_lock);
+	x = vc_host_random_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	vc_host_random_state = x;
+	pthread_mutex_unlock(&vc_host_random_lock);
+
+	return x;
+}
+
+u32 prandom_u32_max(u32 ep_ro)
+{
+	return (u32)(((u64)prandom_u32() * ep_ro) >> 32);
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Time
+
+ktime_t ktime_get(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ktime_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void vc_host_sleep_us(unsigned long us)
+{
+	struct timespec ts = { .tv_sec = us / USEC_PER_SEC, .tv_nsec = (us % USEC_PER_SEC) * NSEC_PER_USEC };
+
+	while (nanosleep(&ts, &ts) && errno == EINTR)
+		;
+}
+
+void usleep_range(unsigned long min, unsigned long max)
+{
+	vc_host_sleep_us(min);
+}
+
+void msleep(unsigned int msecs)
+{
+	vc_host_sleep_us(msecs * USEC_PER_MSEC);
+}
+
+void udelay(unsigned long usecs)
+{
+	ktime_t end = ktime_add_us(ktime_get(), usecs);
+
+	while (ktime_before(ktime_get(), end))
+		;
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Mutexes
+
+void mutex_init(struct mutex *lock)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+	pthread_mutex_init(&lock->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	lock->locked = 0;
+}
+
+void mutex_destroy(struct mutex *lock)
+{
+	pthread_mutex_destroy(&lock->lock);
+}
+
+void mutex_lock(struct mutex *lock)
+{
+	if (pthread_mutex_lock(&lock->lock)) {
+		fprintf(stderr, "BUG: recursive locking of mutex %p\n", (void *)lock);
+		abort();
+	}
+	lock->owner = pthread_self();
+	lock->locked = 1;
+}
+
+void mutex_unlock(struct mutex *lock)
+{
+	lock->locked = 0;
+	if (pthread_mutex_unlock(&lock->lock)) {
+		fprintf(stderr, "BUG: unlocking mutex %p which isn't held\n", (void *)lock);
+		abort();
+	}
+}
+
+int mutex_is_locked(struct mutex *lock)
+{
+	return lock->locked;
+}
+
+void vc_host_assert_held(struct mutex *lock, const char *file, int line)
+{
+	if (!lock->locked || !pthread_equal(lock->owner, pthread_self())) {
+		fprintf(stderr, "BUG: %s:%d: mutex %p not held\n", file, line, (void *)lock);
+		abort();
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Wait queues
+
+void init_waitqueue_head(wait_queue_head_t *wq_head)
+{
+	pthread_mutex_init(&wq_head->lock, NULL);
+	pthread_cond_init(&wq_head->cond, NULL);
+}
+
+void wake_up_all(wait_queue_head_t *wq_head)
+{
+	pthread_mutex_lock(&wq_head->lock);
+	pthread_cond_broadcast(&wq_head->cond);
+	pthread_mutex_unlock(&wq_head->lock);
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Work queue
+//
+// One worker thread executes the work items in the order they become due. A work item which is
+// requeued while it runs is executed again, canceling waits for a running item like the kernel.
+
+static pthread_mutex_t vc_host_wq_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t vc_host_wq_cond;
+static struct work_struct *vc_host_wq_head;
+static pthread_t vc_host_wq_thread;
+static int vc_host_wq_started;
+static int vc_host_wq_running;
+
+static struct work_struct *vc_host_wq_next(void)
+{
+	struct work_struct *work;
+	struct work_struct *next = NULL;
+
+	for (work = vc_host_wq_head; work; work = work->next) {
+		if (!next || ktime_before(work->expires, next->expires))
+			next = work;
+	}
+	return next;
+}
+
+static void vc_host_wq_remove(struct work_struct *work)
+{
+	struct work_struct **link = &vc_host_wq_head;
+
+	while (*link && *link != work)
+		link = &(*link)->next;
+	if (*link)
+		*link = work->next;
+	work->next = NULL;
+	work->pending = 0;
+}
+
+static void *vc_host_wq_worker(void *arg)
+{
+	struct work_struct *work;
+	struct timespec ts;
+	ktime_t now;
+
+	pthread_mutex_lock(&vc_host_wq_lock);
+	for (;;) {
+		work = vc_host_wq_next();
+		if (!work) {
+			pthread_cond_wait(&vc_host_wq_cond, &vc_host_wq_lock);
+			continue;
+		}
+		now = ktime_get();
+		if (ktime_before(now, work->expires)) {
+			ts.tv_sec = work->expires / NSEC_PER_SEC;
+			ts.tv_nsec = work->expires % NSEC_PER_SEC;
+			pthread_cond_timedwait(&vc_host_wq_cond, &vc_host_wq_lock, &ts);
+			continue;
+		}
+		vc_host_wq_remove(work);
+		work->running = 1;
+		vc_host_wq_running++;
+		pthread_mutex_unlock(&vc_host_wq_lock);
+		work->func(work);
+		pthread_mutex_lock(&vc_host_wq_lock);
+		work->running = 0;
+		vc_host_wq_running--;
+		pthread_cond_broadcast(&vc_host_wq_cond);
+	}
+	return NULL;
+}
+
+static bool vc_host_queue_work(struct work_struct *work, unsigned long delay_ms)
+{
+	pthread_condattr_t attr;
+	bool queued = false;
+
+	pthread_mutex_lock(&vc_host_wq_lock);
+	if (!vc_host_wq_started) {
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&vc_host_wq_cond, &attr);
+		pthread_condattr_destroy(&attr);
+		pthread_create(&vc_host_wq_thread, NULL, vc_host_wq_worker, NULL);
+		vc_host_wq_started = 1;
+	}
+	if (!work->pending && !work->canceling) {
+		work->pending = 1;
+		work->expires = ktime_add_ms(ktime_get(), delay_ms);
+		work->next = vc_host_wq_head;
+		vc_host_wq_head = work;
+		queued = true;
+		pthread_cond_broadcast(&vc_host_wq_cond);
+	}
+	pthread_mutex_unlock(&vc_host_wq_lock);
+
+	return queued;
+}
+
+static bool vc_host_cancel_work(struct work_struct *work, int sync)
+{
+	bool pending;
+
+	pthread_mutex_lock(&vc_host_wq_lock);
+	pending = work->pending;
+	if (pending)
+		vc_host_wq_remove(work);
+	if (sync) {
+		// A running work item can't requeue itself meanwhile.
+		work->canceling = 1;
+		while (work->running)
+			pthread_cond_wait(&vc_host_wq_cond, &vc_host_wq_lock);
+		work->canceling = 0;
+	}
+	pthread_mutex_unlock(&vc_host_wq_lock);
+
+	return pending;
+}
+
+void vc_host_init_work(struct work_struct *work, work_func_t func)
+{
+	memset(work, 0, sizeof(*work));
+	work->func = func;
+}
+
+bool schedule_work(struct work_struct *work)
+{
+	return vc_host_queue_work(work, 0);
+}
+
+bool schedule_delayed_work(struct delayed_work *dwork, unsigned long delay)
+{
+	return vc_host_queue_work(&dwork->work, delay);
+}
+
+bool cancel_work_sync(struct work_struct *work)
+{
+	return vc_host_cancel_work(work, 1);
+}
+
+bool cancel_delayed_work(struct delayed_work *dwork)
+{
+	return vc_host_cancel_work(&dwork->work, 0);
+}
+
+bool cancel_delayed_work_sync(struct delayed_work *dwork)
+{
+	return vc_host_cancel_work(&dwork->work, 1);
+}
+
+// Waits until no work item is due or running. Delayed work items which aren't due yet are left.
+void flush_scheduled_work(void)
+{
+	struct work_struct *work;
+	int busy;
+
+	pthread_mutex_lock(&vc_host_wq_lock);
+	do {
+		busy = vc_host_wq_running;
+		for (work = vc_host_wq_head; work; work = work->next) {
+			if (!ktime_before(ktime_get(), work->expires))
+				busy = 1;
+		}
+		if (busy) {
+			pthread_mutex_unlock(&vc_host_wq_lock);
+			msleep(1);
+			pthread_mutex_lock(&vc_host_wq_lock);
+		}
+	} while (busy);
+	pthread_mutex_unlock(&vc_host_wq_lock);
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Module parameters
+
+struct vc_host_param {
+	const char *name;
+	enum vc_host_param_type type;
+	void *value;
+};
+
+static struct vc_host_param vc_host_params[32];
+static int vc_host_num_params;
+
+void vc_host_register_param(const char *name, enum vc_host_param_type type, void *value)
+{
+	if (vc_host_num_params == ARRAY_SIZE(vc_host_params)) {
+		fprintf(stderr, "BUG: too many module parameters\n");
+		abort();
+	}
+	vc_host_params[vc_host_num_params++] = (struct vc_host_param) { name, type, value };
+}
+
+int vc_host_set_param(const char *name, const char *value)
+{
+	struct vc_host_param *param;
+	int index;
+	u32 u;
+	int i;
+
+	for (index = 0; index < vc_host_num_params; index++) {
+		param = &vc_host_params[index];
+		if (strcmp(param->name, name))
+			continue;
+
+		switch (param->type) {
+		case VC_HOST_PARAM_int:
+			if (kstrtoint(value, 0, &i))
+				return -EINVAL;
+			*(int *)param->value = i;
+			return 0;
+		case VC_HOST_PARAM_uint:
+			if (kstrtou32(value, 0, &u))
+				return -EINVAL;
+			*(unsigned int *)param->value = u;
+			return 0;
+		case VC_HOST_PARAM_bool:
+			*(bool *)param->value = (value[0] == 'Y' || value[0] == 'y' || value[0] == '1');
+			return 0;
+		case VC_HOST_PARAM_charp:
+			*(const char **)param->value = strdup(value);
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Device tree
+
+const char *vc_host_of_get(const struct device_node *np, const char *name)
+{
+	struct property *prop;
+
+	if (!np || !np->properties)
+		return NULL;
+	for (prop = np->properties; prop->name; prop++) {
+		if (strcmp(prop->name, name) == 0)
+			return prop->value;
+	}
+	return NULL;
+}
+
+int of_property_read_u32(const struct device_node *np, const char *name, u32 *value)
+{
+	const char *str = vc_host_of_get(np, name);
+
+	if (!str)
+		return -EINVAL;
+	return kstrtou32(str, 0, value);
+}
+
+int of_property_read_string(const struct device_node *np, const char *name, const char **value)
+{
+	const char *str = vc_host_of_get(np, name);
+
+	if (!str)
+		return -EINVAL;
+	*value = str;
+	return 0;
+}
+
+struct fwnode_handle *dev_fwnode(struct device *dev)
+{
+	return dev->of_node ? &dev->of_node->fwnode : NULL;
+}
+
+static struct device_node *vc_host_of_find(struct device_node *np, const char *name)
+{
+	struct device_node *child;
+	struct device_node *found;
+
+	for (child = np->child; child; child = child->sibling) {
+		if (strcmp(child->name, name) == 0)
+			return child;
+		found = vc_host_of_find(child, name);
+		if (found)
+			return found;
+	}
+	return NULL;
+}
+
+struct fwnode_handle *fwnode_graph_get_next_endpoint(const struct fwnode_handle *fwnode,
+	struct fwnode_handle *prev)
+{
+	struct device_node *ep;
+
+	if (!fwnode || prev)
+		return NULL;
+	ep = vc_host_of_find(to_of_node((struct fwnode_handle *)fwnode), "endpoint");
+	return ep ? &ep->fwnode : NULL;
+}
+
+void fwnode_handle_put(struct fwnode_handle *fwnode)
+{
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Devices
+
+struct vc_host_attr {
+	struct device *dev;
+	const struct device_attribute *attr;
+};
+
+static struct vc_host_attr vc_host_attrs[16];
+
+int device_create_file(struct device *dev, const struct device_attribute *attr)
+{
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_host_attrs); index++) {
+		if (!vc_host_attrs[index].dev) {
+			vc_host_attrs[index] = (struct vc_host_attr) { dev, attr };
+			return 0;
+		}
+	}
+	return -ENOMEM;
+}
+
+void device_remove_file(struct device *dev, const struct device_attribute *attr)
+{
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_host_attrs); index++) {
+		if (vc_host_attrs[index].dev == dev && vc_host_attrs[index].attr == attr)
+			vc_host_attrs[index].dev = NULL;
+	}
+}
+
+ssize_t vc_host_attr_show(struct device *dev, const char *name, char *buf, size_t size)
+{
+	struct vc_host_attr *entry;
+	char page[4096];
+	ssize_t len;
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_host_attrs); index++) {
+		entry = &vc_host_attrs[index];
+		if (entry->dev != dev || strcmp(entry->attr->name, name))
+			continue;
+		len = entry->attr->show(dev, (struct device_attribute *)entry->attr, page);
+		if (len < 0)
+			return len;
+		snprintf(buf, size, "%.*s", (int)len, page);
+		return len;
+	}
+	return -ENOENT;
+}
+
+struct vc_host_binding {
+	struct platform_device *pdev;
+	struct platform_driver *driver;
+};
+
+static struct platform_driver *vc_host_platform_drivers[4];
+static struct vc_host_binding vc_host_bindings[4];
+
+void vc_host_register_platform_driver(struct platform_driver *driver)
+{
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_host_platform_drivers); index++) {
+		if (!vc_host_platform_drivers[index]) {
+			vc_host_platform_drivers[index] = driver;
+			return;
+		}
+	}
+}
+
+int vc_host_platform_probe(const char *driver, struct platform_device *pdev)
+{
+	struct vc_host_binding *binding = NULL;
+	struct platform_driver *drv;
+	int index;
+	int ret;
+
+	for (index = 0; index < ARRAY_SIZE(vc_host_bindings); index++) {
+		if (!vc_host_bindings[index].pdev)
+			binding = &vc_host_bindings[index];
+	}
+	if (!binding)
+		return -ENOMEM;
+
+	for (index = 0; index < ARRAY_SIZE(vc_host_platform_drivers); index++) {
+		drv = vc_host_platform_drivers[index];
+		if (!drv || strcmp(drv->driver.name, driver))
+			continue;
+		if (!pdev->dev.name[0])
+			snprintf(pdev->dev.name, sizeof(pdev->dev.name), "%s", pdev->name);
+		ret = drv->probe(pdev);
+		if (ret) {
+			devm_release_all(&pdev->dev);
+			return ret;
+		}
+		*binding = (struct vc_host_binding) { pdev, drv };
+		return 0;
+	}
+	return -ENODEV;
+}
+
+void vc_host_platform_remove(struct platform_device *pdev)
+{
+	struct vc_host_binding *binding;
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_host_bindings); index++) {
+		binding = &vc_host_bindings[index];
+		if (binding->pdev != pdev)
+			continue;
+		if (binding->driver->remove)
+			binding->driver->remove(pdev);
+		binding->pdev = NULL;
+		devm_release_all(&pdev->dev);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+//  I2C core
+
+#define VC_HOST_MAX_CLIENTS	8
+#define VC_HOST_MAX_ADAPTERS	4
+
+struct vc_host_client {
+	struct i2c_client client;
+	struct i2c_driver *driver;
+	int used;
+};
+
+static struct i2c_driver *vc_host_i2c_drivers[4];
+static struct vc_host_client vc_host_clients[VC_HOST_MAX_CLIENTS];
+static struct i2c_adapter *vc_host_adapters[VC_HOST_MAX_ADAPTERS];
+static pthread_mutex_t vc_host_bus_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void vc_host_register_i2c_driver(struct i2c_driver *driver)
+{
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_host_i2c_drivers); index++) {
+		if (!vc_host_i2c_drivers[index]) {
+			vc_host_i2c_drivers[index] = driver;
+			return;
+		}
+	}
+}
+
+// The adapter lock of the I2C core serializes the transfers of all clients.
+int i2c_transfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+{
+	int ret;
+
+	pthread_mutex_lock(&vc_host_bus_lock);
+	ret = adap->algo->master_xfer(adap, msgs, num);
+	pthread_mutex_unlock(&vc_host_bus_lock);
+
+	return ret;
+}
+
+int i2c_check_functionality(struct i2c_adapter *adap, u32 func)
+{
+	return (adap->algo->functionality(adap) & func) == func;
+}
+
+static struct i2c_client *vc_host_i2c_new_client(struct i2c_adapter *adap, const char *type,
+	unsigned short addr, struct device_node *np)
+{
+	struct vc_host_client *entry;
+	struct i2c_client *client;
+	int index;
+
+	for (index = 0; index < VC_HOST_MAX_CLIENTS; index++) {
+		entry = &vc_host_clients[index];
+		if (entry->used)
+			continue;
+		memset(entry, 0, sizeof(*entry));
+		entry->used = 1;
+		client = &entry->client;
+		client->addr = addr;
+		client->adapter = adap;
+		strscpy(client->name, type, sizeof(client->name));
+		client->dev.parent = &adap->dev;
+		client->dev.of_node = np;
+		snprintf(client->dev.name, sizeof(client->dev.name), "%d-%04x", adap->nr, addr);
+		return client;
+	}
+	return NULL;
+}
+
+static struct vc_host_client *vc_host_i2c_entry(struct i2c_client *client)
+{
+	return container_of(client, struct vc_host_client, client);
+}
+
+static struct i2c_driver *vc_host_i2c_match(struct device_node *np)
+{
+	const char *compatible = vc_host_of_get(np, "compatible");
+	const struct of_device_id *id;
+	struct i2c_driver *driver;
+	int index;
+
+	for (index = 0; compatible && index < ARRAY_SIZE(vc_host_i2c_drivers); index++) {
+		driver = vc_host_i2c_drivers[index];
+		if (!driver)
+			continue;
+		for (id = driver->driver.of_match_table; id && id->compatible[0]; id++) {
+			if (strcmp(id->compatible, compatible) == 0)
+				return driver;
+		}
+	}
+	return NULL;
+}
+
+int i2c_add_adapter(struct i2c_adapter *adap)
+{
+	struct device_node *np;
+	struct i2c_client *client;
+	struct i2c_driver *driver;
+	u32 addr;
+	int index;
+
+	for (index = 0; index < VC_HOST_MAX_ADAPTERS; index++) {
+		if (!vc_host_adapters[index])
+			break;
+	}
+	if (index == VC_HOST_MAX_ADAPTERS)
+		return -ENOMEM;
+	vc_host_adapters[index] = adap;
+	adap->nr = index;
+	snprintf(adap->dev.name, sizeof(adap->dev.name), "i2c-%d", index);
+
+	// of_i2c_register_devices()
+	for (np = adap->dev.of_node ? adap->dev.of_node->child : NULL; np; np = np->sibling) {
+		if (of_property_read_u32(np, "reg", &addr))
+			continue;
+		client = vc_host_i2c_new_client(adap, np->name, addr, np);
+		if (!client)
+			return -ENOMEM;
+		driver = vc_host_i2c_match(np);
+		if (driver && driver->probe_new(client) == 0) {
+			vc_host_i2c_entry(client)->driver = driver;
+		} else {
+			devm_release_all(&client->dev);
+		}
+	}
+
+	return 0;
+}
+
+void i2c_unregister_device(struct i2c_client *client)
+{
+	struct vc_host_client *entry;
+
+	if (!client)
+		return;
+	entry = vc_host_i2c_entry(client);
+	if (entry->driver && entry->driver->remove)
+		entry->driver->remove(client);
+	devm_release_all(&client->dev);
+	entry->used = 0;
+}
+
+void i2c_del_adapter(struct i2c_adapter *adap)
+{
+	struct vc_host_client *entry;
+	int index;
+
+	// Bound devices first, the camera driver still uses the module client.
+	for (index = 0; index < VC_HOST_MAX_CLIENTS; index++) {
+		entry = &vc_host_clients[index];
+		if (entry->used && entry->driver && entry->client.adapter == adap)
+			i2c_unregister_device(&entry->client);
+	}
+	for (index = 0; index < VC_HOST_MAX_CLIENTS; index++) {
+		entry = &vc_host_clients[index];
+		if (entry->used && entry->client.adapter == adap)
+			i2c_unregister_device(&entry->client);
+	}
+	vc_host_adapters[adap->nr] = NULL;
+}
+
+struct i2c_client *i2c_new_probed_device(struct i2c_adapter *adap, struct i2c_board_info *info,
+	unsigned short const *addr_list, int (*probe)(struct i2c_adapter *adap, unsigned short addr))
+{
+	struct i2c_msg msg = { .flags = 0, .len = 0, .buf = NULL };
+	int index;
+
+	// i2c_default_probe(): The address has to acknowledge a quick write.
+	for (index = 0; addr_list[index] != I2C_CLIENT_END; index++) {
+		msg.addr = addr_list[index];
+		if (i2c_transfer(adap, &msg, 1) == 1)
+			return vc_host_i2c_new_client(adap, info->type, addr_list[index], NULL);
+	}
+	return NULL;
+}
+
+struct i2c_client *vc_host_i2c_find_client(struct i2c_adapter *adap, unsigned short addr)
+{
+	struct vc_host_client *entry;
+	int index;
+
+	for (index = 0; index < VC_HOST_MAX_CLIENTS; index++) {
+		entry = &vc_host_clients[index];
+		if (entry->used && entry->client.adapter == adap && entry->client.addr == addr)
+			return &entry->client;
+	}
+	return NULL;
+}
+
+struct i2c_adapter *vc_host_i2c_find_adapter(const char *name)
+{
+	int index;
+
+	for (index = 0; index < VC_HOST_MAX_ADAPTERS; index++) {
+		if (vc_host_adapters[index] && strstr(vc_host_adapters[index]->name, name))
+			return vc_host_adapters[index];
+	}
+	return NULL;
+}
@@ -0,0 +1,48 @@
+// Host build of the VC MIPI driver
+//
+// The driver sources are compiled unmodified against the shim headers in include/. vc_host.c
+// implements the kernel services they use (logging, memory, mutexes, work queues, time, device
+// tree, I2C core and module parameters), vc_host_v4l2.c the parts of the V4L2 control and sub
+// device framework. The I2C bus is served by the module emulator vc_mipi_emu.c, which simulates
+// the register file of the module controller and the sensor for each emulated MOD_ID.
+
+#ifndef _VC_HOST_H
+#define _VC_HOST_H
+
+#include <linux/device.h>
+#include <linux/i2c.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+
+// --- Logging -------------------------------------------------------------------------------------
+
+// Messages up to the log level are printed to stderr (default: LOGLEVEL_WARNING). The hook gets
+// every message independent of the level, e.g. to collect the bus-cost lines.
+void vc_host_set_loglevel(int level);
+void vc_host_set_log_hook(void (*hook)(int level, const char *msg, void *data), void *data);
+
+// --- Module parameters ---------------------------------------------------------------------------
+
+// Sets a parameter which is registered by module_param() like a write to
+// /sys/module/<module>/parameters/<name>.
+int vc_host_set_param(const char *name, const char *value);
+
+// --- Random numbers ------------------------------------------------------------------------------
+
+void vc_host_seed(u32 seed);
+
+// --- Devices -------------------------------------------------------------------------------------
+
+// Binds the platform driver with the given name to the device.
+int vc_host_platform_probe(const char *driver, struct platform_device *pdev);
+void vc_host_platform_remove(struct platform_device *pdev);
+
+// Adapters register themselves with i2c_add_adapter(). The I2C devices of the child nodes of the
+// adapter node are instantiated and bound to the driver with a matching compatible string.
+struct i2c_client *vc_host_i2c_find_client(struct i2c_adapter *adap, unsigned short addr);
+struct i2c_adapter *vc_host_i2c_find_adapter(const char *name);
+
+// Reads an attribute which is registered by device_create_file() like a read of the sysfs file.
+ssize_t vc_host_attr_show(struct device *dev, const char *name, char *buf, size_t size);
+
+#endif // _VC_HOST_H
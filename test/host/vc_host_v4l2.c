@@ -0,0 +1,479 @@
+// V4L2 control and sub device framework of the host build (see vc_host.h)
+//
+// Follows v4l2-ctrls.c of kernel 5.4: s_ctrl is only called if the value changes (or for
+// V4L2_CTRL_FLAG_EXECUTE_ON_WRITE), the value the driver leaves in ctrl->val becomes the current
+// value and a range update which clamps the current value sets the control again.
+
+#include <errno.h>
+#include <stdlib.h>
+#include <media/v4l2-async.h>
+#include <media/v4l2-ctrls.h>
+#include <media/v4l2-event.h>
+#include <media/v4l2-fwnode.h>
+#include <media/v4l2-subdev.h>
+#include "vc_host.h"
+
+struct vc_host_std_ctrl {
+	u32 id;
+	const char *name;
+	enum v4l2_ctrl_type type;
+	u32 flags;
+};
+
+// v4l2_ctrl_fill() for the standard controls of the driver
+static const struct vc_host_std_ctrl vc_host_std_ctrls[] = {
+	{ V4L2_CID_EXPOSURE, "Exposure", V4L2_CTRL_TYPE_INTEGER, 0 },
+	{ V4L2_CID_GAIN, "Gain", V4L2_CTRL_TYPE_INTEGER, 0 },
+	{ V4L2_CID_ANALOGUE_GAIN, "Analogue Gain", V4L2_CTRL_TYPE_INTEGER, 0 },
+	{ V4L2_CID_BLACK_LEVEL, "Black Level", V4L2_CTRL_TYPE_INTEGER, 0 },
+	{ V4L2_CID_VBLANK, "Vertical Blanking", V4L2_CTRL_TYPE_INTEGER, 0 },
+	{ V4L2_CID_HBLANK, "Horizontal Blanking", V4L2_CTRL_TYPE_INTEGER, 0 },
+	{ V4L2_CID_PIXEL_RATE, "Pixel Rate", V4L2_CTRL_TYPE_INTEGER64, V4L2_CTRL_FLAG_READ_ONLY },
+	{ V4L2_CID_LINK_FREQ, "Link Frequency", V4L2_CTRL_TYPE_INTEGER_MENU, 0 },
+	{ V4L2_CID_TEST_PATTERN, "Test Pattern", V4L2_CTRL_TYPE_MENU, 0 },
+};
+
+static const struct vc_host_std_ctrl *vc_host_find_std_ctrl(u32 id)
+{
+	int index;
+
+	for (index = 0; index < ARRAY_SIZE(vc_host_std_ctrls); index++) {
+		if (vc_host_std_ctrls[index].id == id)
+			return &vc_host_std_ctrls[index];
+	}
+	return NULL;
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Control handler
+
+int v4l2_ctrl_handler_init(struct v4l2_ctrl_handler *hdl, unsigned int nr_of_controls_hint)
+{
+	memset(hdl, 0, sizeof(*hdl));
+	mutex_init(&hdl->_lock);
+	hdl->lock = &hdl->_lock;
+	return 0;
+}
+
+void v4l2_ctrl_handler_free(struct v4l2_ctrl_handler *hdl)
+{
+	struct v4l2_ctrl *ctrl;
+	int index;
+
+	for (index = 0; index < hdl->num_ctrls; index++) {
+		ctrl = hdl->ctrls[index];
+		if (ctrl->p_new.p != &ctrl->val) {
+			free(ctrl->p_new.p);
+			free(ctrl->p_cur.p);
+		}
+		free(ctrl);
+	}
+	free(hdl->ctrls);
+	hdl->ctrls = NULL;
+	hdl->num_ctrls = 0;
+}
+
+struct v4l2_ctrl *v4l2_ctrl_find(struct v4l2_ctrl_handler *hdl, u32 id)
+{
+	int index;
+
+	for (index = 0; index < hdl->num_ctrls; index++) {
+		if (hdl->ctrls[index]->id == id)
+			return hdl->ctrls[index];
+	}
+	return NULL;
+}
+
+static u32 vc_host_elem_size(enum v4l2_ctrl_type type)
+{
+	switch (type) {
+	case V4L2_CTRL_TYPE_INTEGER64:
+		return sizeof(s64);
+	case V4L2_CTRL_TYPE_U8:
+		return sizeof(u8);
+	case V4L2_CTRL_TYPE_U16:
+		return sizeof(u16);
+	default:
+		return sizeof(s32);
+	}
+}
+
+static struct v4l2_ctrl *vc_host_ctrl_new(struct v4l2_ctrl_handler *hdl, const struct v4l2_ctrl_config *cfg, void *priv)
+{
+	struct v4l2_ctrl *ctrl;
+	struct v4l2_ctrl **ctrls;
+	u32 elems = 1;
+	u32 index;
+
+	if (hdl->error)
+		return NULL;
+	if (v4l2_ctrl_find(hdl, cfg->id) || cfg->min > cfg->max || cfg->def < cfg->min ||
+	    cfg->def > cfg->max || cfg->step == 0) {
+		hdl->error = -ERANGE;
+		return NULL;
+	}
+
+	ctrl = calloc(1, sizeof(*ctrl));
+	ctrls = realloc(hdl->ctrls, (hdl->num_ctrls + 1) * sizeof(*ctrls));
+	if (!ctrl || !ctrls) {
+		free(ctrl);
+		hdl->error = -ENOMEM;
+		return NULL;
+	}
+	hdl->ctrls = ctrls;
+
+	ctrl->handler = hdl;
+	ctrl->ops = cfg->ops;
+	ctrl->id = cfg->id;
+	ctrl->name = cfg->name;
+	ctrl->type = cfg->type;
+	ctrl->minimum = cfg->min;
+	ctrl->maximum = cfg->max;
+	ctrl->step = cfg->step;
+	ctrl->default_value = cfg->def;
+	ctrl->flags = cfg->flags;
+	ctrl->qmenu = cfg->qmenu;
+	ctrl->qmenu_int = cfg->qmenu_int;
+	ctrl->priv = priv;
+	ctrl->elem_size = cfg->elem_size ? cfg->elem_size : vc_host_elem_size(cfg->type);
+	for (index = 0; index < V4L2_CTRL_MAX_DIMS && cfg->dims[index]; index++) {
+		ctrl->dims[index] = cfg->dims[index];
+		elems *= cfg->dims[index];
+	}
+	ctrl->nr_of_dims = index;
+	ctrl->elems = elems;
+
+	if (ctrl->nr_of_dims) {
+		ctrl->p_new.p = calloc(elems, ctrl->elem_size);
+		ctrl->p_cur.p = calloc(elems, ctrl->elem_size);
+		for (index = 0; index < elems && ctrl->elem_size == sizeof(u32); index++) {
+			ctrl->p_new.p_u32[index] = cfg->def;
+			ctrl->p_cur.p_u32[index] = cfg->def;
+		}
+	} else {
+		ctrl->p_new.p = &ctrl->val;
+		ctrl->p_cur.p = &ctrl->cur.val;
+		if (ctrl->type == V4L2_CTRL_TYPE_INTEGER64)
+			ctrl->val64 = ctrl->cur.val64 = cfg->def;
+		else
+			ctrl->val = ctrl->cur.val = cfg->def;
+	}
+
+	hdl->ctrls[hdl->num_ctrls++] = ctrl;
+	return ctrl;
+}
+
+struct v4l2_ctrl *v4l2_ctrl_new_std(struct v4l2_ctrl_handler *hdl, const struct v4l2_ctrl_ops *ops,
+	u32 id, s64 min, s64 max, u64 step, s64 def)
+{
+	const struct vc_host_std_ctrl *std = vc_host_find_std_ctrl(id);
+	struct v4l2_ctrl_config cfg = {
+		.ops = ops, .id = id, .min = min, .max = max, .step = step, .def = def,
+	};
+
+	if (!std || std->type == V4L2_CTRL_TYPE_MENU || std->type == V4L2_CTRL_TYPE_INTEGER_MENU) {
+		hdl->error = -EINVAL;
+		return NULL;
+	}
+	cfg.name = std->name;
+	cfg.type = std->type;
+	cfg.flags = std->flags;
+	return vc_host_ctrl_new(hdl, &cfg, NULL);
+}
+
+struct v4l2_ctrl *v4l2_ctrl_new_std_menu_items(struct v4l2_ctrl_handler *hdl,
+	const struct v4l2_ctrl_ops *ops, u32 id, u8 max, u64 mask, u8 def, const char * const *qmenu)
+{
+	const struct vc_host_std_ctrl *std = vc_host_find_std_ctrl(id);
+	struct v4l2_ctrl_config cfg = {
+		.ops = ops, .id = id, .min = 0, .max = max, .step = 1, .def = def,
+		.menu_skip_mask = mask, .qmenu = qmenu,
+	};
+
+	if (!std || std->type != V4L2_CTRL_TYPE_MENU || !qmenu) {
+		hdl->error = -EINVAL;
+		return NULL;
+	}
+	cfg.name = std->name;
+	cfg.type = std->type;
+	return vc_host_ctrl_new(hdl, &cfg, NULL);
+}
+
+struct v4l2_ctrl *v4l2_ctrl_new_int_menu(struct v4l2_ctrl_handler *hdl,
+	const struct v4l2_ctrl_ops *ops, u32 id, u8 max, u8 def, const s64 *qmenu_int)
+{
+	const struct vc_host_std_ctrl *std = vc_host_find_std_ctrl(id);
+	struct v4l2_ctrl_config cfg = {
+		.ops = ops, .id = id, .min = 0, .max = max, .step = 1, .def = def,
+		.qmenu_int = qmenu_int,
+	};
+
+	if (!std || std->type != V4L2_CTRL_TYPE_INTEGER_MENU || !qmenu_int) {
+		hdl->error = -EINVAL;
+		return NULL;
+	}
+	cfg.name = std->name;
+	cfg.type = std->type;
+	return vc_host_ctrl_new(hdl, &cfg, NULL);
+}
+
+struct v4l2_ctrl *v4l2_ctrl_new_custom(struct v4l2_ctrl_handler *hdl,
+	const struct v4l2_ctrl_config *cfg, void *priv)
+{
+	return vc_host_ctrl_new(hdl, cfg, priv);
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Setting controls
+
+static size_t vc_host_ctrl_size(struct v4l2_ctrl *ctrl)
+{
+	return ctrl->nr_of_dims ? ctrl->elems * ctrl->elem_size : vc_host_elem_size(ctrl->type);
+}
+
+static int vc_host_ctrl_changed(struct v4l2_ctrl *ctrl)
+{
+	return memcmp(ctrl->p_new.p, ctrl->p_cur.p, vc_host_ctrl_size(ctrl)) != 0;
+}
+
+static void vc_host_cur_to_new(struct v4l2_ctrl *ctrl)
+{
+	memcpy(ctrl->p_new.p, ctrl->p_cur.p, vc_host_ctrl_size(ctrl));
+}
+
+// new_to_cur(): A changed value or range sends a control event.
+static void vc_host_new_to_cur(struct v4l2_ctrl *ctrl, int range_changed)
+{
+	int changed = vc_host_ctrl_changed(ctrl);
+
+	memcpy(ctrl->p_cur.p, ctrl->p_new.p, vc_host_ctrl_size(ctrl));
+	if (changed || range_changed)
+		ctrl->events++;
+}
+
+// set_ctrl() and try_or_set_cluster() for controls without cluster.
+static int vc_host_set_ctrl(struct v4l2_ctrl *ctrl, int range_changed)
+{
+	int ret;
+
+	if (!(ctrl->flags & V4L2_CTRL_FLAG_EXECUTE_ON_WRITE) && !vc_host_ctrl_changed(ctrl)) {
+		if (range_changed)
+			ctrl->events++;
+		return 0;
+	}
+	if (ctrl->ops && ctrl->ops->s_ctrl) {
+		ret = ctrl->ops->s_ctrl(ctrl);
+		if (ret)
+			return ret;
+	}
+	vc_host_new_to_cur(ctrl, range_changed);
+	return 0;
+}
+
+// validate_new(): Integers are rounded into the range, menus are checked.
+static int vc_host_validate_new(struct v4l2_ctrl *ctrl)
+{
+	u32 index;
+	s64 val;
+
+	switch (ctrl->type) {
+	case V4L2_CTRL_TYPE_INTEGER:
+	case V4L2_CTRL_TYPE_INTEGER64:
+		val = (ctrl->type == V4L2_CTRL_TYPE_INTEGER64) ? ctrl->val64 : ctrl->val;
+		val = clamp_t(s64, val, ctrl->minimum, ctrl->maximum);
+		val = ctrl->minimum + ((val - ctrl->minimum) / (s64)ctrl->step) * (s64)ctrl->step;
+		if (ctrl->type == V4L2_CTRL_TYPE_INTEGER64)
+			ctrl->val64 = val;
+		else
+			ctrl->val = val;
+		return 0;
+	case V4L2_CTRL_TYPE_MENU:
+	case V4L2_CTRL_TYPE_INTEGER_MENU:
+		if (ctrl->val < ctrl->minimum || ctrl->val > ctrl->maximum)
+			return -ERANGE;
+		return 0;
+	case V4L2_CTRL_TYPE_U32:
+		for (index = 0; index < ctrl->elems; index++) {
+			ctrl->p_new.p_u32[index] = clamp_t(s64, ctrl->p_new.p_u32[index],
+				ctrl->minimum, ctrl->maximum);
+		}
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+int __v4l2_ctrl_s_ctrl(struct v4l2_ctrl *ctrl, s32 val)
+{
+	lockdep_assert_held(ctrl->handler->lock);
+	ctrl->val = val;
+	return vc_host_set_ctrl(ctrl, 0);
+}
+
+int __v4l2_ctrl_s_ctrl_int64(struct v4l2_ctrl *ctrl, s64 val)
+{
+	lockdep_assert_held(ctrl->handler->lock);
+	ctrl->val64 = val;
+	return vc_host_set_ctrl(ctrl, 0);
+}
+
+int v4l2_ctrl_s_ctrl(struct v4l2_ctrl *ctrl, s32 val)
+{
+	int ret;
+
+	v4l2_ctrl_lock(ctrl);
+	ret = __v4l2_ctrl_s_ctrl(ctrl, val);
+	v4l2_ctrl_unlock(ctrl);
+
+	return ret;
+}
+
+s32 v4l2_ctrl_g_ctrl(struct v4l2_ctrl *ctrl)
+{
+	s32 val;
+
+	v4l2_ctrl_lock(ctrl);
+	val = ctrl->cur.val;
+	v4l2_ctrl_unlock(ctrl);
+
+	return val;
+}
+
+int __v4l2_ctrl_modify_range(struct v4l2_ctrl *ctrl, s64 min, s64 max, u64 step, s64 def)
+{
+	int range_changed = 0;
+
+	lockdep_assert_held(ctrl->handler->lock);
+
+	if (min > max || step == 0 || def < min || def > max)
+		return -ERANGE;
+	if (ctrl->minimum != min || ctrl->maximum != max || ctrl->step != step ||
+	    ctrl->default_value != def) {
+		range_changed = 1;
+		ctrl->minimum = min;
+		ctrl->maximum = max;
+		ctrl->step = step;
+		ctrl->default_value = def;
+	}
+	vc_host_cur_to_new(ctrl);
+	vc_host_validate_new(ctrl);
+	// A clamped value is set like a new value, s_ctrl is called.
+	return vc_host_set_ctrl(ctrl, range_changed);
+}
+
+int vc_host_ctrl_s_user(struct v4l2_ctrl *ctrl, s64 val)
+{
+	int ret;
+
+	if (ctrl->flags & V4L2_CTRL_FLAG_READ_ONLY)
+		return -EACCES;
+
+	v4l2_ctrl_lock(ctrl);
+	if (ctrl->type == V4L2_CTRL_TYPE_INTEGER64)
+		ctrl->val64 = val;
+	else
+		ctrl->val = val;
+	ret = vc_host_validate_new(ctrl);
+	if (ret == 0)
+		ret = vc_host_set_ctrl(ctrl, 0);
+	if (ret)
+		vc_host_cur_to_new(ctrl);
+	v4l2_ctrl_unlock(ctrl);
+
+	return ret;
+}
+
+int vc_host_ctrl_s_user_array(struct v4l2_ctrl *ctrl, const u32 *values, u32 count)
+{
+	int ret;
+
+	if (ctrl->flags & V4L2_CTRL_FLAG_READ_ONLY)
+		return -EACCES;
+	if (!ctrl->nr_of_dims || ctrl->elem_size != sizeof(u32) || count > ctrl->elems)
+		return -EINVAL;
+
+	v4l2_ctrl_lock(ctrl);
+	memset(ctrl->p_new.p, 0, ctrl->elems * ctrl->elem_size);
+	memcpy(ctrl->p_new.p, values, count * sizeof(u32));
+	ret = vc_host_validate_new(ctrl);
+	if (ret == 0)
+		ret = vc_host_set_ctrl(ctrl, 0);
+	if (ret)
+		vc_host_cur_to_new(ctrl);
+	v4l2_ctrl_unlock(ctrl);
+
+	return ret;
+}
+
+int v4l2_ctrl_subdev_subscribe_event(struct v4l2_subdev *sd, struct v4l2_fh *fh,
+	struct v4l2_event_subscription *sub)
+{
+	return 0;
+}
+
+int v4l2_event_subdev_unsubscribe(struct v4l2_subdev *sd, struct v4l2_fh *fh,
+	struct v4l2_event_subscription *sub)
+{
+	return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Sub device and media entity
+
+void v4l2_i2c_subdev_init(struct v4l2_subdev *sd, struct i2c_client *client,
+	const struct v4l2_subdev_ops *ops)
+{
+	memset(sd, 0, sizeof(*sd));
+	sd->ops = ops;
+	sd->flags = V4L2_SUBDEV_FL_IS_I2C;
+	sd->dev = &client->dev;
+	snprintf(sd->name, sizeof(sd->name), "%s %s", client->name, client->dev.name);
+	i2c_set_clientdata(client, sd);
+}
+
+int v4l2_async_register_subdev_sensor_common(struct v4l2_subdev *sd)
+{
+	return 0;
+}
+
+void v4l2_async_unregister_subdev(struct v4l2_subdev *sd)
+{
+}
+
+int media_entity_pads_init(struct media_entity *entity, u16 num_pads, struct media_pad *pads)
+{
+	u16 index;
+
+	entity->num_pads = num_pads;
+	entity->pads = pads;
+	for (index = 0; index < num_pads; index++) {
+		pads[index].entity = entity;
+		pads[index].index = index;
+	}
+	return 0;
+}
+
+void media_entity_cleanup(struct media_entity *entity)
+{
+}
+
+int v4l2_fwnode_endpoint_parse(struct fwnode_handle *fwnode, struct v4l2_fwnode_endpoint *vep)
+{
+	const char *lanes = vc_host_of_get(to_of_node(fwnode), "data-lanes");
+	struct v4l2_fwnode_bus_mipi_csi2 *bus = &vep->bus.mipi_csi2;
+	char *end;
+
+	memset(vep, 0, sizeof(*vep));
+	if (!lanes)
+		return -ENXIO;
+
+	vep->bus_type = V4L2_MBUS_CSI2_DPHY;
+	while (*lanes && bus->num_data_lanes < ARRAY_SIZE(bus->data_lanes)) {
+		bus->data_lanes[bus->num_data_lanes] = strtoul(lanes, &end, 0);
+		if (end == lanes)
+			break;
+		bus->num_data_lanes++;
+		lanes = end;
+	}
+	return 0;
+}
@@ -0,0 +1,131 @@
+// Runs the KUnit suites of the driver on the host (see include/kunit/test.h)
+//
+// Usage: vckunit [-v] [suite ...]
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <kunit/test.h>
+#include "vc_host.h"
+
+static struct kunit_suite *vckunit_suites[8];
+static int vckunit_num_suites;
+
+void vc_host_kunit_register(struct kunit_suite *suite)
+{
+	if (vckunit_num_suites < ARRAY_SIZE(vckunit_suites))
+		vckunit_suites[vckunit_num_suites++] = suite;
+}
+
+void *kunit_kzalloc(struct kunit *test, size_t size, gfp_t gfp)
+{
+	void **allocs = realloc(test->allocs, (test->num_allocs + 1) * sizeof(*allocs));
+	void *p = calloc(1, size);
+
+	if (!allocs || !p) {
+		free(p);
+		return NULL;
+	}
+	test->allocs = allocs;
+	test->allocs[test->num_allocs++] = p;
+	return p;
+}
+
+void vc_host_kunit_fail(struct kunit *test, int assert, const char *file, int line,
+	const char *fmt, ...)
+{
+	va_list args;
+
+	fprintf(stderr, "    # %s: %s failed at %s:%d\n    # ", test->name,
+		assert ? "ASSERTION" : "EXPECTATION", file, line);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+
+	test->failed = 1;
+	if (assert)
+		longjmp(test->abort, 1);
+}
+
+static int vckunit_run_case(struct kunit_suite *suite, struct kunit_case *test_case)
+{
+	struct kunit test = { .name = test_case->name };
+	int index;
+
+	if (setjmp(test.abort) == 0) {
+		if (suite->init == NULL || suite->init(&test) == 0) {
+			test_case->run_case(&test);
+			if (suite->exit)
+				suite->exit(&test);
+		} else {
+			test.failed = 1;
+		}
+	}
+	for (index = 0; index < test.num_allocs; index++)
+		free(test.allocs[index]);
+	free(test.allocs);
+
+	return test.failed;
+}
+
+static int vckunit_selected(int argc, char **argv, const char *name)
+{
+	int index;
+
+	for (index = 0; index < argc; index++) {
+		if (strcmp(argv[index], name) == 0)
+			return 1;
+	}
+	return argc == 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct kunit_case *test_case;
+	struct kunit_suite *suite;
+	int failures = 0;
+	int cases = 0;
+	int index, number, failed, suite_failures;
+	int opt;
+
+	vc_host_set_loglevel(LOGLEVEL_ERR - 1);
+	while ((opt = getopt(argc, argv, "v")) != -1) {
+		switch (opt) {
+		case 'v':
+			vc_host_set_loglevel(LOGLEVEL_DEBUG);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-v] [suite ...]\n", argv[0]);
+			return 2;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	printf("TAP version 14\n");
+	for (index = 0; index < vckunit_num_suites; index++) {
+		suite = vckunit_suites[index];
+		if (!vckunit_selected(argc, argv, suite->name))
+			continue;
+		printf("    # Subtest: %s\n", suite->name);
+		suite_failures = 0;
+		for (number = 0, test_case = suite->test_cases; test_case->run_case; test_case++) {
+			failed = vckunit_run_case(suite, test_case);
+			printf("    %s %d - %s\n", failed ? "not ok" : "ok", ++number, test_case->name);
+			suite_failures += failed;
+		}
+		printf("%s %d - %s\n", suite_failures || number == 0 ? "not ok" : "ok", index + 1, suite->name);
+		failures += suite_failures || number == 0;
+		cases += number;
+	}
+	// A suite which isn't compiled in (e.g. a lost include) must not pass silently.
+	if (cases == 0) {
+		printf("not ok 1 - no test cases ran\n");
+		return 1;
+	}
+
+	return failures ? 1 : 0;
+}
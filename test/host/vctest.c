@@ -0,0 +1,903 @@
+// Regression tests of the VC MIPI driver against the module emulator (see vc_host.h)
+//
+// Each test binds the driver to a freshly probed emulator, so that the tests of a module don't
+// depend on each other. Usage: vctest [-v] [-P] [-c <file>] [-p <sensor>] [test ...]
+//
+// -P selects the emulated module by the module parameter profile instead of the DT property mod_id.
+// -c writes the bus-cost lines of the driver as CSV (same columns as buscost.sh --emulator). The
+//    module is ready without delay, so that the number of status polls and the rows are stable.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
+#include <linux/vc_mipi_camera.h>
+#include <media/v4l2-ctrls.h>
+#include <media/v4l2-subdev.h>
+#include "vc_host.h"
+
+struct vctest_profile {
+	const char *sensor;
+	const char *mod_id;
+	const char *num_lanes;
+	const char *data_lanes;
+};
+
+static const struct vctest_profile vctest_profiles[] = {
+	{ "IMX178", "0x0178", "4", "1 2 3 4" },
+	{ "IMX183", "0x0183", "2", "1 2" },
+	{ "IMX226", "0x0226", "4", "1 2 3 4" },
+	{ "IMX250", "0x0250", "2", "1 2" },
+	{ "IMX252", "0x0252", "4", "1 2 3 4" },
+	{ "IMX264", "0x0264", "2", "1 2" },
+	{ "IMX265", "0x0265", "2", "1 2" },
+	{ "IMX273", "0x0273", "4", "1 2 3 4" },
+	{ "IMX290", "0x0290", "2", "1 2" },
+	{ "IMX296", "0x0296", "1", "1" },
+	{ "IMX327", "0x0327", "2", "1 2" },
+	{ "IMX392", "0x0392", "2", "1 2" },
+	{ "IMX412", "0x0412", "2", "1 2" },
+	{ "IMX415", "0x0415", "2", "1 2" },
+	{ "OV9281", "0x9281", "2", "1 2" },
+};
+
+struct vctest_emu_stats {
+	unsigned int transfers;
+	unsigned int faults;
+	unsigned int resets;
+	unsigned int mode_errors;
+	unsigned int stream_starts;
+	unsigned int single_triggers;
+};
+
+// Device tree and devices of one test
+struct vctest {
+	const struct vctest_profile *profile;
+	struct property emu_props[5];
+	struct property cam_props[5];
+	struct property ep_props[2];
+	struct device_node emu_node;
+	struct device_node cam_node;
+	struct device_node port_node;
+	struct device_node ep_node;
+	struct platform_device pdev;
+	struct v4l2_subdev *sd;
+	struct v4l2_ctrl_handler *hdl;
+	int errors;			// Driver messages with level error
+};
+
+static int vctest_verbose;
+static int vctest_profile_param;
+static FILE *vctest_csv;
+static int vctest_failures;
+static const char *vctest_name;
+
+#define CHECK(test, cond) \
+	vctest_check(test, cond, #cond, __FILE__, __LINE__)
+
+static int vctest_check(struct vctest *test, int cond, const char *expr, const char *file, int line)
+{
+	if (!cond) {
+		fprintf(stderr, "FAIL %s/%s: %s:%d: %s\n", test->profile->sensor, vctest_name, file,
+			line, expr);
+		vctest_failures++;
+	}
+	return cond;
+}
+
+// Writes the values of a bus-cost line as CSV row, prefixed with the profile.
+static void vctest_csv_row(struct vctest *test, const char *line)
+{
+	char row[256];
+	const char *value;
+	int len;
+
+	len = snprintf(row, sizeof(row), "%s", test->profile->sensor);
+	while ((value = strchr(line, '=')) != NULL) {
+		value++;
+		line = value + strcspn(value, " \n");
+		len += snprintf(row + len, sizeof(row) - len, ",%.*s", (int)(line - value), value);
+		if (len >= sizeof(row))
+			return;
+	}
+	fprintf(vctest_csv, "%s\n", row);
+}
+
+static void vctest_log(int level, const char *msg, void *data)
+{
+	struct vctest *test = data;
+	const char *line;
+
+	// Messages of concurrent tests come from several threads.
+	if (level <= LOGLEVEL_ERR)
+		__sync_fetch_and_add(&test->errors, 1);
+	if (vctest_csv && (line = strstr(msg, "bus-cost ")) != NULL)
+		vctest_csv_row(test, line);
+}
+
+static void vctest_params_default(void)
+{
+	vc_host_set_param("ready_delay_ms", vctest_csv ? "0" : "20");
+	vc_host_set_param("latency_us", "0");
+	vc_host_set_param("bus_khz", "0");
+	vc_host_set_param("fault_rate", "0");
+	vc_host_set_param("fail_ready", "0");
+	vc_host_set_param("profile", "");
+}
+
+static int vctest_setup(struct vctest *test, const struct vctest_profile *profile, const char *watchdog_ms)
+{
+	struct i2c_adapter *adap;
+	struct i2c_client *client;
+	int ret;
+
+	memset(test, 0, sizeof(*test));
+	test->profile = profile;
+
+	test->ep_props[0] = (struct property){ "data-lanes", profile->data_lanes };
+	test->ep_node = (struct device_node){ .name = "endpoint", .properties = test->ep_props };
+	test->port_node = (struct device_node){ .name = "port", .properties = test->ep_props + 1,
+		.child = &test->ep_node };
+	test->cam_props[0] = (struct property){ "compatible", "vc,vc_mipi" };
+	test->cam_props[1] = (struct property){ "reg", "0x1a" };
+	test->cam_props[2] = (struct property){ "num_lanes", profile->num_lanes };
+	if (watchdog_ms)
+		test->cam_props[3] = (struct property){ "watchdog_ms", watchdog_ms };
+	test->cam_node = (struct device_node){ .name = "imx_mipi", .properties = test->cam_props,
+		.child = &test->port_node };
+	test->emu_props[0] = (struct property){ "compatible", "vc,vc_mipi_emu" };
+	if (vctest_profile_param)
+		vc_host_set_param("profile", profile->sensor);
+	else
+		test->emu_props[1] = (struct property){ "mod_id", profile->mod_id };
+	test->emu_node = (struct device_node){ .name = "vc_mipi_emu", .properties = test->emu_props,
+		.child = &test->cam_node };
+	test->pdev.name = "vc-mipi-emu";
+	test->pdev.dev.of_node = &test->emu_node;
+	strscpy(test->pdev.dev.name, "vc_mipi_emu", sizeof(test->pdev.dev.name));
+
+	vc_host_set_log_hook(vctest_log, test);
+
+	ret = vc_host_platform_probe("vc-mipi-emu", &test->pdev);
+	if (!CHECK(test, ret == 0))
+		return -1;
+	adap = vc_host_i2c_find_adapter(profile->sensor);
+	client = adap ? vc_host_i2c_find_client(adap, 0x1a) : NULL;
+	test->sd = client ? i2c_get_clientdata(client) : NULL;
+	if (!CHECK(test, test->sd != NULL)) {
+		vc_host_platform_remove(&test->pdev);
+		return -1;
+	}
+	test->hdl = test->sd->ctrl_handler;
+	return 0;
+}
+
+static void vctest_teardown(struct vctest *test)
+{
+	vc_host_platform_remove(&test->pdev);
+	vc_host_set_log_hook(NULL, NULL);
+	vctest_params_default();
+}
+
+static void vctest_emu_stats(struct vctest *test, struct vctest_emu_stats *stats)
+{
+	char buf[256];
+
+	memset(stats, 0, sizeof(*stats));
+	if (vc_host_attr_show(&test->pdev.dev, "stats", buf, sizeof(buf)) <= 0)
+		return;
+	sscanf(buf, "transfers %u\nfaults %u\nresets %u\nmode_errors %u\nstream_starts %u\n"
+		"single_triggers %u\n", &stats->transfers, &stats->faults, &stats->resets,
+		&stats->mode_errors, &stats->stream_starts, &stats->single_triggers);
+}
+
+static struct v4l2_ctrl *vctest_ctrl(struct vctest *test, u32 id)
+{
+	return v4l2_ctrl_find(test->hdl, id);
+}
+
+static int vctest_stream(struct vctest *test, int enable)
+{
+	return test->sd->ops->video->s_stream(test->sd, enable);
+}
+
+static int vctest_set_fmt(struct vctest *test, u32 code, u32 width, u32 height)
+{
+	struct v4l2_subdev_format format = {
+		.which = V4L2_SUBDEV_FORMAT_ACTIVE,
+		.format = { .code = code, .width = width, .height = height },
+	};
+
+	return test->sd->ops->pad->set_fmt(test->sd, NULL, &format);
+}
+
+// Reads a register of the emulated sensor (-1 on error).
+static int vctest_read_sen(struct vctest *test, u16 addr)
+{
+	struct i2c_adapter *adap = vc_host_i2c_find_adapter("VC MIPI emulator");
+	u8 tx[2] = { addr >> 8, addr & 0xff };
+	u8 rx[1];
+	struct i2c_msg msgs[2] = {
+		{ .addr = 0x1a, .flags = 0, .len = 2, .buf = tx },
+		{ .addr = 0x1a, .flags = I2C_M_RD, .len = 1, .buf = rx },
+	};
+
+	if (!adap || i2c_transfer(adap, msgs, 2) != 2)
+		return -1;
+	return rx[0];
+}
+
+static void vctest_get_fmt(struct vctest *test, struct v4l2_mbus_framefmt *mf)
+{
+	struct v4l2_subdev_format format = { .which = V4L2_SUBDEV_FORMAT_ACTIVE };
+
+	test->sd->ops->pad->get_fmt(test->sd, NULL, &format);
+	*mf = format.format;
+}
+
+// ------------------------------------------------------------------------------------------------
+//  Tests
+
+// The driver probes the module and publishes the standard controls.
+static void test_probe(struct vctest *test)
+{
+	struct v4l2_mbus_framefmt mf;
+	struct v4l2_ctrl *ctrl;
+
+	CHECK(test, test->errors == 0);
+	CHECK(test, vctest_ctrl(test, V4L2_CID_EXPOSURE) != NULL);
+	CHECK(test, vctest_ctrl(test, V4L2_CID_GAIN) != NULL);
+	ctrl = vctest_ctrl(test, V4L2_CID_PIXEL_RATE);
+	if (CHECK(test, ctrl != NULL))
+		CHECK(test, ctrl->cur.val64 > 0);
+	ctrl = vctest_ctrl(test, V4L2_CID_LINK_FREQ);
+	if (CHECK(test, ctrl != NULL))
+		CHECK(test, ctrl->qmenu_int[ctrl->cur.val] > 0);
+
+	vctest_get_fmt(test, &mf);
+	CHECK(test, mf.width > 0 && mf.height > 0);
+	CHECK(test, mf.code != 0);
+}
+
+// The first stream start resets the module into the mode, a restart with the same mode doesn't.
+static void test_stream(struct vctest *test)
+{
+	struct vctest_emu_stats before, cold, warm;
+
+	vctest_emu_stats(test, &before);
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+	vctest_emu_stats(test, &cold);
+	CHECK(test, cold.resets > before.resets);
+	CHECK(test, cold.stream_starts == before.stream_starts + 1);
+	CHECK(test, cold.mode_errors == 0);
+
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+	vctest_emu_stats(test, &warm);
+	CHECK(test, warm.resets == cold.resets);
+	CHECK(test, warm.stream_starts == cold.stream_starts + 1);
+	CHECK(test, test->errors == 0);
+}
+
+// Controls are clamped to their range and applied while streaming.
+static void test_controls(struct vctest *test)
+{
+	struct v4l2_ctrl *exposure = vctest_ctrl(test, V4L2_CID_EXPOSURE);
+	struct v4l2_ctrl *gain = vctest_ctrl(test, V4L2_CID_GAIN);
+	struct v4l2_ctrl *pixel_rate = vctest_ctrl(test, V4L2_CID_PIXEL_RATE);
+	struct vctest_emu_stats before, after;
+
+	if (!CHECK(test, exposure && gain && pixel_rate))
+		return;
+
+	CHECK(test, vctest_stream(test, 1) == 0);
+	vctest_emu_stats(test, &before);
+
+	CHECK(test, vc_host_ctrl_s_user(exposure, exposure->maximum + 1000) == 0);
+	CHECK(test, exposure->cur.val == exposure->maximum);
+	CHECK(test, vc_host_ctrl_s_user(exposure, exposure->minimum) == 0);
+	CHECK(test, exposure->cur.val == exposure->minimum);
+	CHECK(test, vc_host_ctrl_s_user(gain, gain->maximum) == 0);
+	CHECK(test, gain->cur.val == gain->maximum);
+	CHECK(test, vc_host_ctrl_s_user(pixel_rate, 1) == -EACCES);
+
+	vctest_emu_stats(test, &after);
+	CHECK(test, after.transfers > before.transfers);
+	CHECK(test, after.resets == before.resets);
+
+	CHECK(test, vctest_stream(test, 0) == 0);
+	CHECK(test, test->errors == 0);
+}
+
+// A smaller frame is set as ROI of the selected mode.
+static void test_format(struct vctest *test)
+{
+	struct v4l2_mbus_framefmt mf, roi;
+
+	vctest_get_fmt(test, &mf);
+	CHECK(test, vctest_set_fmt(test, mf.code, mf.width / 2, mf.height / 2) == 0);
+	vctest_get_fmt(test, &roi);
+	CHECK(test, roi.code == mf.code);
+	CHECK(test, roi.width <= mf.width / 2 && roi.width > 0);
+	CHECK(test, roi.height <= mf.height / 2 && roi.height > 0);
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+	CHECK(test, test->errors == 0);
+}
+
+// While streaming the crop rectangle can only be moved on modules with register hold. A move
+// which fails keeps the last position.
+static void test_pan(struct vctest *test)
+{
+	struct v4l2_subdev_selection sel = {
+		.which = V4L2_SUBDEV_FORMAT_ACTIVE,
+		.target = V4L2_SEL_TGT_CROP,
+	};
+	struct v4l2_mbus_framefmt mf;
+	int hold = !strcmp(test->profile->sensor, "IMX290") || !strcmp(test->profile->sensor, "IMX327") ||
+		!strcmp(test->profile->sensor, "IMX415");
+
+	vctest_get_fmt(test, &mf);
+	CHECK(test, vctest_set_fmt(test, mf.code, mf.width / 2, mf.height / 2) == 0);
+	vctest_get_fmt(test, &mf);
+	CHECK(test, vctest_stream(test, 1) == 0);
+
+	sel.r = (struct v4l2_rect){ 64, 64, mf.width, mf.height };
+	if (hold) {
+		CHECK(test, test->sd->ops->pad->set_selection(test->sd, NULL, &sel) == 0);
+		CHECK(test, sel.r.left == 64 && sel.r.top == 64);
+		CHECK(test, test->errors == 0);
+
+		vc_host_set_param("fault_rate", "1000");
+		sel.r = (struct v4l2_rect){ 128, 128, mf.width, mf.height };
+		CHECK(test, test->sd->ops->pad->set_selection(test->sd, NULL, &sel) != 0);
+		CHECK(test, sel.r.left == 64 && sel.r.top == 64);
+		vc_host_set_param("fault_rate", "0");
+	} else {
+		CHECK(test, test->sd->ops->pad->set_selection(test->sd, NULL, &sel) == -EBUSY);
+		CHECK(test, sel.r.left == 0 && sel.r.top == 0);
+	}
+	CHECK(test, vctest_stream(test, 0) == 0);
+}
+
+// No module supports the multi ROI readout yet. A list with windows is rejected, the empty list
+// (single ROI) is accepted.
+static void test_multi_roi(struct vctest *test)
+{
+	struct v4l2_ctrl *multi_roi = vctest_ctrl(test, V4L2_CID_MULTI_ROI);
+	const u32 windows[] = { 0, 0, 64, 64, 128, 128, 64, 64 };
+
+	if (!CHECK(test, multi_roi != NULL))
+		return;
+	CHECK(test, vc_host_ctrl_s_user_array(multi_roi, windows, ARRAY_SIZE(windows)) == -EINVAL);
+	CHECK(test, multi_roi->p_cur.p_u32[2] == 0);
+	CHECK(test, vc_host_ctrl_s_user_array(multi_roi, windows, 0) == 0);
+	test->errors = 0;
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+	CHECK(test, test->errors == 0);
+}
+
+// A VBLANK which is clamped by the range of a new format is only cached. It is written with the
+// exposure when the stream starts.
+static void test_vblank(struct vctest *test)
+{
+	struct v4l2_ctrl *vblank = vctest_ctrl(test, V4L2_CID_VBLANK);
+	struct vctest_emu_stats before, after;
+	struct v4l2_mbus_framefmt mf;
+	s64 maximum;
+
+	if (!vblank)
+		return;
+
+	vctest_get_fmt(test, &mf);
+	CHECK(test, vctest_set_fmt(test, mf.code, mf.width, mf.height / 2) == 0);
+	CHECK(test, vc_host_ctrl_s_user(vblank, vblank->maximum) == 0);
+	maximum = vblank->cur.val;
+
+	vctest_emu_stats(test, &before);
+	CHECK(test, vctest_set_fmt(test, mf.code, mf.width, mf.height) == 0);
+	vctest_emu_stats(test, &after);
+	CHECK(test, vblank->maximum < maximum);
+	CHECK(test, vblank->cur.val == vblank->maximum);
+	CHECK(test, after.transfers == before.transfers);
+
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+	CHECK(test, test->errors == 0);
+}
+
+// Lost transfers make single operations fail, but the driver recovers as soon as the bus is
+// working again.
+static void test_faults(struct vctest *test)
+{
+	struct v4l2_ctrl *gain = vctest_ctrl(test, V4L2_CID_GAIN);
+	struct vctest_emu_stats stats;
+	int cycle, value;
+
+	vc_host_set_param("fault_rate", "100");
+	for (cycle = 0; cycle < 10; cycle++) {
+		vctest_stream(test, 1);
+		vctest_stream(test, 0);
+	}
+	vctest_emu_stats(test, &stats);
+	CHECK(test, stats.faults > 0);
+
+	// A control which can't be written reports the error and keeps its value.
+	vc_host_set_param("fault_rate", "1000");
+	value = gain->cur.val;
+	CHECK(test, vc_host_ctrl_s_user(gain, value + 1) != 0);
+	CHECK(test, gain->cur.val == value);
+
+	vc_host_set_param("fault_rate", "0");
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+}
+
+// A module which reports an error after the power up or doesn't get ready fails the stream start
+// instead of streaming in an unknown state. It works again after the next reset.
+static void test_fail_ready(struct vctest *test)
+{
+	struct vctest_emu_stats stats;
+
+	// A module which doesn't get ready isn't started, the timeout is reported as it is.
+	vc_host_set_param("ready_delay_ms", "5000");
+	CHECK(test, vctest_stream(test, 1) == -ETIMEDOUT);
+	vctest_emu_stats(test, &stats);
+	CHECK(test, stats.stream_starts == 0);
+	vc_host_set_param("ready_delay_ms", "20");
+
+	vc_host_set_param("fail_ready", "1");
+	CHECK(test, vctest_stream(test, 1) != 0);
+	CHECK(test, test->errors > 0);
+
+	vc_host_set_param("fail_ready", "0");
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+
+}
+
+// A format without matching mode is rejected when the stream is started.
+static void test_no_mode(struct vctest *test)
+{
+	struct vctest_emu_stats before, after;
+	struct v4l2_mbus_framefmt mf;
+
+	vctest_get_fmt(test, &mf);
+	vctest_emu_stats(test, &before);
+	vctest_set_fmt(test, MEDIA_BUS_FMT_RGB888_1X24, mf.width, mf.height);
+	vctest_get_fmt(test, &mf);
+	if (mf.code == MEDIA_BUS_FMT_RGB888_1X24)
+		CHECK(test, vctest_stream(test, 1) == -EINVAL);
+	vctest_emu_stats(test, &after);
+	CHECK(test, after.stream_starts == before.stream_starts);
+}
+
+// Stream control, format, crop and controls from concurrent threads. While the module boots the
+// driver releases the mutex. Stream control, format and crop wait for the end of the reset instead
+// of failing, controls only cache their values. If the module has two modes (by the trigger mode
+// or by the format), the stream thread switches between them, so that every stream start resets
+// the module.
+struct vctest_thread {
+	struct vctest *test;
+	pthread_t thread;
+	int trigger;		// Trigger mode with a module mode of its own, 0 = none
+	u32 codes[2];		// Formats of two module modes, codes[1] = 0 if there is only one
+	int failures;		// Operations which returned an error
+};
+
+#define VCTEST_STRESS_CYCLES	4
+
+static void *vctest_stream_thread(void *arg)
+{
+	struct vctest_thread *thread = arg;
+	struct vctest *test = thread->test;
+	struct v4l2_ctrl *trigger_mode = vctest_ctrl(test, V4L2_CID_TRIGGER_MODE);
+	struct v4l2_mbus_framefmt mf;
+	int cycle;
+
+	vctest_get_fmt(test, &mf);
+	for (cycle = 0; cycle < VCTEST_STRESS_CYCLES; cycle++) {
+		if (thread->trigger)
+			thread->failures += vc_host_ctrl_s_user(trigger_mode, (cycle & 1) ? 0 : thread->trigger) != 0;
+		else if (thread->codes[1])
+			thread->failures += vctest_set_fmt(test, thread->codes[!(cycle & 1)], mf.width, mf.height) != 0;
+		thread->failures += vctest_stream(test, 1) != 0;
+		usleep(10000);
+		thread->failures += vctest_stream(test, 0) != 0;
+	}
+	return NULL;
+}
+
+static void *vctest_format_thread(void *arg)
+{
+	struct vctest_thread *thread = arg;
+	struct vctest *test = thread->test;
+	struct v4l2_subdev_selection sel = { .which = V4L2_SUBDEV_FORMAT_ACTIVE, .target = V4L2_SEL_TGT_CROP };
+	struct v4l2_mbus_framefmt mf;
+	int cycle;
+
+	for (cycle = 0; cycle < 4 * VCTEST_STRESS_CYCLES; cycle++) {
+		vctest_get_fmt(test, &mf);
+		// The stream thread switches the format.
+		if (!thread->codes[1] || thread->trigger)
+			thread->failures += vctest_set_fmt(test, mf.code, mf.width, mf.height) != 0;
+		sel.r = (struct v4l2_rect){ 0, 0, mf.width, mf.height };
+		thread->failures += test->sd->ops->pad->set_selection(test->sd, NULL, &sel) != 0;
+		usleep(50000);
+	}
+	return NULL;
+}
+
+static void *vctest_ctrl_thread(void *arg)
+{
+	struct vctest_thread *thread = arg;
+	struct vctest *test = thread->test;
+	struct v4l2_ctrl *exposure = vctest_ctrl(test, V4L2_CID_EXPOSURE);
+	struct v4l2_ctrl *gain = vctest_ctrl(test, V4L2_CID_GAIN);
+	int cycle;
+
+	for (cycle = 0; cycle < 8 * VCTEST_STRESS_CYCLES; cycle++) {
+		thread->failures += vc_host_ctrl_s_user(exposure, exposure->minimum + cycle) != 0;
+		thread->failures += vc_host_ctrl_s_user(gain, gain->minimum + cycle) != 0;
+		usleep(25000);
+	}
+	return NULL;
+}
+
+// Returns if a stream start resets the module.
+static int vctest_stream_resets(struct vctest *test)
+{
+	struct vctest_emu_stats before, after;
+
+	vctest_emu_stats(test, &before);
+	vctest_stream(test, 1);
+	vctest_stream(test, 0);
+	vctest_emu_stats(test, &after);
+	return after.resets > before.resets;
+}
+
+// Finds a trigger mode and a format which need another module mode than the current ones.
+static void vctest_find_modes(struct vctest *test, int *trigger, u32 *code)
+{
+	static const u32 codes[] = {
+		MEDIA_BUS_FMT_Y10_1X10, MEDIA_BUS_FMT_Y12_1X12,
+		MEDIA_BUS_FMT_SRGGB10_1X10, MEDIA_BUS_FMT_SRGGB12_1X12,
+		MEDIA_BUS_FMT_SGBRG10_1X10, MEDIA_BUS_FMT_SGBRG12_1X12,
+	};
+	struct v4l2_ctrl *trigger_mode = vctest_ctrl(test, V4L2_CID_TRIGGER_MODE);
+	struct v4l2_mbus_framefmt mf;
+	int index;
+
+	*trigger = 0;
+	*code = 0;
+	vctest_get_fmt(test, &mf);
+	vctest_stream_resets(test);
+	for (index = 1; trigger_mode && index <= trigger_mode->maximum && !*trigger; index++) {
+		vc_host_ctrl_s_user(trigger_mode, index);
+		if (vctest_stream_resets(test))
+			*trigger = index;
+	}
+	if (trigger_mode)
+		vc_host_ctrl_s_user(trigger_mode, 0);
+	vctest_stream_resets(test);
+	for (index = 0; index < ARRAY_SIZE(codes) && !*code; index++) {
+		if (codes[index] == mf.code || vctest_set_fmt(test, codes[index], mf.width, mf.height))
+			continue;
+		if (vctest_stream_resets(test))
+			*code = codes[index];
+	}
+	vctest_set_fmt(test, mf.code, mf.width, mf.height);
+	vctest_stream_resets(test);
+	test->errors = 0;
+}
+
+// The IMX290 family offsets the test patterns by the black level. It is zeroed while a pattern
+// is active, also after a reset, and restored when the pattern is disabled.
+static void test_pattern_blacklevel(struct vctest *test)
+{
+	struct v4l2_ctrl *pattern = vctest_ctrl(test, V4L2_CID_TEST_PATTERN);
+	struct vctest_emu_stats before, after;
+	struct v4l2_mbus_framefmt mf;
+	int blacklevel, trigger;
+	u32 code;
+
+	if (strcmp(test->profile->sensor, "IMX290") && strcmp(test->profile->sensor, "IMX327"))
+		return;
+	if (!CHECK(test, pattern != NULL))
+		return;
+	vctest_find_modes(test, &trigger, &code);
+	if (!CHECK(test, code != 0))
+		return;
+
+	CHECK(test, vctest_stream(test, 1) == 0);
+	blacklevel = vctest_read_sen(test, 0x300a);
+	CHECK(test, blacklevel > 0);
+	CHECK(test, vc_host_ctrl_s_user(pattern, 1) == 0);
+	CHECK(test, vctest_read_sen(test, 0x300a) == 0);
+	CHECK(test, vc_host_ctrl_s_user(pattern, 2) == 0);
+	CHECK(test, vctest_read_sen(test, 0x300a) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+
+	// The reset into the mode of the new format loads the black level again.
+	vctest_get_fmt(test, &mf);
+	CHECK(test, vctest_set_fmt(test, code, mf.width, mf.height) == 0);
+	vctest_emu_stats(test, &before);
+	CHECK(test, vctest_stream(test, 1) == 0);
+	vctest_emu_stats(test, &after);
+	CHECK(test, after.resets > before.resets);
+	CHECK(test, vctest_read_sen(test, 0x300a) == 0);
+	CHECK(test, vc_host_ctrl_s_user(pattern, 0) == 0);
+	CHECK(test, vctest_read_sen(test, 0x300a) == blacklevel);
+	CHECK(test, vctest_stream(test, 0) == 0);
+	CHECK(test, test->errors == 0);
+}
+
+static void test_concurrency(struct vctest *test)
+{
+	struct vctest_thread threads[3];
+	struct vctest_emu_stats before, after;
+	struct v4l2_mbus_framefmt mf;
+	u32 alt_code;
+	int trigger;
+	int index;
+
+	vctest_find_modes(test, &trigger, &alt_code);
+	vctest_get_fmt(test, &mf);
+
+	vctest_emu_stats(test, &before);
+	for (index = 0; index < 3; index++) {
+		threads[index] = (struct vctest_thread){ .test = test, .trigger = trigger,
+			.codes = { mf.code, alt_code } };
+	}
+	pthread_create(&threads[0].thread, NULL, vctest_stream_thread, &threads[0]);
+	pthread_create(&threads[1].thread, NULL, vctest_format_thread, &threads[1]);
+	pthread_create(&threads[2].thread, NULL, vctest_ctrl_thread, &threads[2]);
+	for (index = 0; index < 3; index++) {
+		pthread_join(threads[index].thread, NULL);
+		CHECK(test, threads[index].failures == 0);
+	}
+	vctest_emu_stats(test, &after);
+
+	CHECK(test, after.stream_starts == before.stream_starts + VCTEST_STRESS_CYCLES);
+	if (trigger || alt_code)
+		CHECK(test, after.resets == before.resets + VCTEST_STRESS_CYCLES);
+	CHECK(test, test->errors == 0);
+}
+
+static void *vctest_streamon_thread(void *arg)
+{
+	struct vctest_thread *thread = arg;
+
+	thread->failures += vctest_stream(thread->test, 1) != 0;
+	return NULL;
+}
+
+// A trigger mode which is set while the module boots changes the planned mode. The stream start
+// resets the module again into the new mode instead of streaming in the old one.
+static void test_reset_revalidate(struct vctest *test)
+{
+	struct v4l2_ctrl *trigger_mode = vctest_ctrl(test, V4L2_CID_TRIGGER_MODE);
+	struct vctest_thread thread = { .test = test };
+	struct vctest_emu_stats before, stats;
+	u32 alt_code;
+
+	vctest_find_modes(test, &thread.trigger, &alt_code);
+	if (!thread.trigger)
+		return;
+
+	vctest_emu_stats(test, &before);
+	vc_host_ctrl_s_user(trigger_mode, thread.trigger);
+	pthread_create(&thread.thread, NULL, vctest_streamon_thread, &thread);
+	do {
+		usleep(1000);
+		vctest_emu_stats(test, &stats);
+	} while (stats.resets == before.resets);
+	CHECK(test, vc_host_ctrl_s_user(trigger_mode, 0) == 0);
+	pthread_join(thread.thread, NULL);
+	vctest_emu_stats(test, &stats);
+	CHECK(test, thread.failures == 0);
+	CHECK(test, stats.resets == before.resets + 2);
+	CHECK(test, stats.stream_starts == before.stream_starts + 1);
+
+	// The module is in the mode of the trigger mode which is set now.
+	CHECK(test, vctest_stream(test, 0) == 0);
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+	vctest_emu_stats(test, &stats);
+	CHECK(test, stats.resets == before.resets + 2);
+	CHECK(test, test->errors == 0);
+}
+
+// Resets the module behind the back of the driver, like a module which has stalled.
+static int vctest_reset_module(struct vctest *test)
+{
+	struct i2c_adapter *adap = vc_host_i2c_find_adapter("VC MIPI emulator");
+	u8 tx[3] = { 0x01, 0x00, 0x00 };
+	struct i2c_msg msg = { .addr = 0x10, .flags = 0, .len = 3, .buf = tx };
+
+	if (!adap || i2c_transfer(adap, &msg, 1) != 1)
+		return -1;
+	return 0;
+}
+
+// A recovery which waits for the module gives up on STREAMOFF, which doesn't wait for it. A failed
+// recovery leaves the stream stopped, is counted and the watchdog doesn't run anymore.
+static void test_watchdog(struct vctest *test)
+{
+	struct v4l2_ctrl *failures = vctest_ctrl(test, V4L2_CID_RECOVERY_FAILURES);
+	struct vctest_emu_stats before, after;
+	ktime_t start;
+
+	if (!CHECK(test, failures != NULL))
+		return;
+
+	// The module doesn't get ready within the timeout of the recovery.
+	CHECK(test, vctest_stream(test, 1) == 0);
+	vc_host_set_param("ready_delay_ms", "5000");
+	CHECK(test, vctest_reset_module(test) == 0);
+	usleep(300000);
+	start = ktime_get();
+	vctest_stream(test, 0);
+	CHECK(test, ktime_us_delta(ktime_get(), start) < 1000000);
+	vctest_emu_stats(test, &before);
+	usleep(300000);
+	vctest_emu_stats(test, &after);
+	CHECK(test, after.transfers == before.transfers);
+	CHECK(test, failures->cur.val == 0);
+
+	vc_host_set_param("ready_delay_ms", "20");
+	CHECK(test, vctest_stream(test, 1) == 0);
+	vc_host_set_param("ready_delay_ms", "5000");
+	CHECK(test, vctest_reset_module(test) == 0);
+	usleep(2500000);
+	vctest_emu_stats(test, &before);
+	usleep(300000);
+	vctest_emu_stats(test, &after);
+	CHECK(test, after.transfers == before.transfers);
+	CHECK(test, failures->cur.val == 1);
+
+	vc_host_set_param("ready_delay_ms", "20");
+	vctest_stream(test, 0);
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+}
+
+// The operations of buscost.sh. With -c their bus-cost lines are the rows of the CSV, which
+// make check compares with buscost.csv.
+static void test_buscost(struct vctest *test)
+{
+	struct v4l2_ctrl *exposure = vctest_ctrl(test, V4L2_CID_EXPOSURE);
+	struct v4l2_ctrl *gain = vctest_ctrl(test, V4L2_CID_GAIN);
+	struct v4l2_ctrl *trigger_mode = vctest_ctrl(test, V4L2_CID_TRIGGER_MODE);
+	struct v4l2_ctrl *single_trigger = vctest_ctrl(test, V4L2_CID_SINGLE_TRIGGER);
+	struct v4l2_mbus_framefmt mf;
+
+	if (!CHECK(test, exposure && gain))
+		return;
+
+	// set_fmt and STREAMON from cold, STREAMON from warm
+	vctest_get_fmt(test, &mf);
+	CHECK(test, vctest_set_fmt(test, mf.code, mf.width, mf.height) == 0);
+	CHECK(test, vctest_stream(test, 1) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+	CHECK(test, vctest_stream(test, 1) == 0);
+
+	// Exposure and gain change while streaming
+	CHECK(test, vc_host_ctrl_s_user(exposure, 20000) == 0);
+	CHECK(test, vc_host_ctrl_s_user(gain, 10) == 0);
+	CHECK(test, vctest_stream(test, 0) == 0);
+	CHECK(test, test->errors == 0);
+
+	// Trigger mode change and single trigger
+	if (trigger_mode && single_trigger) {
+		vc_host_ctrl_s_user(trigger_mode, 1);
+		vc_host_ctrl_s_user(single_trigger, 1);
+		vc_host_ctrl_s_user(trigger_mode, 0);
+	}
+}
+
+struct vctest_case {
+	const char *name;
+	void (*run)(struct vctest *test);
+	const char *watchdog_ms;	// Device tree property of the camera, NULL = no watchdog
+};
+
+static const struct vctest_case vctest_cases[] = {
+	{ "probe", test_probe },
+	{ "stream", test_stream },
+	{ "controls", test_controls },
+	{ "format", test_format },
+	{ "pan", test_pan },
+	{ "multi_roi", test_multi_roi },
+	{ "vblank", test_vblank },
+	{ "faults", test_faults },
+	{ "fail_ready", test_fail_ready },
+	{ "no_mode", test_no_mode },
+	{ "pattern_blacklevel", test_pattern_blacklevel },
+	{ "concurrency", test_concurrency },
+	{ "reset_revalidate", test_reset_revalidate },
+	{ "watchdog", test_watchdog, "100" },
+	{ "buscost", test_buscost },
+};
+
+static int vctest_selected(int argc, char **argv, const char *name)
+{
+	int index;
+
+	if (argc == 0)
+		return 1;
+	for (index = 0; index < argc; index++) {
+		if (strcmp(argv[index], name) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *sensor = NULL;
+	struct vctest test;
+	int profile, index, opt;
+	int runs = 0;
+
+	while ((opt = getopt(argc, argv, "vPc:p:")) != -1) {
+		switch (opt) {
+		case 'v':
+			vctest_verbose = 1;
+			break;
+		case 'P':
+			vctest_profile_param = 1;
+			break;
+		case 'c':
+			vctest_csv = fopen(optarg, "w");
+			if (!vctest_csv) {
+				perror(optarg);
+				return 2;
+			}
+			fprintf(vctest_csv, "profile,op,mod_id,transfers,msgs,bytes,bits,errors,sleep_us,"
+				"bus100k_us,bus400k_us\n");
+			break;
+		case 'p':
+			sensor = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-v] [-P] [-c <file>] [-p <sensor>] [test ...]\n", argv[0]);
+			return 2;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	vc_host_seed(1);
+	vc_host_set_loglevel(vctest_verbose ? LOGLEVEL_DEBUG : LOGLEVEL_ERR - 1);
+	vctest_params_default();
+
+	for (profile = 0; profile < ARRAY_SIZE(vctest_profiles); profile++) {
+		if (sensor && strcasecmp(sensor, vctest_profiles[profile].sensor))
+			continue;
+		for (index = 0; index < ARRAY_SIZE(vctest_cases); index++) {
+			if (!vctest_selected(argc, argv, vctest_cases[index].name))
+				continue;
+			vctest_name = vctest_cases[index].name;
+			if (vctest_setup(&test, &vctest_profiles[profile], vctest_cases[index].watchdog_ms) == 0) {
+				vctest_cases[index].run(&test);
+				vctest_teardown(&test);
+			}
+			runs++;
+			if (vctest_verbose)
+				printf("%s/%s done\n", vctest_profiles[profile].sensor, vctest_name);
+		}
+	}
+
+	if (vctest_csv)
+		fclose(vctest_csv);
+	printf("%d tests, %d failures\n", runs, vctest_failures);
+	return (runs == 0 || vctest_failures) ? 1 : 0;
+}